@@ -26,6 +26,13 @@ endif()
 
 list(APPEND CMU_DEFINES "ENABLE_GLDEBUG_P=${gldebug_val}")
 
+set(glcapture_val 0)
+if(ENABLE_GLCAPTURE)
+  set(glcapture_val 1)
+endif()
+
+list(APPEND CMU_DEFINES "ENABLE_GLCAPTURE_P=${glcapture_val}")
+
 set(EXECUTABLE_OUTPUT_PATH ${CMAKE_BINARY_DIR}/bin)
 set(LIBRARY_OUTPUT_PATH ${CMAKE_BINARY_DIR}/bin)
 
@@ -47,6 +54,7 @@ if(PKG_CONFIG_FOUND)
 endif()
 
 message(STATUS "ENABLE_ASAN=${ENABLE_ASAN}")
+message(STATUS "ENABLE_GLCAPTURE=${ENABLE_GLCAPTURE}")
 message(STATUS "ENABLE_GLDEBUG=${ENABLE_GLDEBUG}")
 message(STATUS "ENABLE_LTO=${ENABLE_LTO}")
 message(STATUS "ENABLE_LIBCXX=${ENABLE_LIBCXX}")
@@ -1,6 +1,7 @@
 #include "ge/Camera.hpp"
 #include "ge/Engine.hpp"
 #include "ge/MouseLookPlugin.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
 #include "glt/Transformations.hpp"
 #include "glt/primitives.hpp"
@@ -108,8 +109,8 @@ Anim::init(const ge::Event<ge::InitEvent> &ev)
     sphere(sphere_model, 1.f, 200, 100);
     sphere_model.send();
 
-    GL_CALL(glEnable, GL_DEPTH_TEST);
-    GL_CALL(glEnable, GL_MULTISAMPLE);
+    glt::stateCache().enable(GL_DEPTH_TEST);
+    glt::stateCache().enable(GL_MULTISAMPLE);
     light_position = vec3(0.f, 0.f, -100.f);
 
     ev.info.engine.enablePlugin(mouse_look);
@@ -1,5 +1,6 @@
 #include "math/vec3.hpp"
 
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
 #include "glt/utils.hpp"
 
@@ -164,17 +165,17 @@ Program::init(const ge::Event<ge::InitEvent> &ev)
     }
 
     quadStreamData.generate();
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, *quadStreamData);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, *quadStreamData);
     GL_CALL(glBufferData,
             GL_ARRAY_BUFFER,
             6 * sizeof(QuadStreamVertex),
             0,
             GL_STREAM_DRAW);
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, 0);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, 0);
 
     quadStreamArray.generate();
-    GL_CALL(glBindVertexArray, *quadStreamArray);
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, *quadStreamData);
+    glt::stateCache().bindVertexArray(*quadStreamArray);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, *quadStreamData);
     GL_CALL(glVertexAttribPointer,
             0,
             3,
@@ -189,11 +190,11 @@ Program::init(const ge::Event<ge::InitEvent> &ev)
             GL_FALSE,
             sizeof(QuadStreamVertex),
             (void *) offsetof(QuadStreamVertex, normal));
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, 0);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, 0);
 
     GL_CALL(glEnableVertexAttribArray, 0);
     GL_CALL(glEnableVertexAttribArray, 1);
-    GL_CALL(glBindVertexArray, 0);
+    glt::stateCache().bindVertexArray(0);
 
     quadStream.generate();
     GL_CALL(glBindTransformFeedback, GL_TRANSFORM_FEEDBACK, *quadStream);
@@ -202,7 +203,7 @@ Program::init(const ge::Event<ge::InitEvent> &ev)
 
     glt::GLQueryObject num_written_query;
     num_written_query.generate();
-    GL_CALL(glEnable, GL_RASTERIZER_DISCARD);
+    glt::stateCache().enable(GL_RASTERIZER_DISCARD);
     quadProgram->use();
     GL_CALL(glBeginQuery,
             GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN,
@@ -213,7 +214,7 @@ Program::init(const ge::Event<ge::InitEvent> &ev)
     GL_CALL(glEndTransformFeedback);
     GL_CALL(glEndQuery, GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
     GL_CALL(glBindTransformFeedback, GL_TRANSFORM_FEEDBACK, 0);
-    GL_CALL(glDisable, GL_RASTERIZER_DISCARD);
+    glt::stateCache().disable(GL_RASTERIZER_DISCARD);
 
     GL_CALL(glGetQueryObjectuiv,
             *num_written_query,
@@ -241,11 +242,11 @@ Program::render(const ge::Event<ge::RenderEvent> &)
     rm.activeRenderTarget()->clearColor(glt::color(0xFF, 0xFF, 0xFF));
     rm.activeRenderTarget()->clear();
     renderProgram->use();
-    GL_CALL(glBindVertexArray, *quadStreamArray);
+    glt::stateCache().bindVertexArray(*quadStreamArray);
     //    GL_CALL(glDrawTransformFeedbackInstanced, GL_TRIANGLES, *quadStream,
     //    1);
     GL_CALL(glDrawArraysInstanced, GL_TRIANGLES, 0, primitives_written * 3, 1);
-    GL_CALL(glBindVertexArray, 0);
+    glt::stateCache().bindVertexArray(0);
 }
 
 } // namespace
@@ -0,0 +1,498 @@
+#include "err/err.hpp"
+#include "glt/GLCapture.hpp"
+#include "opengl.hpp"
+#include "sys/clock.hpp"
+#include "sys/io.hpp"
+#include "sys/profile.hpp"
+#include "sys/sys.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Replays a capture written with --gl-capture (glt::glCaptureStart()) in a
+// fresh context and times every call. Object names are not remapped: the
+// replay issues the same calls in the same order and relies on the driver
+// handing out the same names, names and locations that differ are counted
+// as mismatches.
+
+using glt::GLArgKind;
+using glt::GLCallArg;
+using glt::GLCapturedCall;
+using glt::GLPayloadKind;
+
+namespace {
+
+sys::io::OutStream &out = sys::io::stdout();
+
+// size of the memory passed for each pointer GL writes to
+inline constexpr size_t OUT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+struct Replay
+{
+    const GLCapturedCall *call{};
+    std::vector<std::vector<char>> out_buffers;
+    std::vector<std::vector<const char *>> string_arrays;
+    std::unordered_map<uint64_t, GLsync> syncs;
+    uint64_t arg_mismatches{};
+
+    char *outBuffer(size_t arg)
+    {
+        if (out_buffers.size() <= arg)
+            out_buffers.resize(arg + 1);
+        if (out_buffers[arg].empty())
+            out_buffers[arg].resize(OUT_BUFFER_SIZE);
+        return out_buffers[arg].data();
+    }
+
+    const char *const *strings(size_t arg, std::string_view data)
+    {
+        if (string_arrays.size() <= arg)
+            string_arrays.resize(arg + 1);
+        auto &strs = string_arrays[arg];
+        strs.clear();
+
+        uint32_t count;
+        memcpy(&count, data.data(), sizeof count);
+        size_t pos = sizeof count;
+        for (uint32_t i = 0; i < count && pos < data.size(); ++i) {
+            uint32_t len;
+            memcpy(&len, data.data() + pos, sizeof len);
+            pos += sizeof len;
+            strs.push_back(data.data() + pos);
+            pos += len + 1;
+        }
+        return strs.data();
+    }
+};
+
+template<typename T>
+T
+decodeArg(Replay &r, size_t i)
+{
+    const auto &arg = r.call->args[i];
+    if constexpr (std::is_same_v<T, GLsync>) {
+        auto it = r.syncs.find(arg.bits);
+        return it != r.syncs.end() ? it->second : nullptr;
+    } else if constexpr (std::is_pointer_v<T>) {
+        if (const auto *p = r.call->payload(i, GLPayloadKind::Data))
+            return reinterpret_cast<T>(const_cast<char *>(p->data.data()));
+        if (const auto *p = r.call->payload(i, GLPayloadKind::StringArray))
+            return reinterpret_cast<T>(
+              const_cast<const char **>(r.strings(i, p->data)));
+        if (arg.kind == GLArgKind::OutPointer && arg.bits != 0)
+            return reinterpret_cast<T>(r.outBuffer(i));
+        // an offset into a bound buffer
+        return reinterpret_cast<T>(uintptr_t(arg.bits));
+    } else if constexpr (std::is_same_v<T, float>) {
+        float x;
+        const auto bits = uint32_t(arg.bits);
+        memcpy(&x, &bits, sizeof x);
+        return x;
+    } else if constexpr (std::is_same_v<T, double>) {
+        double x;
+        memcpy(&x, &arg.bits, sizeof x);
+        return x;
+    } else {
+        return T(int64_t(arg.bits));
+    }
+}
+
+template<typename Ret, typename... Args, size_t... I>
+GLCallArg
+invokeWith(Ret (*fn)(Args...), Replay &r, std::index_sequence<I...>)
+{
+    if constexpr (std::is_void_v<Ret>) {
+        fn(decodeArg<Args>(r, I)...);
+        return { GLArgKind::Int, 0 };
+    } else {
+        const Ret ret = fn(decodeArg<Args>(r, I)...);
+        return glt::glCallArg<Ret>(ret);
+    }
+}
+
+template<typename Ret, typename... Args>
+bool
+invoke(Ret (*fn)(Args...), Replay &r, GLCallArg &result)
+{
+    if (r.call->args.size() != sizeof...(Args)) {
+        ++r.arg_mismatches;
+        return false;
+    }
+    result = invokeWith(fn, r, std::index_sequence_for<Args...>{});
+    return true;
+}
+
+using Dispatch = bool (*)(Replay &, GLCallArg &);
+
+// the functions are glad function pointers, null if not supported
+template<auto &Fn>
+bool
+dispatch(Replay &r, GLCallArg &result)
+{
+    if constexpr (std::is_pointer_v<std::remove_reference_t<decltype(Fn)>>)
+        if (Fn == nullptr)
+            return false;
+    return invoke(Fn, r, result);
+}
+
+// the helpers glt::GLObject calls instead of glGenPrograms and friends
+void APIENTRY
+gen_programs(GLsizei n, GLuint *names)
+{
+    for (GLsizei i = 0; i < n; ++i)
+        names[i] = glCreateProgram();
+}
+
+void APIENTRY
+del_programs(GLsizei n, const GLuint *names)
+{
+    for (GLsizei i = 0; i < n; ++i)
+        glDeleteProgram(names[i]);
+}
+
+void APIENTRY
+del_shaders(GLsizei n, const GLuint *names)
+{
+    for (GLsizei i = 0; i < n; ++i)
+        glDeleteShader(names[i]);
+}
+
+// clang-format off
+#define GL_REPLAY_FUNCTIONS(X)                                                 \
+    X(glActiveTexture) X(glAttachShader) X(glBeginQuery)                       \
+    X(glBeginTransformFeedback) X(glBindAttribLocation) X(glBindBuffer)        \
+    X(glBindBufferBase) X(glBindBufferRange) X(glBindFramebuffer)              \
+    X(glBindRenderbuffer) X(glBindSampler) X(glBindTexture)                    \
+    X(glBindTransformFeedback) X(glBindVertexArray) X(glBlendFunc)             \
+    X(glBlitFramebuffer) X(glBufferData) X(glBufferSubData)                    \
+    X(glCheckNamedFramebufferStatusEXT) X(glClear) X(glClearBufferfv)          \
+    X(glClearColor) X(glClearDepth) X(glClientWaitSync) X(glColorMask)         \
+    X(glCompileShader) X(glCompressedTexImage2D)                               \
+    X(glCompressedTextureImage2DEXT) X(glCompressedTextureSubImage2DEXT)       \
+    X(glCreateProgram) X(glCreateShader) X(glCullFace) X(glDeleteBuffers)      \
+    X(glDeleteFramebuffers) X(glDeleteProgram) X(glDeleteQueries)              \
+    X(glDeleteRenderbuffers) X(glDeleteSamplers) X(glDeleteShader)             \
+    X(glDeleteSync) X(glDeleteTextures) X(glDeleteTransformFeedbacks)          \
+    X(glDeleteVertexArrays) X(glDepthFunc) X(glDepthMask) X(glDetachShader)    \
+    X(glDisable) X(glDisableVertexArrayAttribEXT)                              \
+    X(glDisableVertexAttribArray) X(glDrawArrays) X(glDrawArraysInstanced)     \
+    X(glDrawArraysInstancedBaseInstance) X(glDrawElements)                     \
+    X(glDrawElementsInstanced) X(glDrawElementsInstancedBaseInstance)          \
+    X(glDrawElementsInstancedBaseVertex)                                       \
+    X(glDrawElementsInstancedBaseVertexBaseInstance)                           \
+    X(glDrawTransformFeedback) X(glDrawTransformFeedbackInstanced)             \
+    X(glEnable) X(glEnableVertexArrayAttribEXT) X(glEnableVertexAttribArray)   \
+    X(glEndQuery) X(glEndTransformFeedback) X(glFenceSync) X(glFinish)         \
+    X(glFlush) X(glFramebufferTexture) X(glFramebufferTexture3D)               \
+    X(glFramebufferTextureLayer) X(glGenBuffers) X(glGenFramebuffers)          \
+    X(glGenQueries) X(glGenRenderbuffers) X(glGenSamplers) X(glGenTextures)    \
+    X(glGenTransformFeedbacks) X(glGenVertexArrays) X(glGenerateMipmap)        \
+    X(glGetActiveUniformBlockiv) X(glGetActiveUniformsiv) X(glGetInteger64v)   \
+    X(glGetIntegerv)                                                           \
+    X(glGetProgramBinary) X(glGetProgramInfoLog) X(glGetProgramiv)             \
+    X(glGetQueryObjectui64v) X(glGetQueryObjectuiv) X(glGetShaderInfoLog)      \
+    X(glGetShaderiv) X(glGetUniformBlockIndex) X(glGetUniformLocation)         \
+    X(glLineWidth) X(glLinkProgram) X(glMapNamedBufferRangeEXT)                \
+    X(glMaxShaderCompilerThreadsKHR) X(glMultiDrawElementsIndirect)            \
+    X(glNamedBufferDataEXT)                                                    \
+    X(glNamedBufferStorageEXT) X(glNamedBufferSubDataEXT)                      \
+    X(glNamedFramebufferRenderbufferEXT) X(glNamedFramebufferTextureEXT)       \
+    X(glNamedRenderbufferStorageEXT)                                           \
+    X(glNamedRenderbufferStorageMultisampleEXT) X(glPixelStorei)               \
+    X(glPolygonMode) X(glProgramBinary) X(glProgramParameteri)                 \
+    X(glProgramUniform1f) X(glProgramUniform1fv) X(glProgramUniform1i)         \
+    X(glProgramUniform1ui) X(glProgramUniform2fv) X(glProgramUniform3fv)       \
+    X(glProgramUniform4fv) X(glProgramUniformMatrix2fv)                        \
+    X(glProgramUniformMatrix3fv) X(glProgramUniformMatrix4fv)                  \
+    X(glQueryCounter) X(glReadBuffer) X(glReadPixels)                          \
+    X(glSamplerParameteri) X(glScissor) X(glShaderSource) X(glTexBuffer)       \
+    X(glTexBufferRange) X(glTexImage1D) X(glTexImage2D)                        \
+    X(glTexImage2DMultisample) X(glTexImage3D) X(glTexParameteri)              \
+    X(glTextureImage2DEXT) X(glTextureImage3DEXT) X(glTextureParameteriEXT)    \
+    X(glTextureParameterivEXT) X(glTextureSubImage2DEXT)                       \
+    X(glTextureSubImage3DEXT) X(glTransformFeedbackVaryings)                   \
+    X(glUniformBlockBinding) X(glUnmapNamedBufferEXT) X(glUseProgram)          \
+    X(glValidateProgram) X(glVertexArrayVertexAttribOffsetEXT)                 \
+    X(glVertexAttribDivisor) X(glVertexAttribIPointer)                         \
+    X(glVertexAttribPointer) X(glViewport) X(glWaitSync)                       \
+    X(gen_programs) X(del_programs) X(del_shaders)
+// clang-format on
+
+const std::unordered_map<std::string_view, Dispatch> &
+dispatchTable()
+{
+#define ENTRY(fn) { #fn, &dispatch<fn> },
+    static const std::unordered_map<std::string_view, Dispatch> table = {
+        GL_REPLAY_FUNCTIONS(ENTRY)
+    };
+#undef ENTRY
+    return table;
+}
+
+// results that name something and have to match the capture
+bool
+checkResult(std::string_view name)
+{
+    return name == "glCreateShader" || name == "glCreateProgram" ||
+           name == "glGetUniformLocation" || name == "glGetUniformBlockIndex";
+}
+
+struct FunctionStats
+{
+    std::string_view name;
+    uint64_t calls{};
+    double replay{};  // seconds
+    double capture{}; // seconds
+};
+
+struct Options
+{
+    const char *file{};
+    int backend = GLFW_NATIVE_CONTEXT_API;
+    bool headless{};
+    int width = 800;
+    int height = 600;
+    int gl_major = 3;
+    int gl_minor = 3;
+    bool finish{};
+    size_t top = 30;
+};
+
+void
+usage()
+{
+    out << "usage: gl-replay [options] FILE\n"
+        << "  --headless egl|osmesa  create the context without a display\n"
+        << "  --window-size WxH      size of the window, default 800x600\n"
+        << "  --gl-version M.N       context version, default 3.3\n"
+        << "  --finish               glFinish at the end of every frame\n"
+        << "  --top N                functions listed, default 30\n";
+}
+
+bool
+parseOptions(int argc, char *argv[], Options &opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--finish") {
+            opts.finish = true;
+        } else if (arg == "--headless" && val != nullptr) {
+            ++i;
+            opts.headless = true;
+            if (strcmp(val, "egl") == 0)
+                opts.backend = GLFW_EGL_CONTEXT_API;
+            else if (strcmp(val, "osmesa") == 0)
+                opts.backend = GLFW_OSMESA_CONTEXT_API;
+            else
+                return false;
+        } else if (arg == "--window-size" && val != nullptr) {
+            ++i;
+            if (sscanf(val, "%dx%d", &opts.width, &opts.height) != 2)
+                return false;
+        } else if (arg == "--gl-version" && val != nullptr) {
+            ++i;
+            if (sscanf(val, "%d.%d", &opts.gl_major, &opts.gl_minor) != 2)
+                return false;
+        } else if (arg == "--top" && val != nullptr) {
+            ++i;
+            if (sscanf(val, "%zu", &opts.top) != 1)
+                return false;
+        } else if (arg.starts_with("-") || opts.file != nullptr) {
+            return false;
+        } else {
+            opts.file = argv[i];
+        }
+    }
+    return opts.file != nullptr;
+}
+
+GLFWwindow *
+createContext(const Options &opts)
+{
+#ifdef GLFW_PLATFORM_NULL
+    if (opts.headless)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    if (!glfwInit())
+        return nullptr;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, opts.gl_major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, opts.gl_minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, opts.backend);
+    glfwWindowHint(GLFW_VISIBLE, opts.headless ? GLFW_FALSE : GLFW_TRUE);
+
+    auto *win =
+      glfwCreateWindow(opts.width, opts.height, "gl-replay", nullptr, nullptr);
+    if (win == nullptr)
+        return nullptr;
+    glfwMakeContextCurrent(win);
+    glfwSwapInterval(0);
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress)))
+        return nullptr;
+    return win;
+}
+
+int
+replay(const Options &opts, GLFWwindow *win)
+{
+    glt::GLCaptureReader reader;
+    if (!reader.open(opts.file))
+        return 1;
+
+    const auto &table = dispatchTable();
+    std::vector<Dispatch> functions;     // by function id
+    std::vector<FunctionStats> stats;    // by function id
+    std::vector<double> frames_replay;   // seconds
+    std::vector<double> frames_captured; // seconds
+    Replay r;
+    GLCapturedCall call;
+    uint64_t frame_ns = 0, last_frame_ns = 0;
+    uint64_t calls = 0, skipped = 0, name_mismatches = 0;
+
+    const double start = sys::queryTimer();
+    double frame_start = start;
+    for (;;) {
+        const auto ev = reader.next(call, frame_ns);
+        if (ev == glt::GLCaptureReader::End)
+            break;
+        if (ev == glt::GLCaptureReader::Error) {
+            ERR("truncated or corrupt capture file");
+            break;
+        }
+
+        if (ev == glt::GLCaptureReader::Frame) {
+            if (opts.finish)
+                glFinish();
+            glfwSwapBuffers(win);
+            const double now = sys::queryTimer();
+            frames_replay.push_back(now - frame_start);
+            frames_captured.push_back(double(frame_ns - last_frame_ns) *
+                                      1e-9);
+            frame_start = now;
+            last_frame_ns = frame_ns;
+            continue;
+        }
+
+        // functions are declared before their first call
+        while (functions.size() < reader.functions().size()) {
+            const auto &name = reader.functions()[functions.size()];
+            auto it = table.find(name);
+            functions.push_back(it != table.end() ? it->second : nullptr);
+            stats.push_back({ name });
+            if (it == table.end())
+                WARN("cannot replay " + name + ", skipping its calls");
+        }
+
+        auto &fs = stats[call.function];
+        const auto fn = functions[call.function];
+        r.call = &call;
+        GLCallArg result{};
+        const double t0 = sys::queryTimer();
+        const bool ok = fn != nullptr && fn(r, result);
+        const double t1 = sys::queryTimer();
+        if (!ok) {
+            ++skipped;
+            continue;
+        }
+
+        ++calls;
+        ++fs.calls;
+        fs.replay += t1 - t0;
+        fs.capture += double(call.duration_ns) * 1e-9;
+
+        if (call.has_result && call.result.kind == GLArgKind::Sync)
+            r.syncs[call.result.bits] =
+              reinterpret_cast<GLsync>(uintptr_t(result.bits));
+        if (fs.name == "glDeleteSync" && !call.args.empty())
+            r.syncs.erase(call.args[0].bits);
+
+        if (call.has_result && checkResult(fs.name) &&
+            call.result.bits != result.bits)
+            ++name_mismatches;
+        for (const auto &p : call.payloads)
+            if (p.kind == GLPayloadKind::Output &&
+                memcmp(r.outBuffer(p.arg), p.data.data(), p.data.size()) != 0)
+                ++name_mismatches;
+    }
+    glFinish();
+    const double total = sys::queryTimer() - start;
+
+    out << "replayed " << calls << " calls, " << frames_replay.size()
+        << " frames in " << total << " s";
+    if (skipped > 0)
+        out << ", skipped " << skipped << " calls";
+    out << "\n";
+    if (!frames_replay.empty()) {
+        out << "frame time replay: ";
+        sys::printTimingStats(out, sys::timingStats(frames_replay));
+        out << "frame time capture: ";
+        sys::printTimingStats(out, sys::timingStats(frames_captured));
+    }
+
+    std::sort(stats.begin(), stats.end(), [](const auto &a, const auto &b) {
+        return a.replay > b.replay;
+    });
+    out << "calls, replay ms, capture ms, replay us per call, function\n";
+    for (size_t i = 0; i < std::min(opts.top, stats.size()); ++i) {
+        const auto &fs = stats[i];
+        if (fs.calls == 0)
+            break;
+        char line[160];
+        snprintf(line,
+                 sizeof line,
+                 "%8llu %10.3f %10.3f %8.3f  ",
+                 (unsigned long long) fs.calls,
+                 fs.replay * 1e3,
+                 fs.capture * 1e3,
+                 fs.replay * 1e6 / double(fs.calls));
+        out << line << fs.name << "\n";
+    }
+
+    if (name_mismatches > 0)
+        out << "WARNING: " << name_mismatches
+            << " object names or locations differ from the capture\n";
+    if (r.arg_mismatches > 0)
+        out << "WARNING: " << r.arg_mismatches
+            << " calls with an unexpected number of arguments skipped\n";
+    return 0;
+}
+
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+    sys::moduleInit();
+
+    Options opts;
+    if (!parseOptions(argc, argv, opts)) {
+        usage();
+        return 1;
+    }
+
+    auto *win = createContext(opts);
+    if (win == nullptr) {
+        ERR("couldnt create an OpenGL context");
+        glfwTerminate();
+        return 1;
+    }
+
+    const int ret = replay(opts, win);
+    glfwDestroyWindow(win);
+    glfwTerminate();
+    return ret;
+}
@@ -2,6 +2,7 @@
 #include "cutil.h"
 
 #include "ge/Engine.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
 #include "glt/utils.hpp"
 #include "math/vec2.hpp"
@@ -51,7 +52,7 @@ Anim::make_texture(const char *filename)
         return tex;
 
     tex.reset(new glt::TextureSampler);
-    GL_CALL(glBindTexture, GL_TEXTURE_2D, *tex->data()->ensureHandle());
+    glt::stateCache().bindTexture(GL_TEXTURE_2D, *tex->data()->ensureHandle());
 
     GL_CALL(glTexImage2D,
             GL_TEXTURE_2D,
@@ -2,6 +2,7 @@
 #include "ge/Engine.hpp"
 #include "ge/Event.hpp"
 #include "glt/CubeMesh.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
 #include "glt/ShaderProgram.hpp"
 #include "glt/TextureRenderTarget.hpp"
@@ -103,10 +104,10 @@ Anim::init(const ge::Event<ge::InitEvent> &ev)
         render_texture = glt::TextureRenderTarget::make_shared(w, h, ps);
         engine.renderManager().setDefaultRenderTarget(render_texture);
 
-        GL_CALL(glEnable, GL_MULTISAMPLE);
+        glt::stateCache().enable(GL_MULTISAMPLE);
     }
 
-    GL_CALL(glDisable, GL_DEPTH_TEST);
+    glt::stateCache().disable(GL_DEPTH_TEST);
 
     ev.info.success = true;
 }
@@ -5,6 +5,7 @@
 #include "ge/Timer.hpp"
 
 #include "glt/CubeMesh.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
 #include "glt/TextureRenderTarget3D.hpp"
 #include "glt/Transformations.hpp"
@@ -223,18 +224,18 @@ Anim::initBlock(Block *block)
     ASSERT(block);
 
     GL_CALL(glGenBuffers, 1, &block->data);
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, block->data);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, block->data);
     GL_CALL(glBufferData,
             GL_ARRAY_BUFFER,
             BLOCK_DATA_SIZE * sizeof(MCFeedbackVertex),
             nullptr,
             GL_STREAM_DRAW);
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, 0);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, 0);
 
     GL_CALL(glGenVertexArrays, 1, &block->array);
-    GL_CALL(glBindVertexArray, block->array);
+    glt::stateCache().bindVertexArray(block->array);
 
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, block->data);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, block->data);
     GL_CALL(glVertexAttribPointer,
             0,
             3,
@@ -249,11 +250,11 @@ Anim::initBlock(Block *block)
             GL_FALSE,
             sizeof(MCFeedbackVertex),
             reinterpret_cast<void *>(offsetof(MCFeedbackVertex, normal)));
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, 0);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, 0);
 
     GL_CALL(glEnableVertexAttribArray, 0);
     GL_CALL(glEnableVertexAttribArray, 1);
-    GL_CALL(glBindVertexArray, 0);
+    glt::stateCache().bindVertexArray(0);
 
     GL_CALL(glGenTransformFeedbacks, 1, &block->stream);
     GL_CALL(glBindTransformFeedback, GL_TRANSFORM_FEEDBACK, block->stream);
@@ -295,7 +296,7 @@ Anim::makeSampleVolume()
 {
     glt::RenderManager &rm = engine->renderManager();
 
-    GL_CALL(glDisable, GL_DEPTH_TEST);
+    glt::stateCache().disable(GL_DEPTH_TEST);
 
     worldProgram->use();
 
@@ -320,7 +321,7 @@ Anim::makeSampleVolume()
     }
 
     rm.setDefaultRenderTarget();
-    GL_CALL(glEnable, GL_DEPTH_TEST);
+    glt::stateCache().enable(GL_DEPTH_TEST);
 }
 
 void
@@ -329,7 +330,7 @@ Anim::makePolygon(const Block &block)
     glt::GeometryTransform &gt = engine->renderManager().geometryTransform();
     auto sp = gt.save();
 
-    GL_CALL(glEnable, GL_RASTERIZER_DISCARD);
+    glt::stateCache().enable(GL_RASTERIZER_DISCARD);
 
     marchingCubesProgram->use();
 
@@ -362,7 +363,7 @@ Anim::makePolygon(const Block &block)
     volumeCube.draw();
     GL_CALL(glEndTransformFeedback, );
 
-    GL_CALL(glDisable, GL_RASTERIZER_DISCARD);
+    glt::stateCache().disable(GL_RASTERIZER_DISCARD);
 }
 
 void
@@ -386,9 +387,9 @@ Anim::renderPolygon(const Block &block)
       .mandatory("projectionMatrix", gt.projectionMatrix())
       .mandatory("normalMatrix", gt.normalMatrix());
 
-    GL_CALL(glBindVertexArray, block.array);
+    glt::stateCache().bindVertexArray(block.array);
     GL_CALL(glDrawTransformFeedback, GL_TRIANGLES, block.stream);
-    GL_CALL(glBindVertexArray, 0);
+    glt::stateCache().bindVertexArray(0);
 }
 
 void
@@ -8,6 +8,7 @@
 #include "ge/MouseLookPlugin.hpp"
 #include "glt/CubeMesh.hpp"
 #include "glt/GLSLPreprocessor.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
 #include "glt/ShaderProgram.hpp"
 #include "glt/TextureRenderTarget.hpp"
@@ -132,8 +133,8 @@ Anim::init(const ge::Event<ge::InitEvent> &ev)
     //    engine.gameLoop().syncDraw(true);
     engine.gameLoop().pause();
 
-    //    GL_CALL(glDisable, GL_CULL_FACE);
-    GL_CALL(glEnable, GL_CULL_FACE);
+    //    glt::stateCache().disable(GL_CULL_FACE);
+    glt::stateCache().enable(GL_CULL_FACE);
 
     ev.info.success = true;
 }
@@ -524,13 +525,13 @@ Anim::constructVertices0(MCState &cur_mc)
     GL_CALL(glGenBuffers, 1, &cur_mc.vbo);
     GL_CALL(glGenVertexArrays, 1, &cur_mc.vao);
 
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, cur_mc.vbo);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, cur_mc.vbo);
     GL_CALL(glBufferData,
             GL_ARRAY_BUFFER,
             cur_mc.num_tris * 3 * 2 * sizeof(vec3_t),
             nullptr,
             GL_STREAM_DRAW);
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, 0);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, 0);
 
     cur_mc.vbo_buf = cl::BufferGL(cl_ctx, CL_MEM_WRITE_ONLY, cur_mc.vbo);
 }
@@ -601,9 +602,9 @@ Anim::renderMC(MCState &cur_mc, glt::ShaderProgram &program, vec3_t ecLight)
         GL_CALL(glEnableVertexArrayAttribEXT, cur_mc.vao, GLuint(i));
     }
 
-    GL_CALL(glBindVertexArray, cur_mc.vao);
+    glt::stateCache().bindVertexArray(cur_mc.vao);
     GL_CALL(glDrawArrays, GL_TRIANGLES, 0, cur_mc.num_tris * 3);
-    GL_CALL(glBindVertexArray, 0);
+    glt::stateCache().bindVertexArray(0);
 
     GL_CALL(glDeleteBuffers, 1, &cur_mc.vbo);
     GL_CALL(glDeleteVertexArrays, 1, &cur_mc.vao);
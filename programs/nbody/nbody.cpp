@@ -1,8 +1,11 @@
 #include "ge/Camera.hpp"
 #include "ge/Engine.hpp"
 #include "ge/MouseLookPlugin.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
+#include "glt/MeshOptimizer.hpp"
 #include "glt/Transformations.hpp"
+#include "glt/packed_types.hpp"
 #include "glt/primitives.hpp"
 #include "glt/utils.hpp"
 #include "math/mat3.hpp"
@@ -26,7 +29,11 @@ static const size_t SIMULATION_FPS = 50;
 #    define SIM_CALL(...) __VA_ARGS__
 #endif
 
-DEF_GL_MAPPED_TYPE(Vertex, (vec3_t, position), (vec3_t, normal))
+// the sphere and ground vertices are within [-1, 1], half precision
+// positions are exact enough
+DEF_GL_MAPPED_TYPE(Vertex,
+                   (glt::half<vec3_t>, position),
+                   (glt::packed_normal<vec3_t>, normal))
 
 struct Anim
 {
@@ -67,6 +74,7 @@ Anim::init(const ge::Event<ge::InitEvent> &ev)
     next_fps_counter_draw = real(0.3);
 
     glt::primitives::sphere(sphere_model, 1.f, 36, 24);
+    glt::MeshOptimizer().optimize(sphere_model);
     sphere_model.send();
 
     {
@@ -84,8 +92,8 @@ Anim::init(const ge::Event<ge::InitEvent> &ev)
         ground_model.send();
     }
 
-    GL_CALL(glEnable, GL_DEPTH_TEST);
-    GL_CALL(glEnable, GL_MULTISAMPLE);
+    glt::stateCache().enable(GL_DEPTH_TEST);
+    glt::stateCache().enable(GL_MULTISAMPLE);
 
     light_dir = normalize(vec3(real(-1)));
 
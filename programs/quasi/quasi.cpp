@@ -1,5 +1,6 @@
 #include "ge/Engine.hpp"
 #include "glt/CubeMesh.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
 #include "glt/ShaderProgram.hpp"
 #include "glt/TextureRenderTarget.hpp"
@@ -48,11 +49,11 @@ Anim::init(const ge::Event<ge::InitEvent> &ev)
     }
 
     if (engine.window().contextInfo().antialiasingLevel > 0) {
-        GL_CALL(glEnable, GL_MULTISAMPLE);
+        glt::stateCache().enable(GL_MULTISAMPLE);
         engine.out() << "enableing multisampling\n";
     }
 
-    GL_CALL(glDisable, GL_DEPTH_TEST);
+    glt::stateCache().disable(GL_DEPTH_TEST);
 
     ev.info.success = true;
 }
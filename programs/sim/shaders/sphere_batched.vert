@@ -0,0 +1,42 @@
+#extension GL_ARB_shader_draw_parameters : require
+
+// the instances of all LODs are in one buffer, the instances of a draw
+// start at its base instance
+uniform samplerBuffer instanceData;
+uniform mat3 normalMatrix;
+uniform mat4 pMatrix;
+uniform mat4 vMatrix;
+
+SL_in vec4 position;
+SL_in vec3 normal;
+
+SL_out vec3 ecPosition;
+SL_out vec3 ecNormal;
+SL_out vec3 color;
+SL_out float shininess;
+
+vec3
+colorGradient(vec3 color, vec3 pos)
+{
+    return color *
+           vec3(pos.x * 0.5 + 0.5, pos.y * 0.5 + 0.5, pos.z * 0.5 + 0.5);
+}
+
+void
+main()
+{
+    int instance = gl_BaseInstanceARB + gl_InstanceID;
+    vec4 data1 = texelFetch(instanceData, instance * 2);
+    vec4 data2 = texelFetch(instanceData, instance * 2 + 1);
+
+    vec3 offset = data1.xyz;
+    float rad = data1.w;
+
+    color = colorGradient(data2.rgb, position.xyz);
+    shininess = data2.a;
+
+    vec4 ecPos4 = vMatrix * vec4(vec3(position) * rad + offset, 1.0);
+    ecPosition = vec3(ecPos4);
+    ecNormal = normalMatrix * normal;
+    gl_Position = pMatrix * ecPos4;
+}
@@ -1,6 +1,6 @@
 
 
-uniform sampler1D instanceData;
+uniform samplerBuffer instanceData;
 uniform mat3 normalMatrix;
 uniform mat4 pMatrix;
 uniform mat4 vMatrix;
@@ -23,8 +23,8 @@ colorGradient(vec3 color, vec3 pos)
 void
 main()
 {
-    vec4 data1 = texelFetch(instanceData, gl_InstanceID * 2, 0);
-    vec4 data2 = texelFetch(instanceData, gl_InstanceID * 2 + 1, 0);
+    vec4 data1 = texelFetch(instanceData, gl_InstanceID * 2);
+    vec4 data2 = texelFetch(instanceData, gl_InstanceID * 2 + 1);
 
     vec3 offset = data1.xyz;
     float rad = data1.w;
@@ -6,7 +6,13 @@
 #include "ge/GameWindow.hpp"
 #include "ge/MouseLookPlugin.hpp"
 #include "glt/CubeMesh.hpp"
+#include "glt/DrawBatch.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
+#include "glt/MeshLODChain.hpp"
+#include "glt/MeshOptimizer.hpp"
+#include "glt/RenderQueue.hpp"
+#include "glt/StreamBuffer.hpp"
 #include "glt/TextureRenderTarget.hpp"
 #include "glt/primitives.hpp"
 #include "glt/utils.hpp"
@@ -19,6 +25,8 @@
 #include "math/vec4.hpp"
 
 #include <algorithm>
+#include <cstring>
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -45,6 +53,20 @@ struct SphereLOD
     size_t level;
 };
 
+struct Game;
+
+// the uniforms of a sphere queued in the render queue, kept until the
+// queue is drawn
+struct SphereDraw
+{
+    const Game *game;
+    mat4_t mvpMatrix;
+    mat4_t mvMatrix;
+    mat3_t normalMatrix;
+    glt::color color;
+    float shininess;
+};
+
 #define SPHERE_INSTANCED_TEXTURED
 // (doesnt work atm)
 // #define SPHERE_INSTANCED_ARRAY
@@ -89,7 +111,7 @@ struct Game
     ge::MouseLookPlugin mouse_look;
 
     CubeMesh wallBatch;
-    Mesh sphereBatches[SPHERE_LOD_MAX];
+    glt::MeshLODChain<Vertex> sphereLODs;
     Mesh lineBatch;
     CubeMesh rectBatch;
 
@@ -122,11 +144,30 @@ struct Game
     bool indirect_rendering{};
 
     std::vector<SphereInstance> sphere_instances[SPHERE_LOD_MAX];
+    // a deque, the queued packets point into it
+    std::deque<SphereDraw> sphere_draws;
+    glt::StreamBuffer instance_stream;
+    size_t instance_align = 16;
+#ifdef SPHERE_INSTANCED_TEXTURED
+    glt::GLTextureObject instance_texture;
+    // the LODs in one batch, the instanced spheres are drawn with one
+    // multi draw if the sphereBatched program could be linked
+    std::unique_ptr<glt::DrawBatch> sphere_batch;
+    glt::DrawBatchMesh sphere_batch_lods[SPHERE_LOD_MAX];
+    // of all frames
+    glt::DrawBatchStatistics sphere_batch_stats{};
+#endif
 
     Game();
 
     ~Game()
     {
+#ifdef SPHERE_INSTANCED_TEXTURED
+        if (sphere_batch_stats.draws > 0)
+            sys::io::stderr()
+              << "batched spheres: " << sphere_batch_stats.draws
+              << " draws in " << sphere_batch_stats.calls << " draw calls\n";
+#endif
         if (engine != nullptr)
             engine->renderManager().shutdown();
         textureRenderTarget.reset();
@@ -145,11 +186,15 @@ struct Game
 
     void windowResized(const ge::Event<ge::WindowResized> & /*ev*/);
     void handleInternalEvents();
-    void spawn_sphere();
+    void spawn_sphere(size_t slot = 0);
 
     SphereLOD calc_sphere_lod(const Sphere &s);
     void render_sphere(const Sphere &s, const SphereModel &m);
+    static void setup_sphere(glt::ShaderProgram &prog, const void *data);
     void end_render_spheres();
+#ifdef SPHERE_INSTANCED_TEXTURED
+    void draw_spheres_batched(glt::ShaderProgram &prog);
+#endif
     void render_box(const glt::AABB &box);
     void render_con(const point3_t &a, const point3_t &b);
     void render_hud();
@@ -207,18 +252,33 @@ Game::init(const ge::Event<ge::InitEvent> &ev)
     glt::primitives::unitCubeEverted(wallBatch);
     wallBatch.send();
 
-    struct
     {
-        int32_t a, b;
-    } sphere_params[SPHERE_LOD_MAX] = { { 12, 6 },  { 16, 8 },  { 20, 10 },
-                                        { 24, 12 }, { 26, 13 }, { 36, 18 } };
-
-    for (size_t i = 0; i < SPHERE_LOD_MAX; ++i) {
-        glt::primitives::sphere(
-          sphereBatches[i], 1.f, sphere_params[i].a, sphere_params[i].b);
-        sphereBatches[i].send();
+        Mesh sphere;
+        glt::primitives::sphere(sphere, 1.f, 36, 18);
+        glt::MeshOptimizer().optimize(sphere);
+        sphereLODs.build(sphere, SPHERE_LOD_MAX, 0.6f);
+        sphereLODs.send();
     }
 
+#ifdef SPHERE_INSTANCED_TEXTURED
+    // created here, the batch checks the GL version
+    sphere_batch =
+      std::make_unique<glt::DrawBatch>(Vertex::gl::struct_info::info);
+    for (size_t lod = 0; lod < sphereLODs.levels(); ++lod)
+        sphere_batch_lods[lod] = sphere_batch->add(sphereLODs.mesh(lod));
+    sphere_batch->send();
+#endif
+
+    instance_stream.init(1024 * sizeof(SphereInstance));
+#ifdef SPHERE_INSTANCED_TEXTURED
+    {
+        GLint align = 0;
+        GL_CALL(glGetIntegerv, GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &align);
+        while (instance_align < size_t(align))
+            instance_align *= 2;
+    }
+#endif
+
     camera.frame().origin = vec3(0.f, 0.f, 0.f);
 
     update_sphere_mass();
@@ -287,12 +347,17 @@ randomColor()
       uint8_t(rand1() * 255), uint8_t(rand1() * 255), uint8_t(rand1() * 255));
 }
 
+// spheres spawned at once are placed on a grid in rows of 8, slot 0 is in
+// front of the camera
 void
-Game::spawn_sphere()
+Game::spawn_sphere(size_t slot)
 {
     vec3_t direction = -camera.frame().localZ();
-    sphere_proto.center =
-      camera.frame().origin + direction * (sphere_proto.r + 1.1f);
+    vec3_t offset = camera.frame().localX() * real(slot % 8) +
+                    camera.frame().localY() * real(slot / 8);
+    sphere_proto.center = camera.frame().origin +
+                          direction * (sphere_proto.r + 1.1f) +
+                          offset * (sphere_proto.r * 3.f);
     sphere_proto.v = direction * sphere_speed;
 
     SphereModel model;
@@ -316,16 +381,19 @@ Game::renderScene(const ge::Event<ge::RenderEvent> &ev)
         interpolation = 0.f;
 
     renderManager.activeRenderTarget()->clear(glt::RT_DEPTH_BUFFER);
-    GL_CALL(glEnable, GL_DEPTH_TEST);
+    glt::stateCache().enable(GL_DEPTH_TEST);
 
     //    e.window().window().setActive();
 
     auto dt = real(interpolation * game_speed * e.gameLoop().tickDuration());
 
     renderWorld(dt);
+    // the spheres have to be in the render target before it is post processed
+    renderManager.drawQueued();
+    sphere_draws.clear();
 
     if (indirect_rendering) {
-        GL_CALL(glDisable, GL_DEPTH_TEST);
+        glt::stateCache().disable(GL_DEPTH_TEST);
 
         renderManager.setActiveRenderTarget(e.window().renderTarget());
         auto postprocShader = e.shaderManager().program("postproc");
@@ -437,30 +505,47 @@ Game::end_render_spheres()
 {
     if (render_spheres_instanced) {
 
+        size_t bytes = 0;
+        for (const auto &insts : sphere_instances)
+            bytes += insts.size() * sizeof(SphereInstance) + instance_align;
+        instance_stream.reserve(bytes);
+        instance_stream.beginFrame();
+
+#ifdef SPHERE_INSTANCED_TEXTURED
+        auto sphereBatchedShader =
+          engine->shaderManager().program("sphereBatched");
+        if (sphereBatchedShader && glt::baseInstanceSupported()) {
+            draw_spheres_batched(*sphereBatchedShader);
+            instance_stream.endFrame();
+            return;
+        }
+#endif
+
         for (size_t lod = 0; lod < SPHERE_LOD_MAX; ++lod) {
             auto num = sphere_instances[lod].size();
 
             if (num == 0)
                 continue;
 
+            auto range = instance_stream.allocate(
+              num * sizeof(SphereInstance), instance_align);
+            ASSERT(range);
+            memcpy(range.data.data(),
+                   &sphere_instances[lod][0],
+                   range.data.size());
+            sphere_instances[lod].clear();
+            instance_stream.flush();
+
 #ifdef SPHERE_INSTANCED_TEXTURED
-            glt::TextureSampler sphereMap(
-              std::make_shared<glt::TextureData>(glt::Texture1D));
-
-            sphereMap.filterMode(glt::TextureSampler::FilterNearest);
-            sphereMap.clampMode(glt::TextureSampler::ClampRepeat);
-            sphereMap.bind(0);
-            GL_CALL(glTexImage1D,
-                    GL_TEXTURE_1D,
-                    0,
+            instance_texture.ensure();
+            glt::stateCache().bindTexture(
+              0, GL_TEXTURE_BUFFER, *instance_texture);
+            GL_CALL(glTexBufferRange,
+                    GL_TEXTURE_BUFFER,
                     GL_RGBA32F,
-                    GLsizei(num * 2),
-                    0,
-                    GL_RGBA,
-                    GL_FLOAT,
-                    &sphere_instances[lod][0]);
-
-            sphere_instances[lod].clear();
+                    instance_stream.buffer(),
+                    range.offset,
+                    GLsizeiptr(range.data.size()));
 
             auto sphereInstancedShader =
               engine->shaderManager().program("sphereInstanced");
@@ -475,11 +560,10 @@ Game::end_render_spheres()
               .optional("pMatrix", gt.projectionMatrix())
               .optional("ecLight", sphereUniforms.ecLightPos)
               .optional("gammaCorrection", indirect_rendering ? 1.f : GAMMA)
-              .mandatory("instanceData", glt::Sampler(sphereMap, 0));
+              .mandatory("instanceData",
+                         glt::BoundTexture(GL_SAMPLER_BUFFER, 0));
 
-            sphereBatches[lod].drawInstanced(num);
-            sphereMap.unbind(0);
-            sphereMap.free();
+            sphereLODs.mesh(lod).drawInstanced(num);
 
 #elif defined(SPHERE_INSTANCED_ARRAY)
 
@@ -488,37 +572,31 @@ Game::end_render_spheres()
             ASSERT(sphereInstanced2Shader);
             sphereInstanced2Shader->use();
 
-            GLBufferObject per_instance_vbo;
-            per_instance_vbo.ensure();
-            GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, *per_instance_vbo);
-            GL_CALL(glBufferData,
-                    GL_ARRAY_BUFFER,
-                    sizeof(SphereInstance) * num,
-                    &sphere_instances[lod][0],
-                    GL_STREAM_DRAW);
-
-            sphereBatches[lod].bind();
+            sphereLODs.mesh(lod).bind();
+            glt::stateCache().bindBuffer(GL_ARRAY_BUFFER,
+                                         instance_stream.buffer());
             GLint attr_mvMatrix;
             GL_ASSIGN_CALL(attr_mvMatrix,
                            glGetAttribLocation,
-                           sphereInstanced2Shader->program(),
+                           *sphereInstanced2Shader->program(),
                            "mvMatrix");
             ASSERT(attr_mvMatrix >= 0);
             GLint attr_colorShininess;
             GL_ASSIGN_CALL(attr_colorShininess,
                            glGetAttribLocation,
-                           sphereInstanced2Shader->program(),
+                           *sphereInstanced2Shader->program(),
                            "colorShininess");
             ASSERT(attr_colorShininess >= 0);
 
-            for (uint32 col = 0; col < 4; ++col) {
+            for (uint32_t col = 0; col < 4; ++col) {
                 GL_CALL(glVertexAttribPointer,
                         attr_mvMatrix + col,
                         4,
                         GL_FLOAT,
                         GL_FALSE,
-                        sizeof(vec4_t),
-                        (void *) (offsetof(SphereInstance, mvMatrix) +
+                        sizeof(SphereInstance),
+                        (void *) (range.offset +
+                                  offsetof(SphereInstance, mvMatrix) +
                                   col * sizeof(vec4_t)));
                 GL_CALL(glVertexAttribDivisor, attr_mvMatrix + col, 1);
                 GL_CALL(glEnableVertexAttribArray, attr_mvMatrix + col);
@@ -530,11 +608,12 @@ Game::end_render_spheres()
                     GL_FLOAT,
                     GL_FALSE,
                     sizeof(SphereInstance),
-                    (void *) offsetof(SphereInstance, colorShininess));
+                    (void *) (range.offset +
+                              offsetof(SphereInstance, colorShininess)));
             GL_CALL(glVertexAttribDivisor, attr_colorShininess, 1);
             GL_CALL(glEnableVertexAttribArray, attr_colorShininess);
 
-            GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, 0);
+            glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, 0);
 
             glt::GeometryTransform &gt =
               engine->renderManager().geometryTransform();
@@ -543,51 +622,95 @@ Game::end_render_spheres()
               .optional("ecLight", sphereUniforms.ecLightPos)
               .optional("gammaCorrection", indirect_rendering ? 1.f : GAMMA);
 
-            sphereBatches[lod].drawInstanced(num);
-            sphereBatches[lod].bind();
+            sphereLODs.mesh(lod).drawInstanced(num);
+            sphereLODs.mesh(lod).bind();
 
-            for (uint32 col = 0; col < 4; ++col) {
+            for (uint32_t col = 0; col < 4; ++col) {
                 GL_CALL(glDisableVertexAttribArray, attr_mvMatrix + col);
             }
 
             GL_CALL(glDisableVertexAttribArray, attr_colorShininess);
-            GL_CALL(glBindVertexArray, 0);
+            glt::stateCache().bindVertexArray(0);
 #endif
         }
+
+        instance_stream.endFrame();
     }
 }
 
-SphereLOD
-Game::calc_sphere_lod(const Sphere &s)
+#ifdef SPHERE_INSTANCED_TEXTURED
+// the instances of all LODs go into one range of the instance stream, every
+// LOD is a draw of the batch whose base instance is its first instance
+void
+Game::draw_spheres_batched(glt::ShaderProgram &prog)
 {
-    glt::GeometryTransform &gt = engine->renderManager().geometryTransform();
-    vec3_t ecCoord = gt.transformPoint(s.center);
-
-    // near upper right corner of frustm (view coord)
-    vec4_t nur_corner =
-      gt.inverseProjectionMatrix() * vec4(-1.f, -1.f, -1.f, 1.f);
-
-    float x_max = math::abs(nur_corner[0]);
-    float y_max = math::abs(nur_corner[1]);
-    float z_min = math::abs(nur_corner[2]);
-
-    float size = min(x_max, y_max);
+    size_t num = 0;
+    for (const auto &insts : sphere_instances)
+        num += insts.size();
+    if (num == 0)
+        return;
 
-    // calculate lod, use projected radius on screen
-    float r_proj = s.r / ecCoord[2] * z_min;
-    float screen_rad = r_proj / size;
-    if (screen_rad < 0)
-        screen_rad = 0;
+    auto range =
+      instance_stream.allocate(num * sizeof(SphereInstance), instance_align);
+    ASSERT(range);
+
+    sphere_batch->begin();
+    uint32_t first = 0;
+    for (size_t lod = 0; lod < SPHERE_LOD_MAX; ++lod) {
+        auto &insts = sphere_instances[lod];
+        if (insts.empty())
+            continue;
+        memcpy(range.data.data() + first * sizeof(SphereInstance),
+               insts.data(),
+               insts.size() * sizeof(SphereInstance));
+        sphere_batch->record(
+          0, sphere_batch_lods[lod], uint32_t(insts.size()), first);
+        first += uint32_t(insts.size());
+        insts.clear();
+    }
+    instance_stream.flush();
+    sphere_batch->end();
+
+    instance_texture.ensure();
+    glt::stateCache().bindTexture(0, GL_TEXTURE_BUFFER, *instance_texture);
+    GL_CALL(glTexBufferRange,
+            GL_TEXTURE_BUFFER,
+            GL_RGBA32F,
+            instance_stream.buffer(),
+            range.offset,
+            GLsizeiptr(range.data.size()));
+
+    prog.use();
+    glt::GeometryTransform &gt = engine->renderManager().geometryTransform();
+    glt::Uniforms(prog)
+      .optional("normalMatrix", gt.normalMatrix())
+      .optional("vMatrix", gt.mvMatrix())
+      .optional("pMatrix", gt.projectionMatrix())
+      .optional("ecLight", sphereUniforms.ecLightPos)
+      .optional("gammaCorrection", indirect_rendering ? 1.f : GAMMA)
+      .mandatory("instanceData", glt::BoundTexture(GL_SAMPLER_BUFFER, 0));
+
+    sphere_batch->draw(0);
+
+    const auto stats = sphere_batch->statistics();
+    sphere_batch_stats.draws += stats.draws;
+    sphere_batch_stats.groups += stats.groups;
+    sphere_batch_stats.calls += stats.calls;
+}
+#endif
 
-    screen_rad *= 2;
+SphereLOD
+Game::calc_sphere_lod(const Sphere &s)
+{
+    auto &rm = engine->renderManager();
+    float screen_rad = glt::projectedRadius(rm.geometryTransform(),
+                                            s.center,
+                                            s.r * sphereLODs.radius(),
+                                            rm.activeRenderTarget()->viewport());
 
     SphereLOD lod{};
-    lod.level = size_t(screen_rad * SPHERE_LOD_MAX);
-    if (lod.level >= SPHERE_LOD_MAX)
-        lod.level = SPHERE_LOD_MAX - 1;
-
+    lod.level = sphereLODs.selectLevel(screen_rad);
     ASSERT(lod.level < SPHERE_LOD_MAX);
-
     return lod;
 }
 
@@ -618,8 +741,8 @@ Game::render_sphere(const Sphere &s, const SphereModel &m)
         sphere_instances[lod.level].push_back(inst);
 
     } else {
-        glt::GeometryTransform &gt =
-          engine->renderManager().geometryTransform();
+        auto &rm = engine->renderManager();
+        glt::GeometryTransform &gt = rm.geometryTransform();
         const vec3_t &pos = s.center;
         auto sp = gt.save();
         gt.translate(pos);
@@ -628,28 +751,49 @@ Game::render_sphere(const Sphere &s, const SphereModel &m)
         auto sphereShader = engine->shaderManager().program("sphere");
         ASSERT(sphereShader);
 
-        sphereShader->use();
-
+        // level 0 is the finest, the coarser levels are drawn brighter
         vec3_t col3 = vec3(1.f);
-        col3 /= real(lod.level + 1);
-        auto col = glt::color(col3);
-
-        glt::Uniforms us(*sphereShader);
-        us.optional("mvpMatrix", gt.mvpMatrix());
-        us.optional("mvMatrix", gt.mvMatrix());
-        us.optional("normalMatrix", gt.normalMatrix());
-        us.optional("ecLight", sphereUniforms.ecLightPos);
-        us.optional("ecSpotDirection", sphereUniforms.ecSpotDir);
-        us.optional("spotAngle", sphereUniforms.spotAngle);
-        us.optional("color", col);
-        us.optional("shininess", m.shininess);
-        us.optional("gammaCorrection", indirect_rendering ? 1.f : GAMMA);
+        col3 /= real(SPHERE_LOD_MAX - lod.level);
+
+        auto &d = sphere_draws.emplace_back();
+        d.game = this;
+        d.mvpMatrix = gt.mvpMatrix();
+        d.mvMatrix = gt.mvMatrix();
+        d.normalMatrix = gt.normalMatrix();
+        d.color = glt::color(col3);
+        d.shininess = m.shininess;
+
+        // sorted by LOD mesh and drawn front to back
+        glt::DrawPacket p;
+        p.mesh = &sphereLODs.mesh(lod.level);
+        p.program = sphereShader.get();
+        p.setup = setup_sphere;
+        p.setup_data = &d;
+        p.depth = length(gt.transformPoint(vec3(0.f)));
+        rm.submit(p);
+    }
+}
+
+void
+Game::setup_sphere(glt::ShaderProgram &prog, const void *data)
+{
+    const auto &d = *static_cast<const SphereDraw *>(data);
+    const auto &game = *d.game;
+
+    glt::Uniforms us(prog);
+    us.optional("mvpMatrix", d.mvpMatrix);
+    us.optional("mvMatrix", d.mvMatrix);
+    us.optional("normalMatrix", d.normalMatrix);
+    us.optional("ecLight", game.sphereUniforms.ecLightPos);
+    us.optional("ecSpotDirection", game.sphereUniforms.ecSpotDir);
+    us.optional("spotAngle", game.sphereUniforms.spotAngle);
+    us.optional("color", d.color);
+    us.optional("shininess", d.shininess);
+    us.optional("gammaCorrection", game.indirect_rendering ? 1.f : GAMMA);
 
 #if ENABLE_GLDEBUG_P
-        sphereShader->validate();
+    prog.validate();
 #endif
-        sphereBatches[lod.level].draw();
-    }
 }
 
 void
@@ -889,6 +1033,14 @@ Game::link(ge::Engine &e)
                           spawn_sphere();
                       }));
 
+    proc.define(ge::makeCommand(
+      "spawnSpheres",
+      "spawn the given number of spheres side by side",
+      [this](const ge::Event<ge::CommandEvent> & /*unused*/, int64_t n) {
+          for (int64_t i = 0; i < n; ++i)
+              spawn_sphere(size_t(i));
+      }));
+
     proc.define(ge::makeCommand(
       "incSphereRadius",
       "",
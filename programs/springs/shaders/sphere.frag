@@ -1,5 +1,10 @@
 
-uniform vec4 color;
+layout(std140) uniform Sphere
+{
+    mat4 vpMatrix;
+    vec4 color;
+    float grid_size;
+};
 
 out vec4 fragColor;
 
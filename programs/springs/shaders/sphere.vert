@@ -1,8 +1,12 @@
 
 uniform samplerBuffer particle_data1;
 
-uniform mat4 vpMatrix;
-uniform float grid_size;
+layout(std140) uniform Sphere
+{
+    mat4 vpMatrix;
+    vec4 color;
+    float grid_size;
+};
 
 in vec3 position;
 
@@ -3,8 +3,10 @@
 #include "ge/MouseLookPlugin.hpp"
 #include "ge/Timer.hpp"
 #include "glt/GLPerfCounter.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
 #include "glt/Transformations.hpp"
+#include "glt/UniformBlock.hpp"
 #include "glt/Uniforms.hpp"
 #include "glt/primitives.hpp"
 #include "glt/utils.hpp"
@@ -15,6 +17,7 @@
 
 #include <algorithm>
 #include <map>
+#include <memory>
 #include <vector>
 
 const size_t N_SPRINGS = 20;
@@ -23,6 +26,12 @@ using namespace math;
 
 DEF_GL_MAPPED_TYPE(Vertex, (vec3_t, position), (vec3_t, normal))
 
+// the Sphere uniform block of sphere.vert and sphere.frag
+DEF_GL_MAPPED_TYPE(SphereUniforms,
+                   (mat4_t, vpMatrix),
+                   (vec4_t, color),
+                   (real, grid_size))
+
 template<typename Vertex>
 void
 sphere(glt::Mesh<Vertex> &mesh, real radius, int slices, int stacks);
@@ -63,6 +72,9 @@ struct Anim
 
     std::shared_ptr<glt::ShaderProgram> physics_prog;
 
+    std::unique_ptr<glt::UniformBlock<SphereUniforms>> sphere_uniforms;
+    std::shared_ptr<glt::ShaderProgram> sphere_prog;
+
     Anim() : fpsTimer(engine) {}
 
     void init(const ge::Event<ge::InitEvent> &);
@@ -130,35 +142,35 @@ Anim::init(const ge::Event<ge::InitEvent> &ev)
     GL_CALL(glGenBuffers, 2, particle_vel_handle);
     GL_CALL(glGenBuffers, 1, &particle_conn_handle);
 
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, particle_pos_mass_handle[0]);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, particle_pos_mass_handle[0]);
     GL_CALL(glBufferData,
             GL_ARRAY_BUFFER,
             sizeof(vec4_t) * particle_pos_mass.size(),
             &particle_pos_mass[0],
             GL_STREAM_DRAW);
 
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, particle_vel_handle[0]);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, particle_vel_handle[0]);
     GL_CALL(glBufferData,
             GL_ARRAY_BUFFER,
             sizeof(vec3_t) * particle_vel.size(),
             &particle_vel[0],
             GL_STREAM_DRAW);
 
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, particle_pos_mass_handle[1]);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, particle_pos_mass_handle[1]);
     GL_CALL(glBufferData,
             GL_ARRAY_BUFFER,
             sizeof(vec4_t) * particle_pos_mass.size(),
             nullptr,
             GL_STREAM_DRAW);
 
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, particle_vel_handle[1]);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, particle_vel_handle[1]);
     GL_CALL(glBufferData,
             GL_ARRAY_BUFFER,
             sizeof(vec3_t) * particle_vel.size(),
             nullptr,
             GL_STREAM_DRAW);
 
-    GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, particle_conn_handle);
+    glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, particle_conn_handle);
     GL_CALL(glBufferData,
             GL_ARRAY_BUFFER,
             sizeof(GLint) * particle_conn.size(),
@@ -166,21 +178,22 @@ Anim::init(const ge::Event<ge::InitEvent> &ev)
             GL_STREAM_DRAW);
 
     for (const auto i : irange(2)) {
-        GL_CALL(glBindVertexArray, particle_vertex_array[i]);
+        glt::stateCache().bindVertexArray(particle_vertex_array[i]);
 
-        GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, particle_pos_mass_handle[i]);
+        glt::stateCache().bindBuffer(GL_ARRAY_BUFFER,
+                                     particle_pos_mass_handle[i]);
         GL_CALL(glVertexAttribPointer, 0, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
         GL_CALL(glEnableVertexAttribArray, 0);
 
-        GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, particle_vel_handle[i]);
+        glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, particle_vel_handle[i]);
         GL_CALL(glVertexAttribPointer, 1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
         GL_CALL(glEnableVertexAttribArray, 1);
 
-        GL_CALL(glBindBuffer, GL_ARRAY_BUFFER, particle_conn_handle);
+        glt::stateCache().bindBuffer(GL_ARRAY_BUFFER, particle_conn_handle);
         GL_CALL(glVertexAttribIPointer, 2, 4, GL_INT, 0, nullptr);
         GL_CALL(glEnableVertexAttribArray, 2);
 
-        GL_CALL(glBindVertexArray, 0);
+        glt::stateCache().bindVertexArray(0);
     }
 
     GL_CALL(glGenTextures, 2, particle_pos_mass_tex);
@@ -188,18 +201,19 @@ Anim::init(const ge::Event<ge::InitEvent> &ev)
     GL_CALL(glGenTextures, 1, &particle_conn_tex);
 
     for (const auto i : irange(2)) {
-        GL_CALL(glBindTexture, GL_TEXTURE_BUFFER, particle_pos_mass_tex[i]);
+        glt::stateCache().bindTexture(GL_TEXTURE_BUFFER,
+                                      particle_pos_mass_tex[i]);
         GL_CALL(glTexBuffer,
                 GL_TEXTURE_BUFFER,
                 GL_RGBA32F,
                 particle_pos_mass_handle[i]);
 
-        GL_CALL(glBindTexture, GL_TEXTURE_BUFFER, particle_vel_tex[i]);
+        glt::stateCache().bindTexture(GL_TEXTURE_BUFFER, particle_vel_tex[i]);
         GL_CALL(
           glTexBuffer, GL_TEXTURE_BUFFER, GL_RGB32F, particle_vel_handle[i]);
     }
 
-    GL_CALL(glBindTexture, GL_TEXTURE_BUFFER, particle_conn_tex);
+    glt::stateCache().bindTexture(GL_TEXTURE_BUFFER, particle_conn_tex);
     GL_CALL(glTexBuffer, GL_TEXTURE_BUFFER, GL_RGBA32I, particle_conn_handle);
 
     physics_prog = std::make_shared<glt::ShaderProgram>(engine.shaderManager());
@@ -217,6 +231,8 @@ Anim::init(const ge::Event<ge::InitEvent> &ev)
 
     ASSERT(physics_prog->link());
 
+    sphere_uniforms = std::make_unique<glt::UniformBlock<SphereUniforms>>(0);
+
     ev.info.success = true;
 }
 
@@ -237,18 +253,27 @@ Anim::renderScene(const ge::Event<ge::RenderEvent> &)
     auto prog = engine.shaderManager().program("sphere");
     ASSERT(prog);
 
-    GL_CALL(glActiveTexture, GL_TEXTURE0);
-    GL_CALL(
-      glBindTexture, GL_TEXTURE_BUFFER, particle_pos_mass_tex[particle_source]);
+    glt::stateCache().bindTexture(
+      0, GL_TEXTURE_BUFFER, particle_pos_mass_tex[particle_source]);
+
+    // the binding is kept across relinks, only a new program needs it
+    if (prog != sphere_prog) {
+        sphere_prog = prog;
+        if (!sphere_uniforms->bindBlock(*prog, "Sphere"))
+            ERR("cannot bind the Sphere uniform block");
+    }
 
     {
         glt::GeometryTransform &gt = engine.renderManager().geometryTransform();
+        SphereUniforms u;
+        u.vpMatrix = gt.vpMatrix();
+        u.color = vec4(1, 0, 0, 1);
+        u.grid_size = real(N_SPRINGS);
+        sphere_uniforms->set(u);
+
         prog->use();
-        glt::Uniforms(*prog)
-          .optional("color", glt::color(0xFF, 0, 0))
-          .optional("vpMatrix", gt.vpMatrix())
-          .optional("grid_size", real(N_SPRINGS))
-          .mandatory("particle_data1", glt::BoundTexture(GL_SAMPLER_BUFFER, 0));
+        glt::Uniforms(*prog).mandatory(
+          "particle_data1", glt::BoundTexture(GL_SAMPLER_BUFFER, 0));
     }
 
     sphere_model.drawInstanced(N_SPRINGS * N_SPRINGS);
@@ -270,15 +295,14 @@ Anim::animate(const ge::Event<ge::AnimationEvent> &)
 {
     physics_perf_counter.begin();
 
-    GL_CALL(glEnable, GL_RASTERIZER_DISCARD);
+    glt::stateCache().enable(GL_RASTERIZER_DISCARD);
 
     auto particle_dest = (1 + particle_source) % 2;
 
     physics_prog->use();
 
-    GL_CALL(glActiveTexture, GL_TEXTURE0);
-    GL_CALL(
-      glBindTexture, GL_TEXTURE_BUFFER, particle_pos_mass_tex[particle_source]);
+    glt::stateCache().bindTexture(
+      0, GL_TEXTURE_BUFFER, particle_pos_mass_tex[particle_source]);
 
     auto dt = real(engine.gameLoop().tickDuration());
     auto damp_coeff = 0.99_r; // damping over the period of 1 sec;
@@ -299,13 +323,13 @@ Anim::animate(const ge::Event<ge::AnimationEvent> &)
             1,
             particle_vel_handle[particle_dest]);
 
-    GL_CALL(glBindVertexArray, particle_vertex_array[particle_source]);
+    glt::stateCache().bindVertexArray(particle_vertex_array[particle_source]);
 
     GL_CALL(glBeginTransformFeedback, GL_POINTS);
     GL_CALL(glDrawArrays, GL_POINTS, 0, N_SPRINGS * N_SPRINGS);
     GL_CALL(glEndTransformFeedback);
 
-    GL_CALL(glDisable, GL_RASTERIZER_DISCARD);
+    glt::stateCache().disable(GL_RASTERIZER_DISCARD);
 
     particle_source = particle_dest;
 
@@ -15,7 +15,10 @@
 #include "ge/MouseLookPlugin.hpp"
 #include "ge/Timer.hpp"
 #include "glt/Frame.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/Mesh.hpp"
+#include "glt/PlyLoader.hpp"
+#include "glt/TextureLoader.hpp"
 #include "glt/TextureRenderTarget.hpp"
 #include "glt/Uniforms.hpp"
 #include "glt/color.hpp"
@@ -29,12 +32,11 @@
 #include "math/vec3.hpp"
 #include "math/vec4.hpp"
 #include "sys/fs.hpp"
+#include "sys/io.hpp"
 #ifdef MESH_CUBEMESH
 #    include "glt/CubeMesh.hpp"
 #endif
 
-#include "dump_bmp.h"
-
 #include <vector>
 
 #ifdef MESH_CUBEMESH
@@ -352,9 +354,9 @@ Anim::renderScene(const Event<RenderEvent> &e)
       glt::color(vec4(vec3(0.65f), bg_alpha)));
     rm.activeRenderTarget()->clear();
 
-    GL_CALL(glDisable, GL_BLEND);
-    GL_CALL(glEnable, GL_DEPTH_TEST);
-    GL_CALL(glDisable, GL_ALPHA_TEST);
+    glt::stateCache().disable(GL_BLEND);
+    glt::stateCache().enable(GL_DEPTH_TEST);
+    glt::stateCache().disable(GL_ALPHA_TEST);
 
     light = lightPosition(interpolation);
 
@@ -393,7 +395,7 @@ Anim::renderScene(const Event<RenderEvent> &e)
     renderTeapot(teapot2);
 
 #ifdef RENDER_GLOW
-    GL_CALL(glDisable, GL_DEPTH_TEST);
+    glt::stateCache().disable(GL_DEPTH_TEST);
 
     { // create the glow texture
         engine.renderManager().setActiveRenderTarget(
@@ -686,57 +688,67 @@ Anim::keyPressed(const Event<KeyPressed> &e)
     END_NO_WARN_SWITCH
 }
 
-struct FileDeleter
-{
-    void operator()(FILE *h) noexcept { fclose(h); }
-};
-
-using unique_file = std::unique_ptr<FILE, FileDeleter>;
-
 void
 Anim::loadResources(const std::string &dir)
 {
     data_dir = dir;
 
-    int w, h;
-    uint32_t *wood_data;
-    auto file = unique_file(fopen((data_dir + "/wood.bmp").c_str(), "rb"));
-    if (!file) {
+    // block compressed once, with --texture-cache the result is reused
+    auto wood_path = data_dir + "/wood.bmp";
+    auto wood_file = sys::io::mapFile(wood_path);
+    if (!wood_file) {
         ERR("couldnt open data/wood.bmp");
         return;
     }
-    if (bmp_read(file.get(), &w, &h, &wood_data) != BMP_OK) {
-        ERR("couldnt load data/wood.bmp");
-        return;
+    glt::TextureLoadOptions wood_opts;
+    wood_opts.compress = true;
+    wood_opts.format = glt::BlockFormat::BC1;
+    wood_opts.quality = glt::BlockQuality::High;
+
+    auto &texture_cache = engine.textureCache();
+    auto wood_key =
+      glt::CompressedTextureCache::key(wood_file->data(), wood_opts);
+    glt::CompressedTexture wood;
+    if (!texture_cache.load(wood_key, wood)) {
+        glt::Image img;
+        std::string error;
+        if (!glt::decodeBMP(wood_file->data(), img, error)) {
+            ERR("couldnt load data/wood.bmp: " + error);
+            return;
+        }
+        glt::buildCompressedTexture(img, wood_opts, wood);
+        texture_cache.store(wood_key, wood);
     }
 
-    GL_CALL(glTextureImage2DEXT,
-            *woodTexture.data()->ensureHandle(),
-            GL_TEXTURE_2D,
-            0,
-            GL_RGB8,
-            GLint(w),
-            GLint(h),
-            0,
-            GL_RGBA,
-            GL_UNSIGNED_BYTE,
-            wood_data);
-    free(wood_data);
+    woodTexture.data()->uploadCompressed(wood);
     woodTexture.filterMode(glt::TextureSampler::FilterLinear);
-
-    auto nfaces = parse_sply((data_dir + "/teapot.sply").c_str(), teapotModel);
-    if (nfaces < 0) {
+    GL_CALL(glSamplerParameteri,
+            *woodTexture.ensureSampler(),
+            GL_TEXTURE_MIN_FILTER,
+            GL_LINEAR_MIPMAP_LINEAR);
+
+    // with --mesh-cache the parsed model is mapped and uploaded directly
+    auto teapot_file = data_dir + "/teapot.sply";
+    bool ok = engine.meshCache().loadOrBuild(
+      "teapot",
+      teapotModel,
+      [&](glt::MeshBase &) {
+          auto nfaces = parse_sply(teapot_file.c_str(), teapotModel);
+          if (nfaces < 0)
+              return false;
+          sys::io::stdout() << "parsed teapot model: " << nfaces << " vertices"
+                            << "\n";
+#ifdef MESH_MESH
+          teapotModel.primType(GL_QUADS);
+#endif
+          teapotModel.drawType(glt::DrawElements);
+          return true;
+      },
+      teapot_file);
+    if (!ok) {
         ERR("couldnt parse teapot model");
         return;
     }
-    sys::io::stdout() << "parsed teapot model: " << nfaces << " vertices"
-                      << "\n";
-
-#ifdef MESH_MESH
-    teapotModel.primType(GL_QUADS);
-#endif
-    teapotModel.drawType(glt::DrawElements);
-    teapotModel.send();
 }
 
 int
@@ -755,79 +767,25 @@ main(int argc, char *argv[])
 int32_t
 parse_sply(const char *filename, CubeMeshOf<Vertex> &model)
 {
-    auto data = unique_file(fopen(filename, "rb"));
-    if (!data)
-        return -1;
-
-    char line[512];
-
-    std::vector<Vertex> verts;
-    uint32_t nverts = 0;
-    uint32_t nfaces = 0;
-
-    if (fscanf(data.get(), "%u\n%u\n", &nverts, &nfaces) != 2)
+    glt::PlyMesh ply;
+    glt::PlyLoadOptions opts;
+#ifndef MESH_CUBEMESH
+    opts.triangulate = false; // drawn as GL_QUADS
+#endif
+    if (!glt::loadPly(filename, ply, opts))
         return -1;
 
-    while (fgets(line, sizeof line, data.get()) != nullptr &&
-           verts.size() < nverts) {
-        point3_t p;
-        direction3_t n;
-        int nparsed = sscanf(line,
-                             "%" R_FMT " %" R_FMT " %" R_FMT " %" R_FMT
-                             " %" R_FMT " %" R_FMT,
-                             &p[0],
-                             &p[1],
-                             &p[2],
-                             &n[0],
-                             &n[1],
-                             &n[2]);
-
-        if (nparsed != 6)
-            return -1;
-
-        Vertex v{};
-        v.position = p;
-        v.normal = normalize(n);
-        verts.push_back(v);
-    }
-
-    if (verts.size() != nverts)
+    auto pos = ply.property("x");
+    auto nrm = ply.property("nx");
+    if (pos < 0 || nrm < 0)
         return -1;
 
-    uint32_t faces = 0;
-
-    for (const auto &vert : verts)
-        model.addVertex(vert);
-
-    while (fgets(line, sizeof line, data.get()) != nullptr && faces < nfaces) {
-        uint32_t n, i, j, k, l;
-        int nparsed = sscanf(line, "%u %u %u %u %u", &n, &i, &j, &k, &l);
-
-        if (nparsed != 5 || n != 4)
-            return -1;
-
-#ifdef MESH_CUBEMESH
-
-        model.pushElement(i);
-        model.pushElement(j);
-        model.pushElement(k);
-        model.pushElement(i);
-        model.pushElement(k);
-        model.pushElement(l);
-
-#else
-
-        model.pushElement(i);
-        model.pushElement(j);
-        model.pushElement(k);
-        model.pushElement(l);
-
-#endif
-
-        ++faces;
-    }
-
-    return int32_t(nfaces) * 4;
+    ply.toMesh(model, [&](std::span<const float> v) {
+        Vertex vert{};
+        vert.position = vec3(v[pos], v[pos + 1], v[pos + 2]);
+        vert.normal = normalize(vec3(v[nrm], v[nrm + 1], v[nrm + 2]));
+        return vert;
+    });
 
-    //    return faces == nfaces ? int32(nfaces) * 4: -1;
+    return int32_t(ply.faces) * 4;
 }
@@ -4,7 +4,10 @@
 #include "ge/Timer.hpp"
 #include "glt/CubeMesh.hpp"
 #include "glt/Frame.hpp"
+#include "glt/GLStateCache.hpp"
+#include "glt/MeshCache.hpp"
 #include "glt/color.hpp"
+#include "glt/packed_types.hpp"
 #include "glt/primitives.hpp"
 #include "glt/utils.hpp"
 #include "math/ivec3.hpp"
@@ -70,10 +73,11 @@ sumNoise3D(const vec3_t &p,
 static void
 pointsOnSphere(uint32_t n, vec3_t *ps);
 
+// normal.w holds the ambient occlusion factor, both fit in [-1, 1]
 DEF_GL_MAPPED_TYPE(Vertex,
                    (vec3_t, position),
                    (glt::color, color),
-                   (vec4_t, normal))
+                   (glt::snorm16<vec4_t>, normal))
 
 using CubeMesh = glt::CubeMesh<Vertex>;
 
@@ -142,7 +146,13 @@ initState(State *state, const InitEv &ev)
       "recreate the entire world",
       [state](const ge::Event<ge::CommandEvent> & /*unused*/) {
           state->worldModel.freeGPU();
-          time_op(initWorld(state, state->worldModel, state->sphere_points));
+          bool ok;
+          time_op(ok =
+                    initWorld(state, state->worldModel, state->sphere_points));
+          if (ok) {
+              state->worldModel.send();
+              state->worldModel.freeHost();
+          }
       }));
 
     state->mouse_look.camera(&state->camera);
@@ -172,20 +182,27 @@ initState(State *state, const InitEv &ev)
     }
 #endif
 
+    // the generated world is kept in the mesh cache if one is configured,
+    // writing the model file needs the host side data though
+    auto &mesh_cache = e.meshCache();
     if (state->read_model) {
         if (!readModel(WORLD_MODEL_FILE, state->worldModel)) {
             ERR("couldnt read model file");
             return;
         }
-    } else {
-
+    } else if (state->write_model ||
+               !mesh_cache.load("voxel-world", state->worldModel)) {
         if (!initWorld(state, state->worldModel, state->sphere_points))
             return;
-    }
 
-    if (state->write_model) {
-        if (!writeModel(WORLD_MODEL_FILE, state->worldModel))
+        if (state->write_model &&
+            !writeModel(WORLD_MODEL_FILE, state->worldModel))
             ERR("couldnt write model file");
+        if (mesh_cache.enabled())
+            mesh_cache.store("voxel-world", state->worldModel);
+
+        state->worldModel.send();
+        state->worldModel.freeHost();
     }
 
     // std::shared_ptr<glt::ShaderProgram> voxel =
@@ -988,9 +1005,6 @@ initWorld(State *state, CubeMesh &worldModel, vec3_t *sphere_points)
     sys::io::stderr() << "faces: " << stats.faces
                       << ", visible faces: " << stats.visFaces << "\n";
 
-    worldModel.send();
-    worldModel.freeHost();
-
     return true;
 }
 
@@ -1003,7 +1017,7 @@ renderScene(State *state, const RenderEv &ev)
     ge::Engine &e = ev.info.engine;
 
     GL_CALL(glClearColor, 1., 1., 1., 1.);
-    GL_CALL(glEnable, GL_DEPTH_TEST);
+    glt::stateCache().enable(GL_DEPTH_TEST);
     GL_CALL(glClear, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     state->ecLightDir =
@@ -1069,22 +1083,21 @@ renderBlocks(State *state, ge::Engine &e)
 //     camera.rotateWorld(rotX, vec3(0., 1., 0.));
 // }
 
+// the model file is mapped and uploaded as is, mdl gets no host side data
 static bool
 readModel(const std::string &file, CubeMesh &mdl)
 {
-    UNUSED(file);
-    UNUSED(mdl);
-    //    return mdl.read(file.c_str());
-    return false;
+    glt::MeshFile mf;
+    if (!mf.open(file, mdl.structInfo(), true))
+        return false;
+    mf.send(mdl);
+    return true;
 }
 
 static bool
 writeModel(const std::string &file, const CubeMesh &mdl)
 {
-    UNUSED(file);
-    UNUSED(mdl);
-    //    return mdl[3]rite(file.c_str());
-    return false;
+    return glt::writeMeshFile(file, mdl);
 }
 
 int
@@ -2,8 +2,10 @@
 
 #include "ge/Engine.hpp"
 #include "glt/GLObject.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/ShaderCompiler.hpp"
 #include "glt/ShaderProgram.hpp"
+#include "glt/Uniforms.hpp"
 #include "glt/utils.hpp"
 
 #include <cassert>
@@ -130,13 +132,33 @@ COMMAND("printGLInstanceStats",
     glt::printStats(e.info.engine.out());
 }
 
+COMMAND("printUniformStats",
+        "print number of issued and skipped uniform uploads")
+(const Event<CommandEvent> &e)
+{
+    glt::printUniformStatistics(e.info.engine.out());
+}
+
+COMMAND("printGLStateStats",
+        "print number of issued and filtered OpenGL state changes")
+(const Event<CommandEvent> &e)
+{
+    glt::stateCache().printStatistics(e.info.engine.out());
+}
+
+COMMAND("resetUniformStats", "reset the uniform upload counters")
+(const Event<CommandEvent> & /*unused*/)
+{
+    glt::resetUniformStatistics();
+}
+
 COMMAND("reloadShaders", "reload ShaderPrograms")
 (const Event<CommandEvent> &e, std::span<const CommandArg> args)
 {
 
     if (args.size() == 0) {
         e.info.engine.out() << "reloading shaders\n";
-        e.info.engine.shaderManager().reloadShaders();
+        e.info.engine.shaderManager().reloadShadersAsync();
         // std::cerr << "all shaders reloaded\n";
     } else {
         glt::ShaderManager &sm = e.info.engine.shaderManager();
@@ -5,12 +5,19 @@
 #include "err/err.hpp"
 #include "ge/Tokenizer.hpp"
 #include "ge/ge.hpp"
+#include "glt/GPUProfiler.hpp"
+#include "glt/NullGL.hpp"
+#include "glt/ProgramBinaryCache.hpp"
 #include "glt/glt.hpp"
 #include "glt/utils.hpp"
 #include "sys/clock.hpp"
 #include "sys/fs.hpp"
+#include "sys/profile.hpp"
 #include "sys/sys.hpp"
 
+#include <algorithm>
+#include <vector>
+
 namespace ge {
 
 using math::real;
@@ -53,8 +60,18 @@ struct Engine::Data : public GameLoop::Game
     bool initialized{ false };
     const EngineOptions *opts{}; // only during init
 
+    // --frames: seconds each frame took, exit once all are recorded
+    size_t frames{};
+    std::vector<double> frame_times;
+    double frame_start{};
+
+    // --capture: every frame of the window is written out
+    std::shared_ptr<glt::CaptureFileWriter> capture_writer;
+
     glt::ShaderManager shaderManager;
     glt::RenderManager renderManager;
+    glt::MeshCache meshCache;
+    glt::CompressedTextureCache textureCache;
 
     EngineEvents events;
 
@@ -78,6 +95,8 @@ struct Engine::Data : public GameLoop::Game
 
     void registerHandlers();
     bool execCommand(std::vector<CommandArg> &args);
+    void recordFrame();
+    void printFrameTimes();
 };
 
 DECLARE_PIMPL_DEL(Engine)
@@ -144,6 +163,18 @@ Engine::renderManager()
     return SELF->renderManager;
 }
 
+glt::MeshCache &
+Engine::meshCache()
+{
+    return SELF->meshCache;
+}
+
+glt::CompressedTextureCache &
+Engine::textureCache()
+{
+    return SELF->textureCache;
+}
+
 EngineEvents &
 Engine::events()
 {
@@ -206,6 +237,32 @@ Engine::run(const EngineOptions &opts)
 
     self->programName = sys::fs::dropExtension(sys::fs::basename(opts.binary));
 
+    // relative to the directory the program was started in
+    if (!opts.meshCacheDir.empty()) {
+        if (sys::fs::directoryExists(opts.meshCacheDir))
+            self->meshCache.directory(
+              sys::fs::absolutePath(opts.meshCacheDir));
+        else
+            ERR("mesh cache directory not found: " + opts.meshCacheDir);
+    }
+
+    if (!opts.programCacheDir.empty()) {
+        if (!self->shaderManager.programBinaryCache().open(
+              sys::fs::absolutePath(opts.programCacheDir)))
+            ERR("program cache directory not found: " + opts.programCacheDir);
+    }
+
+    if (!opts.textureCacheDir.empty()) {
+        if (!self->textureCache.open(
+              sys::fs::absolutePath(opts.textureCacheDir)))
+            ERR("texture cache directory not found: " + opts.textureCacheDir);
+    }
+
+    // relative to the directory the program was started in
+    std::string glCapturePath;
+    if (!opts.glCaptureFile.empty())
+        glCapturePath = sys::fs::absolutePath(opts.glCaptureFile);
+
     if (!wd.empty()) {
         if (!sys::fs::cwd(wd)) {
             ERR("couldnt change into directory: " + wd);
@@ -242,6 +299,16 @@ Engine::run(const EngineOptions &opts)
     if (!runInit(opts.inits.preInit0, initEv))
         return 1;
 
+    // before the context exists, so the capture sees every object created
+    if (!opts.glCaptureFile.empty()) {
+#if ENABLE_GLCAPTURE_P
+        if (!glt::glCaptureStart(glCapturePath))
+            ERR("couldnt open GL capture file: " + glCapturePath);
+#else
+        WARN("cannot capture OpenGL calls: not compiled with ENABLE_GLCAPTURE");
+#endif
+    }
+
     if (!self->init(opts))
         return 1;
 
@@ -283,6 +350,12 @@ Engine::run(const EngineOptions &opts)
     if (!runInit(opts.inits.postInit, initEv))
         return 1;
 
+    // most programs are linked during initialization
+    if (self->shaderManager.programBinaryCache().enabled()) {
+        self->shaderManager.programBinaryCache().flush();
+        self->shaderManager.programBinaryCache().printStats(out());
+    }
+
     opts.inits.preInit0.clear();
     opts.inits.preInit1.clear();
     opts.inits.init.clear();
@@ -290,29 +363,85 @@ Engine::run(const EngineOptions &opts)
 
     self->opts = nullptr;
 
+    if (!opts.capturePrefix.empty())
+        self->capture_writer = std::make_shared<glt::CaptureFileWriter>(
+          opts.capturePrefix, opts.captureFormat);
+
+    if (!opts.traceFile.empty()) {
+        if (sys::trace().open(opts.traceFile))
+            sys::trace().nameTrack(sys::TraceWriter::threadTrack(), "main");
+        else
+            WARN("couldnt open trace file: " + opts.traceFile);
+    }
+
+    if (opts.frames > 0) {
+        self->frames = opts.frames;
+        self->frame_times.reserve(opts.frames);
+        self->gameLoop.maxFPS(0);
+        self->frame_start = sys::queryTimer();
+        if (glt::glBackend() == glt::GLBackend::Null)
+            glt::resetNullGLCalls();
+    }
+
     return self->gameLoop.run(*self);
 }
 
 void
 Engine::Data::tick()
 {
+    CPU_SCOPE("tick");
     events.animate.raise(Event(AnimationEvent(theEngine)));
 }
 
 void
 Engine::Data::render(double interpolation)
 {
+    CPU_SCOPE("render");
+    shaderManager.pollReloads();
+    shaderManager.pollPrewarm();
     events.beforeRender.raise(
       Event(RenderEvent(theEngine, real(interpolation))));
     if (!skipRender) {
+        if (capture_writer)
+            window->renderTarget()->captureAsync(capture_writer);
         GL_TRACE("BEGIN_SCENE");
         renderManager.beginScene();
         events.render.raise(Event(RenderEvent(theEngine, real(interpolation))));
         renderManager.endScene();
         GL_TRACE("END_SCENE");
+#if ENABLE_GLCAPTURE_P
+        glt::glCaptureFrame();
+#endif
     }
     events.afterRender.raise(
       Event(RenderEvent(theEngine, real(interpolation))));
+    if (frames > 0)
+        recordFrame();
+}
+
+void
+Engine::Data::recordFrame()
+{
+    const double t = sys::queryTimer();
+    frame_times.push_back(t - frame_start);
+    frame_start = t;
+    if (frame_times.size() == frames) {
+        printFrameTimes();
+        gameLoop.exit(0);
+    }
+}
+
+void
+Engine::Data::printFrameTimes()
+{
+    const auto stats = sys::timingStats(frame_times);
+    *out << "frames: " << stats.count << " in " << stats.total << " s, "
+         << (double(stats.count) / stats.total) << " fps\n"
+         << "frame time: ";
+    sys::printTimingStats(*out, stats);
+    glt::gpuProfiler().printStatistics(*out);
+    if (glt::glBackend() == glt::GLBackend::Null)
+        glt::printNullGLCalls(*out, stats.count);
 }
 
 void
@@ -336,13 +465,31 @@ Engine::Data::sleep(GameLoop::time secs)
 void
 Engine::Data::atExit(int32_t exit_code)
 {
+    if (capture_writer) {
+        auto &rt = *window->renderTarget();
+        rt.finishCaptures();
+        *out << "captured frames: " << capture_writer->written();
+        if (rt.frameCapture() != nullptr)
+            *out << ", " << rt.frameCapture()->stalls()
+                 << " waited for the GPU";
+        *out << "\n";
+    }
     events.exit.raise(Event(ExitEvent(theEngine, exit_code)));
+    sys::trace().close();
+#if ENABLE_GLCAPTURE_P
+    if (glt::glCapturing()) {
+        *out << "captured GL calls: " << glt::glCapturedCalls() << "\n";
+        glt::glCaptureStop();
+    }
+#endif
 }
 
 bool
 Engine::Data::init(const EngineOptions &eopts)
 {
     opts = &eopts;
+    if (eopts.window.backend == WindowOptions::HeadlessNull)
+        glt::moduleInit(glt::GLBackend::Null);
     window = std::make_unique<GameWindow>(eopts.window);
     renderManager.setDefaultRenderTarget(window->renderTarget());
     registerHandlers();
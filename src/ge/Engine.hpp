@@ -13,6 +13,8 @@
 #include "ge/KeyHandler.hpp"
 #include "ge/Plugin.hpp"
 #include "ge/ReplServer.hpp"
+#include "glt/CompressedTextureCache.hpp"
+#include "glt/MeshCache.hpp"
 #include "glt/RenderManager.hpp"
 #include "glt/ShaderManager.hpp"
 #include "glt/ShaderProgram.hpp"
@@ -36,6 +38,8 @@ struct GE_API Engine
 
     glt::ShaderManager &shaderManager();
     glt::RenderManager &renderManager();
+    glt::MeshCache &meshCache();
+    glt::CompressedTextureCache &textureCache();
 
     EngineEvents &events();
 
@@ -31,10 +31,20 @@ enum OptionCase
     GLProfile,
     GLDebug,
     GLTrace,
+    GLCapture,
     AASamples,
     VSync,
     DisableRender,
-    DumpShaders
+    DumpShaders,
+    MeshCache,
+    ProgramCache,
+    TextureCache,
+    Headless,
+    WindowSize,
+    Frames,
+    Capture,
+    CaptureFileFormat,
+    Trace
 };
 
 struct Option
@@ -76,6 +86,11 @@ const constexpr auto OPTIONS = std::to_array<Option>({
     "set the OpenGL profile type: core|compatibility" },
   { "--gl-debug", "BOOL", GLDebug, "create a OpenGL debug context: yes|no" },
   { "--gl-trace", "BOOL", GLTrace, "print every OpenGL call: yes|no" },
+  { "--gl-capture",
+    "FILE",
+    GLCapture,
+    "record every OpenGL call into FILE, for replay with gl-replay, needs "
+    "ENABLE_GLCAPTURE" },
   { "--aa-samples", "NUM", AASamples, "set the number of FSAA Samples" },
   { "--vsync", "BOOL", VSync, "enable vertical sync: yes|no" },
   { "--disable-render",
@@ -86,6 +101,43 @@ const constexpr auto OPTIONS = std::to_array<Option>({
     "BOOL",
     DumpShaders,
     "dump shader source after preprocessing" },
+  { "--mesh-cache",
+    "DIR",
+    MeshCache,
+    "store and load preprocessed meshes in directory DIR" },
+  { "--program-cache",
+    "DIR",
+    ProgramCache,
+    "store and load linked shader program binaries in directory DIR" },
+  { "--texture-cache",
+    "DIR",
+    TextureCache,
+    "store and load block compressed textures in directory DIR" },
+  { "--headless",
+    "TYPE",
+    Headless,
+    "render offscreen without a display, null: without GL at all: "
+    "egl|osmesa|null|no" },
+  { "--window-size",
+    "WxH",
+    WindowSize,
+    "set the window or offscreen framebuffer size" },
+  { "--frames",
+    "NUM",
+    Frames,
+    "render NUM frames as fast as possible, print timings and exit" },
+  { "--capture",
+    "PREFIX",
+    Capture,
+    "write every frame to PREFIX<frame>.bmp, read back asynchronously" },
+  { "--capture-format",
+    "FORMAT",
+    CaptureFileFormat,
+    "file format of captured frames: bmp|raw" },
+  { "--trace",
+    "FILE",
+    Trace,
+    "write CPU and GPU zones to FILE as Chrome trace JSON" },
 });
 
 struct State
@@ -197,6 +249,9 @@ State::option(OptionCase opt, const char *arg)
             return false;
         }
         return true;
+    case GLCapture:
+        options.glCaptureFile = arg;
+        return true;
     case AASamples:
         unsigned samples;
         if (sscanf(arg, "%u", &samples) != 1) {
@@ -225,6 +280,61 @@ State::option(OptionCase opt, const char *arg)
             return false;
         }
         return true;
+    case MeshCache:
+        options.meshCacheDir = arg;
+        return true;
+    case ProgramCache:
+        options.programCacheDir = arg;
+        return true;
+    case TextureCache:
+        options.textureCacheDir = arg;
+        return true;
+    case Headless:
+        if (str_eq(arg, "egl")) {
+            options.window.backend = WindowOptions::HeadlessEGL;
+        } else if (str_eq(arg, "osmesa")) {
+            options.window.backend = WindowOptions::HeadlessOSMesa;
+        } else if (str_eq(arg, "null")) {
+            options.window.backend = WindowOptions::HeadlessNull;
+        } else if (str_eq(arg, "no")) {
+            options.window.backend = WindowOptions::Windowed;
+        } else {
+            CMDWARN("--headless: invalid type: " + std::string(arg));
+            return false;
+        }
+        return true;
+    case WindowSize: {
+        unsigned w, h;
+        if (sscanf(arg, "%ux%u", &w, &h) != 2 || w == 0 || h == 0) {
+            CMDWARN("--window-size: expected WIDTHxHEIGHT");
+            return false;
+        }
+        options.window.width = w;
+        options.window.height = h;
+        return true;
+    }
+    case Frames:
+        if (sscanf(arg, "%zu", &options.frames) != 1) {
+            CMDWARN("--frames: not an integer");
+            return false;
+        }
+        return true;
+    case Capture:
+        options.capturePrefix = arg;
+        return true;
+    case CaptureFileFormat:
+        if (str_eq(arg, "bmp")) {
+            options.captureFormat = glt::CaptureFormat::BMP;
+        } else if (str_eq(arg, "raw")) {
+            options.captureFormat = glt::CaptureFormat::Raw;
+        } else {
+            CMDWARN("--capture-format: invalid format: " + std::string(arg));
+            return false;
+        }
+        return true;
+    case Trace:
+        options.traceFile = arg;
+        return true;
     }
     FATAL_ERR("foo");
 }
@@ -239,6 +349,8 @@ EngineOptions::EngineOptions()
   , traceOpenGL(false)
   , disableRender(false)
   , dumpShaders(false)
+  , frames(0)
+  , captureFormat(glt::CaptureFormat::BMP)
 {
     window.settings.majorVersion = 3;
     window.settings.minorVersion = 3;
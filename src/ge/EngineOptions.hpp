@@ -3,6 +3,7 @@
 
 #include "ge/GameWindow.hpp"
 #include "ge/Init.hpp"
+#include "glt/FrameCapture.hpp"
 
 #include <vector>
 
@@ -34,6 +35,14 @@ struct GE_API EngineOptions
     bool traceOpenGL;
     bool disableRender;
     bool dumpShaders;
+    std::string meshCacheDir;    // empty: no mesh cache
+    std::string programCacheDir; // empty: no program binary cache
+    std::string textureCacheDir; // empty: no compressed texture cache
+    size_t frames;               // 0: until exit, else exit and print timings
+    std::string capturePrefix;   // empty: no frames are captured
+    glt::CaptureFormat captureFormat;
+    std::string traceFile;       // empty: no trace of CPU and GPU zones
+    std::string glCaptureFile;   // empty: GL calls are not captured
 
     mutable EngineInitializers inits;
 
@@ -5,6 +5,7 @@
 #include "err/err.hpp"
 #include "ge/Event.hpp"
 #include "ge/module.hpp"
+#include "glt/glt.hpp"
 #include "glt/utils.hpp"
 #include "math/real.hpp"
 #include "opengl.hpp"
@@ -30,12 +31,17 @@ struct GameWindow::Data
     const bool owning_win;
     bool have_focus{ true };
     bool vsync{ false };
+    bool headless{ false };
+    size_t null_width{}; // size of the window without GLFW
+    size_t null_height{};
 
     Data(GameWindow &_self, bool owns_win, GLFWwindow *rw)
       : self(_self), win(rw), owning_win(owns_win)
     {}
 
     void init(const WindowOptions &opts);
+    void initNull(const WindowOptions &opts);
+    void registerCallbacks();
     static void handleInputEvents();
     void setMouse(int16_t x, int16_t y);
 
@@ -189,8 +195,26 @@ convertGLFWMouseButton(int button)
 GLFWwindow *
 GameWindow::Data::makeWindow(const WindowOptions &opts)
 {
-    glfwWindowHint(GLFW_SAMPLES,
-                   static_cast<int>(opts.settings.antialiasingLevel));
+    if (opts.backend == WindowOptions::HeadlessNull)
+        return nullptr;
+
+    if (!module->_internal_game_window_init.initGLFW(opts.headless()))
+        return nullptr;
+
+    glfwDefaultWindowHints();
+    if (opts.headless()) {
+        // rendering goes to the offscreen framebuffer of the render target,
+        // the default framebuffer is never drawn to
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API,
+                       opts.backend == WindowOptions::HeadlessOSMesa
+                         ? GLFW_OSMESA_CONTEXT_API
+                         : GLFW_EGL_CONTEXT_API);
+        glfwWindowHint(GLFW_SAMPLES, 0);
+    } else {
+        glfwWindowHint(GLFW_SAMPLES,
+                       static_cast<int>(opts.settings.antialiasingLevel));
+    }
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,
                    static_cast<int>(opts.settings.majorVersion));
@@ -352,14 +376,8 @@ GameWindow::Data::glfw_mouse_scroll_callback(GLFWwindow *win,
 }
 
 void
-GameWindow::Data::init(const WindowOptions &opts)
+GameWindow::Data::registerCallbacks()
 {
-
-    ASSERT(renderTarget == nullptr);
-    renderTarget = std::make_shared<WindowRenderTarget>(self);
-
-    glfwSetWindowUserPointer(win, this);
-
     glfwSetWindowSizeCallback(win, glfw_window_size_callback);
     glfwSetWindowCloseCallback(win, glfw_window_close_callback);
     glfwSetWindowRefreshCallback(win, glfw_window_refresh_callback);
@@ -371,6 +389,29 @@ GameWindow::Data::init(const WindowOptions &opts)
     glfwSetKeyCallback(win, glfw_key_callback);
     glfwSetMouseButtonCallback(win, glfw_mouse_button_callback);
     glfwSetScrollCallback(win, glfw_mouse_scroll_callback);
+}
+
+void
+GameWindow::Data::init(const WindowOptions &opts)
+{
+    ASSERT(renderTarget == nullptr);
+    if (opts.backend == WindowOptions::HeadlessNull) {
+        initNull(opts);
+        return;
+    }
+
+    if (win == nullptr)
+        FATAL_ERR(opts.headless()
+                    ? "couldnt create a headless OpenGL context"
+                    : "couldnt create window, without a display try "
+                      "--headless egl|osmesa");
+
+    headless = opts.headless();
+    glfwSetWindowUserPointer(win, this);
+
+    // headless windows get no input
+    if (!headless)
+        registerCallbacks();
 
     glfwMakeContextCurrent(win);
 
@@ -379,7 +420,7 @@ GameWindow::Data::init(const WindowOptions &opts)
         FATAL_ERR("GLAD initialization failed");
     GL_CHECK_ERRORS();
 
-    vsync = opts.vsync;
+    vsync = opts.vsync && !headless;
     //    win->setVerticalSyncEnabled(opts.vsync);
 
     events.windowResized.reg(resizeRenderTarget);
@@ -394,19 +435,42 @@ GameWindow::Data::init(const WindowOptions &opts)
     context_info.coreProfile =
       glfwGetWindowAttrib(win, GLFW_OPENGL_PROFILE) == GLFW_OPENGL_CORE_PROFILE;
 
-    if (!glfwExtensionSupported("GL_ARB_multisample")) {
+    if (headless) {
+        // the samples of the offscreen framebuffer
+    } else if (!glfwExtensionSupported("GL_ARB_multisample")) {
         context_info.antialiasingLevel = 0;
     } else {
         GLint samples;
         glGetIntegerv(GL_SAMPLES_ARB, &samples);
         context_info.antialiasingLevel = samples;
     }
+
+    renderTarget = std::make_shared<WindowRenderTarget>(self);
+}
+
+void
+GameWindow::Data::initNull(const WindowOptions &opts)
+{
+    if (glt::glBackend() != glt::GLBackend::Null)
+        FATAL_ERR("headless null window without the null GL backend");
+
+    headless = true;
+    null_width = opts.width;
+    null_height = opts.height;
+    events.windowResized.reg(resizeRenderTarget);
+
+    context_info = opts.settings;
+    context_info.majorVersion = unsigned(GLVersion.major);
+    context_info.minorVersion = unsigned(GLVersion.minor);
+
+    renderTarget = std::make_shared<WindowRenderTarget>(self);
 }
 
 void
 GameWindow::Data::setMouse(int16_t x, int16_t y)
 {
-    glfwSetCursorPos(win, x, y);
+    if (win != nullptr)
+        glfwSetCursorPos(win, x, y);
     mouse_x = x;
     mouse_y = y;
 }
@@ -420,6 +484,8 @@ GameWindow::GameWindow(const WindowOptions &opts)
 GameWindow::~GameWindow()
 {
     self->renderTarget.reset();
+    if (self->win == nullptr)
+        return;
     glfwMakeContextCurrent(nullptr);
     if (self->owning_win)
         glfwDestroyWindow(self->win);
@@ -442,6 +508,8 @@ GameWindow::showMouseCursor(bool show)
 {
     if (show != self->show_mouse_cursor) {
         self->show_mouse_cursor = show;
+        if (self->win == nullptr)
+            return;
         glfwSetInputMode(self->win,
                          GLFW_CURSOR,
                          show ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_HIDDEN);
@@ -457,6 +525,10 @@ GameWindow::showMouseCursor() const
 void
 GameWindow::vsync(bool enable)
 {
+    if (enable && self->headless) {
+        WARN("no vsync in headless mode");
+        return;
+    }
     if (self->vsync != enable) {
         self->vsync = enable;
         ERR("VSYNC not implemented");
@@ -475,6 +547,12 @@ GameWindow::focused() const
     return self->have_focus;
 }
 
+bool
+GameWindow::headless() const
+{
+    return self->headless;
+}
+
 const std::shared_ptr<WindowRenderTarget> &
 GameWindow::renderTarget() const
 {
@@ -490,6 +568,8 @@ GameWindow::events()
 void
 GameWindow::registerHandlers(EngineEvents &evnts)
 {
+    if (self->headless)
+        return;
     evnts.handleInput.reg(
       [self = self.get()](const Event<InputEvent> & /*unused*/) {
           self->handleInputEvents();
@@ -519,6 +599,12 @@ GameWindow::windowHeight() const
 void
 GameWindow::windowSize(size_t &width, size_t &height) const
 {
+    if (self->win == nullptr) {
+        width = self->null_width;
+        height = self->null_height;
+        return;
+    }
+
     int w;
 
     int h;
@@ -536,7 +622,9 @@ GameWindow::setMouse(int16_t x, int16_t y)
 void
 GameWindow::swapBuffers()
 {
-    glfwSwapBuffers(self->win);
+    // headless contexts may have no default framebuffer
+    if (!self->headless)
+        glfwSwapBuffers(self->win);
 }
 
 GLContextInfo
@@ -547,16 +635,40 @@ GameWindow::contextInfo() const
 
 GameWindowInit::GameWindowInit()
 {
-    if (!glfwInit()) {
-        ERR("Couldnt initialize GLFW");
-    } else {
-        glfwSetErrorCallback(glfw_error_callback);
-    }
+    glfwSetErrorCallback(glfw_error_callback);
 }
 
 GameWindowInit::~GameWindowInit()
 {
-    glfwTerminate();
+    if (initialized)
+        glfwTerminate();
+}
+
+bool
+GameWindowInit::initGLFW(bool want_headless)
+{
+    if (initialized && headless == want_headless)
+        return true;
+    if (initialized)
+        glfwTerminate();
+    initialized = false;
+
+#ifdef GLFW_PLATFORM_NULL
+    glfwInitHint(GLFW_PLATFORM,
+                 want_headless ? GLFW_PLATFORM_NULL : GLFW_ANY_PLATFORM);
+#else
+    if (want_headless)
+        WARN("GLFW older than 3.4 has no null platform, headless windows "
+             "still need a display");
+#endif
+
+    if (!glfwInit()) {
+        ERR("Couldnt initialize GLFW");
+        return false;
+    }
+    initialized = true;
+    headless = want_headless;
+    return true;
 }
 
 } // namespace ge
@@ -39,15 +39,36 @@ struct GE_API GLContextInfo
 
 struct GE_API WindowOptions
 {
+    // Headless backends need no display: the context is created through
+    // EGL (surfaceless Mesa platform) or OSMesa and the window render
+    // target is an offscreen framebuffer of width x height. There is no
+    // input and no vsync. HeadlessNull creates no context at all, it needs
+    // glt::moduleInit(glt::GLBackend::Null) and nothing is drawn.
+    enum Backend : uint8_t
+    {
+        Windowed,
+        HeadlessEGL,
+        HeadlessOSMesa,
+        HeadlessNull
+    };
+
     size_t width;
     size_t height;
     std::string title;
     GLContextInfo settings;
     bool vsync;
+    Backend backend;
 
     WindowOptions()
-      : width(800), height(600), title(""), settings(), vsync(false)
+      : width(800)
+      , height(600)
+      , title("")
+      , settings()
+      , vsync(false)
+      , backend(Windowed)
     {}
+
+    bool headless() const { return backend != Windowed; }
 };
 
 struct GE_API GameWindow
@@ -63,6 +84,8 @@ struct GE_API GameWindow
 
     bool focused() const;
 
+    bool headless() const;
+
     static bool init();
 
     const std::shared_ptr<WindowRenderTarget> &renderTarget() const;
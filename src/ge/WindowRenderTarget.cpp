@@ -1,5 +1,6 @@
 #include "ge/WindowRenderTarget.hpp"
 #include "ge/GameWindow.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/utils.hpp"
 #include "math/vec3.hpp"
 #include "math/vec4.hpp"
@@ -23,27 +24,137 @@ buffersOf(GameWindow &win)
 } // namespace
 
 WindowRenderTarget::WindowRenderTarget(GameWindow &w)
-  : RenderTarget(w.windowWidth(), w.windowHeight(), buffersOf(w)), window(w)
-{}
+  : RenderTarget(w.windowWidth(), w.windowHeight(), buffersOf(w))
+  , window(w)
+  , _frame_buffer(0)
+  , _color_buffer(0)
+  , _depth_buffer(0)
+  , _resolve_frame_buffer(0)
+  , _resolve_color_buffer(0)
+{
+    if (window.headless())
+        createOffscreen();
+}
+
+void
+WindowRenderTarget::createOffscreen()
+{
+    const auto samples = GLsizei(window.contextInfo().antialiasingLevel);
+    const auto w = GLsizei(width());
+    const auto h = GLsizei(height());
+
+    auto storage = [&](GLuint rb, GLenum format) {
+        if (samples > 1)
+            GL_CALL(glNamedRenderbufferStorageMultisampleEXT,
+                    rb,
+                    samples,
+                    format,
+                    w,
+                    h);
+        else
+            GL_CALL(glNamedRenderbufferStorageEXT, rb, format, w, h);
+    };
+
+    // on resize only the storage is replaced, the framebuffer keeps its
+    // name and stays bound
+    _frame_buffer.ensure();
+
+    _color_buffer.ensure();
+    storage(*_color_buffer, GL_RGBA8);
+    GL_CALL(glNamedFramebufferRenderbufferEXT,
+            *_frame_buffer,
+            GL_COLOR_ATTACHMENT0,
+            GL_RENDERBUFFER,
+            *_color_buffer);
+
+    const auto bs = buffers();
+    if (bs & (glt::RT_DEPTH_BUFFER | glt::RT_STENCIL_BUFFER)) {
+        const bool stencil = (bs & glt::RT_STENCIL_BUFFER) != 0;
+        _depth_buffer.ensure();
+        storage(*_depth_buffer,
+                stencil ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24);
+        GL_CALL(glNamedFramebufferRenderbufferEXT,
+                *_frame_buffer,
+                stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+                GL_RENDERBUFFER,
+                *_depth_buffer);
+    }
+
+    GLenum status;
+    GL_ASSIGN_CALL(
+      status, glCheckNamedFramebufferStatusEXT, *_frame_buffer, GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        ERR("offscreen framebuffer incomplete");
+
+    // glReadPixels cannot read multisampled framebuffers
+    if (samples <= 1)
+        return;
+    _resolve_frame_buffer.ensure();
+    _resolve_color_buffer.ensure();
+    GL_CALL(glNamedRenderbufferStorageEXT,
+            *_resolve_color_buffer,
+            GL_RGBA8,
+            w,
+            h);
+    GL_CALL(glNamedFramebufferRenderbufferEXT,
+            *_resolve_frame_buffer,
+            GL_COLOR_ATTACHMENT0,
+            GL_RENDERBUFFER,
+            *_resolve_color_buffer);
+    GL_ASSIGN_CALL(status,
+                   glCheckNamedFramebufferStatusEXT,
+                   *_resolve_frame_buffer,
+                   GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        ERR("offscreen resolve framebuffer incomplete");
+}
 
 void
 WindowRenderTarget::resized()
 {
     updateSize(window.windowWidth(), window.windowHeight());
+    if (window.headless())
+        createOffscreen();
 }
 
 void
 WindowRenderTarget::doActivate()
 {
-    GL_CALL(glBindFramebuffer, GL_FRAMEBUFFER, 0);
+    glt::stateCache().bindFramebuffer(GL_FRAMEBUFFER, *_frame_buffer);
 }
 
 void
 WindowRenderTarget::doDraw()
 {
     window.swapBuffers();
-    if (window.vsync())
+    // headless frames are finished so frame times include the GPU work
+    if (window.vsync() || window.headless())
         GL_CALL(glFinish);
 }
 
+void
+WindowRenderTarget::doResolve()
+{
+    if (!_resolve_frame_buffer.valid())
+        return;
+    const auto w = GLint(width());
+    const auto h = GLint(height());
+    glt::stateCache().bindFramebuffer(GL_READ_FRAMEBUFFER, *_frame_buffer);
+    glt::stateCache().bindFramebuffer(GL_DRAW_FRAMEBUFFER,
+                                      *_resolve_frame_buffer);
+    GL_CALL(glBlitFramebuffer,
+            0,
+            0,
+            w,
+            h,
+            0,
+            0,
+            w,
+            h,
+            GL_COLOR_BUFFER_BIT,
+            GL_NEAREST);
+    glt::stateCache().bindFramebuffer(GL_READ_FRAMEBUFFER,
+                                      *_resolve_frame_buffer);
+}
+
 } // namespace ge
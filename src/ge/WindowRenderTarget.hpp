@@ -2,24 +2,40 @@
 #define GLT_WINDOW_RENDER_TARGET_HPP
 
 #include "ge/conf.hpp"
+#include "glt/GLObject.hpp"
 #include "glt/RenderTarget.hpp"
 
 namespace ge {
 
 struct GameWindow;
 
+// The default framebuffer of a window, for headless windows an offscreen
+// framebuffer of the window size with the buffers of the context settings.
+// A multisampled offscreen framebuffer is resolved into a single sampled
+// one before frames are read back.
 struct GE_API WindowRenderTarget : public glt::RenderTarget
 {
 private:
     GameWindow &window;
+    glt::GLFramebufferObject _frame_buffer;
+    glt::GLRenderbufferObject _color_buffer;
+    glt::GLRenderbufferObject _depth_buffer;
+    glt::GLFramebufferObject _resolve_frame_buffer;
+    glt::GLRenderbufferObject _resolve_color_buffer;
+
+    void createOffscreen();
 
 public:
     WindowRenderTarget(GameWindow &win);
     void resized();
 
+    // 0 for the default framebuffer
+    GLuint framebuffer() const { return *_frame_buffer; }
+
 protected:
     virtual void doActivate() final override;
     virtual void doDraw() final override;
+    virtual void doResolve() final override;
 };
 
 } // namespace ge
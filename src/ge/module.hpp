@@ -17,6 +17,14 @@ struct GameWindowInit
 {
     GameWindowInit();
     ~GameWindowInit();
+
+    // GLFW is initialized with the first window, headless windows need the
+    // null platform
+    bool initGLFW(bool headless);
+
+private:
+    bool initialized{ false };
+    bool headless{ false };
 };
 
 struct Module
@@ -0,0 +1,534 @@
+#include "glt/BlockCompression.hpp"
+
+#include "err/err.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace glt {
+
+PP_DEF_ENUM_IMPL(GLT_BLOCK_FORMAT_ENUM_DEF);
+PP_DEF_ENUM_IMPL(GLT_BLOCK_QUALITY_ENUM_DEF);
+
+namespace {
+
+// least squares refinements of the High quality color endpoints
+constexpr int REFINE_ITERATIONS = 2;
+
+// power iterations to find the principal axis of the block colors
+constexpr int AXIS_ITERATIONS = 8;
+
+using Texels = uint8_t[16][4];
+
+template<typename F>
+void
+parallelFor(size_t n, unsigned threads, F &&f)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    threads = unsigned(std::min(size_t(threads), n));
+    if (threads <= 1) {
+        for (size_t i = 0; i < n; ++i)
+            f(i);
+        return;
+    }
+
+    std::atomic<size_t> next{ 0 };
+    auto work = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;)
+            f(i);
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned k = 1; k < threads; ++k)
+        workers.emplace_back(work);
+    work();
+    for (auto &w : workers)
+        w.join();
+}
+
+uint16_t
+le16(const uint8_t *p)
+{
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+void
+put16(uint8_t *p, uint16_t v)
+{
+    p[0] = uint8_t(v);
+    p[1] = uint8_t(v >> 8);
+}
+
+void
+fetchBlock(const Image &img, size_t bx, size_t by, Texels &texels)
+{
+    const auto c = img.channels;
+    for (size_t y = 0; y < 4; ++y) {
+        const size_t sy = std::min<size_t>(by * 4 + y, img.height - 1);
+        const auto *row = img.pixels.data() + sy * img.rowSize();
+        for (size_t x = 0; x < 4; ++x) {
+            const size_t sx = std::min<size_t>(bx * 4 + x, img.width - 1);
+            const auto *p = row + sx * c;
+            auto *t = texels[y * 4 + x];
+            t[0] = p[0];
+            t[1] = c >= 3 ? p[1] : p[0];
+            t[2] = c >= 3 ? p[2] : p[0];
+            t[3] = c == 4 ? p[3] : 255;
+        }
+    }
+}
+
+uint16_t
+pack565(const float c[3])
+{
+    auto q = [](float v, int max) {
+        return std::clamp(int(std::lround(v * float(max) / 255.f)), 0, max);
+    };
+    return uint16_t((q(c[0], 31) << 11) | (q(c[1], 63) << 5) | q(c[2], 31));
+}
+
+void
+unpack565(uint16_t v, int out[3])
+{
+    const int r = (v >> 11) & 31;
+    const int g = (v >> 5) & 63;
+    const int b = v & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+// as decoded by the GPU, the fourth entry is transparent black in three
+// color mode
+void
+colorPalette(uint16_t c0, uint16_t c1, int pal[4][4])
+{
+    unpack565(c0, pal[0]);
+    unpack565(c1, pal[1]);
+    pal[0][3] = pal[1][3] = 255;
+    for (int k = 0; k < 3; ++k) {
+        if (c0 > c1) {
+            pal[2][k] = (2 * pal[0][k] + pal[1][k]) / 3;
+            pal[3][k] = (pal[0][k] + 2 * pal[1][k]) / 3;
+        } else {
+            pal[2][k] = (pal[0][k] + pal[1][k]) / 2;
+            pal[3][k] = 0;
+        }
+    }
+    pal[2][3] = 255;
+    pal[3][3] = c0 > c1 ? 255 : 0;
+}
+
+uint32_t
+colorError(const int pal[4], const uint8_t t[4])
+{
+    uint32_t err = 0;
+    for (int k = 0; k < 3; ++k) {
+        const int d = pal[k] - t[k];
+        err += uint32_t(d * d);
+    }
+    return err;
+}
+
+// BC1 block from the given endpoints, returns the squared error
+uint32_t
+encodeColor(const Texels &texels,
+            const float e0[3],
+            const float e1[3],
+            uint8_t out[8])
+{
+    uint16_t c0 = pack565(e0);
+    uint16_t c1 = pack565(e1);
+    // four color mode needs c0 > c1
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    int pal[4][4];
+    colorPalette(c0, c1, pal);
+
+    uint32_t indices = 0;
+    uint32_t err = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 0;
+        uint32_t best_err = colorError(pal[0], texels[i]);
+        // with c0 == c1 there is only one color
+        for (uint32_t j = 1; c0 != c1 && j < 4; ++j) {
+            const auto e = colorError(pal[j], texels[i]);
+            if (e < best_err) {
+                best_err = e;
+                best = j;
+            }
+        }
+        indices |= best << (2 * i);
+        err += best_err;
+    }
+
+    put16(out, c0);
+    put16(out + 2, c1);
+    put16(out + 4, uint16_t(indices));
+    put16(out + 6, uint16_t(indices >> 16));
+    return err;
+}
+
+// endpoints minimizing the squared error for the indices of block, false
+// if they are not determined
+bool
+refineEndpoints(const Texels &texels,
+                const uint8_t block[8],
+                float e0[3],
+                float e1[3])
+{
+    // weight of the first endpoint per index
+    static constexpr float WEIGHT[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+
+    const uint32_t indices = le16(block + 4) | (uint32_t(le16(block + 6)) << 16);
+    float aa = 0, ab = 0, bb = 0;
+    float ax[3]{}, bx[3]{};
+    for (uint32_t i = 0; i < 16; ++i) {
+        const float a = WEIGHT[(indices >> (2 * i)) & 3];
+        const float b = 1.f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int k = 0; k < 3; ++k) {
+            ax[k] += a * texels[i][k];
+            bx[k] += b * texels[i][k];
+        }
+    }
+
+    const float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-6f)
+        return false;
+    for (int k = 0; k < 3; ++k) {
+        e0[k] = std::clamp((bb * ax[k] - ab * bx[k]) / det, 0.f, 255.f);
+        e1[k] = std::clamp((aa * bx[k] - ab * ax[k]) / det, 0.f, 255.f);
+    }
+    return true;
+}
+
+void
+boundingBoxEndpoints(const Texels &texels, float e0[3], float e1[3])
+{
+    float mean[3]{};
+    for (const auto &t : texels)
+        for (int k = 0; k < 3; ++k) {
+            e0[k] = std::max(e0[k], float(t[k]));
+            e1[k] = std::min(e1[k], float(t[k]));
+            mean[k] += t[k];
+        }
+    for (auto &m : mean)
+        m /= 16.f;
+
+    // pick the diagonal of the box matching the correlation of red and
+    // blue with green
+    float cov_rg = 0, cov_bg = 0;
+    for (const auto &t : texels) {
+        const float g = t[1] - mean[1];
+        cov_rg += (t[0] - mean[0]) * g;
+        cov_bg += (t[2] - mean[2]) * g;
+    }
+    if (cov_rg < 0)
+        std::swap(e0[0], e1[0]);
+    if (cov_bg < 0)
+        std::swap(e0[2], e1[2]);
+
+    // inset by 1/16 of the range, the extremes are rarely texels
+    for (int k = 0; k < 3; ++k) {
+        const float inset = (e0[k] - e1[k]) / 16.f;
+        e0[k] -= inset;
+        e1[k] += inset;
+    }
+}
+
+void
+principalAxisEndpoints(const Texels &texels, float e0[3], float e1[3])
+{
+    float mean[3]{};
+    for (const auto &t : texels)
+        for (int k = 0; k < 3; ++k)
+            mean[k] += t[k];
+    for (auto &m : mean)
+        m /= 16.f;
+
+    float cov[3][3]{};
+    for (const auto &t : texels) {
+        const float d[3] = { t[0] - mean[0], t[1] - mean[1], t[2] - mean[2] };
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                cov[i][j] += d[i] * d[j];
+    }
+
+    float axis[3] = { 1.f, 1.f, 1.f };
+    for (int it = 0; it < AXIS_ITERATIONS; ++it) {
+        float next[3];
+        for (int i = 0; i < 3; ++i)
+            next[i] =
+              cov[i][0] * axis[0] + cov[i][1] * axis[1] + cov[i][2] * axis[2];
+        const float len =
+          std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+        if (len < 1e-6f)
+            break;
+        for (int i = 0; i < 3; ++i)
+            axis[i] = next[i] / len;
+    }
+
+    float tmin = 0, tmax = 0;
+    const float norm =
+      axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    for (const auto &t : texels) {
+        const float p = ((t[0] - mean[0]) * axis[0] +
+                         (t[1] - mean[1]) * axis[1] +
+                         (t[2] - mean[2]) * axis[2]) /
+                        norm;
+        tmin = std::min(tmin, p);
+        tmax = std::max(tmax, p);
+    }
+    for (int k = 0; k < 3; ++k) {
+        e0[k] = std::clamp(mean[k] + tmax * axis[k], 0.f, 255.f);
+        e1[k] = std::clamp(mean[k] + tmin * axis[k], 0.f, 255.f);
+    }
+}
+
+void
+encodeColorBlock(const Texels &texels, BlockQuality quality, uint8_t out[8])
+{
+    float e0[3] = { 0, 0, 0 };
+    float e1[3] = { 255, 255, 255 };
+    boundingBoxEndpoints(texels, e0, e1);
+    uint32_t err = encodeColor(texels, e0, e1, out);
+    if (quality == BlockQuality::Fast || err == 0)
+        return;
+
+    uint8_t tmp[8];
+    principalAxisEndpoints(texels, e0, e1);
+    auto e = encodeColor(texels, e0, e1, tmp);
+    if (e < err) {
+        err = e;
+        memcpy(out, tmp, sizeof tmp);
+    }
+
+    for (int it = 0; it < REFINE_ITERATIONS && err > 0; ++it) {
+        if (!refineEndpoints(texels, out, e0, e1))
+            break;
+        e = encodeColor(texels, e0, e1, tmp);
+        if (e >= err)
+            break;
+        err = e;
+        memcpy(out, tmp, sizeof tmp);
+    }
+}
+
+void
+alphaPalette(int a0, int a1, int pal[8])
+{
+    pal[0] = a0;
+    pal[1] = a1;
+    if (a0 > a1) {
+        for (int i = 1; i < 7; ++i)
+            pal[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    } else {
+        for (int i = 1; i < 5; ++i)
+            pal[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        pal[6] = 0;
+        pal[7] = 255;
+    }
+}
+
+// BC4 block from the given endpoints, a0 > a1 selects eight interpolated
+// values, otherwise six and the constants 0 and 255
+uint32_t
+encodeAlpha(const uint8_t values[16], int a0, int a1, uint8_t out[8])
+{
+    int pal[8];
+    alphaPalette(a0, a1, pal);
+
+    uint64_t indices = 0;
+    uint32_t err = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 0;
+        uint32_t best_err = ~0u;
+        for (uint32_t j = 0; j < 8; ++j) {
+            const int d = pal[j] - values[i];
+            if (uint32_t(d * d) < best_err) {
+                best_err = uint32_t(d * d);
+                best = j;
+            }
+        }
+        indices |= uint64_t(best) << (3 * i);
+        err += best_err;
+    }
+
+    out[0] = uint8_t(a0);
+    out[1] = uint8_t(a1);
+    for (int k = 0; k < 6; ++k)
+        out[2 + k] = uint8_t(indices >> (8 * k));
+    return err;
+}
+
+void
+encodeAlphaBlock(const uint8_t values[16], BlockQuality quality, uint8_t out[8])
+{
+    const auto [lo, hi] = std::minmax_element(values, values + 16);
+    uint32_t err = encodeAlpha(values, *hi, *lo, out);
+    if (quality == BlockQuality::Fast || err == 0)
+        return;
+
+    // six value mode, 0 and 255 are free
+    int inner_lo = 255, inner_hi = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (values[i] == 0 || values[i] == 255)
+            continue;
+        inner_lo = std::min(inner_lo, int(values[i]));
+        inner_hi = std::max(inner_hi, int(values[i]));
+    }
+    if (inner_lo > inner_hi)
+        return;
+
+    uint8_t tmp[8];
+    if (encodeAlpha(values, inner_lo, inner_hi, tmp) < err)
+        memcpy(out, tmp, sizeof tmp);
+}
+
+void
+decodeColorBlock(const uint8_t in[8], Texels &texels)
+{
+    int pal[4][4];
+    colorPalette(le16(in), le16(in + 2), pal);
+    const uint32_t indices = le16(in + 4) | (uint32_t(le16(in + 6)) << 16);
+    for (uint32_t i = 0; i < 16; ++i)
+        for (int k = 0; k < 4; ++k)
+            texels[i][k] = uint8_t(pal[(indices >> (2 * i)) & 3][k]);
+}
+
+void
+decodeAlphaBlock(const uint8_t in[8], Texels &texels, int channel)
+{
+    int pal[8];
+    alphaPalette(in[0], in[1], pal);
+    uint64_t indices = 0;
+    for (int k = 0; k < 6; ++k)
+        indices |= uint64_t(in[2 + k]) << (8 * k);
+    for (uint32_t i = 0; i < 16; ++i)
+        texels[i][channel] = uint8_t(pal[(indices >> (3 * i)) & 7]);
+}
+
+} // namespace
+
+size_t
+blockSize(BlockFormat format)
+{
+    switch (format.value) {
+    case BlockFormat::BC1:
+    case BlockFormat::BC4:
+        return 8;
+    case BlockFormat::BC3:
+    case BlockFormat::BC5:
+        return 16;
+    }
+    UNREACHABLE;
+}
+
+size_t
+compressedSize(BlockFormat format, uint32_t width, uint32_t height)
+{
+    return ((width + 3) / 4) * size_t((height + 3) / 4) * blockSize(format);
+}
+
+void
+compressImage(const Image &img,
+              BlockFormat format,
+              BlockQuality quality,
+              CompressedImage &out,
+              unsigned threads)
+{
+    out.format = format;
+    out.width = img.width;
+    out.height = img.height;
+    out.blocks.assign(compressedSize(format, img.width, img.height), 0);
+    if (img.pixels.empty())
+        return;
+
+    const size_t bw = out.blocksWide();
+    const size_t bsize = blockSize(format);
+    parallelFor(out.blocksHigh(), threads, [&](size_t by) {
+        Texels texels;
+        uint8_t channel[16];
+        auto extract = [&](int k) {
+            for (int i = 0; i < 16; ++i)
+                channel[i] = texels[i][k];
+            return channel;
+        };
+
+        for (size_t bx = 0; bx < bw; ++bx) {
+            auto *dst = out.blocks.data() + (by * bw + bx) * bsize;
+            fetchBlock(img, bx, by, texels);
+            switch (format.value) {
+            case BlockFormat::BC1:
+                encodeColorBlock(texels, quality, dst);
+                break;
+            case BlockFormat::BC3:
+                encodeAlphaBlock(extract(3), quality, dst);
+                encodeColorBlock(texels, quality, dst + 8);
+                break;
+            case BlockFormat::BC4:
+                encodeAlphaBlock(extract(0), quality, dst);
+                break;
+            case BlockFormat::BC5:
+                encodeAlphaBlock(extract(0), quality, dst);
+                encodeAlphaBlock(extract(1), quality, dst + 8);
+                break;
+            }
+        }
+    });
+}
+
+void
+decompressImage(const CompressedImage &img, Image &out)
+{
+    uint32_t channels = 4;
+    if (img.format == BlockFormat::BC4)
+        channels = 1;
+    else if (img.format == BlockFormat::BC5)
+        channels = 3;
+    out.resize(img.width, img.height, channels);
+
+    const size_t bsize = blockSize(img.format);
+    for (size_t by = 0; by < img.blocksHigh(); ++by) {
+        for (size_t bx = 0; bx < img.blocksWide(); ++bx) {
+            const auto *src =
+              img.blocks.data() + (by * img.blocksWide() + bx) * bsize;
+            Texels texels{};
+            switch (img.format.value) {
+            case BlockFormat::BC1:
+                decodeColorBlock(src, texels);
+                break;
+            case BlockFormat::BC3:
+                decodeColorBlock(src + 8, texels);
+                decodeAlphaBlock(src, texels, 3);
+                break;
+            case BlockFormat::BC4:
+                decodeAlphaBlock(src, texels, 0);
+                break;
+            case BlockFormat::BC5:
+                decodeAlphaBlock(src, texels, 0);
+                decodeAlphaBlock(src + 8, texels, 1);
+                break;
+            }
+
+            for (size_t y = 0; y < 4 && by * 4 + y < img.height; ++y) {
+                auto *row = out.pixels.data() + (by * 4 + y) * out.rowSize();
+                for (size_t x = 0; x < 4 && bx * 4 + x < img.width; ++x)
+                    memcpy(row + (bx * 4 + x) * channels,
+                           texels[y * 4 + x],
+                           channels);
+            }
+        }
+    }
+}
+
+} // namespace glt
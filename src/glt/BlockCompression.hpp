@@ -0,0 +1,75 @@
+#ifndef GLT_BLOCK_COMPRESSION_HPP
+#define GLT_BLOCK_COMPRESSION_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/Image.hpp"
+#include "pp/enum.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace glt {
+
+// BC1: RGB, 8 bytes per 4x4 block. BC3: RGBA, BC1 color and BC4 alpha, 16
+// bytes. BC4: one channel, 8 bytes. BC5: two channels, 16 bytes.
+#define GLT_BLOCK_FORMAT_ENUM_DEF(T, V0, V)                                    \
+    T(BlockFormat, uint8_t, V0(BC1) V(BC3) V(BC4) V(BC5))
+
+PP_DEF_ENUM_WITH_API(GLT_API, GLT_BLOCK_FORMAT_ENUM_DEF);
+
+// Fast: bounding box endpoints. High: endpoints along the principal axis
+// of the block colors, refined by least squares.
+#define GLT_BLOCK_QUALITY_ENUM_DEF(T, V0, V)                                   \
+    T(BlockQuality, uint8_t, V0(Fast) V(High))
+
+PP_DEF_ENUM_WITH_API(GLT_API, GLT_BLOCK_QUALITY_ENUM_DEF);
+
+GLT_API size_t
+blockSize(BlockFormat format);
+
+GLT_API size_t
+compressedSize(BlockFormat format, uint32_t width, uint32_t height);
+
+// 4x4 blocks in rows, the first block row covers the first 4 rows of the
+// source image, partial blocks at the edges repeat the last row or column
+struct CompressedImage
+{
+    BlockFormat format = BlockFormat::BC1;
+    uint32_t width{};
+    uint32_t height{};
+    std::vector<uint8_t> blocks;
+
+    size_t blocksWide() const { return (width + 3) / 4; }
+
+    size_t blocksHigh() const { return (height + 3) / 4; }
+
+    size_t rowSize() const { return blocksWide() * blockSize(format); }
+};
+
+// a compressed mipmap chain, base level first
+struct CompressedTexture
+{
+    BlockFormat format = BlockFormat::BC1;
+    bool srgb = false;
+    std::vector<CompressedImage> levels;
+};
+
+// BC1 and BC3 use the first three channels as color, a single channel is
+// replicated, missing alpha is opaque. BC4 encodes the first channel, BC5
+// the first two. threads 0: one per hardware thread.
+GLT_API void
+compressImage(const Image &img,
+              BlockFormat format,
+              BlockQuality quality,
+              CompressedImage &out,
+              unsigned threads = 0);
+
+// BC1 and BC3 decode to RGBA, BC4 to one channel and BC5 to RGB with blue
+// set to zero
+GLT_API void
+decompressImage(const CompressedImage &img, Image &out);
+
+} // namespace glt
+
+#endif
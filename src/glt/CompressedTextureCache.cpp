@@ -0,0 +1,258 @@
+#include "glt/CompressedTextureCache.hpp"
+
+#include "err/err.hpp"
+#include "glt/TextureLoader.hpp"
+#include "sys/fs.hpp"
+#include "sys/io.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace glt {
+
+namespace {
+
+inline constexpr char TEXTURE_FILE_MAGIC[8] = "GLTBCN";
+inline constexpr uint32_t TEXTURE_FILE_VERSION = 1;
+
+struct TextureFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t format; // BlockFormat
+    uint32_t srgb;
+    uint32_t levels;
+    uint32_t width;
+    uint32_t height;
+    uint64_t length; // of all levels
+    Hash128 key;
+    Hash128 checksum; // of all levels
+};
+
+// workers may store concurrently, each writes its own temporary
+std::atomic<uint64_t> temp_counter{ 0 };
+
+bool
+writeFileAtomic(const std::string &path,
+                std::span<const std::span<const char>> parts)
+{
+    auto tmp_path =
+      path + "." + std::to_string(temp_counter.fetch_add(1)) + ".tmp";
+    {
+        auto res = sys::io::HandleStream::open(tmp_path, sys::io::HM_WRITE);
+        if (!res)
+            return false;
+        auto out = std::move(res).value();
+        bool ok = true;
+        for (auto part : parts) {
+            auto [n, ret] = out.write(part);
+            ok = ok && ret == sys::io::StreamResult::OK && n == part.size();
+        }
+        ok = ok && out.flush() == sys::io::StreamResult::OK;
+        out.close();
+        if (!ok) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+uint32_t
+levelSize(uint32_t base, size_t level)
+{
+    return std::max(base >> level, 1u);
+}
+
+} // namespace
+
+struct CompressedTextureCache::Data
+{
+    std::string dir;
+    mutable std::mutex mutex; // guards stats
+    CompressedTextureCacheStats stats;
+
+    std::string path(const Hash128 &key) const
+    {
+        auto file = key.hex() + ".btc";
+        return sys::fs::join(dir, file.c_str());
+    }
+
+    void count(size_t CompressedTextureCacheStats::*field)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++(stats.*field);
+    }
+};
+
+DECLARE_PIMPL_DEL(CompressedTextureCache)
+
+CompressedTextureCache::CompressedTextureCache() : self(new Data) {}
+
+CompressedTextureCache::~CompressedTextureCache() = default;
+
+bool
+CompressedTextureCache::open(const std::string &dir)
+{
+    close();
+    if (!sys::fs::directoryExists(dir))
+        return false;
+    self->dir = dir;
+    return true;
+}
+
+void
+CompressedTextureCache::close()
+{
+    self->dir.clear();
+}
+
+bool
+CompressedTextureCache::enabled() const
+{
+    return !self->dir.empty();
+}
+
+const std::string &
+CompressedTextureCache::directory() const
+{
+    return self->dir;
+}
+
+Hash128
+CompressedTextureCache::key(std::span<const char> source,
+                            const TextureLoadOptions &opts)
+{
+    Hasher128 h;
+    h.value(TEXTURE_FILE_VERSION);
+    h.value(uint32_t(opts.format.value));
+    h.value(uint32_t(opts.quality.value));
+    h.value(uint32_t(opts.srgb));
+    h.value(uint32_t(opts.mipmaps));
+    h.value(uint32_t(opts.filter.value));
+    h.update(source.data(), source.size());
+    return h.finish();
+}
+
+bool
+CompressedTextureCache::load(const Hash128 &key, CompressedTexture &tex)
+{
+    if (!enabled())
+        return false;
+
+    auto file_path = self->path(key);
+    if (!sys::fs::fileExists(file_path)) {
+        self->count(&CompressedTextureCacheStats::misses);
+        return false;
+    }
+
+    auto res = sys::io::mapFile(file_path);
+    if (!res || res->data().size() < sizeof(TextureFileHeader)) {
+        self->count(&CompressedTextureCacheStats::misses);
+        return false;
+    }
+
+    auto data = res->data();
+    TextureFileHeader hdr;
+    memcpy(&hdr, data.data(), sizeof hdr);
+    auto blocks = data.subspan(sizeof hdr);
+
+    size_t expected = 0;
+    const bool valid_format = hdr.format < BlockFormat::count;
+    if (valid_format)
+        for (size_t i = 0; i < hdr.levels; ++i)
+            expected += compressedSize(BlockFormat(uint8_t(hdr.format)),
+                                       levelSize(hdr.width, i),
+                                       levelSize(hdr.height, i));
+
+    if (memcmp(hdr.magic, TEXTURE_FILE_MAGIC, sizeof hdr.magic) != 0 ||
+        hdr.version != TEXTURE_FILE_VERSION || hdr.key != key ||
+        !valid_format || hdr.levels == 0 || hdr.levels > 32 ||
+        hdr.length != blocks.size() || expected != blocks.size() ||
+        Hasher128().update(blocks.data(), blocks.size()).finish() !=
+          hdr.checksum) {
+        WARN("corrupt compressed texture: " + file_path);
+        std::remove(file_path.c_str());
+        self->count(&CompressedTextureCacheStats::misses);
+        return false;
+    }
+
+    tex.format = BlockFormat(uint8_t(hdr.format));
+    tex.srgb = hdr.srgb != 0;
+    tex.levels.resize(hdr.levels);
+    size_t offset = 0;
+    for (size_t i = 0; i < hdr.levels; ++i) {
+        auto &level = tex.levels[i];
+        level.format = tex.format;
+        level.width = levelSize(hdr.width, i);
+        level.height = levelSize(hdr.height, i);
+        const auto size = compressedSize(tex.format, level.width, level.height);
+        const auto *p = reinterpret_cast<const uint8_t *>(blocks.data());
+        level.blocks.assign(p + offset, p + offset + size);
+        offset += size;
+    }
+
+    self->count(&CompressedTextureCacheStats::hits);
+    return true;
+}
+
+bool
+CompressedTextureCache::store(const Hash128 &key, const CompressedTexture &tex)
+{
+    if (!enabled() || tex.levels.empty())
+        return false;
+
+    TextureFileHeader hdr{};
+    memcpy(hdr.magic, TEXTURE_FILE_MAGIC, sizeof hdr.magic);
+    hdr.version = TEXTURE_FILE_VERSION;
+    hdr.format = tex.format.value;
+    hdr.srgb = tex.srgb;
+    hdr.levels = uint32_t(tex.levels.size());
+    hdr.width = tex.levels[0].width;
+    hdr.height = tex.levels[0].height;
+    hdr.key = key;
+
+    std::vector<std::span<const char>> parts;
+    parts.push_back({ reinterpret_cast<const char *>(&hdr), sizeof hdr });
+    Hasher128 checksum;
+    for (const auto &level : tex.levels) {
+        const auto *p = reinterpret_cast<const char *>(level.blocks.data());
+        parts.push_back({ p, level.blocks.size() });
+        checksum.update(p, level.blocks.size());
+        hdr.length += level.blocks.size();
+    }
+    hdr.checksum = checksum.finish();
+
+    if (!writeFileAtomic(self->path(key), parts)) {
+        WARN("couldnt write compressed texture: " + self->path(key));
+        return false;
+    }
+    self->count(&CompressedTextureCacheStats::stores);
+    return true;
+}
+
+CompressedTextureCacheStats
+CompressedTextureCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(self->mutex);
+    return self->stats;
+}
+
+void
+CompressedTextureCache::printStats(sys::io::OutStream &out) const
+{
+    const auto s = stats();
+    out << "compressed texture cache: " << s.hits << "/" << (s.hits + s.misses)
+        << " hits, " << s.stores << " stored\n";
+}
+
+} // namespace glt
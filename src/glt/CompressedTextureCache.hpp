@@ -0,0 +1,61 @@
+#ifndef GLT_COMPRESSED_TEXTURE_CACHE_HPP
+#define GLT_COMPRESSED_TEXTURE_CACHE_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/BlockCompression.hpp"
+#include "pp/pimpl.hpp"
+#include "sys/io/Stream.hpp"
+#include "util/Hash128.hpp"
+
+#include <memory>
+#include <span>
+#include <string>
+
+namespace glt {
+
+struct TextureLoadOptions;
+
+struct CompressedTextureCacheStats
+{
+    size_t hits{};
+    size_t misses{};
+    size_t stores{};
+};
+
+// Compressed mipmap chains stored on disk, keyed by a hash of the source
+// file and the settings they were built with, see key(). Loading and
+// storing is thread safe, so workers can use the cache while encoding.
+struct GLT_API CompressedTextureCache
+{
+    CompressedTextureCache();
+    ~CompressedTextureCache();
+
+    // enables the cache, dir has to exist
+    bool open(const std::string &dir);
+
+    void close();
+
+    bool enabled() const;
+
+    const std::string &directory() const;
+
+    static Hash128 key(std::span<const char> source,
+                       const TextureLoadOptions &opts);
+
+    // false on a miss or if the cache is not enabled
+    bool load(const Hash128 &key, CompressedTexture &tex);
+
+    bool store(const Hash128 &key, const CompressedTexture &tex);
+
+    CompressedTextureCacheStats stats() const;
+
+    void printStats(sys::io::OutStream &out) const;
+
+private:
+    DECLARE_PIMPL(GLT_API, self);
+};
+
+} // namespace glt
+
+#endif
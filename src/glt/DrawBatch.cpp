@@ -0,0 +1,365 @@
+#include "glt/DrawBatch.hpp"
+
+#include "err/err.hpp"
+#include "glt/GLObject.hpp"
+#include "glt/GLStateCache.hpp"
+#include "glt/Mesh.hpp"
+#include "glt/StreamBuffer.hpp"
+#include "glt/utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace glt {
+
+namespace {
+
+bool
+multiDrawSupported()
+{
+    return GLAD_GL_ARB_multi_draw_indirect || GLVersion.major > 4 ||
+           (GLVersion.major == 4 && GLVersion.minor >= 3);
+}
+
+// grows the storage geometrically, uploads only what was not sent before
+void
+uploadBuffer(const GLBufferObject &buffer,
+             std::span<const char> data,
+             size_t &sent,
+             size_t &capacity)
+{
+    if (data.size() > capacity) {
+        capacity = std::max(data.size(), 2 * capacity);
+        GL_CALL(glNamedBufferDataEXT,
+                *buffer,
+                GLsizeiptr(capacity),
+                nullptr,
+                GL_STATIC_DRAW);
+        sent = 0;
+    }
+
+    if (data.size() > sent)
+        GL_CALL(glNamedBufferSubDataEXT,
+                *buffer,
+                GLintptr(sent),
+                GLsizeiptr(data.size() - sent),
+                data.data() + sent);
+    sent = data.size();
+}
+
+} // namespace
+
+struct DrawBatch::Data
+{
+    struct Record
+    {
+        uint32_t group;
+        DrawElementsIndirectCommand command;
+    };
+
+    struct Group
+    {
+        uint32_t first; // index of the first command
+        uint32_t count;
+    };
+
+    const StructInfo &vertex_type;
+    const GLenum prim_type;
+    const bool multi_draw;
+    const bool base_instance;
+
+    // host copies of all meshes, kept to refill grown buffers
+    std::vector<char> vertices;
+    std::vector<uint32_t> elements;
+    uint32_t vertex_count{};
+
+    GLVertexArrayObject vertex_array;
+    GLBufferObject vertex_buffer;
+    GLBufferObject element_buffer;
+    size_t vertices_sent{};
+    size_t vertices_capacity{};
+    size_t elements_sent{};
+    size_t elements_capacity{};
+
+    std::vector<Record> records;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<uint32_t> group_ids;
+    std::vector<Group> groups;
+
+    StreamBuffer command_stream;
+    bool stream_in_frame{};
+    GLintptr commands_offset{};
+
+    DrawBatchStatistics stats;
+
+    Data(const StructInfo &type, GLenum prim)
+      : vertex_type(type)
+      , prim_type(prim)
+      , multi_draw(multiDrawSupported())
+      , base_instance(baseInstanceSupported())
+    {}
+
+    void initVertexArray();
+    void uploadCommands();
+};
+
+DECLARE_PIMPL_DEL(DrawBatch)
+
+void
+DrawBatch::Data::initVertexArray()
+{
+    vertex_array.ensure();
+    for (size_t i = 0; i < vertex_type.fields.size(); ++i) {
+        const auto &a = vertex_type.fields[i];
+        GL_CALL(glVertexArrayVertexAttribOffsetEXT,
+                *vertex_array,
+                *vertex_buffer,
+                GLuint(i),
+                GLint(a.type_info.arity),
+                toGLScalarType(a.type_info.scalar_type),
+                gl_bool(a.type_info.normalized),
+                GLsizei(vertex_type.size),
+                GLintptr(a.offset));
+        GL_CALL(glEnableVertexArrayAttribEXT, *vertex_array, GLuint(i));
+    }
+
+    stateCache().bindVertexArray(*vertex_array);
+    stateCache().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, *element_buffer);
+    stateCache().bindVertexArray(0);
+}
+
+void
+DrawBatch::Data::uploadCommands()
+{
+    // fences the commands of the previous frame, its draws are submitted
+    if (stream_in_frame) {
+        command_stream.endFrame();
+        stream_in_frame = false;
+    }
+
+    const auto bytes = commands.size() * sizeof commands[0];
+    if (!multi_draw || bytes == 0)
+        return;
+
+    command_stream.reserve(bytes);
+    command_stream.beginFrame();
+    stream_in_frame = true;
+    auto range = command_stream.allocate(bytes);
+    ASSERT(range, "reserved too little");
+    memcpy(range.data.data(), commands.data(), bytes);
+    command_stream.flush();
+    commands_offset = range.offset;
+}
+
+DrawBatch::DrawBatch(const StructInfo &vertex_type, GLenum prim_type)
+  : self(new Data(vertex_type, prim_type))
+{}
+
+DrawBatch::~DrawBatch() = default;
+
+const StructInfo &
+DrawBatch::vertexType() const
+{
+    return self->vertex_type;
+}
+
+GLenum
+DrawBatch::primType() const
+{
+    return self->prim_type;
+}
+
+DrawBatchMesh
+DrawBatch::add(std::span<const char> vertices,
+               std::span<const uint32_t> elements)
+{
+    ASSERT(vertices.size() % self->vertex_type.size == 0);
+    DrawBatchMesh mesh;
+    mesh.base_vertex = self->vertex_count;
+    mesh.first_index = uint32_t(self->elements.size());
+    mesh.index_count = uint32_t(elements.size());
+
+    self->vertices.insert(
+      self->vertices.end(), vertices.begin(), vertices.end());
+    self->elements.insert(
+      self->elements.end(), elements.begin(), elements.end());
+    self->vertex_count += uint32_t(vertices.size() / self->vertex_type.size);
+    return mesh;
+}
+
+DrawBatchMesh
+DrawBatch::add(const MeshBase &mesh)
+{
+    ASSERT(&mesh.structInfo() == &self->vertex_type,
+           "mesh has a different vertex type");
+    ASSERT(mesh.primType() == self->prim_type,
+           "mesh has a different primitive type");
+
+    if (!mesh.elementData().empty())
+        return add(mesh.vertexData(), mesh.elementData());
+
+    std::vector<uint32_t> elements(mesh.verticesSize());
+    for (size_t i = 0; i < elements.size(); ++i)
+        elements[i] = uint32_t(i);
+    return add(mesh.vertexData(), elements);
+}
+
+void
+DrawBatch::clearMeshes()
+{
+    self->vertices.clear();
+    self->elements.clear();
+    self->vertex_count = 0;
+    self->vertices_sent = 0;
+    self->elements_sent = 0;
+    self->records.clear();
+    self->commands.clear();
+    self->group_ids.clear();
+    self->groups.clear();
+}
+
+void
+DrawBatch::send()
+{
+    self->vertex_buffer.ensure();
+    self->element_buffer.ensure();
+
+    uploadBuffer(self->vertex_buffer,
+                 self->vertices,
+                 self->vertices_sent,
+                 self->vertices_capacity);
+    uploadBuffer(self->element_buffer,
+                 // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+                 { reinterpret_cast<const char *>(self->elements.data()),
+                   self->elements.size() * sizeof(uint32_t) },
+                 self->elements_sent,
+                 self->elements_capacity);
+
+    if (!self->vertex_array.valid())
+        self->initVertexArray();
+}
+
+void
+DrawBatch::begin()
+{
+    self->records.clear();
+}
+
+void
+DrawBatch::record(uint32_t group,
+                  const DrawBatchMesh &mesh,
+                  uint32_t instance_count,
+                  uint32_t base_instance)
+{
+    if (mesh.index_count == 0 || instance_count == 0)
+        return;
+    if (base_instance != 0 && !self->base_instance) {
+        ERR("base instances need GL 4.2 or ARB_base_instance");
+        return;
+    }
+    self->records.push_back({ group,
+                              { mesh.index_count,
+                                instance_count,
+                                mesh.first_index,
+                                GLint(mesh.base_vertex),
+                                base_instance } });
+}
+
+void
+DrawBatch::end()
+{
+    auto &records = self->records;
+    std::stable_sort(
+      records.begin(), records.end(), [](const auto &a, const auto &b) {
+          return a.group < b.group;
+      });
+
+    self->commands.clear();
+    self->group_ids.clear();
+    self->groups.clear();
+    for (const auto &r : records) {
+        if (self->group_ids.empty() || self->group_ids.back() != r.group) {
+            self->group_ids.push_back(r.group);
+            self->groups.push_back({ uint32_t(self->commands.size()), 0 });
+        }
+        ++self->groups.back().count;
+        self->commands.push_back(r.command);
+    }
+
+    self->uploadCommands();
+    self->stats = { records.size(), self->groups.size(), 0 };
+}
+
+std::span<const uint32_t>
+DrawBatch::groups() const
+{
+    return self->group_ids;
+}
+
+void
+DrawBatch::draw(uint32_t group)
+{
+    const auto &ids = self->group_ids;
+    const auto it = std::lower_bound(ids.begin(), ids.end(), group);
+    if (it == ids.end() || *it != group || !self->vertex_array.valid())
+        return;
+    const auto &g = self->groups[size_t(it - ids.begin())];
+
+    stateCache().bindVertexArray(*self->vertex_array);
+    if (self->multi_draw) {
+        // GL_DRAW_INDIRECT_BUFFER is not tracked by the state cache
+        stateCache().bindBuffer(GL_DRAW_INDIRECT_BUFFER,
+                                self->command_stream.buffer());
+        const auto offset = size_t(self->commands_offset) +
+                            g.first * sizeof(DrawElementsIndirectCommand);
+        GL_CALL(glMultiDrawElementsIndirect,
+                self->prim_type,
+                GL_UNSIGNED_INT,
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+                reinterpret_cast<const void *>(offset),
+                GLsizei(g.count),
+                0);
+        ++self->stats.calls;
+    } else {
+        for (uint32_t i = g.first; i < g.first + g.count; ++i) {
+            const auto &c = self->commands[i];
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            const auto *indices =
+              reinterpret_cast<const void *>(c.first_index * sizeof(GLuint));
+            if (c.base_instance == 0)
+                GL_CALL(glDrawElementsInstancedBaseVertex,
+                        self->prim_type,
+                        GLsizei(c.count),
+                        GL_UNSIGNED_INT,
+                        indices,
+                        GLsizei(c.instance_count),
+                        c.base_vertex);
+            else
+                GL_CALL(glDrawElementsInstancedBaseVertexBaseInstance,
+                        self->prim_type,
+                        GLsizei(c.count),
+                        GL_UNSIGNED_INT,
+                        indices,
+                        GLsizei(c.instance_count),
+                        c.base_vertex,
+                        c.base_instance);
+        }
+        self->stats.calls += g.count;
+    }
+    stateCache().bindVertexArray(0);
+}
+
+bool
+DrawBatch::multiDraw() const
+{
+    return self->multi_draw;
+}
+
+DrawBatchStatistics
+DrawBatch::statistics() const
+{
+    return self->stats;
+}
+
+} // namespace glt
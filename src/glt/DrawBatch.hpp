@@ -0,0 +1,109 @@
+#ifndef GLT_DRAW_BATCH_HPP
+#define GLT_DRAW_BATCH_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/type_info.hpp"
+#include "opengl.hpp"
+#include "pp/pimpl.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace glt {
+
+struct MeshBase;
+
+// an entry of GL_DRAW_INDIRECT_BUFFER as read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+// where a mesh lives in the shared buffers of a DrawBatch
+struct DrawBatchMesh
+{
+    uint32_t base_vertex{};
+    uint32_t first_index{};
+    uint32_t index_count{};
+};
+
+struct DrawBatchStatistics
+{
+    size_t draws{};  // recorded draws
+    size_t groups{}; // state groups
+    size_t calls{};  // GL draw calls issued
+};
+
+// Draws many small meshes of one vertex type with a few GL calls. The meshes
+// are suballocated from one vertex and one element buffer behind a single
+// vertex array. Every frame the draws are recorded together with a caller
+// defined state group, end() writes them as DrawElementsIndirectCommand
+// arrays into a StreamBuffer and draw() submits all draws of a group with one
+// glMultiDrawElementsIndirect. Without GL 4.3 or ARB_multi_draw_indirect
+// draw() loops over the commands instead. Setting the state of a group
+// (program, textures, uniforms) is up to the caller, per draw data can be
+// looked up in the shader through the base instance.
+struct GLT_API DrawBatch
+{
+    explicit DrawBatch(const StructInfo &vertex_type,
+                       GLenum prim_type = GL_TRIANGLES);
+    ~DrawBatch();
+
+    const StructInfo &vertexType() const;
+
+    GLenum primType() const;
+
+    // copies the vertices and elements, elements index the given vertices.
+    // The vertices have to be of the vertex type of the batch.
+    DrawBatchMesh add(std::span<const char> vertices,
+                      std::span<const uint32_t> elements);
+
+    // copies the host data of mesh, meshes without elements get one element
+    // per vertex
+    DrawBatchMesh add(const MeshBase &mesh);
+
+    // drops all meshes and recorded draws
+    void clearMeshes();
+
+    // uploads the meshes added since the last send(), a mesh has to be sent
+    // before it is drawn
+    void send();
+
+    // drops the draws of the last frame
+    void begin();
+
+    // a nonzero base_instance needs GL 4.2 or ARB_base_instance, without
+    // them such draws are dropped
+    void record(uint32_t group,
+                const DrawBatchMesh &mesh,
+                uint32_t instance_count = 1,
+                uint32_t base_instance = 0);
+
+    // orders the draws by group and uploads the commands
+    void end();
+
+    // the recorded groups in ascending order, valid after end()
+    std::span<const uint32_t> groups() const;
+
+    // draws the commands of group with the current state
+    void draw(uint32_t group);
+
+    // true if draw() uses glMultiDrawElementsIndirect
+    bool multiDraw() const;
+
+    // of the last frame
+    DrawBatchStatistics statistics() const;
+
+private:
+    DECLARE_PIMPL(GLT_API, self);
+};
+
+} // namespace glt
+
+#endif
@@ -0,0 +1,306 @@
+#include "glt/FrameCapture.hpp"
+
+#include "err/err.hpp"
+#include "glt/GLObject.hpp"
+#include "glt/GLStateCache.hpp"
+#include "glt/utils.hpp"
+#include "sys/io.hpp"
+#include "util/string.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace glt {
+
+PP_DEF_ENUM_IMPL(GLT_CAPTURE_FORMAT_ENUM_DEF);
+
+namespace {
+
+inline constexpr GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+
+bool
+writeFile(const std::string &path, std::span<const char> data)
+{
+    auto res = sys::io::HandleStream::open(path, sys::io::HM_WRITE);
+    if (!res)
+        return false;
+    auto out = std::move(res).value();
+    auto [n, ret] = out.write(data);
+    const bool ok = ret == sys::io::StreamResult::OK && n == data.size() &&
+                    out.flush() == sys::io::StreamResult::OK;
+    out.close();
+    return ok;
+}
+
+} // namespace
+
+FrameSink::~FrameSink() = default;
+
+CaptureFileWriter::CaptureFileWriter(std::string prefix, CaptureFormat format)
+  : _prefix(std::move(prefix)), _format(format)
+{}
+
+void
+CaptureFileWriter::consume(const CapturedFrame &frame)
+{
+    char index[24];
+    snprintf(index, sizeof index, "%06llu", (unsigned long long) frame.index);
+
+    bool ok = false;
+    std::string path;
+    switch (_format.value) {
+    case CaptureFormat::BMP: {
+        path = string_concat(_prefix, index, ".bmp");
+        std::vector<char> bmp;
+        encodeBMP(frame.image, bmp);
+        ok = writeFile(path, bmp);
+        break;
+    }
+    case CaptureFormat::Raw: {
+        path = string_concat(_prefix, index, ".raw");
+        const auto *px =
+          reinterpret_cast<const char *>(frame.image.pixels.data());
+        ok = writeFile(path, { px, frame.image.pixels.size() });
+        break;
+    }
+    }
+
+    if (ok)
+        ++_written;
+    else
+        ERR("couldnt write captured frame: " + path);
+}
+
+struct FrameCapture::Data
+{
+    struct Slot
+    {
+        GLBufferObject buffer;
+        size_t capacity{};
+        GLsync fence{};
+        uint64_t index{};
+        uint32_t width{};
+        uint32_t height{};
+        std::shared_ptr<FrameSink> sink;
+    };
+
+    struct Job
+    {
+        CapturedFrame frame;
+        std::shared_ptr<FrameSink> sink;
+    };
+
+    std::vector<Slot> ring;
+    size_t head{}; // next slot to read into
+    size_t tail{}; // oldest slot in flight
+    size_t in_flight{};
+    uint64_t next_index{};
+    uint64_t stalls{};
+
+    std::thread encoder;
+    std::mutex mutex;
+    std::condition_variable work_cond;
+    std::condition_variable idle_cond;
+    std::deque<Job> jobs; // guarded by mutex
+    bool busy{};          // guarded by mutex
+    bool stop{};          // guarded by mutex
+
+    ~Data() { shutdown(); }
+
+    void shutdown();
+    bool complete(bool wait);
+    void encodeLoop();
+};
+
+DECLARE_PIMPL_DEL(FrameCapture)
+
+void
+FrameCapture::Data::shutdown()
+{
+    if (!encoder.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    work_cond.notify_all();
+    encoder.join();
+}
+
+bool
+FrameCapture::Data::complete(bool wait)
+{
+    auto &slot = ring[tail];
+    for (;;) {
+        GLenum res;
+        GL_ASSIGN_CALL(res,
+                       glClientWaitSync,
+                       slot.fence,
+                       GL_SYNC_FLUSH_COMMANDS_BIT,
+                       wait ? FENCE_TIMEOUT_NS : 0);
+        if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED)
+            break;
+        if (res == GL_WAIT_FAILED) {
+            ERR("FrameCapture: glClientWaitSync failed");
+            break;
+        }
+        if (!wait)
+            return false;
+    }
+    GL_CALL(glDeleteSync, slot.fence);
+    slot.fence = nullptr;
+
+    Job job;
+    job.sink = std::move(slot.sink);
+    job.frame.index = slot.index;
+    job.frame.image.resize(slot.width, slot.height, 4);
+    const auto size = job.frame.image.size();
+    const void *ptr;
+    GL_ASSIGN_CALL(ptr,
+                   glMapNamedBufferRangeEXT,
+                   *slot.buffer,
+                   0,
+                   GLsizeiptr(size),
+                   GL_MAP_READ_BIT);
+    if (ptr != nullptr) {
+        memcpy(job.frame.image.pixels.data(), ptr, size);
+        GL_CALL(glUnmapNamedBufferEXT, *slot.buffer);
+    } else {
+        ERR("FrameCapture: couldnt map pixel buffer");
+    }
+
+    tail = (tail + 1) % ring.size();
+    --in_flight;
+
+    if (ptr != nullptr) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        work_cond.notify_one();
+    }
+    return true;
+}
+
+void
+FrameCapture::Data::encodeLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        work_cond.wait(lock, [this] { return stop || !jobs.empty(); });
+        if (jobs.empty())
+            return;
+        auto job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+        lock.unlock();
+        job.sink->consume(job.frame);
+        lock.lock();
+        busy = false;
+        if (jobs.empty())
+            idle_cond.notify_all();
+    }
+}
+
+FrameCapture::FrameCapture() : self(new Data) {}
+
+FrameCapture::~FrameCapture()
+{
+    finish();
+}
+
+void
+FrameCapture::init(size_t ring_size)
+{
+    finish();
+    self->ring = std::vector<Data::Slot>(std::max(ring_size, size_t(1)));
+    self->head = 0;
+    self->tail = 0;
+    if (!self->encoder.joinable())
+        self->encoder = std::thread([this]() { self->encodeLoop(); });
+}
+
+void
+FrameCapture::capture(int32_t x,
+                      int32_t y,
+                      uint32_t width,
+                      uint32_t height,
+                      std::shared_ptr<FrameSink> sink)
+{
+    if (self->ring.empty())
+        init();
+
+    if (self->in_flight == self->ring.size()) {
+        ++self->stalls;
+        self->complete(true);
+    }
+
+    auto &slot = self->ring[self->head];
+    const size_t size = size_t(width) * height * 4;
+    slot.buffer.ensure();
+    if (slot.capacity < size) {
+        GL_CALL(glNamedBufferDataEXT,
+                *slot.buffer,
+                GLsizeiptr(size),
+                nullptr,
+                GL_STREAM_READ);
+        slot.capacity = size;
+    }
+
+    stateCache().bindBuffer(GL_PIXEL_PACK_BUFFER, *slot.buffer);
+    GL_CALL(glPixelStorei, GL_PACK_ALIGNMENT, 1);
+    GL_CALL(glReadPixels,
+            x,
+            y,
+            GLsizei(width),
+            GLsizei(height),
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            nullptr);
+    GL_CALL(glPixelStorei, GL_PACK_ALIGNMENT, 4);
+    stateCache().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    GL_ASSIGN_CALL(slot.fence, glFenceSync, GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    slot.index = self->next_index++;
+    slot.width = width;
+    slot.height = height;
+    slot.sink = std::move(sink);
+    self->head = (self->head + 1) % self->ring.size();
+    ++self->in_flight;
+}
+
+void
+FrameCapture::poll()
+{
+    while (self->in_flight > 0 && self->complete(false))
+        ;
+}
+
+void
+FrameCapture::finish()
+{
+    while (self->in_flight > 0)
+        self->complete(true);
+    std::unique_lock<std::mutex> lock(self->mutex);
+    self->idle_cond.wait(lock,
+                         [this] { return self->jobs.empty() && !self->busy; });
+}
+
+size_t
+FrameCapture::inFlight() const
+{
+    return self->in_flight;
+}
+
+uint64_t
+FrameCapture::stalls() const
+{
+    return self->stalls;
+}
+
+} // namespace glt
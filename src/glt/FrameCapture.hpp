@@ -0,0 +1,94 @@
+#ifndef GLT_FRAME_CAPTURE_HPP
+#define GLT_FRAME_CAPTURE_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/Image.hpp"
+#include "pp/enum.hpp"
+#include "pp/pimpl.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace glt {
+
+#define GLT_CAPTURE_FORMAT_ENUM_DEF(T, V0, V)                                  \
+    T(CaptureFormat, uint8_t, V0(BMP) V(Raw))
+
+PP_DEF_ENUM_WITH_API(GLT_API, GLT_CAPTURE_FORMAT_ENUM_DEF);
+
+// pixel pack buffers a FrameCapture cycles through by default
+inline constexpr size_t CAPTURE_RING_SIZE = 3;
+
+// a frame read back by a FrameCapture: RGBA, rows bottom up
+struct CapturedFrame
+{
+    uint64_t index{}; // counts the captures of one FrameCapture
+    Image image;
+};
+
+// Receives captured frames on the encoder thread of a FrameCapture, in the
+// order they were captured.
+struct GLT_API FrameSink
+{
+    virtual ~FrameSink();
+    virtual void consume(const CapturedFrame &frame) = 0;
+};
+
+// Writes each frame to <prefix><index>.bmp, or .raw: the RGBA pixels without
+// a header.
+struct GLT_API CaptureFileWriter : FrameSink
+{
+    CaptureFileWriter(std::string prefix, CaptureFormat format);
+
+    void consume(const CapturedFrame &frame) final;
+
+    size_t written() const { return _written.load(); }
+
+private:
+    std::string _prefix;
+    CaptureFormat _format;
+    std::atomic<size_t> _written{ 0 };
+};
+
+// Reads framebuffers back without stalling the pipeline: glReadPixels goes
+// into the next buffer of a ring of pixel pack buffers and is fenced,
+// buffers are mapped once their fence signaled, usually one or two frames
+// later, and the pixels are handed to a FrameSink on an encoder thread.
+// Only when all buffers are still in flight a capture waits for the oldest.
+struct GLT_API FrameCapture
+{
+    FrameCapture();
+    ~FrameCapture();
+
+    // GL thread only, like all other members
+    void init(size_t ring_size = CAPTURE_RING_SIZE);
+
+    // reads the color buffer of the bound read framebuffer, which must not
+    // be multisampled
+    void capture(int32_t x,
+                 int32_t y,
+                 uint32_t width,
+                 uint32_t height,
+                 std::shared_ptr<FrameSink> sink);
+
+    // hands completed reads to the encoder, once per frame
+    void poll();
+
+    // waits for all reads and for the sinks to consume them
+    void finish();
+
+    // reads not yet handed to the encoder
+    size_t inFlight() const;
+
+    // frames that had to wait for the GPU because the ring was full
+    uint64_t stalls() const;
+
+private:
+    DECLARE_PIMPL(GLT_API, self);
+};
+
+} // namespace glt
+
+#endif
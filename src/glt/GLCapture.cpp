@@ -0,0 +1,627 @@
+#include "glt/GLCapture.hpp"
+
+#include "err/err.hpp"
+#include "glt/module.hpp"
+#include "sys/clock.hpp"
+#include "sys/io.hpp"
+#include "util/string.hpp"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <unordered_map>
+
+#define G (module->utils)
+
+namespace glt {
+
+namespace {
+
+// buffered bytes written out at once
+inline constexpr size_t CAPTURE_CHUNK_SIZE = 1024 * 1024;
+
+inline constexpr size_t MAX_CAPTURED_ARGS = 16;
+
+// what the pointer arguments of a function point to, -1: no such argument
+struct PayloadRule
+{
+    enum Kind : uint8_t
+    {
+        Bytes,       // size bytes
+        Compressed,  // size bytes, or an offset into the unpack buffer
+        Elements,    // count * elem_size bytes
+        ClearValue,  // 4 values, 1 for GL_DEPTH and GL_STENCIL
+        TexParams,   // 4 values for vector parameters, else 1
+        CString,     // NUL terminated
+        StringArray, // count strings, lengths at arg b if given
+        Pixels,      // width a, height b, depth c, format d, type e
+        GenNames     // count names written by the call
+    };
+
+    const char *name;
+    Kind kind;
+    int8_t ptr;
+    int8_t count; // size or count argument
+    uint32_t elem_size;
+    int8_t a = -1, b = -1, c = -1, d = -1, e = -1;
+};
+
+using R = PayloadRule;
+
+// clang-format off
+const PayloadRule PAYLOAD_RULES[] = {
+    { "glBufferData", R::Bytes, 2, 1, 0 },
+    { "glBufferSubData", R::Bytes, 3, 2, 0 },
+    { "glBufferStorage", R::Bytes, 2, 1, 0 },
+    { "glNamedBufferDataEXT", R::Bytes, 2, 1, 0 },
+    { "glNamedBufferSubDataEXT", R::Bytes, 3, 2, 0 },
+    { "glNamedBufferStorageEXT", R::Bytes, 2, 1, 0 },
+    { "glCompressedTexImage2D", R::Compressed, 7, 6, 0 },
+    { "glCompressedTextureImage2DEXT", R::Compressed, 8, 7, 0 },
+    { "glCompressedTextureSubImage2DEXT", R::Compressed, 9, 8, 0 },
+    { "glProgramBinary", R::Bytes, 2, 3, 0 },
+    { "glGetActiveUniformsiv", R::Elements, 2, 1, 4 },
+
+    { "glTexImage1D", R::Pixels, 7, -1, 0, 3, -1, -1, 5, 6 },
+    { "glTexImage2D", R::Pixels, 8, -1, 0, 3, 4, -1, 6, 7 },
+    { "glTexImage3D", R::Pixels, 9, -1, 0, 3, 4, 5, 7, 8 },
+    { "glTexSubImage2D", R::Pixels, 8, -1, 0, 4, 5, -1, 6, 7 },
+    { "glTextureImage2DEXT", R::Pixels, 9, -1, 0, 4, 5, -1, 7, 8 },
+    { "glTextureImage3DEXT", R::Pixels, 10, -1, 0, 4, 5, 6, 8, 9 },
+    { "glTextureSubImage2DEXT", R::Pixels, 9, -1, 0, 5, 6, -1, 7, 8 },
+    { "glTextureSubImage3DEXT", R::Pixels, 11, -1, 0, 6, 7, 8, 9, 10 },
+
+    { "glDeleteBuffers", R::Elements, 1, 0, 4 },
+    { "glDeleteFramebuffers", R::Elements, 1, 0, 4 },
+    { "glDeleteQueries", R::Elements, 1, 0, 4 },
+    { "glDeleteRenderbuffers", R::Elements, 1, 0, 4 },
+    { "glDeleteSamplers", R::Elements, 1, 0, 4 },
+    { "glDeleteTextures", R::Elements, 1, 0, 4 },
+    { "glDeleteTransformFeedbacks", R::Elements, 1, 0, 4 },
+    { "glDeleteVertexArrays", R::Elements, 1, 0, 4 },
+    { "del_programs", R::Elements, 1, 0, 4 },
+    { "del_shaders", R::Elements, 1, 0, 4 },
+
+    { "glGenBuffers", R::GenNames, 1, 0, 4 },
+    { "glGenFramebuffers", R::GenNames, 1, 0, 4 },
+    { "glGenQueries", R::GenNames, 1, 0, 4 },
+    { "glGenRenderbuffers", R::GenNames, 1, 0, 4 },
+    { "glGenSamplers", R::GenNames, 1, 0, 4 },
+    { "glGenTextures", R::GenNames, 1, 0, 4 },
+    { "glGenTransformFeedbacks", R::GenNames, 1, 0, 4 },
+    { "glGenVertexArrays", R::GenNames, 1, 0, 4 },
+    { "gen_programs", R::GenNames, 1, 0, 4 },
+
+    { "glProgramUniform1fv", R::Elements, 3, 2, 4 },
+    { "glProgramUniform2fv", R::Elements, 3, 2, 8 },
+    { "glProgramUniform3fv", R::Elements, 3, 2, 12 },
+    { "glProgramUniform4fv", R::Elements, 3, 2, 16 },
+    { "glProgramUniform1iv", R::Elements, 3, 2, 4 },
+    { "glProgramUniform2iv", R::Elements, 3, 2, 8 },
+    { "glProgramUniform3iv", R::Elements, 3, 2, 12 },
+    { "glProgramUniform4iv", R::Elements, 3, 2, 16 },
+    { "glProgramUniformMatrix2fv", R::Elements, 4, 2, 16 },
+    { "glProgramUniformMatrix3fv", R::Elements, 4, 2, 36 },
+    { "glProgramUniformMatrix4fv", R::Elements, 4, 2, 64 },
+    { "glUniform1fv", R::Elements, 2, 1, 4 },
+    { "glUniform2fv", R::Elements, 2, 1, 8 },
+    { "glUniform3fv", R::Elements, 2, 1, 12 },
+    { "glUniform4fv", R::Elements, 2, 1, 16 },
+    { "glUniformMatrix4fv", R::Elements, 3, 1, 64 },
+
+    { "glClearBufferfv", R::ClearValue, 2, -1, 4 },
+    { "glClearBufferiv", R::ClearValue, 2, -1, 4 },
+    { "glClearBufferuiv", R::ClearValue, 2, -1, 4 },
+    { "glTexParameteriv", R::TexParams, 2, -1, 4, 1 },
+    { "glTexParameterfv", R::TexParams, 2, -1, 4, 1 },
+    { "glTextureParameterivEXT", R::TexParams, 3, -1, 4, 2 },
+    { "glTextureParameterfvEXT", R::TexParams, 3, -1, 4, 2 },
+    { "glSamplerParameteriv", R::TexParams, 2, -1, 4, 1 },
+    { "glSamplerParameterfv", R::TexParams, 2, -1, 4, 1 },
+
+    { "glBindAttribLocation", R::CString, 2, -1, 0 },
+    { "glBindFragDataLocation", R::CString, 2, -1, 0 },
+    { "glGetAttribLocation", R::CString, 1, -1, 0 },
+    { "glGetUniformBlockIndex", R::CString, 1, -1, 0 },
+    { "glGetUniformLocation", R::CString, 1, -1, 0 },
+
+    { "glShaderSource", R::StringArray, 2, 1, 0, -1, 3 },
+    { "glTransformFeedbackVaryings", R::StringArray, 2, 1, 0 },
+};
+// clang-format on
+
+const PayloadRule *
+findRule(std::string_view name)
+{
+    for (const auto &rule : PAYLOAD_RULES)
+        if (name == rule.name)
+            return &rule;
+    return nullptr;
+}
+
+size_t
+formatComponents(GLenum format)
+{
+    switch (format) {
+    case GL_RED:
+    case GL_RED_INTEGER:
+    case GL_DEPTH_COMPONENT:
+    case GL_STENCIL_INDEX:
+        return 1;
+    case GL_RG:
+    case GL_RG_INTEGER:
+    case GL_DEPTH_STENCIL:
+        return 2;
+    case GL_RGB:
+    case GL_BGR:
+    case GL_RGB_INTEGER:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+// bytes per pixel, 0 for unknown types
+size_t
+pixelSize(GLenum format, GLenum type)
+{
+    switch (type) {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+        return formatComponents(format);
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_HALF_FLOAT:
+        return 2 * formatComponents(format);
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+    case GL_FLOAT:
+        return 4 * formatComponents(format);
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+        return 2;
+    case GL_UNSIGNED_INT_8_8_8_8:
+    case GL_UNSIGNED_INT_8_8_8_8_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+    case GL_UNSIGNED_INT_24_8:
+        return 4;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+// with a pixel unpack buffer bound texture data pointers are offsets
+bool
+unpackBufferBound()
+{
+    GLint buffer;
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &buffer);
+    return buffer != 0;
+}
+
+} // namespace
+
+struct GLCaptureWriter
+{
+    struct Function
+    {
+        uint32_t id;
+        const PayloadRule *rule;
+    };
+
+    sys::io::HandleStream out;
+    std::vector<char> buffer;
+    double start{};
+    uint64_t calls{};
+    bool failed{};
+
+    // by the address of the name, then by its contents
+    std::unordered_map<const char *, Function> sites;
+    std::map<std::string, Function, std::less<>> functions;
+
+    // the call begun last
+    Function function{};
+    double call_start{};
+    size_t argc{};
+    std::array<GLCallArg, MAX_CAPTURED_ARGS> args{};
+    std::vector<char> payloads;
+    uint8_t npayloads{};
+
+    explicit GLCaptureWriter(sys::io::HandleStream &&s) : out(std::move(s))
+    {}
+
+    template<typename T>
+    void put(std::vector<char> &dst, const T &x)
+    {
+        const auto *p = reinterpret_cast<const char *>(&x);
+        dst.insert(dst.end(), p, p + sizeof x);
+    }
+
+    void put(std::vector<char> &dst, std::string_view bytes)
+    {
+        dst.insert(dst.end(), bytes.begin(), bytes.end());
+    }
+
+    void flush();
+    Function intern(const char *name);
+    void payload(size_t arg, GLPayloadKind kind, const void *data, size_t n);
+    void inputs(const PayloadRule &rule);
+    void strings(const PayloadRule &rule);
+    uint64_t nanos(double t) const { return uint64_t((t - start) * 1e9); }
+    int64_t intArg(int8_t i) const { return int64_t(args[size_t(i)].bits); }
+    const void *ptrArg(int8_t i) const
+    {
+        return reinterpret_cast<const void *>(uintptr_t(args[size_t(i)].bits));
+    }
+};
+
+void
+GLCaptureWriter::flush()
+{
+    if (buffer.empty())
+        return;
+    auto [n, ret] = out.write(buffer);
+    if (!failed && (ret != sys::io::StreamResult::OK || n != buffer.size())) {
+        failed = true;
+        ERR("couldnt write GL capture");
+    }
+    buffer.clear();
+}
+
+GLCaptureWriter::Function
+GLCaptureWriter::intern(const char *name)
+{
+    auto site = sites.find(name);
+    if (site != sites.end())
+        return site->second;
+
+    auto it = functions.find(std::string_view(name));
+    if (it == functions.end()) {
+        const Function f{ uint32_t(functions.size()), findRule(name) };
+        it = functions.emplace(name, f).first;
+        const std::string_view str(name);
+        put(buffer, GLCaptureRecord::Function);
+        put(buffer, f.id);
+        put(buffer, uint16_t(str.size()));
+        put(buffer, str);
+    }
+    sites.emplace(name, it->second);
+    return it->second;
+}
+
+void
+GLCaptureWriter::payload(size_t arg,
+                         GLPayloadKind kind,
+                         const void *data,
+                         size_t n)
+{
+    put(payloads, uint8_t(arg));
+    put(payloads, kind);
+    put(payloads, uint32_t(n));
+    const auto *p = static_cast<const char *>(data);
+    payloads.insert(payloads.end(), p, p + n);
+    ++npayloads;
+}
+
+void
+GLCaptureWriter::strings(const PayloadRule &rule)
+{
+    const auto count = size_t(std::max(intArg(rule.count), int64_t(0)));
+    const auto *strs = static_cast<const char *const *>(ptrArg(rule.ptr));
+    const auto *lens =
+      rule.b >= 0 ? static_cast<const GLint *>(ptrArg(rule.b)) : nullptr;
+
+    std::vector<char> data;
+    put(data, uint32_t(count));
+    for (size_t i = 0; i < count; ++i) {
+        const size_t len = lens != nullptr && lens[i] >= 0 ? size_t(lens[i])
+                                                           : strlen(strs[i]);
+        put(data, uint32_t(len));
+        put(data, std::string_view(strs[i], len));
+        data.push_back('\0');
+    }
+    payload(size_t(rule.ptr),
+            GLPayloadKind::StringArray,
+            data.data(),
+            data.size());
+
+    // a replay passes the NUL terminated strings without lengths
+    if (lens != nullptr)
+        args[size_t(rule.b)].bits = 0;
+}
+
+void
+GLCaptureWriter::inputs(const PayloadRule &rule)
+{
+    if (size_t(rule.ptr) >= argc)
+        return;
+    const void *ptr = ptrArg(rule.ptr);
+    if (ptr == nullptr)
+        return;
+
+    size_t n = 0;
+    switch (rule.kind) {
+    case PayloadRule::Compressed:
+        if (unpackBufferBound())
+            return;
+        [[fallthrough]];
+    case PayloadRule::Bytes:
+        n = size_t(std::max(intArg(rule.count), int64_t(0)));
+        break;
+    case PayloadRule::Elements:
+        n = size_t(std::max(intArg(rule.count), int64_t(0))) * rule.elem_size;
+        break;
+    case PayloadRule::ClearValue: {
+        const auto buffer = GLenum(intArg(0));
+        n = rule.elem_size *
+            (buffer == GL_DEPTH || buffer == GL_STENCIL ? 1 : 4);
+        break;
+    }
+    case PayloadRule::TexParams: {
+        const auto pname = GLenum(intArg(rule.a));
+        n = rule.elem_size * (pname == GL_TEXTURE_BORDER_COLOR ||
+                                  pname == GL_TEXTURE_SWIZZLE_RGBA
+                                ? 4
+                                : 1);
+        break;
+    }
+    case PayloadRule::CString:
+        n = strlen(static_cast<const char *>(ptr)) + 1;
+        break;
+    case PayloadRule::StringArray:
+        strings(rule);
+        return;
+    case PayloadRule::Pixels: {
+        if (unpackBufferBound())
+            return;
+        GLint alignment, row_length;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glGetIntegerv(GL_UNPACK_ROW_LENGTH, &row_length);
+        const auto bpp =
+          pixelSize(GLenum(intArg(rule.d)), GLenum(intArg(rule.e)));
+        if (bpp == 0) {
+            WARN("GL capture: unknown pixel type, texture data not captured");
+            return;
+        }
+        const auto w = size_t(intArg(rule.a));
+        const auto h = rule.b >= 0 ? size_t(intArg(rule.b)) : 1;
+        const auto d = rule.c >= 0 ? size_t(intArg(rule.c)) : 1;
+        if (w == 0 || h == 0 || d == 0)
+            return;
+        const auto align = size_t(std::max(alignment, 1));
+        const auto row = (size_t(row_length > 0 ? row_length : GLint(w)) * bpp +
+                          align - 1) /
+                         align * align;
+        n = row * (h * d - 1) + w * bpp;
+        break;
+    }
+    case PayloadRule::GenNames:
+        return;
+    }
+
+    if (n > 0)
+        payload(size_t(rule.ptr), GLPayloadKind::Data, ptr, n);
+}
+
+bool
+glCaptureStart(std::string_view path)
+{
+    glCaptureStop();
+    auto res = sys::io::HandleStream::open(path, sys::io::HM_WRITE);
+    if (!res)
+        return false;
+
+    auto w = std::make_shared<GLCaptureWriter>(std::move(res).value());
+    w->start = sys::queryTimer();
+    w->put(w->buffer,
+           std::string_view(GL_CAPTURE_MAGIC, sizeof GL_CAPTURE_MAGIC));
+    w->put(w->buffer, GL_CAPTURE_VERSION);
+    w->put(w->buffer, uint32_t(0));
+    G.gl_capture = std::move(w);
+    return true;
+}
+
+void
+glCaptureStop()
+{
+    if (!G.gl_capture)
+        return;
+    auto &w = *G.gl_capture;
+    w.flush();
+    w.out.close();
+    G.gl_capture.reset();
+}
+
+bool
+glCapturing()
+{
+    return module && G.gl_capture;
+}
+
+void
+glCaptureFrame()
+{
+    if (!glCapturing())
+        return;
+    auto &w = *G.gl_capture;
+    w.put(w.buffer, GLCaptureRecord::Frame);
+    w.put(w.buffer, w.nanos(sys::queryTimer()));
+    w.flush();
+}
+
+uint64_t
+glCapturedCalls()
+{
+    return glCapturing() ? G.gl_capture->calls : 0;
+}
+
+void
+GLCallRecorder::beginCall(const char *name, const GLCallArg *args, size_t argc)
+{
+    auto &w = *G.gl_capture;
+    if (argc > MAX_CAPTURED_ARGS) {
+        WARN(string_concat("GL capture: too many arguments: ", name));
+        return;
+    }
+
+    _active = true;
+    w.function = w.intern(name);
+    w.argc = argc;
+    std::copy(args, args + argc, w.args.begin());
+    w.payloads.clear();
+    w.npayloads = 0;
+    if (w.function.rule != nullptr)
+        w.inputs(*w.function.rule);
+    w.call_start = sys::queryTimer();
+}
+
+void
+GLCallRecorder::endCall(const GLCallArg *result)
+{
+    _active = false;
+    if (!glCapturing())
+        return;
+    auto &w = *G.gl_capture;
+    const double now = sys::queryTimer();
+
+    const auto *rule = w.function.rule;
+    if (rule != nullptr && rule->kind == PayloadRule::GenNames &&
+        size_t(rule->ptr) < w.argc) {
+        const auto n = size_t(std::max(w.intArg(rule->count), int64_t(0)));
+        w.payload(size_t(rule->ptr),
+                  GLPayloadKind::Output,
+                  w.ptrArg(rule->ptr),
+                  n * rule->elem_size);
+    }
+
+    w.put(w.buffer, GLCaptureRecord::Call);
+    w.put(w.buffer, w.function.id);
+    w.put(w.buffer, w.nanos(w.call_start));
+    w.put(w.buffer, uint32_t(std::min((now - w.call_start) * 1e9, 4e9)));
+    w.put(w.buffer, uint8_t(w.argc));
+    for (size_t i = 0; i < w.argc; ++i) {
+        w.put(w.buffer, w.args[i].kind);
+        w.put(w.buffer, w.args[i].bits);
+    }
+    w.put(w.buffer, uint8_t(result != nullptr));
+    if (result != nullptr) {
+        w.put(w.buffer, result->kind);
+        w.put(w.buffer, result->bits);
+    }
+    w.put(w.buffer, w.npayloads);
+    w.buffer.insert(w.buffer.end(), w.payloads.begin(), w.payloads.end());
+
+    ++w.calls;
+    if (w.buffer.size() >= CAPTURE_CHUNK_SIZE)
+        w.flush();
+}
+
+const GLCapturedPayload *
+GLCapturedCall::payload(size_t arg, GLPayloadKind kind) const
+{
+    for (const auto &p : payloads)
+        if (p.arg == arg && p.kind == kind)
+            return &p;
+    return nullptr;
+}
+
+bool
+GLCaptureReader::open(std::string_view path)
+{
+    auto res = sys::io::readFile(path);
+    if (!res)
+        return false;
+    auto contents = std::move(res).value();
+    _data.assign(contents.data(), contents.data() + contents.size());
+    _pos = 0;
+    _functions.clear();
+
+    char magic[sizeof GL_CAPTURE_MAGIC];
+    uint32_t version, reserved;
+    if (!read(magic, sizeof magic) || !read(&version, sizeof version) ||
+        !read(&reserved, sizeof reserved) ||
+        memcmp(magic, GL_CAPTURE_MAGIC, sizeof magic) != 0) {
+        ERR("not a GL capture file: " + std::string(path));
+        return false;
+    }
+    if (version != GL_CAPTURE_VERSION) {
+        ERR("unsupported GL capture version: " + std::to_string(version));
+        return false;
+    }
+    return true;
+}
+
+bool
+GLCaptureReader::read(void *dst, size_t size)
+{
+    if (_data.size() - _pos < size)
+        return false;
+    memcpy(dst, _data.data() + _pos, size);
+    _pos += size;
+    return true;
+}
+
+GLCaptureReader::Event
+GLCaptureReader::next(GLCapturedCall &call, uint64_t &frame_ns)
+{
+    for (;;) {
+        GLCaptureRecord type;
+        if (!read(&type, sizeof type))
+            return End;
+
+        switch (type) {
+        case GLCaptureRecord::Function: {
+            uint32_t id;
+            uint16_t len;
+            if (!read(&id, sizeof id) || !read(&len, sizeof len) ||
+                _data.size() - _pos < len || id != _functions.size())
+                return Error;
+            _functions.emplace_back(_data.data() + _pos, len);
+            _pos += len;
+            continue;
+        }
+        case GLCaptureRecord::Frame:
+            return read(&frame_ns, sizeof frame_ns) ? Frame : Error;
+        case GLCaptureRecord::Call: {
+            uint8_t argc, has_result, npayloads;
+            if (!read(&call.function, sizeof call.function) ||
+                !read(&call.start_ns, sizeof call.start_ns) ||
+                !read(&call.duration_ns, sizeof call.duration_ns) ||
+                !read(&argc, sizeof argc) || call.function >= _functions.size())
+                return Error;
+            call.args.resize(argc);
+            for (auto &arg : call.args)
+                if (!read(&arg.kind, sizeof arg.kind) ||
+                    !read(&arg.bits, sizeof arg.bits))
+                    return Error;
+            if (!read(&has_result, sizeof has_result))
+                return Error;
+            call.has_result = has_result != 0;
+            if (call.has_result && (!read(&call.result.kind, 1) ||
+                                    !read(&call.result.bits, 8)))
+                return Error;
+            if (!read(&npayloads, sizeof npayloads))
+                return Error;
+            call.payloads.resize(npayloads);
+            for (auto &p : call.payloads) {
+                uint32_t size;
+                if (!read(&p.arg, sizeof p.arg) ||
+                    !read(&p.kind, sizeof p.kind) ||
+                    !read(&size, sizeof size) || _data.size() - _pos < size)
+                    return Error;
+                p.data = { _data.data() + _pos, size };
+                _pos += size;
+            }
+            return Call;
+        }
+        }
+        return Error;
+    }
+}
+
+} // namespace glt
@@ -0,0 +1,199 @@
+#ifndef GLT_GL_CAPTURE_HPP
+#define GLT_GL_CAPTURE_HPP
+
+#include "glt/conf.hpp"
+
+#include "opengl.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace glt {
+
+// Binary capture of the GL calls made through GL_CALL and GL_ASSIGN_CALL.
+//
+// A capture file starts with GL_CAPTURE_MAGIC and the format version,
+// followed by records, all integers little endian:
+//   Function: u8 1, u32 id, u16 length, name
+//   Call:     u8 2, u32 function id, u64 start ns, u32 duration ns,
+//             u8 argc, argc * (u8 kind, u64 bits),
+//             u8 has result, [u8 kind, u64 bits],
+//             u8 payloads, payloads * (u8 arg, u8 kind, u32 size, bytes)
+//   Frame:    u8 3, u64 ns
+// Times count from the start of the capture. Payloads hold the memory
+// referenced by pointer arguments: buffer and texture data, uniform values,
+// strings, and after the call the names written by glGen*.
+
+inline constexpr char GL_CAPTURE_MAGIC[8] = { 'G', 'L', 'T', 'C',
+                                              'A', 'P', '\0', '\0' };
+inline constexpr uint32_t GL_CAPTURE_VERSION = 1;
+
+enum class GLCaptureRecord : uint8_t
+{
+    Function = 1,
+    Call = 2,
+    Frame = 3
+};
+
+enum class GLArgKind : uint8_t
+{
+    Int,        // integers, enums and booleans, sign extended
+    Float,      // the bits of a float
+    Double,     // the bits of a double
+    Pointer,    // const pointer: input data, or an offset into a buffer
+    OutPointer, // non const pointer: written by GL
+    Sync        // a GLsync handle
+};
+
+enum class GLPayloadKind : uint8_t
+{
+    Data,        // the bytes the pointer points to
+    StringArray, // u32 count, count * (u32 length, bytes, '\0')
+    Output       // written by the call, for checking a replay
+};
+
+struct GLCallArg
+{
+    GLArgKind kind;
+    uint64_t bits;
+};
+
+template<typename T>
+GLCallArg
+glCallArg(const T &x)
+{
+    if constexpr (std::is_same_v<T, GLsync>) {
+        return { GLArgKind::Sync, uint64_t(reinterpret_cast<uintptr_t>(x)) };
+    } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+        return { GLArgKind::Pointer, 0 };
+    } else if constexpr (std::is_pointer_v<T>) {
+        constexpr bool input = std::is_const_v<std::remove_pointer_t<T>>;
+        return { input ? GLArgKind::Pointer : GLArgKind::OutPointer,
+                 uint64_t(reinterpret_cast<uintptr_t>(x)) };
+    } else if constexpr (std::is_same_v<T, float>) {
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof bits);
+        return { GLArgKind::Float, bits };
+    } else if constexpr (std::is_same_v<T, double>) {
+        uint64_t bits;
+        memcpy(&bits, &x, sizeof bits);
+        return { GLArgKind::Double, bits };
+    } else {
+        static_assert(std::is_integral_v<T> || std::is_enum_v<T>);
+        return { GLArgKind::Int, uint64_t(int64_t(x)) };
+    }
+}
+
+// starts writing all calls to path, GL thread only. Best started before
+// the first object is created: a replay creates the same objects in a
+// fresh context and relies on getting the same names.
+GLT_API bool
+glCaptureStart(std::string_view path);
+
+GLT_API void
+glCaptureStop();
+
+GLT_API bool
+glCapturing();
+
+// marks the end of a frame
+GLT_API void
+glCaptureFrame();
+
+// calls written since glCaptureStart()
+GLT_API uint64_t
+glCapturedCalls();
+
+// Used by GL_CALL: begin() records the arguments and the data they point
+// to, end() the duration and what the call returned or wrote.
+struct GLT_API GLCallRecorder
+{
+    template<typename... Args>
+    void begin(const char *name, Args &&...args)
+    {
+        if (!glCapturing())
+            return;
+        const std::array<GLCallArg, sizeof...(Args)> argv = {
+            glCallArg<std::decay_t<Args>>(args)...
+        };
+        beginCall(name, argv.data(), argv.size());
+    }
+
+    void end()
+    {
+        if (_active)
+            endCall(nullptr);
+    }
+
+    template<typename R>
+    void end(const R &result)
+    {
+        if (_active) {
+            const auto arg = glCallArg<R>(result);
+            endCall(&arg);
+        }
+    }
+
+private:
+    void beginCall(const char *name, const GLCallArg *args, size_t argc);
+    void endCall(const GLCallArg *result);
+
+    bool _active = false;
+};
+
+// a call read back from a capture file
+struct GLCapturedPayload
+{
+    uint8_t arg;
+    GLPayloadKind kind;
+    std::string_view data;
+};
+
+struct GLT_API GLCapturedCall
+{
+    uint32_t function;
+    uint64_t start_ns;
+    uint32_t duration_ns;
+    std::vector<GLCallArg> args;
+    bool has_result;
+    GLCallArg result;
+    std::vector<GLCapturedPayload> payloads;
+
+    const GLCapturedPayload *payload(size_t arg, GLPayloadKind kind) const;
+};
+
+// Reads a capture file, the whole file is loaded by open().
+struct GLT_API GLCaptureReader
+{
+    enum Event : uint8_t
+    {
+        End,
+        Call,
+        Frame,
+        Error
+    };
+
+    bool open(std::string_view path);
+
+    // call is valid until the next call of next()
+    Event next(GLCapturedCall &call, uint64_t &frame_ns);
+
+    // names of the functions seen so far, indexed by id
+    const std::vector<std::string> &functions() const { return _functions; }
+
+private:
+    bool read(void *dst, size_t size);
+
+    std::vector<char> _data;
+    size_t _pos{};
+    std::vector<std::string> _functions;
+};
+
+} // namespace glt
+
+#endif
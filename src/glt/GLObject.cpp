@@ -1,5 +1,6 @@
 #include "glt/GLObject.hpp"
 
+#include "glt/module.hpp"
 #include "glt/utils.hpp"
 
 #include <array>
@@ -47,9 +48,20 @@ struct ObjectKind
     Destructor destructor{};
 
     const char *kind{};
+    // for the GL capture
+    const char *generator_name{};
+    const char *destructor_name{};
     ObjectKind() = default;
-    ObjectKind(Generator g, Destructor d, const char *k)
-      : generator(g), destructor(d), kind(k)
+    ObjectKind(Generator g,
+               Destructor d,
+               const char *k,
+               const char *gname,
+               const char *dname)
+      : generator(g)
+      , destructor(d)
+      , kind(k)
+      , generator_name(gname)
+      , destructor_name(dname)
     {}
 };
 
@@ -70,7 +82,8 @@ struct Tables
 Tables::Tables()
 {
     int i = 0;
-#define KIND(g, d, k) (kinds[ObjectType::k] = ObjectKind(g, d, #k)), ++i
+#define KIND(g, d, k)                                                          \
+    (kinds[ObjectType::k] = ObjectKind(g, d, #k, #g, #d)), ++i
     KIND(gen_programs, del_programs, Program);
     KIND(nullptr, del_shaders, Shader);
     KIND(glGenBuffers, glDeleteBuffers, Buffer);
@@ -100,7 +113,8 @@ generate(ObjectType t, GLsizei n, GLuint *names)
     ASSERT(t.is_valid());
     auto idx = size_t(t.value);
     ASSERT(tab.kinds[idx].generator != nullptr);
-    GL_CALL(tab.kinds[idx].generator, n, names);
+    GL_CALL_NAMED(
+      tab.kinds[idx].generator_name, tab.kinds[idx].generator, n, names);
     for (GLsizei i = 0; i < n; ++i) {
         if (names[i] != 0) {
             ++tab.instance_count[idx];
@@ -124,7 +138,10 @@ release(ObjectType t, GLsizei n, const GLuint *names)
     auto tab = Tables::get();
     ASSERT(t.is_valid());
     auto idx = size_t(t.value);
-    GL_CALL(tab.kinds[idx].destructor, n, names);
+    GL_CALL_NAMED(
+      tab.kinds[idx].destructor_name, tab.kinds[idx].destructor, n, names);
+    if (module)
+        module->state_cache.forgetObjects(t, n, names);
     for (GLsizei i = 0; i < n; ++i) {
         if (names[i] != 0) {
             DBG(sys::io::stdout() << "releasing GLObject, stack: "
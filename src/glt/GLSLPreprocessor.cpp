@@ -4,10 +4,13 @@
 #include "glt/ShaderCompiler.hpp"
 #include "sys/fs.hpp"
 #include "sys/io.hpp"
+#include "util/string.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <cstring>
-#include <stack>
-#include <unordered_set>
+#include <mutex>
+#include <unordered_map>
 
 namespace glt {
 
@@ -50,40 +53,267 @@ parseFileArg(const Preprocessor::DirectiveContext &ctx,
     return false;
 }
 
-} // namespace
+using Kind = ShaderFileSegments::Kind;
+
+const std::pair<std::string_view, Kind> DIRECTIVES[] = {
+    { "include", ShaderFileSegments::Include },
+    { "need", ShaderFileSegments::Need },
+    { "version", ShaderFileSegments::Version },
+    { "define", ShaderFileSegments::Define },
+    { "undef", ShaderFileSegments::Undef },
+    { "if", ShaderFileSegments::If },
+    { "ifdef", ShaderFileSegments::Ifdef },
+    { "ifndef", ShaderFileSegments::Ifndef },
+    { "elif", ShaderFileSegments::Elif },
+    { "else", ShaderFileSegments::Else },
+    { "endif", ShaderFileSegments::Endif },
+};
 
-struct FileContext
+bool
+is_ident_char(char c)
 {
-    const char *pos;
+    return isalnum(static_cast<unsigned char>(c)) != 0 || c == '_';
+}
+
+struct ScanState
+{
+    std::vector<ShaderFileSegments::Piece> &pieces;
+    const char *const begin;
+    const char *const end;
+    const char *pos;     // begin of the text not yet added to pieces
+    const char *counted; // the newlines before are counted in line
+    uint32_t line = 1;
+
+    uint32_t offset(const char *p) const { return uint32_t(p - begin); }
+
+    // p must not decrease between calls
+    uint32_t lineAt(const char *p)
+    {
+        line += uint32_t(std::count(counted, p, '\n'));
+        counted = p;
+        return line;
+    }
 };
 
-struct ProcessingState
+void
+addText(ScanState &state, const char *end)
 {
-    std::unordered_set<std::string> visitingFiles;
-    std::unordered_set<std::string> deps;
-    std::unordered_set<std::string> incs;
-    std::stack<FileContext> stack;
+    if (end > state.pos)
+        state.pieces.push_back({ ShaderFileSegments::Text,
+                                 state.lineAt(state.pos),
+                                 state.offset(state.pos),
+                                 uint32_t(end - state.pos),
+                                 0,
+                                 0 });
+}
+
+// installed as default handler, so directives like #if(X) are recognized
+// as well, unknown directives like #extension stay in the text
+struct DirectiveRecorder final : public Preprocessor::DirectiveHandler
+{
+    ScanState &state;
+
+    explicit DirectiveRecorder(ScanState &st) : state(st) {}
+
+    void directiveEncountered(const Preprocessor::DirectiveContext &ctx) final
+    {
+        const char *line = state.begin + ctx.lineOffset;
+        const char *eol = line + ctx.lineLength;
+
+        // a line continuing a #define
+        if (line < state.pos)
+            return;
+
+        const char *name = state.begin + ctx.beginDirective;
+        const char *name_end = name;
+        while (name_end < eol && is_ident_char(*name_end))
+            ++name_end;
+
+        auto it = std::find_if(std::begin(DIRECTIVES),
+                               std::end(DIRECTIVES),
+                               [&](const auto &d) {
+                                   return d.first ==
+                                          std::string_view(
+                                            name, size_t(name_end - name));
+                               });
+        if (it == std::end(DIRECTIVES))
+            return;
+
+        const Kind kind = it->second;
+        const char *arg = name_end;
+        uint32_t len;
+
+        if (kind == ShaderFileSegments::Include ||
+            kind == ShaderFileSegments::Need) {
+            auto &proc = ctx.content.processor;
+            if (!parseFileArg(ctx, arg, len) || len == 0) {
+                proc.out() << ctx.content.name
+                           << (kind == ShaderFileSegments::Include
+                                 ? ": #include-directive: invalid parameter"
+                                 : ": #need-directive: invalid parameter")
+                           << "\n";
+                proc.setError();
+                return;
+            }
+        } else {
+            if (kind == ShaderFileSegments::Define) {
+                while (eol > line && eol[-1] == '\\' && eol < state.end) {
+                    if (*eol == '\r')
+                        ++eol;
+                    if (eol < state.end && *eol == '\n')
+                        ++eol;
+                    while (eol < state.end && *eol != '\n' && *eol != '\r')
+                        ++eol;
+                }
+            }
+            while (arg < eol && isspace(static_cast<unsigned char>(*arg)))
+                ++arg;
+            len = uint32_t(eol - arg);
+        }
+
+        addText(state, line);
+        state.pieces.push_back({ kind,
+                                 state.lineAt(line),
+                                 state.offset(line),
+                                 uint32_t(eol - line),
+                                 state.offset(arg),
+                                 len });
+        state.pos = eol;
+    }
 };
 
-GLSLPreprocessor::GLSLPreprocessor(const IncludePath &incPath,
-                                   ShaderIncludes &incs,
-                                   ShaderDependencies &deps)
-  : includePath(incPath), includes(incs), dependencies(deps)
+std::shared_ptr<ShaderFileSegments>
+readShaderFile(const std::string &path,
+               sys::fs::FileTime mtime,
+               sys::io::OutStream &err)
+{
+    auto data = sys::io::readFile(path, err);
+    if (!data)
+        return nullptr;
+
+    auto file = std::make_shared<ShaderFileSegments>();
+    file->contents = std::move(data).value();
+    file->mtime = mtime;
+    if (!file->scan(path, err))
+        return nullptr;
+    return file;
+}
+
+} // namespace
+
+bool
+ShaderFileSegments::scan(const std::string &name, sys::io::OutStream &err)
 {
-    this->installHandler("include", includeHandler);
-    this->installHandler("need", dependencyHandler);
+    pieces.clear();
+
+    const char *begin = contents.data();
+    const char *end = begin + contents.size();
+    ScanState state{ pieces, begin, end, begin, begin };
+    DirectiveRecorder recorder(state);
+
+    Preprocessor scanner;
+    scanner.out(err);
+    scanner.name(std::string(name));
+    scanner.defaultHandler(recorder);
+    scanner.process(std::string_view(begin, contents.size()));
+    if (scanner.wasError())
+        return false;
+
+    addText(state, end);
+    return true;
 }
 
+struct ShaderFileCache::Data
+{
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<const ShaderFileSegments>>
+      files;
+    size_t hits{};
+    size_t misses{};
+};
+
+DECLARE_PIMPL_DEL(ShaderFileCache)
+
+ShaderFileCache::ShaderFileCache() : self(new Data) {}
+
+ShaderFileCache::~ShaderFileCache() = default;
+
+std::shared_ptr<const ShaderFileSegments>
+ShaderFileCache::load(const std::string &path,
+                      sys::fs::FileTime mtime,
+                      sys::io::OutStream &err)
+{
+    {
+        std::lock_guard lock(self->mutex);
+        auto it = self->files.find(path);
+        if (it != self->files.end() && it->second->mtime == mtime) {
+            ++self->hits;
+            return it->second;
+        }
+    }
+
+    // read without holding the lock, if two threads miss on the same file
+    // both read it and the last one wins
+    std::shared_ptr<const ShaderFileSegments> file =
+      readShaderFile(path, mtime, err);
+    if (!file)
+        return nullptr;
+
+    std::lock_guard lock(self->mutex);
+    ++self->misses;
+    self->files[path] = file;
+    return file;
+}
+
+void
+ShaderFileCache::clear()
+{
+    std::lock_guard lock(self->mutex);
+    self->files.clear();
+}
+
+size_t
+ShaderFileCache::hits() const
+{
+    std::lock_guard lock(self->mutex);
+    return self->hits;
+}
+
+size_t
+ShaderFileCache::misses() const
+{
+    std::lock_guard lock(self->mutex);
+    return self->misses;
+}
+
+GLSLPreprocessor::GLSLPreprocessor(const IncludePath &incPath,
+                                   ShaderIncludes &incs,
+                                   ShaderDependencies &deps_,
+                                   ShaderFileCache *cache)
+  : includePath(incPath)
+  , includes(incs)
+  , dependencies(deps_)
+  , fileCache(cache)
+{}
+
 GLSLPreprocessor::~GLSLPreprocessor() = default;
 
 void
 GLSLPreprocessor::appendString(std::string_view str)
 {
-    if (!str.empty()) {
-        auto &data = contents.emplace_back(str);
-        segments.push_back(data.data());
-        segLengths.push_back(uint32_t(data.size()));
+    if (wasError() || str.empty())
+        return;
+
+    // scanned like a file, so the macros it defines are known
+    auto file = std::make_shared<ShaderFileSegments>();
+    file->contents = Array<char>(str);
+    if (!file->scan(name(), out())) {
+        setError();
+        return;
     }
+
+    files.push_back(file);
+    expand(std::string(), *file, -1);
 }
 
 void
@@ -97,18 +327,21 @@ GLSLPreprocessor::addDefines(const PreprocessorDefinitions &defines)
 }
 
 void
-GLSLPreprocessor::advanceSegments(const Preprocessor::DirectiveContext &ctx)
+GLSLPreprocessor::process(std::string_view source)
 {
-    FileContext &frame = state->stack.top();
-
-    size_t seglen = ctx.content.data + ctx.lineOffset - frame.pos;
+    if (wasError())
+        return;
 
-    if (seglen > 0) {
-        segments.push_back(frame.pos);
-        segLengths.push_back(uint32_t(seglen));
+    auto file = std::make_shared<ShaderFileSegments>();
+    file->contents = Array<char>(source);
+    if (!file->scan(name(), out())) {
+        setError();
+        return;
     }
 
-    frame.pos = ctx.content.data + ctx.lineOffset + ctx.lineLength;
+    files.push_back(file);
+    expand(name(), *file, sourceIndex(name()));
+    emitHeld(-1, 0);
 }
 
 void
@@ -118,155 +351,353 @@ GLSLPreprocessor::processFileRecursively(std::string &&file)
         return;
 
     ASSERT(sys::fs::isAbsolute(file));
-    auto data = sys::io::readFile(file, out());
-    if (!data) {
+    auto mtime = sys::fs::modificationTime(file);
+    if (!mtime) {
+        out() << "cannot open file: " << file << "\n";
         setError();
         return;
     }
 
-    auto &dref = contents.emplace_back(std::move(data).value());
+    auto segs = loadFile(file, *mtime);
+    if (!segs) {
+        setError();
+        return;
+    }
 
-    this->name(std::move(file));
-    process(std::string_view(dref.data(), dref.size()));
+    this->name(std::string(file));
+    expand(file, *segs, sourceIndex(file));
+    emitHeld(-1, 0);
 }
 
-void
-DependencyHandler::directiveEncountered(
-  const Preprocessor::DirectiveContext &ctx)
+std::shared_ptr<const ShaderFileSegments>
+GLSLPreprocessor::loadFile(const std::string &path, sys::fs::FileTime mtime)
 {
-    auto &proc =
-      static_cast<GLSLPreprocessor &>(ctx.content.processor); // NOLINT
-
-    const char *arg;
-    uint32_t len;
+    auto file = fileCache ? fileCache->load(path, mtime, out())
+                          : readShaderFile(path, mtime, out());
+    if (file)
+        files.push_back(file);
+    return file;
+}
 
-    // FIXME: add an option to specify ShaderType explicitly
+int32_t
+GLSLPreprocessor::sourceIndex(const std::string &name)
+{
+    auto it = std::find(sourceNames.begin(), sourceNames.end(), name);
+    if (it != sourceNames.end())
+        return int32_t(it - sourceNames.begin());
+    sourceNames.push_back(name);
+    return int32_t(sourceNames.size() - 1);
+}
 
-    if (!parseFileArg(ctx, arg, len)) {
-        proc.out() << ctx.content.name << ": #need-directive: invalid parameter"
-                   << "\n";
-        proc.setError();
+void
+GLSLPreprocessor::emit(std::string_view text, int32_t source, uint32_t line)
+{
+    if (text.empty())
         return;
-    }
 
-    std::string file(arg, len);
-    std::string realPath = sys::fs::lookup(proc.includePath, file);
-    if (realPath.empty()) {
-        proc.out() << ctx.content.name
-                   << ": #need-directive: cannot find file: " << file << "\n";
-        proc.setError();
+    if (source >= 0 &&
+        text.find_first_not_of(" \t\r\n") == std::string_view::npos) {
+        held.push_back({ text, source, line });
         return;
     }
 
-    proc.advanceSegments(ctx);
-
-    ShaderType stype;
-    if (!ShaderCompiler::guessShaderType(file, &stype)) {
-        proc.out()
-          << ctx.content.name
-          << ": #need-directive: cannot guess shader type based on name: "
-          << file << "\n";
-        proc.setError();
-        return;
+    emitHeld(source, line);
+    if (source >= 0 && (source != driverSource || line != driverLine)) {
+        // up to GLSL 3.30 (ES 3.00) #line gives the number of the line
+        // before the next one
+        const bool es = macros.defined("GL_ES").value_or(false);
+        const bool line_before = version < (es ? 300u : 330u);
+        auto marker = string_concat(driverLineStart ? "" : "\n",
+                                    "#line ",
+                                    line_before ? line - 1 : line,
+                                    " ",
+                                    source,
+                                    "\n");
+        auto &data = contents.emplace_back(std::string_view(marker));
+        append({ data.data(), data.size() });
+        driverSource = source;
+        driverLine = line;
     }
 
-    std::string absPath = sys::fs::absolutePath(realPath);
-    if (proc.state->deps.insert(absPath).second)
-        proc.dependencies.push_back(
-          ShaderSource::makeFileSource(stype, absPath));
+    append(text);
 }
 
 void
-IncludeHandler::beginProcessing(const Preprocessor::ContentContext &ctx)
+GLSLPreprocessor::append(std::string_view text)
 {
-    auto &proc = static_cast<GLSLPreprocessor &>(ctx.processor); // NOLINT
-
-    if (!proc.state)
-        proc.state.reset(new ProcessingState); // NOLINT
-
-    if (!ctx.name.empty())
-        proc.state->visitingFiles.insert(ctx.name);
-
-    FileContext frame{};
-    frame.pos = ctx.data;
-    proc.state->stack.push(frame);
+    segments.push_back(text.data());
+    segLengths.push_back(uint32_t(text.size()));
+    driverLine += uint32_t(std::count(text.begin(), text.end(), '\n'));
+    driverLineStart = text.back() == '\n';
 }
 
 void
-IncludeHandler::directiveEncountered(const Preprocessor::DirectiveContext &ctx)
+GLSLPreprocessor::emitHeld(int32_t source, uint32_t line)
 {
-    auto &proc =
-      static_cast<GLSLPreprocessor &>(ctx.content.processor); // NOLINT
+    auto src = driverSource;
+    auto ln = driverLine;
+    for (const auto &h : held) {
+        if (h.source != src || h.line != ln) {
+            held.clear();
+            return;
+        }
+        ln += uint32_t(std::count(h.text.begin(), h.text.end(), '\n'));
+    }
 
-    const char *arg;
-    uint32_t len;
+    if (source < 0 || (source == src && line == ln))
+        for (const auto &h : held)
+            append(h.text);
+    held.clear();
+}
 
-    if (!parseFileArg(ctx, arg, len) || len == 0) {
-        proc.out() << ctx.content.name
-                   << ": #include-directive: invalid parameter"
-                   << "\n";
-        proc.setError();
+void
+GLSLPreprocessor::defineVersion(std::string_view arg)
+{
+    uint32_t vers = 0;
+    auto [p, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), vers);
+    if (ec != std::errc{})
+        return; // the driver reports it
+
+    std::string_view profile(p, size_t(arg.data() + arg.size() - p));
+    while (!profile.empty() && isspace(static_cast<unsigned char>(profile[0])))
+        profile.remove_prefix(1);
+
+    version = vers;
+    macros.define(string_concat("__VERSION__ ", vers));
+    if (profile.starts_with("es")) {
+        macros.define("GL_ES 1");
         return;
     }
 
-    std::string file(arg, len);
-    std::string realPath = sys::fs::lookup(proc.includePath, file);
-    if (realPath.empty()) {
-        proc.out() << ctx.content.name
-                   << ": #include-directive: cannot find file: " << file
-                   << "\n";
-        proc.setError();
-        return;
+    macros.undefine("GL_ES");
+    if (profile.starts_with("compatibility")) {
+        macros.define("GL_compatibility_profile 1");
+        macros.undefine("GL_core_profile");
+    } else if (vers >= 150) {
+        macros.define("GL_core_profile 1");
+        macros.undefine("GL_compatibility_profile");
     }
+}
 
-    proc.advanceSegments(ctx);
+bool
+GLSLPreprocessor::conditional(const std::string &name,
+                              const ShaderFileSegments &file,
+                              const ShaderFileSegments::Piece &piece,
+                              int32_t source,
+                              size_t depth)
+{
+    auto arg = file.arg(piece);
+    auto directive = file.text(piece);
+
+    if (piece.kind == ShaderFileSegments::If ||
+        piece.kind == ShaderFileSegments::Ifdef ||
+        piece.kind == ShaderFileSegments::Ifndef) {
+        Conditional c{};
+        if (!active()) {
+            c.taken = true;
+        } else if (passthrough()) {
+            c.active = c.passthrough = true;
+        } else {
+            std::optional<bool> cond;
+            if (piece.kind == ShaderFileSegments::If) {
+                if (auto value = macros.evaluate(arg))
+                    cond = *value != 0;
+            } else {
+                cond = macros.defined(arg);
+                if (cond && piece.kind == ShaderFileSegments::Ifndef)
+                    cond = !*cond;
+            }
+
+            if (cond)
+                c.active = c.taken = *cond;
+            else
+                c.active = c.passthrough = true;
+        }
 
-    auto filestat = sys::fs::stat(realPath);
-    if (!filestat) {
-        proc.out() << ctx.content.name
-                   << ": #include-directive: cannot open file: " << realPath
-                   << "\n";
-        proc.setError();
-        return;
+        if (c.passthrough)
+            emit(directive, source, piece.line);
+        conditionals.push_back(c);
+        return true;
     }
-    proc.state->incs.insert(filestat->absolute);
 
-    if (proc.state->visitingFiles.count(filestat->absolute) == 0) {
-        proc.includes.emplace_back(filestat->absolute, filestat->mtime);
+    if (conditionals.size() <= depth) {
+        out() << name << ":" << piece.line << ": unmatched conditional: "
+              << directive << "\n";
+        return false;
+    }
 
-        auto res = readFile(filestat->absolute, proc.out());
-        if (!res) {
-            proc.setError();
-            return;
+    auto &c = conditionals.back();
+    if (piece.kind == ShaderFileSegments::Endif) {
+        if (c.passthrough)
+            emit(directive, source, piece.line);
+        conditionals.pop_back();
+        return true;
+    }
+
+    if (c.seen_else) {
+        out() << name << ":" << piece.line << ": directive after #else: "
+              << directive << "\n";
+        return false;
+    }
+
+    if (piece.kind == ShaderFileSegments::Else) {
+        c.seen_else = true;
+        if (c.passthrough) {
+            emit(directive, source, piece.line);
+        } else {
+            c.active = !c.taken;
+            c.taken = true;
         }
+        return true;
+    }
 
-        auto &dref = proc.contents.emplace_back(std::move(res).value());
-        proc.name(std::move(filestat->absolute));
-        proc.process(std::string_view(dref.data(), dref.size()));
+    // #elif
+    if (c.passthrough) {
+        emit(directive, source, piece.line);
+        return true;
+    }
+
+    if (c.taken) {
+        c.active = false;
+        return true;
     }
+
+    auto value = macros.evaluate(arg);
+    if (!value) {
+        // the preceding branches were stripped, for the driver the
+        // conditional starts here
+        auto &data = contents.emplace_back(
+          std::string_view(string_concat("#if ", arg)));
+        emit({ data.data(), data.size() }, source, piece.line);
+        c.active = c.passthrough = c.taken = true;
+        return true;
+    }
+
+    c.active = c.taken = *value != 0;
+    return true;
 }
 
 void
-IncludeHandler::endProcessing(const Preprocessor::ContentContext &ctx)
+GLSLPreprocessor::expand(const std::string &name,
+                         const ShaderFileSegments &file,
+                         int32_t source)
 {
-    auto &proc = static_cast<GLSLPreprocessor &>(ctx.processor); // NOLINT
+    if (!name.empty())
+        visitingFiles.insert(name);
 
-    FileContext &frame = proc.state->stack.top();
-    size_t seglen = ctx.data + ctx.size - frame.pos;
+    const size_t depth = conditionals.size();
 
-    if (seglen > 0) {
-        proc.segments.push_back(frame.pos);
-        proc.segLengths.push_back(uint32_t(seglen));
-    }
+    for (const auto &piece : file.pieces) {
+        if (wasError())
+            return;
+
+        auto arg = file.arg(piece);
+        switch (piece.kind) {
+        case ShaderFileSegments::Text:
+            if (active())
+                emit(file.text(piece), source, piece.line);
+            continue;
+        case ShaderFileSegments::Version:
+            if (active()) {
+                if (!passthrough())
+                    defineVersion(arg);
+                emit(file.text(piece), source, piece.line);
+            }
+            continue;
+        case ShaderFileSegments::Define:
+        case ShaderFileSegments::Undef:
+            if (!active())
+                continue;
+            // the driver still needs the macros, the directives are kept
+            if (passthrough())
+                macros.markUnknown(arg);
+            else if (piece.kind == ShaderFileSegments::Undef)
+                macros.undefine(arg);
+            else if (!macros.define(arg))
+                macros.markUnknown(arg);
+            emit(file.text(piece), source, piece.line);
+            continue;
+        case ShaderFileSegments::If:
+        case ShaderFileSegments::Ifdef:
+        case ShaderFileSegments::Ifndef:
+        case ShaderFileSegments::Elif:
+        case ShaderFileSegments::Else:
+        case ShaderFileSegments::Endif:
+            if (!conditional(name, file, piece, source, depth)) {
+                setError();
+                return;
+            }
+            continue;
+        case ShaderFileSegments::Include:
+        case ShaderFileSegments::Need:
+            if (!active())
+                continue;
+            break;
+        }
+
+        const bool is_include = piece.kind == ShaderFileSegments::Include;
+        std::string realPath = sys::fs::lookup(includePath, arg);
+        if (realPath.empty()) {
+            out() << name
+                  << (is_include ? ": #include-directive: cannot find file: "
+                                 : ": #need-directive: cannot find file: ")
+                  << arg << "\n";
+            setError();
+            return;
+        }
+
+        if (!is_include) {
+            // FIXME: add an option to specify ShaderType explicitly
+            ShaderType stype;
+            if (!ShaderCompiler::guessShaderType(arg, &stype)) {
+                out() << name
+                      << ": #need-directive: cannot guess shader type based "
+                         "on name: "
+                      << arg << "\n";
+                setError();
+                return;
+            }
+
+            std::string absPath = sys::fs::absolutePath(realPath);
+            if (deps.insert(absPath).second)
+                dependencies.push_back(ShaderSource::makeFileSource(
+                  stype,
+                  absPath,
+                  sourceDefines ? *sourceDefines : PreprocessorDefinitions{}));
+            continue;
+        }
 
-    proc.state->stack.pop();
+        auto filestat = sys::fs::stat(realPath);
+        if (!filestat) {
+            out() << name << ": #include-directive: cannot open file: "
+                  << realPath << "\n";
+            setError();
+            return;
+        }
 
-    if (!ctx.name.empty())
-        proc.state->visitingFiles.erase(ctx.name);
+        if (visitingFiles.count(filestat->absolute) == 0) {
+            includes.emplace_back(filestat->absolute, filestat->mtime);
+
+            auto inc = loadFile(filestat->absolute, filestat->mtime);
+            if (!inc) {
+                setError();
+                return;
+            }
+            expand(filestat->absolute,
+                   *inc,
+                   sourceIndex(filestat->absolute));
+        }
+    }
 
-    if (proc.state->stack.empty()) {
-        proc.state.reset();
+    if (conditionals.size() > depth) {
+        out() << (name.empty() ? this->name() : name)
+              << ": unterminated conditional directive\n";
+        setError();
+        return;
     }
+
+    if (!name.empty())
+        visitingFiles.erase(name);
 }
 
 } // namespace glt
@@ -1,7 +1,10 @@
 #ifndef GLT_GLSLPREPROCESSOR_HPP
 #define GLT_GLSLPREPROCESSOR_HPP
 
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
 #include "glt/Preprocessor.hpp"
@@ -11,50 +14,181 @@
 
 namespace glt {
 
-struct ProcessingState;
-
-struct GLT_API IncludeHandler : public Preprocessor::DirectiveHandler
+// A shader file split at its #include, #need, #version, macro and
+// conditional directives. Directives are evaluated when the file is
+// expanded, so the same segments serve every shader including the file,
+// whatever its include path and defines.
+struct GLT_API ShaderFileSegments
 {
-    void beginProcessing(const Preprocessor::ContentContext & /*ctx*/) final;
-    void directiveEncountered(
-      const Preprocessor::DirectiveContext & /*ctx*/) final;
-    void endProcessing(const Preprocessor::ContentContext & /*ctx*/) final;
+    enum Kind : uint8_t
+    {
+        Text,
+        Include,
+        Need,
+        Version,
+        Define,
+        Undef,
+        If,
+        Ifdef,
+        Ifndef,
+        Elif,
+        Else,
+        Endif
+    };
+
+    // Text: a range of contents, directives: the directive line without
+    // its newline, the argument is the file name of Include and Need and
+    // the rest of the line otherwise
+    struct Piece
+    {
+        Kind kind;
+        uint32_t line; // of the first character
+        uint32_t offset;
+        uint32_t length;
+        uint32_t arg_offset;
+        uint32_t arg_length;
+    };
+
+    Array<char> contents;
+    std::vector<Piece> pieces;
+    sys::fs::FileTime mtime{};
+
+    std::string_view text(const Piece &p) const
+    {
+        return { contents.data() + p.offset, p.length };
+    }
+
+    std::string_view arg(const Piece &p) const
+    {
+        return { contents.data() + p.arg_offset, p.arg_length };
+    }
+
+    // splits contents into pieces, name is used in error messages
+    bool scan(const std::string &name, sys::io::OutStream &err);
 };
 
-struct GLT_API DependencyHandler : public Preprocessor::DirectiveHandler
+// Scanned shader files, keyed by absolute path and modification time, so
+// headers shared by many shaders are read and scanned once. Thread safe.
+struct GLT_API ShaderFileCache
 {
-    void directiveEncountered(
-      const Preprocessor::DirectiveContext & /*ctx*/) final;
+    ShaderFileCache();
+    ~ShaderFileCache();
+
+    std::shared_ptr<const ShaderFileSegments> load(const std::string &path,
+                                                   sys::fs::FileTime mtime,
+                                                   sys::io::OutStream &err);
+
+    void clear();
+
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    DECLARE_PIMPL(GLT_API, self);
 };
 
+// Expands includes and evaluates conditionals on the CPU, the driver only
+// sees the active regions. Conditions depending on the driver, e.g. on
+// extension macros, are left in place. #line markers keep the line numbers
+// of the driver's messages right, the source string number is the index in
+// sourceNames.
 struct GLT_API GLSLPreprocessor : public Preprocessor
 {
     const IncludePath &includePath;
     ShaderIncludes &includes;
     ShaderDependencies &dependencies;
+    ShaderFileCache *fileCache;
+    // defines of the shader source, passed on to #need dependencies
+    const PreprocessorDefinitions *sourceDefines = nullptr;
 
     std::vector<uint32_t> segLengths;
     std::vector<const char *> segments;
     std::vector<Array<char>> contents;
-
-    std::unique_ptr<ProcessingState> state;
-
-    IncludeHandler includeHandler;
-    DependencyHandler dependencyHandler;
+    std::vector<std::shared_ptr<const ShaderFileSegments>> files;
+    std::vector<std::string> sourceNames;
+    MacroTable macros;
 
     GLSLPreprocessor(const IncludePath &,
                      ShaderIncludes &,
-                     ShaderDependencies &);
+                     ShaderDependencies &,
+                     ShaderFileCache *cache = nullptr);
     ~GLSLPreprocessor();
 
     void appendString(std::string_view);
 
     void addDefines(const PreprocessorDefinitions &);
 
+    // embedded source code, expanded like a file but not cached
+    void process(std::string_view);
+
     void processFileRecursively(std::string &&);
 
-    // internal use only
-    void advanceSegments(const Preprocessor::DirectiveContext &);
+private:
+    std::unordered_set<std::string> visitingFiles;
+    std::unordered_set<std::string> deps;
+
+    struct Conditional
+    {
+        bool active;
+        bool taken;       // a branch was active already
+        bool passthrough; // left to the driver, directives are emitted
+        bool seen_else;
+    };
+
+    std::vector<Conditional> conditionals;
+
+    // where the driver thinks the next emitted character is
+    int32_t driverSource = 0;
+    uint32_t driverLine = 1;
+    bool driverLineStart = true;
+    uint32_t version = 110;
+
+    // whitespace is held back, it is dropped if a #line marker follows
+    struct HeldText
+    {
+        std::string_view text;
+        int32_t source;
+        uint32_t line;
+    };
+
+    std::vector<HeldText> held;
+
+    std::shared_ptr<const ShaderFileSegments> loadFile(
+      const std::string &path,
+      sys::fs::FileTime mtime);
+
+    bool active() const
+    {
+        return conditionals.empty() || conditionals.back().active;
+    }
+
+    bool passthrough() const
+    {
+        return !conditionals.empty() && conditionals.back().passthrough;
+    }
+
+    // source < 0: generated text, not subject to #line
+    void emit(std::string_view text, int32_t source, uint32_t line);
+
+    void append(std::string_view text);
+
+    // emits the held text, unless the driver would be at another position
+    // than source:line afterwards
+    void emitHeld(int32_t source, uint32_t line);
+
+    void defineVersion(std::string_view arg);
+
+    bool conditional(const std::string &name,
+                     const ShaderFileSegments &file,
+                     const ShaderFileSegments::Piece &piece,
+                     int32_t source,
+                     size_t depth);
+
+    int32_t sourceIndex(const std::string &name);
+
+    void expand(const std::string &name,
+                const ShaderFileSegments &file,
+                int32_t source);
 };
 
 } // namespace glt
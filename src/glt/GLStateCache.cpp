@@ -0,0 +1,220 @@
+#include "glt/GLStateCache.hpp"
+
+#include "err/err.hpp"
+#include "glt/module.hpp"
+#include "glt/utils.hpp"
+
+namespace glt {
+
+GLStateCache::GLStateCache()
+{
+    invalidate();
+}
+
+void
+GLStateCache::invalidate()
+{
+    _program = UNKNOWN;
+    _vertex_array = UNKNOWN;
+    _array_buffer = UNKNOWN;
+    _element_buffer = UNKNOWN;
+    _active_unit = uint32_t(UNKNOWN);
+    for (auto &unit : _units) {
+        unit.targets.clear();
+        unit.sampler = UNKNOWN;
+    }
+    _draw_framebuffer = UNKNOWN;
+    _read_framebuffer = UNKNOWN;
+    _viewport_known = false;
+    _enabled.clear();
+}
+
+void
+GLStateCache::forgetObjects(ObjectType t, GLsizei n, const GLuint *names)
+{
+    auto forget = [](GLuint &bound, GLuint name) {
+        if (bound == name)
+            bound = 0;
+    };
+
+    for (GLsizei i = 0; i < n; ++i) {
+        auto name = names[i];
+        if (name == 0)
+            continue;
+        switch (t.value) {
+        case ObjectType::Program:
+            // a program in use is only flagged for deletion
+            if (_program == name)
+                _program = UNKNOWN;
+            break;
+        case ObjectType::VertexArray:
+            if (_vertex_array == name) {
+                _vertex_array = 0;
+                _element_buffer = UNKNOWN;
+            }
+            break;
+        case ObjectType::Buffer:
+            forget(_array_buffer, name);
+            forget(_element_buffer, name);
+            break;
+        case ObjectType::Texture:
+            for (auto &unit : _units)
+                for (auto &ent : unit.targets)
+                    forget(ent.second, name);
+            break;
+        case ObjectType::Sampler:
+            for (auto &unit : _units)
+                forget(unit.sampler, name);
+            break;
+        case ObjectType::Framebuffer:
+            forget(_draw_framebuffer, name);
+            forget(_read_framebuffer, name);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void
+GLStateCache::useProgram(GLuint program)
+{
+    if (filter(_program == program))
+        return;
+    _program = program;
+    GL_CALL(glUseProgram, program);
+}
+
+void
+GLStateCache::bindVertexArray(GLuint vao)
+{
+    if (filter(_vertex_array == vao))
+        return;
+    _vertex_array = vao;
+    _element_buffer = UNKNOWN;
+    GL_CALL(glBindVertexArray, vao);
+}
+
+void
+GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    GLuint *bound = nullptr;
+    if (target == GL_ARRAY_BUFFER)
+        bound = &_array_buffer;
+    else if (target == GL_ELEMENT_ARRAY_BUFFER)
+        bound = &_element_buffer;
+
+    if (filter(bound != nullptr && *bound == buffer))
+        return;
+    if (bound != nullptr)
+        *bound = buffer;
+    GL_CALL(glBindBuffer, target, buffer);
+}
+
+void
+GLStateCache::activeTexture(uint32_t unit)
+{
+    if (filter(_active_unit == unit))
+        return;
+    _active_unit = unit;
+    GL_CALL(glActiveTexture, GL_TEXTURE0 + unit);
+}
+
+void
+GLStateCache::bindTexture(GLenum target, GLuint texture)
+{
+    if (_active_unit >= MAX_TEXTURE_UNITS) {
+        filter(false);
+        GL_CALL(glBindTexture, target, texture);
+        return;
+    }
+
+    auto &targets = _units[_active_unit].targets;
+    auto it = targets.find(target);
+    if (filter(it != targets.end() && it->second == texture))
+        return;
+    targets[target] = texture;
+    GL_CALL(glBindTexture, target, texture);
+}
+
+void
+GLStateCache::bindTexture(uint32_t unit, GLenum target, GLuint texture)
+{
+    activeTexture(unit);
+    bindTexture(target, texture);
+}
+
+void
+GLStateCache::bindSampler(uint32_t unit, GLuint sampler)
+{
+    auto *bound = unit < MAX_TEXTURE_UNITS ? &_units[unit].sampler : nullptr;
+    if (filter(bound != nullptr && *bound == sampler))
+        return;
+    if (bound != nullptr)
+        *bound = sampler;
+    GL_CALL(glBindSampler, unit, sampler);
+}
+
+void
+GLStateCache::bindFramebuffer(GLenum target, GLuint fb)
+{
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    if (filter((!draw || _draw_framebuffer == fb) &&
+               (!read || _read_framebuffer == fb)))
+        return;
+    if (draw)
+        _draw_framebuffer = fb;
+    if (read)
+        _read_framebuffer = fb;
+    GL_CALL(glBindFramebuffer, target, fb);
+}
+
+void
+GLStateCache::viewport(GLint x, GLint y, GLsizei w, GLsizei h)
+{
+    const std::array<GLint, 4> vp{ x, y, GLint(w), GLint(h) };
+    if (filter(_viewport_known && _viewport == vp))
+        return;
+    _viewport = vp;
+    _viewport_known = true;
+    GL_CALL(glViewport, x, y, w, h);
+}
+
+void
+GLStateCache::setEnabled(GLenum cap, bool enabled)
+{
+    auto it = _enabled.find(cap);
+    if (filter(it != _enabled.end() && it->second == enabled))
+        return;
+    _enabled[cap] = enabled;
+    if (enabled)
+        GL_CALL(glEnable, cap);
+    else
+        GL_CALL(glDisable, cap);
+}
+
+void
+GLStateCache::beginFrame()
+{
+    _last_frame = _frame;
+    _frame = {};
+}
+
+void
+GLStateCache::printStatistics(sys::io::OutStream &out) const
+{
+    out << "GL state changes (last frame): " << _last_frame.issued
+        << " issued, " << _last_frame.filtered << " filtered\n"
+        << "GL state changes (total): " << _total.issued << " issued, "
+        << _total.filtered << " filtered\n";
+}
+
+GLStateCache &
+stateCache()
+{
+    ASSERT(module, "glt module not initialized");
+    return module->state_cache;
+}
+
+} // namespace glt
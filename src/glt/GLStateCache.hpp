@@ -0,0 +1,114 @@
+#ifndef GLT_GL_STATE_CACHE_HPP
+#define GLT_GL_STATE_CACHE_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/GLObject.hpp"
+#include "opengl.hpp"
+#include "sys/io/Stream.hpp"
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+namespace glt {
+
+struct GLT_API GLStateStatistics
+{
+    size_t issued{};
+    size_t filtered{};
+};
+
+// Shadows the binding state of the current context and drops binds which
+// would not change it. All state starts out unknown, so the first call for
+// each binding always reaches OpenGL. Code changing bindings through raw GL
+// calls has to call invalidate() afterwards.
+struct GLT_API GLStateCache
+{
+    static inline constexpr GLuint UNKNOWN = GLuint(-1);
+    static inline constexpr size_t MAX_TEXTURE_UNITS = 32;
+
+    GLStateCache();
+
+    void invalidate();
+
+    // called by glt::release(), bindings of deleted objects revert to 0
+    void forgetObjects(ObjectType t, GLsizei n, const GLuint *names);
+
+    void useProgram(GLuint program);
+
+    void bindVertexArray(GLuint vao);
+
+    void bindBuffer(GLenum target, GLuint buffer);
+
+    void activeTexture(uint32_t unit);
+
+    // binds to the currently active texture unit
+    void bindTexture(GLenum target, GLuint texture);
+
+    void bindTexture(uint32_t unit, GLenum target, GLuint texture);
+
+    void bindSampler(uint32_t unit, GLuint sampler);
+
+    void bindFramebuffer(GLenum target, GLuint fb);
+
+    void viewport(GLint x, GLint y, GLsizei w, GLsizei h);
+
+    void enable(GLenum cap) { setEnabled(cap, true); }
+
+    void disable(GLenum cap) { setEnabled(cap, false); }
+
+    void setEnabled(GLenum cap, bool enabled);
+
+    // starts a new frame, the counters of the finished one are kept
+    void beginFrame();
+
+    GLStateStatistics frameStatistics() const { return _last_frame; }
+
+    GLStateStatistics totalStatistics() const { return _total; }
+
+    void printStatistics(sys::io::OutStream &) const;
+
+private:
+    struct TextureUnit
+    {
+        std::unordered_map<GLenum, GLuint> targets;
+        GLuint sampler = UNKNOWN;
+    };
+
+    GLuint _program = UNKNOWN;
+    GLuint _vertex_array = UNKNOWN;
+    GLuint _array_buffer = UNKNOWN;
+    GLuint _element_buffer = UNKNOWN; // part of the vertex array state
+    uint32_t _active_unit = uint32_t(UNKNOWN);
+    std::array<TextureUnit, MAX_TEXTURE_UNITS> _units;
+    GLuint _draw_framebuffer = UNKNOWN;
+    GLuint _read_framebuffer = UNKNOWN;
+    std::array<GLint, 4> _viewport{};
+    bool _viewport_known = false;
+    std::unordered_map<GLenum, bool> _enabled;
+
+    GLStateStatistics _frame;
+    GLStateStatistics _last_frame;
+    GLStateStatistics _total;
+
+    bool filter(bool redundant)
+    {
+        if (redundant) {
+            ++_frame.filtered;
+            ++_total.filtered;
+        } else {
+            ++_frame.issued;
+            ++_total.issued;
+        }
+        return redundant;
+    }
+};
+
+// the state cache of the current context, owned by the glt module
+GLT_API GLStateCache &
+stateCache();
+
+} // namespace glt
+
+#endif
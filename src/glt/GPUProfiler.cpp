@@ -0,0 +1,277 @@
+#include "glt/GPUProfiler.hpp"
+
+#include "glt/GLObject.hpp"
+#include "glt/module.hpp"
+#include "glt/utils.hpp"
+#include "sys/clock.hpp"
+
+#include <map>
+
+namespace glt {
+
+struct GPUProfiler::Data
+{
+    struct Scope
+    {
+        uint32_t name;
+        uint32_t begin; // query indices in the pool of the frame
+        uint32_t end;
+    };
+
+    struct Frame
+    {
+        std::vector<GLQueryObject> queries;
+        size_t used{};
+        std::vector<Scope> scopes;
+        // both clocks sampled at the start of the frame
+        GLint64 gpu_base{};
+        double cpu_base{};
+        bool pending{};
+    };
+
+    struct History
+    {
+        std::string name;
+        uint32_t depth{};
+        std::vector<double> samples; // ring of the latest durations
+        size_t next{};
+    };
+
+    std::vector<Frame> frames;
+    size_t current{};
+    bool in_frame{};
+    std::vector<uint32_t> open; // indices of open scopes in the frame
+
+    std::vector<History> names;
+    std::map<std::string, uint32_t, std::less<>> ids;
+    size_t history{};
+    uint64_t dropped{};
+    bool track_named{};
+
+    uint32_t nameId(std::string_view name);
+    uint32_t query();
+    void collect();
+    bool available(const Frame &frame) const;
+    void read(Frame &frame);
+};
+
+DECLARE_PIMPL_DEL(GPUProfiler)
+
+uint32_t
+GPUProfiler::Data::nameId(std::string_view name)
+{
+    auto it = ids.find(name);
+    if (it != ids.end())
+        return it->second;
+    const auto id = uint32_t(names.size());
+    names.push_back({ std::string(name), uint32_t(open.size()), {}, 0 });
+    ids.emplace(std::string(name), id);
+    return id;
+}
+
+uint32_t
+GPUProfiler::Data::query()
+{
+    auto &frame = frames[current];
+    if (frame.used == frame.queries.size())
+        frame.queries.emplace_back().ensure();
+    const auto index = uint32_t(frame.used++);
+    GL_CALL(glQueryCounter, *frame.queries[index], GL_TIMESTAMP);
+    return index;
+}
+
+bool
+GPUProfiler::Data::available(const Frame &frame) const
+{
+    // queries complete in order, the last one was issued by endFrame()
+    GLuint avail = GL_FALSE;
+    GL_CALL(glGetQueryObjectuiv,
+            *frame.queries[frame.used - 1],
+            GL_QUERY_RESULT_AVAILABLE,
+            &avail);
+    return avail != GL_FALSE;
+}
+
+void
+GPUProfiler::Data::collect()
+{
+    // oldest frame first, later ones cannot be done before it
+    for (size_t i = 1; i <= frames.size(); ++i) {
+        auto &frame = frames[(current + i) % frames.size()];
+        if (!frame.pending)
+            continue;
+        if (!available(frame))
+            break;
+        read(frame);
+    }
+}
+
+void
+GPUProfiler::Data::read(Frame &frame)
+{
+    frame.pending = false;
+
+    auto &tr = sys::trace();
+    const bool tracing = tr.isOpen();
+    if (!tracing) {
+        track_named = false;
+    } else if (!track_named) {
+        track_named = true;
+        tr.nameTrack(sys::TRACE_GPU_TRACK, "GPU");
+    }
+
+    for (const auto &scope : frame.scopes) {
+        GLuint64 t0, t1;
+        GL_CALL(glGetQueryObjectui64v,
+                *frame.queries[scope.begin],
+                GL_QUERY_RESULT,
+                &t0);
+        GL_CALL(glGetQueryObjectui64v,
+                *frame.queries[scope.end],
+                GL_QUERY_RESULT,
+                &t1);
+
+        auto &h = names[scope.name];
+        const double secs = double(t1 - t0) * 1e-9;
+        if (h.samples.size() < history) {
+            h.samples.push_back(secs);
+        } else {
+            h.samples[h.next] = secs;
+            h.next = (h.next + 1) % history;
+        }
+
+        if (tracing) {
+            const double begin =
+              frame.cpu_base + double(GLint64(t0) - frame.gpu_base) * 1e-9;
+            tr.zone(h.name, sys::TRACE_GPU_TRACK, begin, begin + secs);
+        }
+    }
+}
+
+GPUProfiler::GPUProfiler() : self(new Data) {}
+
+GPUProfiler::~GPUProfiler() = default;
+
+void
+GPUProfiler::init(size_t frames, size_t history)
+{
+    ASSERT(frames > 1);
+    ASSERT(history > 0);
+    shutdown();
+    self->frames = std::vector<Data::Frame>(frames);
+    self->history = history;
+}
+
+void
+GPUProfiler::shutdown()
+{
+    self->frames.clear();
+    self->current = 0;
+    self->in_frame = false;
+    self->open.clear();
+}
+
+bool
+GPUProfiler::initialized() const
+{
+    return !self->frames.empty();
+}
+
+void
+GPUProfiler::beginFrame()
+{
+    if (self->frames.empty())
+        return;
+    ASSERT(!self->in_frame, "nested beginFrame()");
+
+    self->collect();
+    self->current = (self->current + 1) % self->frames.size();
+    auto &frame = self->frames[self->current];
+    if (frame.pending) {
+        ++self->dropped;
+        frame.pending = false;
+    }
+    frame.used = 0;
+    frame.scopes.clear();
+
+    GL_CALL(glGetInteger64v, GL_TIMESTAMP, &frame.gpu_base);
+    frame.cpu_base = sys::queryTimer();
+
+    self->in_frame = true;
+    push("frame");
+}
+
+void
+GPUProfiler::endFrame()
+{
+    if (!self->in_frame)
+        return;
+    while (!self->open.empty())
+        pop();
+    self->in_frame = false;
+    self->frames[self->current].pending = true;
+}
+
+void
+GPUProfiler::push(std::string_view name)
+{
+    if (!self->in_frame)
+        return;
+    const auto id = self->nameId(name);
+    auto &scopes = self->frames[self->current].scopes;
+    self->open.push_back(uint32_t(scopes.size()));
+    scopes.push_back({ id, self->query(), 0 });
+}
+
+void
+GPUProfiler::pop()
+{
+    if (!self->in_frame || self->open.empty())
+        return;
+    const auto index = self->open.back();
+    self->open.pop_back();
+    const auto end = self->query();
+    self->frames[self->current].scopes[index].end = end;
+}
+
+std::vector<GPUScopeStats>
+GPUProfiler::statistics() const
+{
+    std::vector<GPUScopeStats> result;
+    result.reserve(self->names.size());
+    for (const auto &h : self->names) {
+        auto samples = h.samples;
+        result.push_back({ h.name, sys::timingStats(samples) });
+    }
+    return result;
+}
+
+void
+GPUProfiler::printStatistics(sys::io::OutStream &out) const
+{
+    const auto stats = statistics();
+    for (size_t i = 0; i < stats.size(); ++i) {
+        out << "GPU ";
+        for (uint32_t d = 0; d < self->names[i].depth; ++d)
+            out << "  ";
+        out << stats[i].name << ": ";
+        sys::printTimingStats(out, stats[i].stats);
+    }
+    if (self->dropped > 0)
+        out << "GPU frames dropped: " << self->dropped << "\n";
+}
+
+uint64_t
+GPUProfiler::dropped() const
+{
+    return self->dropped;
+}
+
+GPUProfiler &
+gpuProfiler()
+{
+    ASSERT(module, "glt module not initialized");
+    return module->gpu_profiler;
+}
+
+} // namespace glt
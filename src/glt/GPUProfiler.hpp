@@ -0,0 +1,89 @@
+#ifndef GLT_GPU_PROFILER_HPP
+#define GLT_GPU_PROFILER_HPP
+
+#include "glt/conf.hpp"
+
+#include "pp/pimpl.hpp"
+#include "sys/io/Stream.hpp"
+#include "sys/profile.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace glt {
+
+// frames of queries in flight before results are given up on
+inline constexpr size_t GPU_PROFILER_FRAMES = 4;
+
+// durations kept per scope name for the statistics
+inline constexpr size_t GPU_PROFILER_HISTORY = 512;
+
+struct GPUScopeStats
+{
+    std::string name;
+    sys::TimingStats stats;
+};
+
+// Times named, nestable scopes on the GPU with pairs of GL_TIMESTAMP queries.
+// The queries of a frame come from a pool per frame, the pools form a ring
+// several frames deep. Results are read only once available, a frame whose
+// queries are still pending when its pool is needed again is dropped, so
+// reading never stalls. GPU timestamps are mapped to sys::queryTimer() by
+// sampling both clocks every frame, completed scopes go into sys::trace() on
+// the GPU track next to the CPU zones. GL thread only.
+struct GLT_API GPUProfiler
+{
+    GPUProfiler();
+    ~GPUProfiler();
+
+    // scopes are ignored until init() was called
+    void init(size_t frames = GPU_PROFILER_FRAMES,
+              size_t history = GPU_PROFILER_HISTORY);
+
+    // releases all queries, needs the context still current
+    void shutdown();
+
+    bool initialized() const;
+
+    // reads finished frames and opens a scope "frame"
+    void beginFrame();
+
+    // closes all open scopes
+    void endFrame();
+
+    // nothing happens outside of beginFrame()/endFrame()
+    void push(std::string_view name);
+    void pop();
+
+    // per scope name, in order of first use
+    std::vector<GPUScopeStats> statistics() const;
+
+    void printStatistics(sys::io::OutStream &out) const;
+
+    // frames whose results were not available in time
+    uint64_t dropped() const;
+
+private:
+    DECLARE_PIMPL(GLT_API, self);
+};
+
+// the profiler of the current context, owned by the glt module
+GLT_API GPUProfiler &
+gpuProfiler();
+
+struct GPUScope
+{
+    explicit GPUScope(std::string_view name) { gpuProfiler().push(name); }
+    ~GPUScope() { gpuProfiler().pop(); }
+
+    GPUScope(const GPUScope &) = delete;
+    GPUScope &operator=(const GPUScope &) = delete;
+};
+
+} // namespace glt
+
+#define GPU_SCOPE(name) ::glt::GPUScope PP_CAT(gpu_scope_, __LINE__)(name)
+
+#endif
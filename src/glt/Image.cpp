@@ -0,0 +1,578 @@
+#include "glt/Image.hpp"
+
+#include "err/err.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+namespace glt {
+
+PP_DEF_ENUM_IMPL(GLT_MIPMAP_FILTER_ENUM_DEF);
+
+namespace {
+
+// larger images are rejected instead of risking size overflows
+constexpr uint32_t MAX_IMAGE_SIZE = 32768;
+
+// Kaiser window: radius in destination texels and shape parameter
+constexpr float KAISER_WIDTH = 2.f;
+constexpr float KAISER_ALPHA = 4.f;
+
+const uint8_t *
+bytes(std::span<const char> data)
+{
+    return reinterpret_cast<const uint8_t *>(data.data());
+}
+
+uint16_t
+le16(const uint8_t *p)
+{
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+uint32_t
+le32(const uint8_t *p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) |
+           (uint32_t(p[3]) << 24);
+}
+
+void
+put16(uint8_t *p, uint32_t v)
+{
+    p[0] = uint8_t(v);
+    p[1] = uint8_t(v >> 8);
+}
+
+void
+put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+bool
+fail(std::string &error, const char *msg)
+{
+    error = msg;
+    return false;
+}
+
+void
+flipRows(Image &img)
+{
+    const auto row = img.rowSize();
+    auto *p = img.pixels.data();
+    for (uint32_t y = 0; y < img.height / 2; ++y)
+        std::swap_ranges(p + y * row,
+                         p + (y + 1) * row,
+                         p + (img.height - 1 - y) * row);
+}
+
+// BGR(A) to RGB(A)
+void
+swapRedBlue(Image &img)
+{
+    const auto c = img.channels;
+    auto *p = img.pixels.data();
+    const auto n = img.size();
+    for (size_t i = 0; i < n; i += c)
+        std::swap(p[i], p[i + 2]);
+}
+
+// 8 bit value of the bits selected by mask, missing channels read as
+// fallback
+uint8_t
+maskedChannel(uint32_t v, uint32_t mask, uint8_t fallback)
+{
+    if (mask == 0)
+        return fallback;
+    const auto shift = std::countr_zero(mask);
+    const auto bits = std::popcount(mask);
+    const auto max = (uint64_t(1) << bits) - 1;
+    return uint8_t(((v & mask) >> shift) * 255 / max);
+}
+
+struct SrgbTables
+{
+    float to_linear[256];
+    uint8_t from_linear[4096];
+};
+
+const SrgbTables &
+srgbTables()
+{
+    static const SrgbTables tables = [] {
+        SrgbTables t;
+        for (int i = 0; i < 256; ++i) {
+            float s = float(i) / 255.f;
+            t.to_linear[i] = s <= 0.04045f
+                               ? s / 12.92f
+                               : std::pow((s + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < 4096; ++i) {
+            float l = float(i) / 4095.f;
+            float s = l <= 0.0031308f
+                        ? l * 12.92f
+                        : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+            t.from_linear[i] = uint8_t(std::lround(s * 255.f));
+        }
+        return t;
+    }();
+    return tables;
+}
+
+uint8_t
+quantize(float v, bool srgb)
+{
+    v = std::clamp(v, 0.f, 1.f);
+    if (srgb)
+        return srgbTables().from_linear[std::lround(v * 4095.f)];
+    return uint8_t(std::lround(v * 255.f));
+}
+
+// whether channel k is stored in sRGB, alpha never is
+bool
+isColor(uint32_t k, uint32_t channels)
+{
+    return !(channels == 4 && k == 3);
+}
+
+void
+boxRow(const uint8_t *r0,
+       const uint8_t *r1,
+       uint8_t *out,
+       uint32_t sw,
+       uint32_t dw,
+       uint32_t c)
+{
+    uint32_t x = 0;
+#if defined(__SSE2__)
+    // two RGBA output pixels from 16 bytes of each source row
+    if (c == 4) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for (; x + 2 <= dw && 2 * x + 4 <= sw; x += 2) {
+            auto a = _mm_loadu_si128(
+              reinterpret_cast<const __m128i *>(r0 + 8 * size_t(x)));
+            auto b = _mm_loadu_si128(
+              reinterpret_cast<const __m128i *>(r1 + 8 * size_t(x)));
+            auto lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                    _mm_unpacklo_epi8(b, zero));
+            auto hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                    _mm_unpackhi_epi8(b, zero));
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            auto sum = _mm_srli_epi16(
+              _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 4 * size_t(x)),
+                             _mm_packus_epi16(sum, sum));
+        }
+    }
+#endif
+    for (; x < dw; ++x) {
+        const size_t x0 = std::min(2 * x, sw - 1) * size_t(c);
+        const size_t x1 = std::min(2 * x + 1, sw - 1) * size_t(c);
+        for (uint32_t k = 0; k < c; ++k)
+            out[x * c + k] =
+              uint8_t((r0[x0 + k] + r0[x1 + k] + r1[x0 + k] + r1[x1 + k] + 2) >>
+                      2);
+    }
+}
+
+void
+boxRowSrgb(const uint8_t *r0,
+           const uint8_t *r1,
+           uint8_t *out,
+           uint32_t sw,
+           uint32_t dw,
+           uint32_t c)
+{
+    const auto &lin = srgbTables().to_linear;
+    for (uint32_t x = 0; x < dw; ++x) {
+        const size_t x0 = std::min(2 * x, sw - 1) * size_t(c);
+        const size_t x1 = std::min(2 * x + 1, sw - 1) * size_t(c);
+        for (uint32_t k = 0; k < c; ++k) {
+            if (isColor(k, c)) {
+                float sum = lin[r0[x0 + k]] + lin[r0[x1 + k]] +
+                            lin[r1[x0 + k]] + lin[r1[x1 + k]];
+                out[x * c + k] = quantize(sum * 0.25f, true);
+            } else {
+                out[x * c + k] = uint8_t(
+                  (r0[x0 + k] + r0[x1 + k] + r1[x0 + k] + r1[x1 + k] + 2) >> 2);
+            }
+        }
+    }
+}
+
+void
+boxDownsample(const Image &src, Image &dst, bool srgb)
+{
+    const auto c = src.channels;
+    for (uint32_t y = 0; y < dst.height; ++y) {
+        const auto *r0 =
+          src.pixels.data() + std::min(2 * y, src.height - 1) * src.rowSize();
+        const auto *r1 = src.pixels.data() +
+                         std::min(2 * y + 1, src.height - 1) * src.rowSize();
+        auto *out = dst.pixels.data() + y * dst.rowSize();
+        if (srgb)
+            boxRowSrgb(r0, r1, out, src.width, dst.width, c);
+        else
+            boxRow(r0, r1, out, src.width, dst.width, c);
+    }
+}
+
+float
+besselI0(float x)
+{
+    // power series, converges quickly for the small arguments used here
+    float sum = 1.f;
+    float term = 1.f;
+    const float q = x * x * 0.25f;
+    for (int k = 1; k < 32 && term > 1e-7f * sum; ++k) {
+        term *= q / float(k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+float
+kaiserWeight(float t)
+{
+    if (std::abs(t) >= KAISER_WIDTH)
+        return 0.f;
+    const float r = t / KAISER_WIDTH;
+    const float window = besselI0(KAISER_ALPHA * std::sqrt(1.f - r * r)) /
+                         besselI0(KAISER_ALPHA);
+    const float x = std::numbers::pi_v<float> * t;
+    const float sinc = t == 0.f ? 1.f : std::sin(x) / x;
+    return sinc * window;
+}
+
+// normalized weights of the source texels contributing to each destination
+// texel, indices clamped to the edge
+struct ResampleTaps
+{
+    uint32_t count{};
+    std::vector<uint32_t> index; // dst * count
+    std::vector<float> weight;   // dst * count
+};
+
+ResampleTaps
+kaiserTaps(uint32_t src, uint32_t dst)
+{
+    ResampleTaps taps;
+    const float scale = float(src) / float(dst);
+    const float radius = KAISER_WIDTH * scale;
+    taps.count = uint32_t(std::ceil(2 * radius)) + 1;
+    taps.index.resize(size_t(dst) * taps.count);
+    taps.weight.resize(size_t(dst) * taps.count);
+
+    for (uint32_t i = 0; i < dst; ++i) {
+        const float center = (float(i) + 0.5f) * scale;
+        const auto first = int64_t(std::floor(center - radius));
+        float sum = 0.f;
+        for (uint32_t j = 0; j < taps.count; ++j) {
+            const auto s = first + j;
+            const float w =
+              kaiserWeight((float(s) + 0.5f - center) / scale);
+            taps.index[i * taps.count + j] =
+              uint32_t(std::clamp<int64_t>(s, 0, int64_t(src) - 1));
+            taps.weight[i * taps.count + j] = w;
+            sum += w;
+        }
+        for (uint32_t j = 0; j < taps.count; ++j)
+            taps.weight[i * taps.count + j] /= sum;
+    }
+    return taps;
+}
+
+void
+kaiserDownsample(const Image &src, Image &dst, bool srgb)
+{
+    const auto c = src.channels;
+    const size_t sw = src.width, sh = src.height;
+    const size_t dw = dst.width, dh = dst.height;
+
+    auto in = std::vector<float>(src.size());
+    const auto &lin = srgbTables().to_linear;
+    for (size_t i = 0; i < in.size(); ++i) {
+        const auto v = src.pixels[i];
+        in[i] = srgb && isColor(uint32_t(i % c), c) ? lin[v] : float(v) / 255.f;
+    }
+
+    // horizontal pass: sw x sh -> dw x sh
+    const auto hx = kaiserTaps(src.width, dst.width);
+    auto tmp = std::vector<float>(dw * sh * c);
+    for (size_t y = 0; y < sh; ++y) {
+        const float *row = in.data() + y * sw * c;
+        float *out = tmp.data() + y * dw * c;
+        for (size_t x = 0; x < dw; ++x) {
+            for (uint32_t j = 0; j < hx.count; ++j) {
+                const float w = hx.weight[x * hx.count + j];
+                const float *p = row + size_t(hx.index[x * hx.count + j]) * c;
+                for (uint32_t k = 0; k < c; ++k)
+                    out[x * c + k] += w * p[k];
+            }
+        }
+    }
+
+    // vertical pass: dw x sh -> dw x dh, whole rows at a time
+    const auto hy = kaiserTaps(src.height, dst.height);
+    const size_t row_len = dw * c;
+    auto acc = std::vector<float>(row_len);
+    for (size_t y = 0; y < dh; ++y) {
+        std::fill(acc.begin(), acc.end(), 0.f);
+        for (uint32_t j = 0; j < hy.count; ++j) {
+            const float w = hy.weight[y * hy.count + j];
+            const float *row =
+              tmp.data() + size_t(hy.index[y * hy.count + j]) * row_len;
+            for (size_t i = 0; i < row_len; ++i)
+                acc[i] += w * row[i];
+        }
+        auto *out = dst.pixels.data() + y * dst.rowSize();
+        for (size_t i = 0; i < row_len; ++i)
+            out[i] = quantize(acc[i], srgb && isColor(uint32_t(i % c), c));
+    }
+}
+
+} // namespace
+
+void
+Image::resize(uint32_t w, uint32_t h, uint32_t c)
+{
+    width = w;
+    height = h;
+    channels = c;
+    pixels.resize(size());
+}
+
+bool
+decodeTGA(std::span<const char> data, Image &img, std::string &error)
+{
+    const auto *p = bytes(data);
+    const size_t size = data.size();
+    if (size < 18)
+        return fail(error, "truncated TGA header");
+
+    const uint8_t id_len = p[0];
+    const uint8_t cmap_type = p[1];
+    const uint8_t type = p[2];
+    const uint16_t cmap_len = le16(p + 5);
+    const uint8_t cmap_bits = p[7];
+    const uint16_t w = le16(p + 12);
+    const uint16_t h = le16(p + 14);
+    const uint8_t bpp = p[16];
+    const uint8_t desc = p[17];
+
+    if (type != 2 && type != 3 && type != 10 && type != 11)
+        return fail(error, "unsupported TGA image type, only true color and "
+                           "grayscale images are supported");
+    const bool rle = type >= 10;
+    const bool gray = type == 3 || type == 11;
+    if (gray ? bpp != 8 : bpp != 24 && bpp != 32)
+        return fail(error, "unsupported TGA pixel depth");
+    if (desc & 0x10)
+        return fail(error, "right to left TGA images are not supported");
+    if (w == 0 || h == 0 || w > MAX_IMAGE_SIZE || h > MAX_IMAGE_SIZE)
+        return fail(error, "invalid TGA image size");
+
+    size_t pos = 18 + size_t(id_len);
+    if (cmap_type != 0)
+        pos += size_t(cmap_len) * ((cmap_bits + 7u) / 8);
+    if (pos > size)
+        return fail(error, "truncated TGA file");
+
+    const uint32_t c = bpp / 8;
+    img.resize(w, h, c);
+    auto *out = img.pixels.data();
+    const size_t n = img.size();
+
+    if (!rle) {
+        if (size - pos < n)
+            return fail(error, "truncated TGA file");
+        memcpy(out, p + pos, n);
+    } else {
+        for (size_t i = 0; i < n;) {
+            if (pos >= size)
+                return fail(error, "truncated TGA file");
+            const uint8_t packet = p[pos++];
+            const size_t count = (packet & 0x7f) + 1u;
+            const size_t len = count * c;
+            if (len > n - i)
+                return fail(error, "corrupt TGA run length encoding");
+            if (packet & 0x80) {
+                if (size - pos < c)
+                    return fail(error, "truncated TGA file");
+                for (size_t k = 0; k < count; ++k)
+                    memcpy(out + i + k * c, p + pos, c);
+                pos += c;
+            } else {
+                if (size - pos < len)
+                    return fail(error, "truncated TGA file");
+                memcpy(out + i, p + pos, len);
+                pos += len;
+            }
+            i += len;
+        }
+    }
+
+    if (c >= 3)
+        swapRedBlue(img);
+    if (desc & 0x20) // origin in the upper left corner
+        flipRows(img);
+    return true;
+}
+
+bool
+decodeBMP(std::span<const char> data, Image &img, std::string &error)
+{
+    const auto *p = bytes(data);
+    const size_t size = data.size();
+    if (size < 54 || p[0] != 'B' || p[1] != 'M')
+        return fail(error, "not a BMP file");
+
+    const uint32_t offset = le32(p + 10);
+    const uint32_t header_size = le32(p + 14);
+    const auto w = int32_t(le32(p + 18));
+    const auto h = int32_t(le32(p + 22));
+    const uint16_t bpp = le16(p + 28);
+    const uint32_t compression = le32(p + 30);
+
+    if (header_size < 40)
+        return fail(error, "unsupported BMP header");
+    if (bpp != 24 && bpp != 32)
+        return fail(error, "unsupported BMP pixel depth, only 24 and 32 bit "
+                           "images are supported");
+    // BI_RGB, or BI_BITFIELDS for 32 bit
+    if (compression != 0 && !(compression == 3 && bpp == 32))
+        return fail(error, "compressed BMP files are not supported");
+
+    const bool top_down = h < 0;
+    const uint32_t height = top_down ? uint32_t(-int64_t(h)) : uint32_t(h);
+    if (w <= 0 || height == 0 || uint32_t(w) > MAX_IMAGE_SIZE ||
+        height > MAX_IMAGE_SIZE)
+        return fail(error, "invalid BMP image size");
+    const auto width = uint32_t(w);
+
+    uint32_t rmask = 0x00ff0000, gmask = 0x0000ff00, bmask = 0x000000ff;
+    uint32_t amask = 0xff000000;
+    if (compression == 3) {
+        if (size < 66)
+            return fail(error, "truncated BMP header");
+        rmask = le32(p + 54);
+        gmask = le32(p + 58);
+        bmask = le32(p + 62);
+        amask = header_size >= 56 && size >= 70 ? le32(p + 66) : 0;
+    }
+
+    const size_t stride = (size_t(width) * (bpp / 8) + 3) & ~size_t(3);
+    if (offset > size || (size - offset) / stride < height)
+        return fail(error, "truncated BMP file");
+
+    const uint32_t c = bpp == 24 ? 3 : 4;
+    img.resize(width, height, c);
+    bool has_alpha = false;
+    for (uint32_t y = 0; y < height; ++y) {
+        const auto *src = p + offset + y * stride;
+        auto *dst = img.pixels.data() +
+                    size_t(top_down ? height - 1 - y : y) * img.rowSize();
+        if (c == 3) {
+            for (uint32_t x = 0; x < width; ++x) {
+                dst[3 * x + 0] = src[3 * x + 2];
+                dst[3 * x + 1] = src[3 * x + 1];
+                dst[3 * x + 2] = src[3 * x + 0];
+            }
+            continue;
+        }
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t v = le32(src + 4 * x);
+            dst[4 * x + 0] = maskedChannel(v, rmask, 0);
+            dst[4 * x + 1] = maskedChannel(v, gmask, 0);
+            dst[4 * x + 2] = maskedChannel(v, bmask, 0);
+            dst[4 * x + 3] = maskedChannel(v, amask, 255);
+            has_alpha |= dst[4 * x + 3] != 0;
+        }
+    }
+
+    // most writers leave the fourth byte of BI_RGB pixels zero
+    if (c == 4 && !has_alpha)
+        for (size_t i = 3; i < img.pixels.size(); i += 4)
+            img.pixels[i] = 255;
+    return true;
+}
+
+void
+encodeBMP(const Image &img, std::vector<char> &out)
+{
+    const uint32_t bpp = img.channels == 4 ? 32 : 24;
+    const size_t stride = (size_t(img.width) * (bpp / 8) + 3) & ~size_t(3);
+    const size_t payload = stride * img.height;
+
+    out.assign(54 + payload, 0);
+    auto *p = reinterpret_cast<uint8_t *>(out.data());
+    p[0] = 'B';
+    p[1] = 'M';
+    put32(p + 2, uint32_t(out.size()));
+    put32(p + 10, 54);
+    put32(p + 14, 40);
+    put32(p + 18, img.width);
+    put32(p + 22, img.height); // positive: rows bottom up like Image
+    put16(p + 26, 1);
+    put16(p + 28, bpp);
+    put32(p + 34, uint32_t(payload));
+
+    const uint32_t c = img.channels;
+    for (uint32_t y = 0; y < img.height; ++y) {
+        const auto *src = img.pixels.data() + y * img.rowSize();
+        auto *dst = p + 54 + y * stride;
+        for (uint32_t x = 0; x < img.width; ++x, src += c) {
+            // BGR(A), luminance is replicated
+            const uint8_t r = src[0];
+            const uint8_t g = c >= 3 ? src[1] : r;
+            const uint8_t b = c >= 3 ? src[2] : r;
+            *dst++ = b;
+            *dst++ = g;
+            *dst++ = r;
+            if (bpp == 32)
+                *dst++ = src[3];
+        }
+    }
+}
+
+void
+downsample(const Image &src, Image &dst, MipmapFilter filter, bool srgb)
+{
+    dst.resize(std::max(src.width / 2, 1u),
+               std::max(src.height / 2, 1u),
+               src.channels);
+    switch (filter.value) {
+    case MipmapFilter::Box:
+        boxDownsample(src, dst, srgb);
+        return;
+    case MipmapFilter::Kaiser:
+        kaiserDownsample(src, dst, srgb);
+        return;
+    }
+}
+
+void
+generateMipmaps(const Image &base,
+                std::vector<Image> &levels,
+                MipmapFilter filter,
+                bool srgb)
+{
+    const auto largest = std::max(base.width, base.height);
+    levels.resize(largest == 0 ? 0 : std::bit_width(largest) - 1);
+    for (size_t i = 0; i < levels.size(); ++i)
+        downsample(i == 0 ? base : levels[i - 1], levels[i], filter, srgb);
+}
+
+} // namespace glt
@@ -0,0 +1,69 @@
+#ifndef GLT_IMAGE_HPP
+#define GLT_IMAGE_HPP
+
+#include "glt/conf.hpp"
+
+#include "pp/enum.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace glt {
+
+#define GLT_MIPMAP_FILTER_ENUM_DEF(T, V0, V)                                   \
+    T(MipmapFilter, uint8_t, V0(Box) V(Kaiser))
+
+PP_DEF_ENUM_WITH_API(GLT_API, GLT_MIPMAP_FILTER_ENUM_DEF);
+
+// 8 bits per channel, 1 (luminance), 3 (RGB) or 4 (RGBA) channels. Rows are
+// stored bottom up and tightly packed, the layout glTexImage2D expects with
+// GL_UNPACK_ALIGNMENT 1.
+struct GLT_API Image
+{
+    uint32_t width{};
+    uint32_t height{};
+    uint32_t channels{};
+    std::vector<uint8_t> pixels;
+
+    size_t rowSize() const { return size_t(width) * channels; }
+
+    size_t size() const { return rowSize() * height; }
+
+    void resize(uint32_t w, uint32_t h, uint32_t c);
+};
+
+// decodes a file in memory, sets error and returns false if it cant
+using ImageDecoder = bool (*)(std::span<const char> data,
+                              Image &img,
+                              std::string &error);
+
+// uncompressed and RLE encoded true color and grayscale TGA files
+GLT_API bool
+decodeTGA(std::span<const char> data, Image &img, std::string &error);
+
+// uncompressed 24 and 32 bit BMP files, 32 bit also with bit field masks
+GLT_API bool
+decodeBMP(std::span<const char> data, Image &img, std::string &error);
+
+// a 24 bit BMP file, 32 bit with BI_RGB alpha for 4 channels, readable by
+// decodeBMP()
+GLT_API void
+encodeBMP(const Image &img, std::vector<char> &out);
+
+// halves both sizes, rounding down but never below 1. With srgb the color
+// channels are averaged in linear space, alpha is always linear.
+GLT_API void
+downsample(const Image &src, Image &dst, MipmapFilter filter, bool srgb);
+
+// the mipmap chain below base, down to 1x1
+GLT_API void
+generateMipmaps(const Image &base,
+                std::vector<Image> &levels,
+                MipmapFilter filter,
+                bool srgb);
+
+} // namespace glt
+
+#endif
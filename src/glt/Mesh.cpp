@@ -1,5 +1,6 @@
 #include "glt/Mesh.hpp"
 
+#include "glt/GLStateCache.hpp"
 #include "glt/utils.hpp"
 #include "util/range.hpp"
 
@@ -7,6 +8,7 @@
 #    include <cstdlib>
 #endif
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
@@ -110,7 +112,7 @@ MeshBase::bind()
 {
     if (!vertex_array_name.valid())
         initVertexArray();
-    GL_CALL(glBindVertexArray, *vertex_array_name);
+    stateCache().bindVertexArray(*vertex_array_name);
 }
 
 void
@@ -134,6 +136,10 @@ MeshBase::initVertexAttribs()
     ASSERT(vertex_array_name.valid());
 
     for (const auto [i, a] : enumerate(struct_info.fields)) {
+        // packed formats always have 4 components, normalized maps integer
+        // components to [-1, 1] or [0, 1] and is ignored for float and half
+        ASSERT(a.type_info.scalar_type != ScalarType::I2_10_10_10_REV ||
+               a.type_info.arity == 4);
         GL_CALL(glVertexArrayVertexAttribOffsetEXT,
                 *vertex_array_name,
                 *vertex_buffer_name,
@@ -146,6 +152,28 @@ MeshBase::initVertexAttribs()
     }
 }
 
+void
+MeshBase::assign(std::span<const char> vertices, std::span<const uint32_t> elems)
+{
+    ASSERT(vertices.size() % struct_info.size == 0);
+    auto n = vertices.size() / struct_info.size;
+    auto cap = size_t(vertex_data_lim - vertex_data.get()) / struct_info.size;
+    if (n > cap) {
+        cap = std::max(cap, MIN_NUM_VERTICES);
+        while (cap < n)
+            cap *= 2;
+        vertex_data = realloc_vertex_buf(
+          std::move(vertex_data), struct_info.size, cap);
+        vertex_data_lim = vertex_data.get() + cap * struct_info.size;
+    }
+
+    if (!vertices.empty())
+        memcpy(vertex_data.get(), vertices.data(), vertices.size());
+    vertex_data_end = vertex_data.get() + vertices.size();
+    vertex_count = n;
+    elements.assign(elems.begin(), elems.end());
+}
+
 void
 MeshBase::primType(GLenum primType)
 {
@@ -168,6 +196,41 @@ MeshBase::send()
 
 void
 MeshBase::send(GLenum usageHint)
+{
+    if (vertex_count < 65536) {
+        short_elements.assign(elements.begin(), elements.end());
+        upload({ vertex_data.get(), vertex_count * struct_info.size },
+               short_elements.data(),
+               short_elements.size(),
+               GL_UNSIGNED_SHORT,
+               usageHint);
+    } else {
+        upload({ vertex_data.get(), vertex_count * struct_info.size },
+               elements.data(),
+               elements.size(),
+               GL_UNSIGNED_INT,
+               usageHint);
+    }
+}
+
+void
+MeshBase::sendExternal(std::span<const char> vertices,
+                       const void *elems,
+                       size_t num_elems,
+                       GLenum elem_type,
+                       GLenum usageHint)
+{
+    ASSERT(vertices.size() % struct_info.size == 0);
+    ASSERT(elem_type == GL_UNSIGNED_SHORT || elem_type == GL_UNSIGNED_INT);
+    upload(vertices, elems, num_elems, elem_type, usageHint);
+}
+
+void
+MeshBase::upload(std::span<const char> vertices,
+                 const void *elems,
+                 size_t num_elems,
+                 GLenum elem_type,
+                 GLenum usageHint)
 {
     validateUsageHint(usageHint);
 
@@ -179,26 +242,29 @@ MeshBase::send(GLenum usageHint)
 
     GL_CALL(glNamedBufferDataEXT,
             *vertex_buffer_name,
-            vertex_count * struct_info.size,
-            vertex_data.get(),
+            GLsizeiptr(vertices.size()),
+            vertices.data(),
             usageHint);
-    gpu_vertex_count = vertex_count;
+    gpu_vertex_count = vertices.size() / struct_info.size;
     initVertexAttribs();
 
-    if (!element_buffer_name.valid() && !elements.empty())
+    if (!element_buffer_name.valid() && num_elems > 0)
         element_buffer_name.ensure();
 
     if (element_buffer_name.valid()) {
+        auto elem_size =
+          elem_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
         GL_CALL(glNamedBufferDataEXT,
                 *element_buffer_name,
-                GLsizeiptr(elements.size() * sizeof(GLuint)),
-                elements.data(),
+                GLsizeiptr(num_elems * elem_size),
+                elems,
                 usageHint);
-        gpu_element_count = elements.size();
+        gpu_element_count = num_elems;
+        gpu_element_type = elem_type;
 
-        GL_CALL(glBindVertexArray, *vertex_array_name);
-        GL_CALL(glBindBuffer, GL_ELEMENT_ARRAY_BUFFER, *element_buffer_name);
-        GL_CALL(glBindVertexArray, 0);
+        stateCache().bindVertexArray(*vertex_array_name);
+        stateCache().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, *element_buffer_name);
+        stateCache().bindVertexArray(0);
     }
 }
 
@@ -227,28 +293,43 @@ MeshBase::enableAttributes()
         }
     }
 
-    GL_CALL(glBindVertexArray, *vertex_array_name);
+    stateCache().bindVertexArray(*vertex_array_name);
 }
 
 void
 MeshBase::disableAttributes()
 {
-    GL_CALL(glBindVertexArray, 0);
+    stateCache().bindVertexArray(0);
 }
 
 void
-MeshBase::drawElementsInstanced(size_t num, GLenum primType)
+MeshBase::drawElementsInstanced(size_t num,
+                                GLenum primType,
+                                uint32_t base_instance)
 {
     validatePrimType(primType);
     if (gpu_element_count == 0)
         return;
+    if (base_instance != 0 && !baseInstanceSupported()) {
+        ERR("base instances need GL 4.2 or ARB_base_instance");
+        return;
+    }
     enableAttributes();
-    GL_CALL(glDrawElementsInstanced,
-            primType,
-            GLsizei(gpu_element_count),
-            GL_UNSIGNED_INT,
-            nullptr,
-            GLsizei(num));
+    if (base_instance == 0)
+        GL_CALL(glDrawElementsInstanced,
+                primType,
+                GLsizei(gpu_element_count),
+                gpu_element_type,
+                nullptr,
+                GLsizei(num));
+    else
+        GL_CALL(glDrawElementsInstancedBaseInstance,
+                primType,
+                GLsizei(gpu_element_count),
+                gpu_element_type,
+                nullptr,
+                GLsizei(num),
+                base_instance);
     disableAttributes();
 }
 
@@ -262,7 +343,7 @@ MeshBase::drawElements(GLenum primType)
     GL_CALL(glDrawElements,
             primType,
             GLsizei(gpu_element_count),
-            GL_UNSIGNED_INT,
+            gpu_element_type,
             nullptr);
     disableAttributes();
 }
@@ -279,17 +360,31 @@ MeshBase::drawArrays(GLenum primType)
 }
 
 void
-MeshBase::drawArraysInstanced(size_t num, GLenum primType)
+MeshBase::drawArraysInstanced(size_t num,
+                              GLenum primType,
+                              uint32_t base_instance)
 {
     if (gpu_vertex_count == 0)
         return;
     validatePrimType(primType);
+    if (base_instance != 0 && !baseInstanceSupported()) {
+        ERR("base instances need GL 4.2 or ARB_base_instance");
+        return;
+    }
     enableAttributes();
-    GL_CALL(glDrawArraysInstanced,
-            primType,
-            0,
-            GLsizei(gpu_vertex_count),
-            GLsizei(num));
+    if (base_instance == 0)
+        GL_CALL(glDrawArraysInstanced,
+                primType,
+                0,
+                GLsizei(gpu_vertex_count),
+                GLsizei(num));
+    else
+        GL_CALL(glDrawArraysInstancedBaseInstance,
+                primType,
+                0,
+                GLsizei(gpu_vertex_count),
+                GLsizei(num),
+                base_instance);
     disableAttributes();
 }
 
@@ -307,14 +402,14 @@ MeshBase::draw(GLenum primType)
 }
 
 void
-MeshBase::drawInstanced(size_t num, GLenum primType)
+MeshBase::drawInstanced(size_t num, GLenum primType, uint32_t base_instance)
 {
     switch (draw_type) {
     case DrawArrays:
-        drawArraysInstanced(num, primType);
+        drawArraysInstanced(num, primType, base_instance);
         break;
     case DrawElements:
-        drawElementsInstanced(num, primType);
+        drawElementsInstanced(num, primType, base_instance);
         break;
     }
 }
@@ -357,6 +452,7 @@ MeshBase::freeHost()
     vertex_data_end = vertex_data_lim = nullptr;
     vertex_count = 0;
     elements.clear();
+    short_elements = {};
 }
 
 void
@@ -13,6 +13,7 @@
 #include "opengl.hpp"
 
 #include <memory>
+#include <span>
 #include <vector>
 
 namespace glt {
@@ -42,10 +43,13 @@ private:
     char *vertex_data_lim{};
     size_t vertex_count{};
     std::vector<uint32_t> elements;
+    // the elements narrowed to 16 bit by send(), kept to reuse the storage
+    std::vector<GLushort> short_elements;
     const StructInfo &struct_info;
     std::vector<bool> enabled_attributes;
     size_t gpu_vertex_count = 0;
     size_t gpu_element_count = 0;
+    GLenum gpu_element_type = GL_UNSIGNED_INT;
     GLVertexArrayObject vertex_array_name;
     GLBufferObject element_buffer_name;
     GLBufferObject vertex_buffer_name;
@@ -101,9 +105,32 @@ public:
     size_t verticesSize() const { return vertex_count; }
     size_t elementsSize() const { return elements.size(); }
 
+    const StructInfo &structInfo() const { return struct_info; }
+
+    // host side vertex data, verticesSize() * structInfo().size bytes
+    std::span<const char> vertexData() const
+    {
+        return { vertex_data.get(), vertex_count * struct_info.size };
+    }
+    std::span<char> vertexData()
+    {
+        return { vertex_data.get(), vertex_count * struct_info.size };
+    }
+
+    std::span<const uint32_t> elementData() const { return elements; }
+
+    // replaces the host side vertices and elements, vertices has to consist
+    // of whole vertices of this meshes type
+    void assign(std::span<const char> vertices,
+                std::span<const uint32_t> elems);
+
     size_t gpuVerticesSize() const { return gpu_vertex_count; }
     size_t gpuElementsSize() const { return gpu_element_count; }
 
+    // GL_UNSIGNED_SHORT if the mesh had less than 65536 vertices when it was
+    // sent, GL_UNSIGNED_INT otherwise
+    GLenum gpuElementType() const { return gpu_element_type; }
+
     DrawType drawType() const { return draw_type; }
     void drawType(DrawType type);
 
@@ -117,14 +144,27 @@ public:
     void send();
     void send(GLenum usageHint);
 
+    // uploads vertices and elements not owned by the mesh, e.g. a mapped
+    // mesh file, without copying them into the host side data.
+    // elem_type is GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+    void sendExternal(std::span<const char> vertices,
+                      const void *elems,
+                      size_t num_elems,
+                      GLenum elem_type,
+                      GLenum usageHint = GL_STATIC_DRAW);
+
     void drawElements() { drawElements(prim_type); }
     void drawElements(GLenum primType);
 
+    // the instanced draws drop draws with a nonzero base_instance unless
+    // GL 4.2 or ARB_base_instance is available
     void drawElementsInstanced(size_t instances)
     {
         drawElementsInstanced(instances, prim_type);
     }
-    void drawElementsInstanced(size_t num, GLenum type);
+    void drawElementsInstanced(size_t num,
+                               GLenum type,
+                               uint32_t base_instance = 0);
 
     void drawArrays() { drawArrays(prim_type); }
     void drawArrays(GLenum primType);
@@ -133,13 +173,17 @@ public:
     {
         drawArraysInstanced(num, prim_type);
     }
-    void drawArraysInstanced(size_t num, GLenum primType);
+    void drawArraysInstanced(size_t num,
+                             GLenum primType,
+                             uint32_t base_instance = 0);
 
     void draw() { draw(prim_type); }
     void draw(GLenum primType);
 
     void drawInstanced(size_t num) { drawInstanced(num, prim_type); }
-    void drawInstanced(size_t num, GLenum primType);
+    void drawInstanced(size_t num,
+                       GLenum primType,
+                       uint32_t base_instance = 0);
 
     void pushElement(uint32_t idx) { elements.push_back(idx); }
     uint32_t element(size_t i) const { return elements[i]; }
@@ -156,6 +200,11 @@ private:
     void initVertexBuffer();
     void initVertexArray();
     void initVertexAttribs();
+    void upload(std::span<const char> vertices,
+                const void *elems,
+                size_t num_elems,
+                GLenum elem_type,
+                GLenum usageHint);
     void free();
 };
 
@@ -0,0 +1,404 @@
+#include "glt/MeshCache.hpp"
+
+#include "err/err.hpp"
+#include "sys/fs.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace glt {
+
+namespace {
+
+inline constexpr char MESH_FILE_MAGIC[8] = "GLTMESH";
+
+struct Fnv1a
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    void bytes(const void *p, size_t n)
+    {
+        auto s = static_cast<const unsigned char *>(p);
+        for (size_t i = 0; i < n; ++i) {
+            h ^= s[i];
+            h *= 0x100000001b3ull;
+        }
+    }
+
+    template<typename T>
+    void value(T x)
+    {
+        bytes(&x, sizeof x);
+    }
+};
+
+// XXH64 structure: 4 independent lanes over 32 byte stripes, fast enough to
+// be checked on every load of large meshes
+inline constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+inline constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+inline constexpr uint64_t P3 = 0x165667B19E3779F9ull;
+inline constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ull;
+inline constexpr uint64_t P5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t
+rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t
+load64(const char *p)
+{
+    uint64_t x;
+    memcpy(&x, p, sizeof x);
+    return x;
+}
+
+inline uint64_t
+round64(uint64_t acc, uint64_t input)
+{
+    acc += input * P2;
+    return rotl(acc, 31) * P1;
+}
+
+inline uint64_t
+merge64(uint64_t acc, uint64_t lane)
+{
+    acc ^= round64(0, lane);
+    return acc * P1 + P4;
+}
+
+uint64_t
+checksum64(std::span<const char> data, uint64_t seed)
+{
+    auto p = data.data();
+    auto n = data.size();
+    uint64_t h;
+
+    if (n >= 32) {
+        uint64_t v[4] = { seed + P1 + P2, seed + P2, seed, seed - P1 };
+        for (; n >= 32; p += 32, n -= 32)
+            for (size_t i = 0; i < 4; ++i)
+                v[i] = round64(v[i], load64(p + 8 * i));
+        h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+        for (auto lane : v)
+            h = merge64(h, lane);
+    } else {
+        h = seed + P5;
+    }
+
+    h += data.size();
+    for (; n >= 8; p += 8, n -= 8)
+        h = rotl(h ^ round64(0, load64(p)), 27) * P1 + P4;
+    for (; n > 0; ++p, --n)
+        h = rotl(h ^ (uint64_t(uint8_t(*p)) * P5), 11) * P1;
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+constexpr uint64_t
+alignUp(uint64_t x)
+{
+    return (x + MESH_FILE_ALIGNMENT - 1) & ~uint64_t(MESH_FILE_ALIGNMENT - 1);
+}
+
+uint64_t
+sectionsChecksum(std::span<const char> vertices,
+                 std::span<const char> elements)
+{
+    return checksum64(elements, checksum64(vertices, 0));
+}
+
+template<typename T>
+bool
+elementsInRange(const char *data, uint64_t count, uint64_t vertex_count)
+{
+    for (uint64_t i = 0; i < count; ++i) {
+        T idx;
+        memcpy(&idx, data + i * sizeof idx, sizeof idx);
+        if (idx >= vertex_count)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+uint64_t
+structFingerprint(const StructInfo &si)
+{
+    Fnv1a h;
+    h.value(si.size);
+    h.value(si.align);
+    h.value(uint32_t(si.fields.size()));
+    for (const auto &f : si.fields) {
+        h.bytes(f.name, strlen(f.name) + 1);
+        h.value(f.type_info.scalar_type.numeric());
+        h.value(f.type_info.arity);
+        h.value(uint8_t(f.type_info.normalized));
+        h.value(uint16_t(f.type_info.size));
+        h.value(f.offset);
+    }
+    return h.h;
+}
+
+bool
+writeMeshFile(const std::string &path, const MeshBase &mesh, bool checksum)
+{
+    const auto &si = mesh.structInfo();
+    auto vertices = mesh.vertexData();
+    auto elements = mesh.elementData();
+
+    std::vector<uint16_t> short_elements;
+    std::span<const char> element_bytes{
+        reinterpret_cast<const char *>(elements.data()), elements.size_bytes()
+    };
+    uint32_t element_size = sizeof(uint32_t);
+    if (mesh.verticesSize() < 65536) {
+        short_elements.assign(elements.begin(), elements.end());
+        element_size = sizeof(uint16_t);
+        element_bytes = { reinterpret_cast<const char *>(short_elements.data()),
+                          short_elements.size() * sizeof(uint16_t) };
+    }
+
+    MeshFileHeader hdr{};
+    memcpy(hdr.magic, MESH_FILE_MAGIC, sizeof hdr.magic);
+    hdr.version = MESH_FILE_VERSION;
+    hdr.fingerprint = structFingerprint(si);
+    hdr.vertex_size = si.size;
+    hdr.element_size = element_size;
+    hdr.prim_type = mesh.primType();
+    hdr.draw_type = mesh.drawType();
+    hdr.vertex_count = mesh.verticesSize();
+    hdr.element_count = elements.size();
+    hdr.vertex_offset = alignUp(sizeof hdr);
+    hdr.element_offset = alignUp(hdr.vertex_offset + vertices.size());
+    if (checksum) {
+        hdr.flags |= MESH_FILE_CHECKSUM;
+        hdr.checksum = sectionsChecksum(vertices, element_bytes);
+    }
+
+    static const char zeros[MESH_FILE_ALIGNMENT]{};
+    const std::span<const char> parts[] = {
+        { reinterpret_cast<const char *>(&hdr), sizeof hdr },
+        { zeros, hdr.vertex_offset - sizeof hdr },
+        vertices,
+        { zeros, hdr.element_offset - hdr.vertex_offset - vertices.size() },
+        element_bytes,
+    };
+
+    // write to a temporary first, readers either see the old or the new file
+    auto tmp_path = path + ".tmp";
+    {
+        auto res = sys::io::HandleStream::open(tmp_path, sys::io::HM_WRITE);
+        if (!res) {
+            ERR("couldnt open file: " + tmp_path);
+            return false;
+        }
+        auto out = std::move(res).value();
+        for (auto part : parts) {
+            auto [n, ret] = out.write(part);
+            if (ret != sys::io::StreamResult::OK || n != part.size()) {
+                ERR("failed to write mesh file: " + tmp_path);
+                out.close();
+                std::remove(tmp_path.c_str());
+                return false;
+            }
+        }
+        auto flushed = out.flush();
+        out.close();
+        if (flushed != sys::io::StreamResult::OK) {
+            ERR("failed to write mesh file: " + tmp_path);
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        ERR("couldnt rename " + tmp_path + " to " + path);
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool
+MeshFile::open(const std::string &path,
+               const StructInfo &si,
+               bool verify_checksum)
+{
+    close();
+
+    auto res = sys::io::mapFile(path);
+    if (!res)
+        return false;
+    auto file = std::move(res).value();
+    auto data = file.data();
+
+    if (data.size() < sizeof(MeshFileHeader)) {
+        WARN("not a mesh file: " + path);
+        return false;
+    }
+
+    // the mapping is page aligned, the header can be accessed in place
+    auto hdr = reinterpret_cast<const MeshFileHeader *>(data.data());
+    if (memcmp(hdr->magic, MESH_FILE_MAGIC, sizeof hdr->magic) != 0 ||
+        hdr->version != MESH_FILE_VERSION) {
+        WARN("not a mesh file or unsupported version: " + path);
+        return false;
+    }
+
+    if (hdr->fingerprint != structFingerprint(si) ||
+        hdr->vertex_size != si.size) {
+        WARN("mesh file has a different vertex type: " + path);
+        return false;
+    }
+
+    const uint64_t size = data.size();
+    bool valid =
+      (hdr->element_size == 2 || hdr->element_size == 4) &&
+      hdr->draw_type <= DrawElements &&
+      hdr->vertex_offset % MESH_FILE_ALIGNMENT == 0 &&
+      hdr->element_offset % MESH_FILE_ALIGNMENT == 0 &&
+      hdr->vertex_offset >= sizeof(MeshFileHeader) &&
+      hdr->vertex_offset <= size &&
+      hdr->vertex_count <= (size - hdr->vertex_offset) / hdr->vertex_size &&
+      hdr->element_offset >=
+        hdr->vertex_offset + hdr->vertex_count * hdr->vertex_size &&
+      hdr->element_offset <= size &&
+      hdr->element_count <= (size - hdr->element_offset) / hdr->element_size;
+    if (!valid) {
+        WARN("corrupt mesh file: " + path);
+        return false;
+    }
+
+    // a bad index would make the GPU read past the vertex buffer
+    const auto *elems = data.data() + hdr->element_offset;
+    if (hdr->element_size == 2
+          ? !elementsInRange<uint16_t>(
+              elems, hdr->element_count, hdr->vertex_count)
+          : !elementsInRange<uint32_t>(
+              elems, hdr->element_count, hdr->vertex_count)) {
+        WARN("mesh file has elements out of range: " + path);
+        return false;
+    }
+
+    _file = std::move(file);
+    _header = hdr;
+
+    if (verify_checksum && (hdr->flags & MESH_FILE_CHECKSUM) != 0) {
+        std::span<const char> elems{ static_cast<const char *>(elementData()),
+                                     elementsSize() * hdr->element_size };
+        if (sectionsChecksum(vertexData(), elems) != hdr->checksum) {
+            WARN("mesh file checksum mismatch: " + path);
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+MeshFile::close()
+{
+    _header = nullptr;
+    _file = {};
+}
+
+GLenum
+MeshFile::elementType() const
+{
+    return _header->element_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+std::span<const char>
+MeshFile::vertexData() const
+{
+    return _file.data().subspan(_header->vertex_offset,
+                                _header->vertex_count * _header->vertex_size);
+}
+
+const void *
+MeshFile::elementData() const
+{
+    return _file.data().data() + _header->element_offset;
+}
+
+void
+MeshFile::send(MeshBase &mesh, GLenum usageHint) const
+{
+    ASSERT(isOpen());
+    mesh.primType(primType());
+    mesh.drawType(drawType());
+    mesh.sendExternal(
+      vertexData(), elementData(), elementsSize(), elementType(), usageHint);
+}
+
+void
+MeshFile::load(MeshBase &mesh) const
+{
+    ASSERT(isOpen());
+    std::vector<uint32_t> elems(elementsSize());
+    if (_header->element_size == 2) {
+        std::vector<uint16_t> short_elems(elementsSize());
+        memcpy(short_elems.data(),
+               elementData(),
+               short_elems.size() * sizeof(uint16_t));
+        elems.assign(short_elems.begin(), short_elems.end());
+    } else {
+        memcpy(elems.data(), elementData(), elems.size() * sizeof(uint32_t));
+    }
+    mesh.assign(vertexData(), elems);
+    mesh.primType(primType());
+    mesh.drawType(drawType());
+}
+
+std::string
+MeshCache::path(std::string_view name) const
+{
+    auto file = std::string(name) + ".mesh";
+    return sys::fs::join(_dir, file.c_str());
+}
+
+bool
+MeshCache::load(std::string_view name,
+                MeshBase &mesh,
+                std::string_view source) const
+{
+    if (!enabled())
+        return false;
+
+    auto file_path = path(name);
+    auto mtime = sys::fs::modificationTime(file_path);
+    if (!mtime)
+        return false;
+
+    if (!source.empty()) {
+        auto src_mtime = sys::fs::modificationTime(source);
+        if (!src_mtime || *mtime < *src_mtime)
+            return false;
+    }
+
+    MeshFile file;
+    if (!file.open(file_path, mesh.structInfo(), verify_checksums))
+        return false;
+    file.send(mesh);
+    return true;
+}
+
+bool
+MeshCache::store(std::string_view name, const MeshBase &mesh) const
+{
+    if (!enabled())
+        return false;
+    return writeMeshFile(path(name), mesh);
+}
+
+} // namespace glt
@@ -0,0 +1,147 @@
+#ifndef GLT_MESH_CACHE_HPP
+#define GLT_MESH_CACHE_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/Mesh.hpp"
+#include "glt/type_info.hpp"
+#include "sys/io.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace glt {
+
+// Binary mesh files: a fixed size header followed by the vertex and element
+// sections, both 64 byte aligned and stored exactly as they are uploaded to
+// the GPU, so a mapped file can be sent without any conversion. All values
+// are in host byte order, files of the other byte order fail the version
+// check.
+
+inline constexpr uint32_t MESH_FILE_VERSION = 1;
+inline constexpr size_t MESH_FILE_ALIGNMENT = 64;
+
+inline constexpr uint32_t MESH_FILE_CHECKSUM = 1; // checksum field is valid
+
+struct MeshFileHeader
+{
+    char magic[8];         // "GLTMESH"
+    uint32_t version;      // MESH_FILE_VERSION
+    uint32_t flags;        // MESH_FILE_*
+    uint64_t fingerprint;  // structFingerprint() of the vertex type
+    uint32_t vertex_size;  // bytes per vertex
+    uint32_t element_size; // 2 or 4
+    uint32_t prim_type;
+    uint32_t draw_type;
+    uint64_t vertex_count;
+    uint64_t element_count;
+    uint64_t vertex_offset;  // from the start of the file
+    uint64_t element_offset; // from the start of the file
+    uint64_t checksum;       // over both sections
+    uint8_t reserved[48];
+};
+
+static_assert(sizeof(MeshFileHeader) == 128);
+
+// hash of the layout of a vertex type: size, alignment and for every field
+// its name, type and offset
+GLT_API uint64_t
+structFingerprint(const StructInfo &si);
+
+// writes the host side data of mesh, elements are stored as 16 bit indices
+// if there are less than 65536 vertices. The file is replaced atomically.
+GLT_API bool
+writeMeshFile(const std::string &path,
+              const MeshBase &mesh,
+              bool checksum = true);
+
+// a mapped mesh file
+struct GLT_API MeshFile
+{
+    sys::io::MappedFile _file;
+    const MeshFileHeader *_header{};
+
+    // fails if the file is not a valid mesh file with vertices of type si or
+    // if an element indexes past the last vertex
+    bool open(const std::string &path,
+              const StructInfo &si,
+              bool verify_checksum = false);
+
+    void close();
+
+    bool isOpen() const { return _header != nullptr; }
+
+    GLenum primType() const { return GLenum(_header->prim_type); }
+
+    DrawType drawType() const { return DrawType(_header->draw_type); }
+
+    size_t verticesSize() const { return _header->vertex_count; }
+
+    size_t elementsSize() const { return _header->element_count; }
+
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum elementType() const;
+
+    std::span<const char> vertexData() const;
+
+    const void *elementData() const;
+
+    // uploads the mapped sections directly, the host side data of mesh is
+    // not touched
+    void send(MeshBase &mesh, GLenum usageHint = GL_STATIC_DRAW) const;
+
+    // copies the file into the host side data of mesh
+    void load(MeshBase &mesh) const;
+};
+
+// Directory of mesh files, addressed by name. An entry can be tied to a
+// source file, it is considered stale if the source was modified after the
+// entry was written.
+struct GLT_API MeshCache
+{
+    std::string _dir;
+    bool verify_checksums = false;
+
+    MeshCache() = default;
+    explicit MeshCache(std::string dir) : _dir(std::move(dir)) {}
+
+    const std::string &directory() const { return _dir; }
+    void directory(std::string dir) { _dir = std::move(dir); }
+
+    bool enabled() const { return !_dir.empty(); }
+
+    std::string path(std::string_view name) const;
+
+    // sends the cached entry to the GPU without copying it into the host
+    // side data of mesh, fails if the entry is missing, stale or of another
+    // vertex type
+    bool load(std::string_view name,
+              MeshBase &mesh,
+              std::string_view source = {}) const;
+
+    bool store(std::string_view name, const MeshBase &mesh) const;
+
+    // loads name from the cache, otherwise lets build fill the host side
+    // data of mesh, stores and sends it
+    template<typename F>
+    bool loadOrBuild(std::string_view name,
+                     MeshBase &mesh,
+                     F &&build,
+                     std::string_view source = {}) const
+    {
+        if (load(name, mesh, source))
+            return true;
+        if (!build(mesh))
+            return false;
+        if (enabled())
+            store(name, mesh);
+        mesh.send();
+        return true;
+    }
+};
+
+} // namespace glt
+
+#endif
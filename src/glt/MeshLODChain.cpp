@@ -0,0 +1,121 @@
+#include "glt/MeshLODChain.hpp"
+
+#include "err/err.hpp"
+#include "glt/GeometryTransform.hpp"
+#include "glt/RenderTarget.hpp"
+#include "math/vec4.hpp"
+
+#include <cstring>
+#include <limits>
+
+namespace glt {
+
+float
+projectedRadius(const GeometryTransform &gt,
+                const math::vec3_t &center,
+                float radius,
+                const Viewport &vp)
+{
+    math::vec3_t ec = gt.transformPoint(center);
+
+    // near upper right corner of the frustum (view coordinates)
+    math::vec4_t nur =
+      gt.inverseProjectionMatrix() * math::vec4(-1.f, -1.f, -1.f, 1.f);
+    if (nur[3] != 0.f)
+        nur /= nur[3];
+
+    float x_max = math::abs(nur[0]);
+    float y_max = math::abs(nur[1]);
+    float z_min = math::abs(nur[2]);
+    float dist = math::abs(ec[2]);
+
+    if (dist <= z_min)
+        return std::numeric_limits<float>::infinity();
+
+    // radius relative to the half extent of the near plane
+    float r_proj = radius / dist * z_min / math::min(x_max, y_max);
+    return r_proj * 0.5f * float(std::min(vp.width, vp.height));
+}
+
+size_t
+MeshLODChainBase::selectLevel(float screen_radius) const
+{
+    ASSERT(!_levels.empty());
+    if (!(_radius > 0.f))
+        return 0;
+
+    const float px_per_unit = screen_radius / _radius;
+    size_t lvl = 0;
+    while (lvl + 1 < _levels.size() &&
+           _levels[lvl + 1].error * px_per_unit <= pixel_error)
+        ++lvl;
+    return lvl;
+}
+
+void
+MeshLODChainBase::initLevels(const MeshBase &base)
+{
+    _levels.clear();
+    auto tris = base.drawType() == DrawElements ? base.elementsSize()
+                                                : base.verticesSize();
+    _levels.push_back({ tris / 3, 0.f });
+
+    _center = math::vec3(0.f);
+    _radius = 0.f;
+
+    const auto &si = base.structInfo();
+    const FieldInfo *pf = nullptr;
+    for (const auto &f : si.fields)
+        if (strcmp(f.name, options.position_field) == 0)
+            pf = &f;
+    if (pf == nullptr || pf->type_info.scalar_type != ScalarType::F32 ||
+        pf->type_info.arity < 3) {
+        WARN("MeshLODChain: no float position field, bounds unknown");
+        return;
+    }
+
+    auto vdata = base.vertexData();
+    auto load = [&](size_t v) {
+        float xyz[3];
+        memcpy(xyz, &vdata[v * si.size + pf->offset], sizeof xyz);
+        return math::vec3(xyz[0], xyz[1], xyz[2]);
+    };
+
+    const auto n = base.verticesSize();
+    if (n == 0)
+        return;
+
+    auto lo = load(0), hi = lo;
+    for (size_t v = 1; v < n; ++v) {
+        auto p = load(v);
+        lo = math::min(lo, p);
+        hi = math::max(hi, p);
+    }
+
+    _center = (lo + hi) * 0.5f;
+    for (size_t v = 0; v < n; ++v)
+        _radius = math::max(_radius, math::distance(_center, load(v)));
+}
+
+bool
+MeshLODChainBase::simplifyLevel(const MeshBase &prev,
+                                MeshBase &next,
+                                size_t target_triangles)
+{
+    next.assign(prev.vertexData(), prev.elementData());
+    next.drawType(prev.drawType());
+
+    MeshSimplifier simplifier;
+    simplifier.options = options;
+    simplifier.options.target_triangles = target_triangles;
+    auto res = simplifier.simplify(next);
+
+    // less than 10% saved is not worth another level
+    if (res.triangles * 10 > _levels.back().triangles * 9)
+        return false;
+
+    _levels.push_back({ res.triangles, _levels.back().error + res.error });
+    return true;
+}
+
+} // namespace glt
@@ -0,0 +1,120 @@
+#ifndef GLT_MESH_LOD_CHAIN_HPP
+#define GLT_MESH_LOD_CHAIN_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/Mesh.hpp"
+#include "glt/MeshSimplifier.hpp"
+#include "math/vec3.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace glt {
+
+struct GeometryTransform;
+struct Viewport;
+
+// radius in pixels of the projection of a sphere given in model coordinates
+// of the current geometry transform
+GLT_API float
+projectedRadius(const GeometryTransform &gt,
+                const math::vec3_t &center,
+                float radius,
+                const Viewport &vp);
+
+struct MeshLODLevel
+{
+    size_t triangles{};
+    float error{}; // deviation from level 0, model units
+};
+
+// Levels of detail of a mesh, level 0 has full detail. A level is selected
+// by how large its simplification error appears on screen, see
+// selectLevel().
+struct GLT_API MeshLODChainBase
+{
+    // largest acceptable error on screen, in pixels
+    float pixel_error = 1.f;
+    // used to generate the levels, target_triangles is set per level
+    SimplifyOptions options;
+
+    std::vector<MeshLODLevel> _levels;
+    math::vec3_t _center{};
+    float _radius{}; // bounding sphere of level 0
+
+    size_t levels() const { return _levels.size(); }
+
+    const MeshLODLevel &level(size_t i) const { return _levels[i]; }
+
+    const math::vec3_t &center() const { return _center; }
+
+    float radius() const { return _radius; }
+
+    // the coarsest level whose error stays below pixel_error for a
+    // bounding sphere projected to screen_radius pixels
+    size_t selectLevel(float screen_radius) const;
+
+protected:
+    void initLevels(const MeshBase &base);
+
+    // fills next with prev simplified to about target_triangles, returns
+    // false if the triangle count could not be reduced noticeably
+    bool simplifyLevel(const MeshBase &prev,
+                       MeshBase &next,
+                       size_t target_triangles);
+};
+
+template<typename T>
+struct MeshLODChain : public MeshLODChainBase
+{
+    std::vector<std::unique_ptr<Mesh<T>>> _meshes;
+
+    // level 0 is a copy of base, every further level has about reduction
+    // times the triangles of the previous one
+    void build(const Mesh<T> &base,
+               size_t max_levels,
+               float reduction = 0.5f,
+               size_t min_triangles = 16)
+    {
+        clear();
+        auto m0 = std::make_unique<Mesh<T>>(base.primType());
+        m0->assign(base.vertexData(), base.elementData());
+        m0->drawType(base.drawType());
+        initLevels(*m0);
+        _meshes.push_back(std::move(m0));
+
+        while (_meshes.size() < max_levels) {
+            auto target = size_t(float(_levels.back().triangles) * reduction);
+            if (target < min_triangles)
+                break;
+            auto next = std::make_unique<Mesh<T>>(base.primType());
+            if (!simplifyLevel(*_meshes.back(), *next, target))
+                break;
+            _meshes.push_back(std::move(next));
+        }
+    }
+
+    Mesh<T> &mesh(size_t i) { return *_meshes[i]; }
+
+    Mesh<T> &select(float screen_radius)
+    {
+        return mesh(selectLevel(screen_radius));
+    }
+
+    void send()
+    {
+        for (auto &m : _meshes)
+            m->send();
+    }
+
+    void clear()
+    {
+        _meshes.clear();
+        _levels.clear();
+    }
+};
+
+} // namespace glt
+
+#endif
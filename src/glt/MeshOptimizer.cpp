@@ -0,0 +1,396 @@
+#include "glt/MeshOptimizer.hpp"
+
+#include "err/err.hpp"
+#include "glt/Mesh.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace glt {
+
+namespace {
+
+inline constexpr uint32_t NO_VERTEX = ~uint32_t(0);
+
+uint64_t
+hashCombine(uint64_t h, uint64_t x)
+{
+    h ^= x + UINT64_C(0x9e3779b97f4a7c15) + (h << 6) + (h >> 2);
+    return h;
+}
+
+uint64_t
+hashBytes(uint64_t h, const char *p, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        h = (h ^ uint8_t(p[i])) * UINT64_C(0x100000001b3);
+    return h;
+}
+
+int64_t
+snap(double x, float epsilon)
+{
+    return int64_t(std::llround(x / double(epsilon)));
+}
+
+template<typename T>
+T
+loadScalar(const char *p)
+{
+    T x;
+    memcpy(&x, p, sizeof x);
+    return x;
+}
+
+bool
+snapsField(const FieldInfo &f, float epsilon)
+{
+    return epsilon > 0.f && (f.type_info.scalar_type == ScalarType::F32 ||
+                             f.type_info.scalar_type == ScalarType::F64);
+}
+
+double
+loadComponent(const FieldInfo &f, const char *v, size_t c)
+{
+    const auto *p = v + f.offset;
+    if (f.type_info.scalar_type == ScalarType::F32)
+        return loadScalar<float>(p + c * sizeof(float));
+    return loadScalar<double>(p + c * sizeof(double));
+}
+
+uint64_t
+hashVertex(const StructInfo &si, const char *v, float epsilon)
+{
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    for (const auto &f : si.fields) {
+        if (snapsField(f, epsilon)) {
+            for (size_t c = 0; c < f.type_info.arity; ++c)
+                h = hashCombine(
+                  h, uint64_t(snap(loadComponent(f, v, c), epsilon)));
+        } else {
+            h = hashBytes(h, v + f.offset, f.type_info.size);
+        }
+    }
+    return h;
+}
+
+bool
+equalVertices(const StructInfo &si,
+              const char *a,
+              const char *b,
+              float epsilon)
+{
+    for (const auto &f : si.fields) {
+        if (snapsField(f, epsilon)) {
+            for (size_t c = 0; c < f.type_info.arity; ++c)
+                if (snap(loadComponent(f, a, c), epsilon) !=
+                    snap(loadComponent(f, b, c), epsilon))
+                    return false;
+        } else if (memcmp(a + f.offset, b + f.offset, f.type_info.size) !=
+                   0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Forsyth, "Linear-Speed Vertex Cache Optimisation"
+inline constexpr float CACHE_DECAY_POWER = 1.5f;
+inline constexpr float LAST_TRI_SCORE = 0.75f;
+inline constexpr float VALENCE_BOOST_SCALE = 2.f;
+inline constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+float
+vertexScore(int cache_pos, uint32_t remaining, size_t cache_size)
+{
+    if (remaining == 0)
+        return -1.f;
+
+    float score = 0.f;
+    if (cache_pos >= 0) {
+        if (cache_pos < 3) {
+            score = LAST_TRI_SCORE;
+        } else {
+            auto scale = 1.f / float(cache_size - 3);
+            score = std::pow(1.f - float(cache_pos - 3) * scale,
+                             CACHE_DECAY_POWER);
+        }
+    }
+
+    return score + VALENCE_BOOST_SCALE *
+                     std::pow(float(remaining), -VALENCE_BOOST_POWER);
+}
+
+} // namespace
+
+VertexCacheStatistics
+analyzeVertexCache(std::span<const uint32_t> indices,
+                   size_t vertex_count,
+                   size_t cache_size)
+{
+    VertexCacheStatistics stats;
+    if (indices.empty() || vertex_count == 0)
+        return stats;
+
+    // a vertex is in the FIFO if fewer than cache_size misses happened
+    // since it was loaded
+    std::vector<size_t> loaded(vertex_count, 0);
+    std::vector<bool> referenced(vertex_count, false);
+    size_t time = cache_size + 1;
+    size_t misses = 0;
+    size_t unique = 0;
+
+    for (auto i : indices) {
+        ASSERT(i < vertex_count);
+        if (time - loaded[i] > cache_size) {
+            loaded[i] = time++;
+            ++misses;
+        }
+        if (!referenced[i]) {
+            referenced[i] = true;
+            ++unique;
+        }
+    }
+
+    stats.acmr = double(misses) / double(indices.size() / 3);
+    stats.atvr = double(misses) / double(unique);
+    return stats;
+}
+
+size_t
+weldVertices(const StructInfo &si,
+             std::vector<char> &vertices,
+             std::vector<uint32_t> &indices,
+             float epsilon)
+{
+    const size_t vsize = si.size;
+    const size_t n = vertices.size() / vsize;
+
+    size_t cap = 16;
+    while (cap < 2 * n)
+        cap *= 2;
+
+    std::vector<uint32_t> table(cap, NO_VERTEX);
+    std::vector<uint32_t> remap(n);
+    std::vector<char> welded;
+    welded.reserve(vertices.size());
+    uint32_t count = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        const char *v = &vertices[i * vsize];
+        auto slot = size_t(hashVertex(si, v, epsilon)) & (cap - 1);
+        for (;;) {
+            auto id = table[slot];
+            if (id == NO_VERTEX) {
+                table[slot] = count;
+                remap[i] = count++;
+                welded.insert(welded.end(), v, v + vsize);
+                break;
+            }
+            if (equalVertices(si, &welded[id * vsize], v, epsilon)) {
+                remap[i] = id;
+                break;
+            }
+            slot = (slot + 1) & (cap - 1);
+        }
+    }
+
+    for (auto &idx : indices)
+        idx = remap[idx];
+    vertices = std::move(welded);
+    return count;
+}
+
+void
+optimizeVertexCache(std::span<uint32_t> indices,
+                    size_t vertex_count,
+                    size_t cache_size)
+{
+    ASSERT(indices.size() % 3 == 0);
+    ASSERT(cache_size > 3);
+    const size_t ntris = indices.size() / 3;
+    if (ntris == 0)
+        return;
+
+    // triangles adjacent to each vertex, the first remaining[v] entries of
+    // a vertex are the not yet emitted ones
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    for (auto i : indices)
+        ++remaining[i];
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    std::partial_sum(remaining.begin(), remaining.end(), offsets.begin() + 1);
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < ntris; ++t)
+            for (size_t k = 0; k < 3; ++k)
+                adjacency[fill[indices[3 * t + k]]++] = uint32_t(t);
+    }
+
+    std::vector<int> cache_pos(vertex_count, -1);
+    std::vector<float> vscore(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+        vscore[v] = vertexScore(-1, remaining[v], cache_size);
+
+    std::vector<float> tscore(ntris);
+    for (size_t t = 0; t < ntris; ++t)
+        tscore[t] = vscore[indices[3 * t]] + vscore[indices[3 * t + 1]] +
+                    vscore[indices[3 * t + 2]];
+
+    std::vector<bool> emitted(ntris, false);
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    std::vector<uint32_t> cache, next_cache;
+    cache.reserve(cache_size + 3);
+    next_cache.reserve(cache_size + 3);
+
+    size_t next_unemitted = 0;
+    int64_t best = -1;
+
+    for (size_t emitted_count = 0; emitted_count < ntris; ++emitted_count) {
+        if (best < 0) {
+            // dead end: continue with the next triangle in input order
+            while (emitted[next_unemitted])
+                ++next_unemitted;
+            best = int64_t(next_unemitted);
+        }
+
+        const auto t = size_t(best);
+        emitted[t] = true;
+        const uint32_t tri[3] = { indices[3 * t],
+                                  indices[3 * t + 1],
+                                  indices[3 * t + 2] };
+
+        for (auto v : tri) {
+            out.push_back(v);
+            auto *adj = &adjacency[offsets[v]];
+            for (uint32_t k = 0; k < remaining[v]; ++k) {
+                if (adj[k] == t) {
+                    std::swap(adj[k], adj[remaining[v] - 1]);
+                    --remaining[v];
+                    break;
+                }
+            }
+        }
+
+        next_cache.clear();
+        next_cache.insert(next_cache.end(), tri, tri + 3);
+        for (auto v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                next_cache.push_back(v);
+        cache.swap(next_cache);
+
+        for (size_t k = 0; k < cache.size(); ++k) {
+            auto v = cache[k];
+            cache_pos[v] = k < cache_size ? int(k) : -1;
+            auto score = vertexScore(cache_pos[v], remaining[v], cache_size);
+            auto delta = score - vscore[v];
+            vscore[v] = score;
+            for (uint32_t a = 0; a < remaining[v]; ++a)
+                tscore[adjacency[offsets[v] + a]] += delta;
+        }
+
+        if (cache.size() > cache_size)
+            cache.resize(cache_size);
+
+        best = -1;
+        float best_score = -1.f;
+        for (auto v : cache) {
+            for (uint32_t a = 0; a < remaining[v]; ++a) {
+                auto cand = adjacency[offsets[v] + a];
+                if (tscore[cand] > best_score) {
+                    best_score = tscore[cand];
+                    best = int64_t(cand);
+                }
+            }
+        }
+    }
+
+    std::copy(out.begin(), out.end(), indices.begin());
+}
+
+size_t
+optimizeVertexFetch(const StructInfo &si,
+                    std::vector<char> &vertices,
+                    std::span<uint32_t> indices)
+{
+    const size_t vsize = si.size;
+    const size_t n = vertices.size() / vsize;
+
+    std::vector<uint32_t> remap(n, NO_VERTEX);
+    std::vector<char> fetched;
+    fetched.reserve(vertices.size());
+    uint32_t count = 0;
+
+    for (auto &idx : indices) {
+        if (remap[idx] == NO_VERTEX) {
+            remap[idx] = count++;
+            const char *v = &vertices[idx * vsize];
+            fetched.insert(fetched.end(), v, v + vsize);
+        }
+        idx = remap[idx];
+    }
+
+    vertices = std::move(fetched);
+    return count;
+}
+
+sys::io::OutStream &
+operator<<(sys::io::OutStream &out, const MeshOptimizerReport &r)
+{
+    out << "triangles: " << r.triangles << ", vertices: " << r.vertices_before
+        << " -> " << r.vertices_after << ", ACMR: " << r.before.acmr << " -> "
+        << r.after.acmr << ", ATVR: " << r.before.atvr << " -> "
+        << r.after.atvr;
+    return out;
+}
+
+MeshOptimizerReport
+MeshOptimizer::optimize(MeshBase &mesh) const
+{
+    MeshOptimizerReport report;
+    report.vertices_before = report.vertices_after = mesh.verticesSize();
+
+    if (mesh.primType() != GL_TRIANGLES) {
+        WARN("MeshOptimizer: only GL_TRIANGLES meshes are supported");
+        return report;
+    }
+
+    const auto &si = mesh.structInfo();
+    auto vdata = mesh.vertexData();
+    std::vector<char> vertices(vdata.begin(), vdata.end());
+    std::vector<uint32_t> indices;
+    if (mesh.drawType() == DrawElements) {
+        auto elems = mesh.elementData();
+        indices.assign(elems.begin(), elems.end());
+    } else {
+        indices.resize(mesh.verticesSize());
+        std::iota(indices.begin(), indices.end(), uint32_t(0));
+    }
+
+    if (indices.size() % 3 != 0) {
+        WARN("MeshOptimizer: incomplete triangle list");
+        return report;
+    }
+
+    size_t nverts = mesh.verticesSize();
+    report.triangles = indices.size() / 3;
+    report.before = analyzeVertexCache(indices, nverts, cache_size);
+
+    if (weld)
+        nverts = weldVertices(si, vertices, indices, weld_epsilon);
+    if (reorder_triangles)
+        optimizeVertexCache(indices, nverts, cache_size);
+    if (reorder_vertices)
+        nverts = optimizeVertexFetch(si, vertices, indices);
+
+    report.vertices_after = nverts;
+    report.after = analyzeVertexCache(indices, nverts, cache_size);
+
+    mesh.assign(vertices, indices);
+    mesh.drawType(DrawElements);
+    return report;
+}
+
+} // namespace glt
@@ -0,0 +1,83 @@
+#ifndef GLT_MESH_OPTIMIZER_HPP
+#define GLT_MESH_OPTIMIZER_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/type_info.hpp"
+#include "sys/io/Stream.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace glt {
+
+struct MeshBase;
+
+inline constexpr size_t VERTEX_CACHE_SIZE_DEFAULT = 32;
+
+struct VertexCacheStatistics
+{
+    double acmr{}; // average cache misses per triangle, >= 0.5
+    double atvr{}; // average transformations per referenced vertex, >= 1
+};
+
+// simulates a FIFO post transform cache over a triangle list
+GLT_API VertexCacheStatistics
+analyzeVertexCache(std::span<const uint32_t> indices,
+                   size_t vertex_count,
+                   size_t cache_size = VERTEX_CACHE_SIZE_DEFAULT);
+
+// Merges equal vertices and rewrites indices to refer to the merged
+// vertices. With epsilon == 0 the fields of two vertices have to be bytewise
+// equal, otherwise floating point components are compared after snapping to
+// a grid of size epsilon. Returns the new number of vertices.
+GLT_API size_t
+weldVertices(const StructInfo &si,
+             std::vector<char> &vertices,
+             std::vector<uint32_t> &indices,
+             float epsilon = 0.f);
+
+// reorders the triangles of a triangle list for the post transform cache
+// (Forsyth's linear speed vertex cache optimization)
+GLT_API void
+optimizeVertexCache(std::span<uint32_t> indices,
+                    size_t vertex_count,
+                    size_t cache_size = VERTEX_CACHE_SIZE_DEFAULT);
+
+// renumbers vertices in order of first use and drops unreferenced ones,
+// returns the new number of vertices
+GLT_API size_t
+optimizeVertexFetch(const StructInfo &si,
+                    std::vector<char> &vertices,
+                    std::span<uint32_t> indices);
+
+struct MeshOptimizerReport
+{
+    size_t vertices_before{};
+    size_t vertices_after{};
+    size_t triangles{};
+    VertexCacheStatistics before;
+    VertexCacheStatistics after;
+};
+
+GLT_API sys::io::OutStream &
+operator<<(sys::io::OutStream &, const MeshOptimizerReport &);
+
+// Runs welding, vertex cache and fetch optimization on the host side data
+// of a triangle mesh, which is indexed afterwards. The mesh has to be sent
+// again for the changes to reach the GPU.
+struct GLT_API MeshOptimizer
+{
+    bool weld = true;
+    float weld_epsilon = 0.f;
+    bool reorder_triangles = true;
+    bool reorder_vertices = true;
+    size_t cache_size = VERTEX_CACHE_SIZE_DEFAULT;
+
+    MeshOptimizerReport optimize(MeshBase &mesh) const;
+};
+
+} // namespace glt
+
+#endif
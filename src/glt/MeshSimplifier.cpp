@@ -0,0 +1,532 @@
+#include "glt/MeshSimplifier.hpp"
+
+#include "err/err.hpp"
+#include "glt/Mesh.hpp"
+#include "glt/MeshOptimizer.hpp"
+#include "math/vec3.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace glt {
+
+namespace {
+
+using math::vec3_t;
+
+inline constexpr uint32_t NO_VERTEX = ~uint32_t(0);
+
+// border planes are weighted stronger than the faces, so borders stay in
+// place unless collapsed along themselves
+inline constexpr double BORDER_WEIGHT = 10.0;
+
+enum VertexKind : uint8_t
+{
+    Interior,
+    Border,
+    Locked
+};
+
+struct Quadric
+{
+    double a00{}, a11{}, a22{}, a01{}, a02{}, a12{};
+    double b0{}, b1{}, b2{};
+    double c{};
+    double w{};
+
+    // plane dot(n, p) + d = 0, n normalized
+    void addPlane(const vec3_t &n, double d, double weight)
+    {
+        const double x = n[0], y = n[1], z = n[2];
+        a00 += weight * x * x;
+        a11 += weight * y * y;
+        a22 += weight * z * z;
+        a01 += weight * x * y;
+        a02 += weight * x * z;
+        a12 += weight * y * z;
+        b0 += weight * x * d;
+        b1 += weight * y * d;
+        b2 += weight * z * d;
+        c += weight * d * d;
+        w += weight;
+    }
+
+    Quadric &operator+=(const Quadric &q)
+    {
+        a00 += q.a00;
+        a11 += q.a11;
+        a22 += q.a22;
+        a01 += q.a01;
+        a02 += q.a02;
+        a12 += q.a12;
+        b0 += q.b0;
+        b1 += q.b1;
+        b2 += q.b2;
+        c += q.c;
+        w += q.w;
+        return *this;
+    }
+
+    double eval(const vec3_t &p) const
+    {
+        const double x = p[0], y = p[1], z = p[2];
+        return a00 * x * x + a11 * y * y + a22 * z * z +
+               2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+               2 * (b0 * x + b1 * y + b2 * z) + c;
+    }
+};
+
+// root of the weighted mean squared distance to the planes of q
+float
+quadricError(const Quadric &q, const vec3_t &p)
+{
+    if (q.w <= 0)
+        return 0.f;
+    return float(std::sqrt(std::max(0.0, q.eval(p)) / q.w));
+}
+
+struct EdgeRef
+{
+    uint64_t key; // position ids, smaller one in the upper half
+    uint32_t tri;
+
+    bool operator<(const EdgeRef &e) const { return key < e.key; }
+};
+
+struct Collapse
+{
+    uint32_t from;
+    uint32_t to;
+    float cost;
+};
+
+const FieldInfo *
+findField(const StructInfo &si, const char *name)
+{
+    for (const auto &f : si.fields)
+        if (strcmp(f.name, name) == 0)
+            return &f;
+    return nullptr;
+}
+
+uint64_t
+edgeKey(uint32_t a, uint32_t b)
+{
+    if (a > b)
+        std::swap(a, b);
+    return (uint64_t(a) << 32) | b;
+}
+
+vec3_t
+faceNormal(const vec3_t &a, const vec3_t &b, const vec3_t &c)
+{
+    return math::cross(b - a, c - a);
+}
+
+struct Simplifier
+{
+    const size_t nverts;
+    std::vector<uint32_t> &indices;
+    std::vector<vec3_t> pos;
+    std::vector<uint32_t> pos_id; // first vertex with the same position
+    std::vector<uint32_t> wedge;  // next vertex with the same position
+    std::vector<Quadric> quadrics;
+    std::vector<uint8_t> kind;
+    std::vector<EdgeRef> edges;
+    std::vector<uint32_t> adj_offsets;
+    std::vector<uint32_t> adjacency;
+
+    Simplifier(size_t n, std::vector<uint32_t> &idxs)
+      : nverts(n)
+      , indices(idxs)
+      , pos(n)
+      , pos_id(n)
+      , wedge(n)
+      , quadrics(n)
+      , kind(n)
+    {}
+
+    uint32_t p(uint32_t v) const { return pos_id[v]; }
+
+    void groupPositions()
+    {
+        size_t cap = 16;
+        while (cap < 2 * nverts)
+            cap *= 2;
+        std::vector<uint32_t> table(cap, NO_VERTEX);
+
+        for (uint32_t v = 0; v < nverts; ++v) {
+            uint64_t h = UINT64_C(0xcbf29ce484222325);
+            const auto *bytes = reinterpret_cast<const char *>(&pos[v]);
+            for (size_t i = 0; i < sizeof(vec3_t); ++i)
+                h = (h ^ uint8_t(bytes[i])) * UINT64_C(0x100000001b3);
+
+            auto slot = size_t(h) & (cap - 1);
+            for (;;) {
+                auto rep = table[slot];
+                if (rep == NO_VERTEX) {
+                    table[slot] = v;
+                    pos_id[v] = v;
+                    wedge[v] = v;
+                    break;
+                }
+                if (pos[rep] == pos[v]) {
+                    pos_id[v] = rep;
+                    wedge[v] = wedge[rep];
+                    wedge[rep] = v;
+                    break;
+                }
+                slot = (slot + 1) & (cap - 1);
+            }
+        }
+    }
+
+    void collectEdges()
+    {
+        edges.clear();
+        const auto ntris = uint32_t(indices.size() / 3);
+        for (uint32_t t = 0; t < ntris; ++t) {
+            for (uint32_t k = 0; k < 3; ++k) {
+                auto a = p(indices[3 * t + k]);
+                auto b = p(indices[3 * t + (k + 1) % 3]);
+                if (a != b)
+                    edges.push_back({ edgeKey(a, b), t });
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+    }
+
+    template<typename F>
+    void forEachEdge(F &&f) const
+    {
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j].key == edges[i].key)
+                ++j;
+            f(uint32_t(edges[i].key >> 32),
+              uint32_t(edges[i].key),
+              j - i,
+              edges[i].tri);
+            i = j;
+        }
+    }
+
+    void computeQuadrics()
+    {
+        const auto ntris = indices.size() / 3;
+        for (size_t t = 0; t < ntris; ++t) {
+            const auto &a = pos[indices[3 * t]];
+            const auto &b = pos[indices[3 * t + 1]];
+            const auto &c = pos[indices[3 * t + 2]];
+            auto n = faceNormal(a, b, c);
+            auto len = math::length(n);
+            if (!(len > 0))
+                continue;
+            n /= len;
+            auto d = -double(math::dot(n, a));
+            for (size_t k = 0; k < 3; ++k)
+                quadrics[p(indices[3 * t + k])].addPlane(n, d, 0.5 * len);
+        }
+
+        collectEdges();
+        forEachEdge([&](uint32_t a, uint32_t b, size_t count, uint32_t t) {
+            if (count != 1)
+                return;
+            auto n = faceNormal(pos[indices[3 * t]],
+                                pos[indices[3 * t + 1]],
+                                pos[indices[3 * t + 2]]);
+            auto e = pos[b] - pos[a];
+            auto bn = math::cross(e, n);
+            auto len = math::length(bn);
+            if (!(len > 0))
+                return;
+            bn /= len;
+            auto d = -double(math::dot(bn, pos[a]));
+            auto weight = BORDER_WEIGHT * double(math::quadrance(e));
+            quadrics[a].addPlane(bn, d, weight);
+            quadrics[b].addPlane(bn, d, weight);
+        });
+    }
+
+    void classify(bool lock_borders)
+    {
+        std::vector<uint32_t> borders(nverts, 0);
+        std::fill(kind.begin(), kind.end(), Interior);
+        forEachEdge([&](uint32_t a, uint32_t b, size_t count, uint32_t) {
+            if (count == 1) {
+                ++borders[a];
+                ++borders[b];
+            } else if (count > 2) {
+                kind[a] = kind[b] = Locked;
+            }
+        });
+
+        for (size_t v = 0; v < nverts; ++v) {
+            if (kind[v] == Locked || borders[v] == 0)
+                continue;
+            kind[v] = borders[v] == 2 && !lock_borders ? Border : Locked;
+        }
+    }
+
+    void buildAdjacency()
+    {
+        adj_offsets.assign(nverts + 1, 0);
+        for (auto v : indices)
+            ++adj_offsets[v + 1];
+        std::partial_sum(
+          adj_offsets.begin(), adj_offsets.end(), adj_offsets.begin());
+        adjacency.resize(indices.size());
+        std::vector<uint32_t> fill(adj_offsets.begin(), adj_offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+    }
+
+    template<typename F>
+    void forEachTriangle(uint32_t v, F &&f) const
+    {
+        for (auto i = adj_offsets[v]; i < adj_offsets[v + 1]; ++i)
+            f(adjacency[i]);
+    }
+
+    template<typename F>
+    void forEachWedge(uint32_t rep, F &&f) const
+    {
+        auto v = rep;
+        do {
+            f(v);
+            v = wedge[v];
+        } while (v != rep);
+    }
+
+    bool allowed(uint32_t from, uint32_t to, bool border_edge) const
+    {
+        (void) to;
+        switch (kind[from]) {
+        case Interior:
+            return true;
+        case Border:
+            return border_edge;
+        case Locked:
+            return false;
+        }
+        UNREACHABLE;
+    }
+
+    std::vector<Collapse> pickCollapses()
+    {
+        std::vector<Collapse> cs;
+        forEachEdge([&](uint32_t a, uint32_t b, size_t count, uint32_t) {
+            const bool border_edge = count == 1;
+            Collapse best{ NO_VERTEX, NO_VERTEX, 0.f };
+            if (allowed(a, b, border_edge))
+                best = { a, b, quadricError(quadrics[a], pos[b]) };
+            if (allowed(b, a, border_edge)) {
+                auto cost = quadricError(quadrics[b], pos[a]);
+                if (best.from == NO_VERTEX || cost < best.cost)
+                    best = { b, a, cost };
+            }
+            if (best.from != NO_VERTEX)
+                cs.push_back(best);
+        });
+        std::sort(cs.begin(), cs.end(), [](const auto &x, const auto &y) {
+            return x.cost < y.cost;
+        });
+        return cs;
+    }
+
+    // finds for every vertex at position from the vertex at position to it
+    // is connected with, fails if the collapse would join different
+    // attributes
+    bool mapWedges(uint32_t from,
+                   uint32_t to,
+                   std::vector<std::pair<uint32_t, uint32_t>> &map) const
+    {
+        map.clear();
+        bool ok = true;
+        forEachWedge(from, [&](uint32_t w) {
+            uint32_t target = NO_VERTEX;
+            forEachTriangle(w, [&](uint32_t t) {
+                for (size_t k = 0; k < 3; ++k) {
+                    auto u = indices[3 * t + k];
+                    if (p(u) != to)
+                        continue;
+                    if (target != NO_VERTEX && target != u)
+                        ok = false;
+                    target = u;
+                }
+            });
+            // a wedge not referenced anymore can be dropped
+            if (target == NO_VERTEX && adj_offsets[w] != adj_offsets[w + 1])
+                ok = false;
+            map.emplace_back(w, target);
+        });
+        return ok;
+    }
+
+    bool flips(uint32_t from, uint32_t to) const
+    {
+        bool flipped = false;
+        forEachWedge(from, [&](uint32_t w) {
+            forEachTriangle(w, [&](uint32_t t) {
+                vec3_t before[3], after[3];
+                bool collapses = false;
+                for (size_t k = 0; k < 3; ++k) {
+                    auto q = p(indices[3 * t + k]);
+                    collapses = collapses || q == to;
+                    before[k] = pos[q];
+                    after[k] = q == from ? pos[to] : pos[q];
+                }
+                if (collapses)
+                    return;
+                auto n0 = faceNormal(before[0], before[1], before[2]);
+                auto n1 = faceNormal(after[0], after[1], after[2]);
+                if (!(math::dot(n0, n1) > 0))
+                    flipped = true;
+            });
+        });
+        return flipped;
+    }
+};
+
+} // namespace
+
+SimplifyResult
+simplifyMesh(const StructInfo &si,
+             std::vector<char> &vertices,
+             std::vector<uint32_t> &indices,
+             const SimplifyOptions &opts)
+{
+    ASSERT(indices.size() % 3 == 0);
+    const size_t vsize = si.size;
+    const size_t n = vertices.size() / vsize;
+
+    SimplifyResult res;
+    res.triangles_before = res.triangles = indices.size() / 3;
+    res.vertices = n;
+
+    const auto *pf = findField(si, opts.position_field);
+    if (pf == nullptr || pf->type_info.scalar_type != ScalarType::F32 ||
+        pf->type_info.arity < 3) {
+        ERR("simplifyMesh: no position field with 3 or 4 float components");
+        return res;
+    }
+
+    Simplifier s(n, indices);
+    for (size_t v = 0; v < n; ++v) {
+        float xyz[3];
+        memcpy(xyz, &vertices[v * vsize + pf->offset], sizeof xyz);
+        s.pos[v] = math::vec3(xyz[0], xyz[1], xyz[2]);
+    }
+
+    s.groupPositions();
+    s.computeQuadrics();
+
+    std::vector<uint32_t> remap(n);
+    std::vector<bool> touched(n);
+    std::vector<std::pair<uint32_t, uint32_t>> wedge_map;
+
+    while (indices.size() / 3 > opts.target_triangles) {
+        s.collectEdges();
+        s.classify(opts.lock_borders);
+        s.buildAdjacency();
+        auto collapses = s.pickCollapses();
+
+        std::iota(remap.begin(), remap.end(), uint32_t(0));
+        std::fill(touched.begin(), touched.end(), false);
+
+        const size_t goal = indices.size() / 3 - opts.target_triangles;
+        size_t removed = 0;
+        size_t performed = 0;
+
+        for (const auto &c : collapses) {
+            if (c.cost > opts.max_error || removed >= goal)
+                break;
+            if (touched[c.from] || touched[c.to])
+                continue;
+            if (!s.mapWedges(c.from, c.to, wedge_map) || s.flips(c.from, c.to))
+                continue;
+
+            for (auto [w, target] : wedge_map)
+                if (target != NO_VERTEX)
+                    remap[w] = target;
+            s.quadrics[c.to] += s.quadrics[c.from];
+            res.error = std::max(res.error, c.cost);
+            ++performed;
+
+            // the one ring of from changes shape, collapses in it are only
+            // considered again in the next pass
+            s.forEachWedge(c.from, [&](uint32_t w) {
+                s.forEachTriangle(w, [&](uint32_t t) {
+                    bool collapses = false;
+                    for (size_t k = 0; k < 3; ++k) {
+                        auto q = s.p(indices[3 * t + k]);
+                        touched[q] = true;
+                        collapses = collapses || q == c.to;
+                    }
+                    removed += collapses;
+                });
+            });
+        }
+
+        if (performed == 0)
+            break;
+
+        size_t out = 0;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            uint32_t a = remap[indices[i]], b = remap[indices[i + 1]],
+                     c = remap[indices[i + 2]];
+            if (s.p(a) == s.p(b) || s.p(b) == s.p(c) || s.p(a) == s.p(c))
+                continue;
+            indices[out++] = a;
+            indices[out++] = b;
+            indices[out++] = c;
+        }
+        indices.resize(out);
+    }
+
+    res.triangles = indices.size() / 3;
+    res.vertices = optimizeVertexFetch(si, vertices, indices);
+    return res;
+}
+
+SimplifyResult
+MeshSimplifier::simplify(MeshBase &mesh) const
+{
+    SimplifyResult res;
+    res.vertices = mesh.verticesSize();
+
+    if (mesh.primType() != GL_TRIANGLES) {
+        WARN("MeshSimplifier: only GL_TRIANGLES meshes are supported");
+        return res;
+    }
+
+    const auto &si = mesh.structInfo();
+    auto vdata = mesh.vertexData();
+    std::vector<char> vertices(vdata.begin(), vdata.end());
+    std::vector<uint32_t> indices;
+    if (mesh.drawType() == DrawElements) {
+        auto elems = mesh.elementData();
+        indices.assign(elems.begin(), elems.end());
+    } else {
+        indices.resize(mesh.verticesSize());
+        std::iota(indices.begin(), indices.end(), uint32_t(0));
+    }
+
+    if (indices.size() % 3 != 0) {
+        WARN("MeshSimplifier: incomplete triangle list");
+        return res;
+    }
+
+    // unindexed meshes repeat every vertex per triangle, as the wedges of a
+    // position have to be connected the mesh is welded first
+    weldVertices(si, vertices, indices);
+    res = simplifyMesh(si, vertices, indices, options);
+
+    mesh.assign(vertices, indices);
+    mesh.drawType(DrawElements);
+    return res;
+}
+
+} // namespace glt
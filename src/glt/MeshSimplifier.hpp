@@ -0,0 +1,61 @@
+#ifndef GLT_MESH_SIMPLIFIER_HPP
+#define GLT_MESH_SIMPLIFIER_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/type_info.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace glt {
+
+struct MeshBase;
+
+struct SimplifyOptions
+{
+    // stop once the triangle count dropped to this
+    size_t target_triangles = 0;
+    // largest allowed deviation from the input surface, in model units
+    float max_error = std::numeric_limits<float>::infinity();
+    // keep border vertices in place, e.g. for meshes of adjacent chunks
+    bool lock_borders = false;
+    // name of the field holding the vertex position, 3 or 4 floats
+    const char *position_field = "position";
+};
+
+struct SimplifyResult
+{
+    size_t triangles_before{};
+    size_t triangles{};
+    size_t vertices{};
+    float error{}; // largest error of a collapse, in model units
+};
+
+// Quadric error metric simplification (Garland, Heckbert) of an indexed
+// triangle list by half edge collapses: a vertex is always moved onto one
+// of its neighbours, so attributes are preserved exactly. Vertices sharing a
+// position but differing in other fields (UV or normal seams) are collapsed
+// together and only along the seam, border vertices only along the border.
+// Collapses that would flip a triangle are rejected. Unreferenced vertices
+// are removed from vertices afterwards.
+GLT_API SimplifyResult
+simplifyMesh(const StructInfo &si,
+             std::vector<char> &vertices,
+             std::vector<uint32_t> &indices,
+             const SimplifyOptions &opts);
+
+// Simplifies the host side data of a GL_TRIANGLES mesh, which is indexed
+// afterwards. The mesh has to be sent again for the changes to reach the
+// GPU.
+struct GLT_API MeshSimplifier
+{
+    SimplifyOptions options;
+
+    SimplifyResult simplify(MeshBase &mesh) const;
+};
+
+} // namespace glt
+
+#endif
@@ -0,0 +1,699 @@
+#include "glt/NullGL.hpp"
+
+#include "err/err.hpp"
+#include "glt/module.hpp"
+#include "opengl.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace glt {
+
+// every GL function used by glt and ge, F: does nothing and returns zero,
+// S: implemented by the template named in the second argument
+#define NULL_GL_FUNCTIONS(F, S)                                                \
+    F(glActiveTexture)                                                         \
+    F(glAttachShader)                                                          \
+    F(glBegin)                                                                 \
+    F(glBeginQuery)                                                            \
+    F(glBeginTransformFeedback)                                                \
+    F(glBindAttribLocation)                                                    \
+    S(glBindBuffer, bindBuffer)                                                \
+    F(glBindBufferBase)                                                        \
+    F(glBindBufferRange)                                                       \
+    F(glBindFragDataLocation)                                                  \
+    F(glBindFramebuffer)                                                       \
+    F(glBindRenderbuffer)                                                      \
+    F(glBindSampler)                                                           \
+    F(glBindTexture)                                                           \
+    F(glBindTransformFeedback)                                                 \
+    F(glBindVertexArray)                                                       \
+    F(glBlendFunc)                                                             \
+    F(glBlitFramebuffer)                                                       \
+    S(glBufferData, bufferData)                                                \
+    S(glBufferStorage, bufferData)                                             \
+    F(glBufferSubData)                                                         \
+    S(glCheckNamedFramebufferStatusEXT, checkFramebufferStatus)                \
+    F(glClear)                                                                 \
+    F(glClearBufferfv)                                                         \
+    F(glClearBufferiv)                                                         \
+    F(glClearBufferuiv)                                                        \
+    F(glClearColor)                                                            \
+    F(glClearDepth)                                                            \
+    S(glClientWaitSync, clientWaitSync)                                        \
+    F(glColor3f)                                                               \
+    F(glColorMask)                                                             \
+    F(glCompileShader)                                                         \
+    F(glCompressedTexImage2D)                                                  \
+    F(glCompressedTextureImage2DEXT)                                           \
+    F(glCompressedTextureSubImage2DEXT)                                        \
+    S(glCreateProgram, createProgram)                                          \
+    S(glCreateShader, createShader)                                            \
+    F(glCullFace)                                                              \
+    F(glDebugMessageCallbackARB)                                               \
+    F(glDebugMessageControlARB)                                                \
+    F(glDebugMessageEnableAMD)                                                 \
+    S(glDeleteBuffers, deleteBuffers)                                          \
+    F(glDeleteFramebuffers)                                                    \
+    S(glDeleteProgram, deleteProgram)                                          \
+    F(glDeleteQueries)                                                         \
+    F(glDeleteRenderbuffers)                                                   \
+    F(glDeleteSamplers)                                                        \
+    S(glDeleteShader, deleteShader)                                            \
+    F(glDeleteSync)                                                            \
+    F(glDeleteTextures)                                                        \
+    F(glDeleteTransformFeedbacks)                                              \
+    F(glDeleteVertexArrays)                                                    \
+    F(glDepthFunc)                                                             \
+    F(glDepthMask)                                                             \
+    F(glDetachShader)                                                          \
+    F(glDisable)                                                               \
+    F(glDisableVertexArrayAttribEXT)                                           \
+    F(glDisableVertexAttribArray)                                              \
+    F(glDrawArrays)                                                            \
+    F(glDrawArraysInstanced)                                                   \
+    F(glDrawArraysInstancedBaseInstance)                                       \
+    F(glDrawElements)                                                          \
+    F(glDrawElementsInstanced)                                                 \
+    F(glDrawElementsInstancedBaseInstance)                                     \
+    F(glDrawElementsInstancedBaseVertex)                                       \
+    F(glDrawElementsInstancedBaseVertexBaseInstance)                           \
+    F(glDrawTransformFeedback)                                                 \
+    F(glDrawTransformFeedbackInstanced)                                        \
+    F(glEnable)                                                                \
+    F(glEnableVertexArrayAttribEXT)                                            \
+    F(glEnableVertexAttribArray)                                               \
+    F(glEnd)                                                                   \
+    F(glEndQuery)                                                              \
+    F(glEndTransformFeedback)                                                  \
+    S(glFenceSync, fenceSync)                                                  \
+    F(glFinish)                                                                \
+    F(glFlush)                                                                 \
+    F(glFramebufferTexture)                                                    \
+    F(glFramebufferTexture3D)                                                  \
+    F(glFramebufferTextureLayer)                                               \
+    S(glGenBuffers, gen)                                                       \
+    S(glGenFramebuffers, gen)                                                  \
+    S(glGenQueries, gen)                                                       \
+    S(glGenRenderbuffers, gen)                                                 \
+    S(glGenSamplers, gen)                                                      \
+    S(glGenTextures, gen)                                                      \
+    S(glGenTransformFeedbacks, gen)                                            \
+    S(glGenVertexArrays, gen)                                                  \
+    F(glGenerateMipmap)                                                        \
+    F(glGetActiveUniformBlockiv)                                               \
+    F(glGetActiveUniformsiv)                                                   \
+    S(glGetAttribLocation, getLocation)                                        \
+    F(glGetDebugMessageLogAMD)                                                 \
+    F(glGetDebugMessageLogARB)                                                 \
+    F(glGetError)                                                              \
+    S(glGetInteger64v, getInteger64v)                                          \
+    S(glGetIntegerv, getIntegerv)                                              \
+    F(glGetProgramBinary)                                                      \
+    S(glGetProgramInfoLog, getInfoLog)                                         \
+    S(glGetProgramiv, getObjectiv)                                             \
+    S(glGetQueryObjectui64v, getQueryObjectui64v)                              \
+    S(glGetQueryObjectuiv, getQueryObjectuiv)                                  \
+    S(glGetShaderInfoLog, getInfoLog)                                          \
+    S(glGetShaderiv, getObjectiv)                                              \
+    S(glGetString, getString)                                                  \
+    S(glGetStringi, getStringi)                                                \
+    S(glGetUniformBlockIndex, getUniformBlockIndex)                            \
+    S(glGetUniformLocation, getLocation)                                       \
+    F(glLineWidth)                                                             \
+    F(glLinkProgram)                                                           \
+    F(glLoadIdentity)                                                          \
+    S(glMapNamedBufferRangeEXT, mapNamedBufferRange)                           \
+    F(glMatrixMode)                                                            \
+    F(glMaxShaderCompilerThreadsKHR)                                           \
+    F(glMultiDrawElementsIndirect)                                             \
+    S(glNamedBufferDataEXT, namedBufferData)                                   \
+    S(glNamedBufferStorageEXT, namedBufferData)                                \
+    F(glNamedBufferSubDataEXT)                                                 \
+    F(glNamedFramebufferRenderbufferEXT)                                       \
+    F(glNamedFramebufferTextureEXT)                                            \
+    F(glNamedRenderbufferStorageEXT)                                           \
+    F(glNamedRenderbufferStorageMultisampleEXT)                                \
+    F(glOrtho)                                                                 \
+    S(glPixelStorei, pixelStorei)                                              \
+    F(glPolygonMode)                                                           \
+    F(glProgramBinary)                                                         \
+    F(glProgramParameteri)                                                     \
+    F(glProgramUniform1f)                                                      \
+    F(glProgramUniform1fv)                                                     \
+    F(glProgramUniform1i)                                                      \
+    F(glProgramUniform1iv)                                                     \
+    F(glProgramUniform1ui)                                                     \
+    F(glProgramUniform2fv)                                                     \
+    F(glProgramUniform2iv)                                                     \
+    F(glProgramUniform3fv)                                                     \
+    F(glProgramUniform3iv)                                                     \
+    F(glProgramUniform4fv)                                                     \
+    F(glProgramUniform4iv)                                                     \
+    F(glProgramUniformMatrix2fv)                                               \
+    F(glProgramUniformMatrix3fv)                                               \
+    F(glProgramUniformMatrix4fv)                                               \
+    F(glQueryCounter)                                                          \
+    F(glReadBuffer)                                                            \
+    F(glReadPixels)                                                            \
+    F(glRotatef)                                                               \
+    F(glSamplerParameterfv)                                                    \
+    F(glSamplerParameteri)                                                     \
+    F(glSamplerParameteriv)                                                    \
+    F(glScissor)                                                               \
+    S(glShaderSource, shaderSource)                                            \
+    F(glTexBuffer)                                                             \
+    F(glTexBufferRange)                                                        \
+    F(glTexImage1D)                                                            \
+    F(glTexImage2D)                                                            \
+    F(glTexImage2DMultisample)                                                 \
+    F(glTexImage3D)                                                            \
+    F(glTexParameterfv)                                                        \
+    F(glTexParameteri)                                                         \
+    F(glTexParameteriv)                                                        \
+    F(glTexSubImage2D)                                                         \
+    F(glTextureImage2DEXT)                                                     \
+    F(glTextureImage3DEXT)                                                     \
+    F(glTextureParameterfvEXT)                                                 \
+    F(glTextureParameteriEXT)                                                  \
+    F(glTextureParameterivEXT)                                                 \
+    F(glTextureSubImage2DEXT)                                                  \
+    F(glTextureSubImage3DEXT)                                                  \
+    F(glTransformFeedbackVaryings)                                             \
+    F(glUniform1fv)                                                            \
+    F(glUniform2fv)                                                            \
+    F(glUniform3fv)                                                            \
+    F(glUniform4fv)                                                            \
+    F(glUniformBlockBinding)                                                   \
+    F(glUniformMatrix4fv)                                                      \
+    S(glUnmapNamedBufferEXT, unmapNamedBuffer)                                 \
+    F(glUseProgram)                                                            \
+    F(glValidateProgram)                                                       \
+    F(glVertex3f)                                                              \
+    F(glVertexArrayVertexAttribOffsetEXT)                                      \
+    F(glVertexAttribDivisor)                                                   \
+    F(glVertexAttribIPointer)                                                  \
+    F(glVertexAttribPointer)                                                   \
+    F(glViewport)                                                              \
+    F(glWaitSync)
+
+namespace {
+
+enum FunctionId : uint16_t
+{
+#define NULL_GL_ID(f, ...) ID_##f,
+    NULL_GL_FUNCTIONS(NULL_GL_ID, NULL_GL_ID)
+#undef NULL_GL_ID
+      FunctionCount
+};
+
+const constexpr auto EXTENSIONS = std::to_array<const char *>({
+  "GL_ARB_buffer_storage",
+  "GL_ARB_multi_draw_indirect",
+  "GL_ARB_texture_compression_bptc",
+  "GL_ARB_texture_compression_rgtc",
+  "GL_ARB_uniform_buffer_object",
+  "GL_EXT_direct_state_access",
+  "GL_EXT_texture_compression_s3tc",
+  "GL_EXT_texture_sRGB",
+  "GL_KHR_parallel_shader_compile",
+});
+
+} // namespace
+
+struct NullGL
+{
+    struct Buffer
+    {
+        size_t size{};
+        std::vector<std::byte> mapping; // allocated by the first map
+    };
+
+    std::array<uint64_t, FunctionCount> calls{};
+    GLuint next_name = 1;
+    uintptr_t next_sync = 1;
+    std::unordered_map<GLenum, GLuint> bound_buffers;
+    std::unordered_map<GLuint, Buffer> buffers;
+    // per program: uniforms, attributes and uniform blocks
+    std::unordered_map<GLuint, std::map<std::string, GLint, std::less<>>>
+      locations;
+    std::unordered_map<GLenum, GLint> integers;
+    // shaders with an #error directive in their source, they fail to compile
+    std::unordered_set<GLuint> failing_shaders;
+    // programs whose completion status was queried, an asynchronous link
+    // is done at the second query
+    std::unordered_set<GLuint> polled_programs;
+
+    NullGL();
+
+    GLint location(GLuint program, std::string_view name);
+};
+
+NullGL::NullGL()
+  : integers({
+      { GL_MAJOR_VERSION, 4 },
+      { GL_MINOR_VERSION, 5 },
+      { GL_NUM_EXTENSIONS, GLint(EXTENSIONS.size()) },
+      { GL_PACK_ALIGNMENT, 4 },
+      { GL_UNPACK_ALIGNMENT, 4 },
+      { GL_MAX_TEXTURE_SIZE, 16384 },
+      { GL_MAX_3D_TEXTURE_SIZE, 2048 },
+      { GL_MAX_ARRAY_TEXTURE_LAYERS, 2048 },
+      { GL_MAX_RENDERBUFFER_SIZE, 16384 },
+      { GL_MAX_SAMPLES, 8 },
+      { GL_MAX_COLOR_ATTACHMENTS, 8 },
+      { GL_MAX_DRAW_BUFFERS, 8 },
+      { GL_MAX_VERTEX_ATTRIBS, 16 },
+      { GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, 192 },
+      { GL_MAX_UNIFORM_BUFFER_BINDINGS, 84 },
+      { GL_MAX_UNIFORM_BLOCK_SIZE, 65536 },
+      { GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, 256 },
+      { GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, 256 },
+    })
+{}
+
+GLint
+NullGL::location(GLuint program, std::string_view name)
+{
+    auto &names = locations[program];
+    auto it = names.find(name);
+    if (it == names.end())
+        it = names.emplace(std::string(name), GLint(names.size())).first;
+    return it->second;
+}
+
+namespace {
+
+NullGL &
+driver()
+{
+    return *module->utils.null_gl;
+}
+
+template<FunctionId Id, typename F>
+struct Nop;
+
+template<FunctionId Id, typename R, typename... Args>
+struct Nop<Id, R(APIENTRY *)(Args...)>
+{
+    static R APIENTRY call(Args... /*unused*/)
+    {
+        ++driver().calls[Id];
+        if constexpr (!std::is_void_v<R>)
+            return R{};
+    }
+};
+
+template<FunctionId Id>
+void APIENTRY
+gen(GLsizei n, GLuint *names)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    for (GLsizei i = 0; i < n; ++i)
+        names[i] = gl.next_name++;
+}
+
+template<FunctionId Id>
+GLuint APIENTRY
+createProgram()
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    return gl.next_name++;
+}
+
+template<FunctionId Id>
+GLuint APIENTRY
+createShader(GLenum /*type*/)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    return gl.next_name++;
+}
+
+template<FunctionId Id>
+void APIENTRY
+deleteProgram(GLuint program)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    gl.locations.erase(program);
+    gl.polled_programs.erase(program);
+}
+
+template<FunctionId Id>
+void APIENTRY
+deleteShader(GLuint shader)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    gl.failing_shaders.erase(shader);
+}
+
+template<FunctionId Id>
+void APIENTRY
+shaderSource(GLuint shader,
+             GLsizei count,
+             const GLchar *const *strings,
+             const GLint *lengths)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    bool error = false;
+    for (GLsizei i = 0; i < count && !error; ++i) {
+        const auto str = lengths != nullptr && lengths[i] >= 0
+                           ? std::string_view(strings[i], size_t(lengths[i]))
+                           : std::string_view(strings[i]);
+        error = str.find("#error") != std::string_view::npos;
+    }
+    if (error)
+        gl.failing_shaders.insert(shader);
+    else
+        gl.failing_shaders.erase(shader);
+}
+
+template<FunctionId Id>
+void APIENTRY
+bindBuffer(GLenum target, GLuint buffer)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    gl.bound_buffers[target] = buffer;
+}
+
+template<FunctionId Id>
+void APIENTRY
+deleteBuffers(GLsizei n, const GLuint *names)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    for (GLsizei i = 0; i < n; ++i)
+        gl.buffers.erase(names[i]);
+}
+
+// glBufferData and glBufferStorage
+template<FunctionId Id>
+void APIENTRY
+bufferData(GLenum target, GLsizeiptr size, const void * /*data*/, GLenum)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    gl.buffers[gl.bound_buffers[target]].size = size_t(size);
+}
+
+template<FunctionId Id>
+void APIENTRY
+namedBufferData(GLuint buffer, GLsizeiptr size, const void * /*data*/, GLenum)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    gl.buffers[buffer].size = size_t(size);
+}
+
+template<FunctionId Id>
+void *APIENTRY
+mapNamedBufferRange(GLuint buffer,
+                    GLintptr offset,
+                    GLsizeiptr length,
+                    GLbitfield /*access*/)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    auto &b = gl.buffers[buffer];
+    const auto size = std::max(b.size, size_t(offset + length));
+    if (b.mapping.size() < size)
+        b.mapping.resize(size);
+    return b.mapping.data() + offset;
+}
+
+template<FunctionId Id>
+GLboolean APIENTRY
+unmapNamedBuffer(GLuint /*buffer*/)
+{
+    ++driver().calls[Id];
+    return GL_TRUE;
+}
+
+template<FunctionId Id>
+const GLubyte *APIENTRY
+getString(GLenum name)
+{
+    ++driver().calls[Id];
+    const char *str = nullptr;
+    switch (name) {
+    case GL_VENDOR:
+        str = "glt";
+        break;
+    case GL_RENDERER:
+        str = "null driver";
+        break;
+    case GL_VERSION:
+        str = "4.5 glt null driver";
+        break;
+    case GL_SHADING_LANGUAGE_VERSION:
+        str = "4.50";
+        break;
+    }
+    return reinterpret_cast<const GLubyte *>(str);
+}
+
+template<FunctionId Id>
+const GLubyte *APIENTRY
+getStringi(GLenum name, GLuint index)
+{
+    ++driver().calls[Id];
+    if (name != GL_EXTENSIONS || index >= EXTENSIONS.size())
+        return nullptr;
+    return reinterpret_cast<const GLubyte *>(EXTENSIONS[index]);
+}
+
+template<FunctionId Id>
+void APIENTRY
+pixelStorei(GLenum pname, GLint param)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    gl.integers[pname] = param;
+}
+
+// single valued state only
+template<FunctionId Id>
+void APIENTRY
+getIntegerv(GLenum pname, GLint *data)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    const auto it = gl.integers.find(pname);
+    *data = it != gl.integers.end() ? it->second : 0;
+}
+
+template<FunctionId Id>
+void APIENTRY
+getInteger64v(GLenum pname, GLint64 *data)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    const auto it = gl.integers.find(pname);
+    *data = it != gl.integers.end() ? it->second : 0;
+}
+
+// glGetShaderiv and glGetProgramiv
+template<FunctionId Id>
+void APIENTRY
+getObjectiv(GLuint object, GLenum pname, GLint *params)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    switch (pname) {
+    case GL_COMPILE_STATUS:
+        *params = gl.failing_shaders.count(object) > 0 ? GL_FALSE : GL_TRUE;
+        break;
+    case GL_LINK_STATUS:
+    case GL_VALIDATE_STATUS:
+        *params = GL_TRUE;
+        break;
+    case GL_COMPLETION_STATUS_KHR:
+        *params = gl.polled_programs.insert(object).second ? GL_FALSE : GL_TRUE;
+        break;
+    default:
+        *params = 0;
+    }
+}
+
+template<FunctionId Id>
+void APIENTRY
+getInfoLog(GLuint /*object*/, GLsizei size, GLsizei *length, GLchar *log)
+{
+    ++driver().calls[Id];
+    if (length != nullptr)
+        *length = 0;
+    if (size > 0 && log != nullptr)
+        log[0] = '\0';
+}
+
+// glGetUniformLocation and glGetAttribLocation
+template<FunctionId Id>
+GLint APIENTRY
+getLocation(GLuint program, const GLchar *name)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    return gl.location(program, name);
+}
+
+template<FunctionId Id>
+GLuint APIENTRY
+getUniformBlockIndex(GLuint program, const GLchar *name)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    return GLuint(gl.location(program, name));
+}
+
+template<FunctionId Id>
+void APIENTRY
+getQueryObjectuiv(GLuint /*query*/, GLenum pname, GLuint *params)
+{
+    ++driver().calls[Id];
+    *params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+}
+
+template<FunctionId Id>
+void APIENTRY
+getQueryObjectui64v(GLuint /*query*/, GLenum /*pname*/, GLuint64 *params)
+{
+    ++driver().calls[Id];
+    *params = 0;
+}
+
+template<FunctionId Id>
+GLenum APIENTRY
+checkFramebufferStatus(GLuint /*framebuffer*/, GLenum /*target*/)
+{
+    ++driver().calls[Id];
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+template<FunctionId Id>
+GLsync APIENTRY
+fenceSync(GLenum /*condition*/, GLbitfield /*flags*/)
+{
+    auto &gl = driver();
+    ++gl.calls[Id];
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<GLsync>(gl.next_sync++);
+}
+
+template<FunctionId Id>
+GLenum APIENTRY
+clientWaitSync(GLsync /*sync*/, GLbitfield /*flags*/, GLuint64 /*timeout*/)
+{
+    ++driver().calls[Id];
+    return GL_ALREADY_SIGNALED;
+}
+
+struct Function
+{
+    const char *name;
+    void *proc;
+};
+
+// the glad pointer type checks the signature of the implementation
+template<typename F>
+void *
+proc(F fn)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<void *>(fn);
+}
+
+#define NULL_GL_NOP(f)                                                         \
+    { #f, proc(&Nop<ID_##f, std::decay_t<decltype(f)>>::call) },
+#define NULL_GL_IMPL(f, impl)                                                  \
+    { #f, proc<std::decay_t<decltype(f)>>(&impl<ID_##f>) },
+
+const Function FUNCTIONS[] = { NULL_GL_FUNCTIONS(NULL_GL_NOP, NULL_GL_IMPL) };
+
+#undef NULL_GL_NOP
+#undef NULL_GL_IMPL
+
+static_assert(std::size(FUNCTIONS) == FunctionCount);
+
+void *
+procAddress(const char *name)
+{
+    for (const auto &fn : FUNCTIONS)
+        if (std::string_view(fn.name) == name)
+            return fn.proc;
+    return nullptr;
+}
+
+} // namespace
+
+bool
+loadNullGL()
+{
+    ASSERT(module, "glt module not initialized");
+    module->utils.null_gl = std::make_shared<NullGL>();
+    if (!gladLoadGLLoader(procAddress)) {
+        module->utils.null_gl.reset();
+        ERR("couldnt load the null GL driver");
+        return false;
+    }
+    // the queries of the loader are not counted
+    resetNullGLCalls();
+    return true;
+}
+
+std::vector<NullGLCalls>
+nullGLCalls()
+{
+    std::vector<NullGLCalls> result;
+    if (!module->utils.null_gl)
+        return result;
+    const auto &calls = driver().calls;
+    for (size_t i = 0; i < calls.size(); ++i)
+        if (calls[i] > 0)
+            result.push_back({ FUNCTIONS[i].name, calls[i] });
+    std::stable_sort(
+      result.begin(), result.end(), [](const auto &a, const auto &b) {
+          return a.calls > b.calls;
+      });
+    return result;
+}
+
+void
+resetNullGLCalls()
+{
+    if (module->utils.null_gl)
+        driver().calls.fill(0);
+}
+
+void
+printNullGLCalls(sys::io::OutStream &out, uint64_t frames, size_t top)
+{
+    const auto calls = nullGLCalls();
+    uint64_t total = 0;
+    for (const auto &c : calls)
+        total += c.calls;
+
+    // per frame, or in total without frames
+    const double scale = frames > 0 ? 1.0 / double(frames) : 1.0;
+    out << "GL calls: " << total;
+    if (frames > 0)
+        out << ", per frame: " << double(total) * scale;
+    out << "\n";
+    for (size_t i = 0; i < std::min(top, calls.size()); ++i)
+        out << "GL   " << calls[i].function << ": "
+            << double(calls[i].calls) * scale << "\n";
+}
+
+} // namespace glt
@@ -0,0 +1,48 @@
+#ifndef GLT_NULL_GL_HPP
+#define GLT_NULL_GL_HPP
+
+#include "glt/conf.hpp"
+
+#include "sys/io/Stream.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace glt {
+
+// A GL driver that draws nothing, selected by moduleInit(GLBackend::Null).
+// It is loaded into the glad function pointers in place of a context, so the
+// engine runs unchanged on machines without GL and the time it takes is the
+// CPU overhead of glt and ge alone. Object names are unique, shaders compile
+// unless their source contains #error, programs link, asynchronous links
+// (KHR_parallel_shader_compile) complete at the second poll, framebuffers
+// are complete, fences are signaled, buffers can be mapped and a few integer
+// limits are reported. Everything else does nothing and queries return zero.
+// Only the functions used by glt and ge are provided, every call is counted
+// per function. GL thread only.
+
+struct NullGLCalls
+{
+    const char *function;
+    uint64_t calls;
+};
+
+// loads the null driver into glad, done by moduleInit()
+GLT_API bool
+loadNullGL();
+
+// calls since loading or the last reset, most frequent first, functions that
+// were not called are left out
+GLT_API std::vector<NullGLCalls>
+nullGLCalls();
+
+GLT_API void
+resetNullGLCalls();
+
+// total and per frame calls of the top functions
+GLT_API void
+printNullGLCalls(sys::io::OutStream &out, uint64_t frames, size_t top = 10);
+
+} // namespace glt
+
+#endif
@@ -0,0 +1,767 @@
+#include "glt/PlyLoader.hpp"
+
+#include "err/err.hpp"
+#include "sys/endian.hpp"
+#include "sys/io.hpp"
+#include "util/bit_cast.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace glt {
+
+namespace {
+
+// ASCII bodies are split into chunks of at least this size
+inline constexpr size_t CHUNK_MIN_SIZE = 256 * 1024;
+
+inline constexpr size_t NO_ERROR_LINE = std::numeric_limits<size_t>::max();
+
+enum class PlyFormat : uint8_t
+{
+    Ascii,
+    BinaryLE,
+    BinaryBE
+};
+
+enum class PlyType : uint8_t
+{
+    None,
+    I8,
+    U8,
+    I16,
+    U16,
+    I32,
+    U32,
+    F32,
+    F64
+};
+
+struct PlyProperty
+{
+    std::string_view name;
+    PlyType type{};
+    PlyType count_type{}; // None for scalar properties
+};
+
+struct PlyElement
+{
+    std::string_view name;
+    size_t count{};
+    std::vector<PlyProperty> properties;
+};
+
+struct PlyHeader
+{
+    PlyFormat format{};
+    std::vector<PlyElement> elements;
+    const char *body{};
+    size_t body_line{}; // line number of the first body line
+    int32_t vertex_element = -1;
+    int32_t face_element = -1;
+    int32_t face_list = -1; // property of the face element with the indices
+};
+
+PlyType
+parseType(std::string_view s)
+{
+    if (s == "char" || s == "int8")
+        return PlyType::I8;
+    if (s == "uchar" || s == "uint8")
+        return PlyType::U8;
+    if (s == "short" || s == "int16")
+        return PlyType::I16;
+    if (s == "ushort" || s == "uint16")
+        return PlyType::U16;
+    if (s == "int" || s == "int32")
+        return PlyType::I32;
+    if (s == "uint" || s == "uint32")
+        return PlyType::U32;
+    if (s == "float" || s == "float32")
+        return PlyType::F32;
+    if (s == "double" || s == "float64")
+        return PlyType::F64;
+    return PlyType::None;
+}
+
+size_t
+typeSize(PlyType t)
+{
+    switch (t) {
+    case PlyType::None:
+        return 0;
+    case PlyType::I8:
+    case PlyType::U8:
+        return 1;
+    case PlyType::I16:
+    case PlyType::U16:
+        return 2;
+    case PlyType::I32:
+    case PlyType::U32:
+    case PlyType::F32:
+        return 4;
+    case PlyType::F64:
+        return 8;
+    }
+    UNREACHABLE;
+}
+
+bool
+fail(std::string_view path, std::string_view msg)
+{
+    ERR(std::string(path) + ": " + std::string(msg));
+    return false;
+}
+
+bool
+nextLine(const char *&p, const char *end, std::string_view &line)
+{
+    if (p >= end)
+        return false;
+    auto eol = static_cast<const char *>(memchr(p, '\n', size_t(end - p)));
+    if (eol == nullptr)
+        eol = end;
+    line = { p, size_t(eol - p) };
+    p = eol < end ? eol + 1 : end;
+    return true;
+}
+
+std::string_view
+nextToken(std::string_view &line)
+{
+    auto b = line.find_first_not_of(" \t\r");
+    if (b == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    auto e = std::min(line.find_first_of(" \t\r", b), line.size());
+    auto tok = line.substr(b, e - b);
+    line.remove_prefix(e);
+    return tok;
+}
+
+template<typename T>
+bool
+parseToken(std::string_view tok, T &x)
+{
+    auto [q, ec] = std::from_chars(tok.data(), tok.data() + tok.size(), x);
+    return ec == std::errc{} && q == tok.data() + tok.size() && !tok.empty();
+}
+
+inline const char *
+skipBlank(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        ++p;
+    return p;
+}
+
+template<typename T>
+inline bool
+parseNext(const char *&p, const char *end, T &x)
+{
+    p = skipBlank(p, end);
+    if (p < end && *p == '+')
+        ++p;
+    auto [q, ec] = std::from_chars(p, end, x);
+    if (ec != std::errc{})
+        return false;
+    p = q;
+    return true;
+}
+
+inline bool
+skipNext(const char *&p, const char *end)
+{
+    p = skipBlank(p, end);
+    if (p == end)
+        return false;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+        ++p;
+    return true;
+}
+
+template<typename T>
+inline T
+loadLE(const char *p)
+{
+    static_assert(sizeof(T) <= 8);
+    using U = std::conditional_t<
+      sizeof(T) == 1,
+      uint8_t,
+      std::conditional_t<sizeof(T) == 2,
+                         uint16_t,
+                         std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+    U u;
+    memcpy(&u, p, sizeof u);
+#if !HU_LITTLE_ENDIAN_P
+    u = sys::bswap(u);
+#endif
+    return bit_cast<T>(u);
+}
+
+inline double
+loadValue(const char *p, PlyType t)
+{
+    switch (t) {
+    case PlyType::None:
+        break;
+    case PlyType::I8:
+        return loadLE<int8_t>(p);
+    case PlyType::U8:
+        return loadLE<uint8_t>(p);
+    case PlyType::I16:
+        return loadLE<int16_t>(p);
+    case PlyType::U16:
+        return loadLE<uint16_t>(p);
+    case PlyType::I32:
+        return loadLE<int32_t>(p);
+    case PlyType::U32:
+        return loadLE<uint32_t>(p);
+    case PlyType::F32:
+        return loadLE<float>(p);
+    case PlyType::F64:
+        return loadLE<double>(p);
+    }
+    UNREACHABLE;
+}
+
+// indices of negative or fractional values are rejected by the caller as
+// out of range
+inline uint32_t
+loadIndex(const char *p, PlyType t)
+{
+    auto x = loadValue(p, t);
+    return x >= 0 && x < 4294967296.0 && x == double(uint32_t(x))
+             ? uint32_t(x)
+             : std::numeric_limits<uint32_t>::max();
+}
+
+// collects the faces of one chunk
+struct FaceSink
+{
+    std::vector<uint32_t> indices;
+    size_t nverts{};
+    bool triangulate{};
+    uint32_t face_size{}; // without triangulation, 0 before the first face
+
+    // next_index(uint32_t &) reads the next index of the face
+    template<typename F>
+    bool face(uint32_t n, F &&next_index)
+    {
+        if (!triangulate) {
+            if (face_size == 0)
+                face_size = n;
+            else if (n != face_size)
+                return false;
+        }
+
+        uint32_t first = 0, prev = 0;
+        for (uint32_t k = 0; k < n; ++k) {
+            uint32_t i;
+            if (!next_index(i) || i >= nverts)
+                return false;
+            if (!triangulate) {
+                indices.push_back(i);
+            } else if (k == 0) {
+                first = i;
+            } else {
+                if (k >= 2) {
+                    indices.push_back(first);
+                    indices.push_back(prev);
+                    indices.push_back(i);
+                }
+                prev = i;
+            }
+        }
+        return true;
+    }
+};
+
+template<typename F>
+void
+parallelFor(size_t n, unsigned threads, F &&f)
+{
+    threads = unsigned(std::min(size_t(threads), n));
+    if (threads <= 1) {
+        for (size_t i = 0; i < n; ++i)
+            f(i);
+        return;
+    }
+
+    std::atomic<size_t> next{ 0 };
+    auto work = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;)
+            f(i);
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned k = 1; k < threads; ++k)
+        workers.emplace_back(work);
+    work();
+    for (auto &w : workers)
+        w.join();
+}
+
+bool
+parsePlyHeader(std::string_view path,
+               const char *p,
+               const char *end,
+               PlyHeader &hdr)
+{
+    std::string_view line;
+    nextLine(p, end, line); // "ply"
+    size_t lineno = 1;
+    bool have_format = false;
+
+    for (;;) {
+        if (!nextLine(p, end, line))
+            return fail(path, "missing end_header");
+        ++lineno;
+
+        auto rest = line;
+        auto kw = nextToken(rest);
+        if (kw == "end_header")
+            break;
+        if (kw.empty() || kw == "comment" || kw == "obj_info")
+            continue;
+
+        if (kw == "format") {
+            auto fmt = nextToken(rest);
+            if (fmt == "ascii")
+                hdr.format = PlyFormat::Ascii;
+            else if (fmt == "binary_little_endian")
+                hdr.format = PlyFormat::BinaryLE;
+            else if (fmt == "binary_big_endian")
+                hdr.format = PlyFormat::BinaryBE;
+            else
+                return fail(path, "unknown format: " + std::string(fmt));
+            have_format = true;
+        } else if (kw == "element") {
+            PlyElement el;
+            el.name = nextToken(rest);
+            if (el.name.empty() || !parseToken(nextToken(rest), el.count))
+                return fail(path, "invalid element: " + std::string(line));
+            hdr.elements.push_back(std::move(el));
+        } else if (kw == "property") {
+            if (hdr.elements.empty())
+                return fail(path, "property outside of an element");
+            PlyProperty prop;
+            auto ty = nextToken(rest);
+            if (ty == "list") {
+                prop.count_type = parseType(nextToken(rest));
+                if (prop.count_type == PlyType::None ||
+                    prop.count_type == PlyType::F32 ||
+                    prop.count_type == PlyType::F64)
+                    return fail(path, "invalid list: " + std::string(line));
+                ty = nextToken(rest);
+            }
+            prop.type = parseType(ty);
+            prop.name = nextToken(rest);
+            if (prop.type == PlyType::None || prop.name.empty())
+                return fail(path, "invalid property: " + std::string(line));
+            hdr.elements.back().properties.push_back(prop);
+        } else {
+            return fail(path, "unknown header line: " + std::string(line));
+        }
+    }
+
+    if (!have_format)
+        return fail(path, "missing format");
+
+    hdr.body = p;
+    hdr.body_line = lineno + 1;
+    return true;
+}
+
+bool
+parseSplyHeader(std::string_view path,
+                const char *p,
+                const char *end,
+                PlyHeader &hdr)
+{
+    static const PlyProperty vertex_props[] = {
+        { "x", PlyType::F32, PlyType::None },
+        { "y", PlyType::F32, PlyType::None },
+        { "z", PlyType::F32, PlyType::None },
+        { "nx", PlyType::F32, PlyType::None },
+        { "ny", PlyType::F32, PlyType::None },
+        { "nz", PlyType::F32, PlyType::None },
+    };
+
+    size_t counts[2];
+    for (auto &count : counts) {
+        std::string_view line;
+        if (!nextLine(p, end, line))
+            return fail(path, "unexpected end of file");
+        auto tok = nextToken(line);
+        if (!parseToken(tok, count) || !nextToken(line).empty())
+            return fail(path, "not a SPLY file");
+    }
+
+    hdr.format = PlyFormat::Ascii;
+    hdr.elements.resize(2);
+    hdr.elements[0].name = "vertex";
+    hdr.elements[0].count = counts[0];
+    hdr.elements[0].properties.assign(std::begin(vertex_props),
+                                      std::end(vertex_props));
+    hdr.elements[1].name = "face";
+    hdr.elements[1].count = counts[1];
+    hdr.elements[1].properties.push_back(
+      { "vertex_indices", PlyType::U32, PlyType::U8 });
+    hdr.body = p;
+    hdr.body_line = 3;
+    return true;
+}
+
+bool
+resolveElements(std::string_view path, PlyHeader &hdr)
+{
+    for (size_t e = 0; e < hdr.elements.size(); ++e) {
+        const auto &el = hdr.elements[e];
+        if (el.name == "vertex" && hdr.vertex_element < 0)
+            hdr.vertex_element = int32_t(e);
+        else if (el.name == "face" && hdr.face_element < 0)
+            hdr.face_element = int32_t(e);
+    }
+
+    if (hdr.vertex_element < 0)
+        return fail(path, "no vertex element");
+
+    for (const auto &prop : hdr.elements[size_t(hdr.vertex_element)].properties)
+        if (prop.count_type != PlyType::None)
+            return fail(path, "list property in vertex element");
+
+    if (hdr.face_element >= 0) {
+        const auto &props = hdr.elements[size_t(hdr.face_element)].properties;
+        for (size_t j = 0; j < props.size(); ++j)
+            if (props[j].count_type != PlyType::None &&
+                (props[j].name == "vertex_indices" ||
+                 props[j].name == "vertex_index"))
+                hdr.face_list = int32_t(j);
+        if (hdr.face_list < 0)
+            return fail(path, "face element without vertex_indices");
+    }
+    return true;
+}
+
+struct AsciiChunk
+{
+    const char *begin{};
+    const char *end{};
+    size_t first_line{}; // index of the first line in the body
+    size_t lines{};
+    FaceSink faces;
+    size_t error_line = NO_ERROR_LINE;
+};
+
+bool
+parseAsciiBody(std::string_view path,
+               const PlyHeader &hdr,
+               const char *end,
+               PlyMesh &mesh,
+               std::vector<FaceSink> &sinks,
+               unsigned threads)
+{
+    // every element instance is on its own line
+    size_t total_lines = 0;
+    size_t vert_begin = 0, face_begin = 0;
+    for (size_t e = 0; e < hdr.elements.size(); ++e) {
+        if (int32_t(e) == hdr.vertex_element)
+            vert_begin = total_lines;
+        if (int32_t(e) == hdr.face_element)
+            face_begin = total_lines;
+        total_lines += hdr.elements[e].count;
+    }
+    const auto &vert_el = hdr.elements[size_t(hdr.vertex_element)];
+    const size_t vert_end = vert_begin + vert_el.count;
+    const PlyElement *face_el =
+      hdr.face_element >= 0 ? &hdr.elements[size_t(hdr.face_element)] : nullptr;
+    const size_t face_end = face_el ? face_begin + face_el->count : face_begin;
+    const size_t nprops = vert_el.properties.size();
+
+    // split into chunks of whole lines
+    const size_t size = size_t(end - hdr.body);
+    const size_t nchunks =
+      std::clamp(size / CHUNK_MIN_SIZE, size_t(1), size_t(threads) * 4);
+    std::vector<AsciiChunk> chunks(nchunks);
+    const char *p = hdr.body;
+    for (size_t k = 0; k < nchunks; ++k) {
+        chunks[k].begin = p;
+        if (k + 1 < nchunks) {
+            auto split = std::max(p, hdr.body + (k + 1) * size / nchunks);
+            auto eol = static_cast<const char *>(
+              memchr(split, '\n', size_t(end - split)));
+            p = eol != nullptr ? eol + 1 : end;
+        } else {
+            p = end;
+        }
+        chunks[k].end = p;
+        chunks[k].faces.nverts = vert_el.count;
+        chunks[k].faces.triangulate = sinks[0].triangulate;
+    }
+
+    parallelFor(nchunks, threads, [&](size_t k) {
+        auto &c = chunks[k];
+        c.lines = size_t(std::count(c.begin, c.end, '\n'));
+        if (c.end > c.begin && c.end[-1] != '\n')
+            ++c.lines;
+    });
+
+    size_t lines = 0;
+    for (auto &c : chunks) {
+        c.first_line = lines;
+        lines += c.lines;
+    }
+    if (lines < total_lines)
+        return fail(path, "unexpected end of file");
+
+    parallelFor(nchunks, threads, [&](size_t k) {
+        auto &c = chunks[k];
+        const char *q = c.begin;
+        std::string_view line;
+        for (size_t l = c.first_line; nextLine(q, c.end, line); ++l) {
+            const char *s = line.data();
+            const char *e = s + line.size();
+            bool ok = true;
+
+            if (l >= vert_begin && l < vert_end) {
+                float *row = &mesh.vertices[(l - vert_begin) * nprops];
+                for (size_t j = 0; ok && j < nprops; ++j)
+                    ok = parseNext(s, e, row[j]);
+            } else if (l >= face_begin && l < face_end) {
+                const auto &props = face_el->properties;
+                for (size_t j = 0; ok && j < props.size(); ++j) {
+                    if (props[j].count_type == PlyType::None) {
+                        ok = skipNext(s, e);
+                        continue;
+                    }
+                    uint32_t n;
+                    ok = parseNext(s, e, n);
+                    if (!ok)
+                        break;
+                    if (int32_t(j) == hdr.face_list) {
+                        ok = c.faces.face(
+                          n, [&](uint32_t &i) { return parseNext(s, e, i); });
+                    } else {
+                        for (uint32_t i = 0; ok && i < n; ++i)
+                            ok = skipNext(s, e);
+                    }
+                }
+            } else if (l >= total_lines) {
+                break;
+            }
+
+            if (!ok) {
+                c.error_line = l;
+                return;
+            }
+        }
+    });
+
+    for (const auto &c : chunks)
+        if (c.error_line != NO_ERROR_LINE)
+            return fail(path,
+                        "invalid data in line " +
+                          std::to_string(hdr.body_line + c.error_line));
+
+    sinks.clear();
+    for (auto &c : chunks)
+        sinks.push_back(std::move(c.faces));
+    return true;
+}
+
+bool
+parseBinaryBody(std::string_view path,
+                const PlyHeader &hdr,
+                const char *end,
+                PlyMesh &mesh,
+                FaceSink &faces,
+                unsigned threads)
+{
+    const char *p = hdr.body;
+    for (size_t e = 0; e < hdr.elements.size(); ++e) {
+        const auto &el = hdr.elements[e];
+        bool has_lists = false;
+        size_t stride = 0;
+        for (const auto &prop : el.properties) {
+            has_lists = has_lists || prop.count_type != PlyType::None;
+            stride += typeSize(prop.type);
+        }
+
+        if (!has_lists) {
+            if (stride > 0 && size_t(end - p) / stride < el.count)
+                return fail(path, "unexpected end of file");
+
+            if (int32_t(e) == hdr.vertex_element) {
+                const size_t nprops = el.properties.size();
+                bool all_float = true;
+                for (const auto &prop : el.properties)
+                    all_float = all_float && prop.type == PlyType::F32;
+
+                const size_t block = 65536;
+                const size_t nblocks = (el.count + block - 1) / block;
+                parallelFor(nblocks, threads, [&](size_t b) {
+                    const size_t v0 = b * block;
+                    const size_t v1 = std::min(el.count, v0 + block);
+#if HU_LITTLE_ENDIAN_P
+                    if (all_float) {
+                        memcpy(&mesh.vertices[v0 * nprops],
+                               p + v0 * stride,
+                               (v1 - v0) * stride);
+                        return;
+                    }
+#endif
+                    for (size_t v = v0; v < v1; ++v) {
+                        const char *s = p + v * stride;
+                        float *row = &mesh.vertices[v * nprops];
+                        for (size_t j = 0; j < nprops; ++j) {
+                            row[j] = float(loadValue(s, el.properties[j].type));
+                            s += typeSize(el.properties[j].type);
+                        }
+                    }
+                });
+            }
+            p += el.count * stride;
+            continue;
+        }
+
+        // variable size instances, walked sequentially
+        const bool is_face = int32_t(e) == hdr.face_element;
+        for (size_t i = 0; i < el.count; ++i) {
+            for (size_t j = 0; j < el.properties.size(); ++j) {
+                const auto &prop = el.properties[j];
+                if (prop.count_type == PlyType::None) {
+                    if (size_t(end - p) < typeSize(prop.type))
+                        return fail(path, "unexpected end of file");
+                    p += typeSize(prop.type);
+                    continue;
+                }
+
+                const size_t csize = typeSize(prop.count_type);
+                const size_t isize = typeSize(prop.type);
+                if (size_t(end - p) < csize)
+                    return fail(path, "unexpected end of file");
+                auto n = loadIndex(p, prop.count_type);
+                p += csize;
+                if (n == std::numeric_limits<uint32_t>::max() ||
+                    size_t(end - p) / isize < n)
+                    return fail(path, "unexpected end of file");
+
+                if (is_face && int32_t(j) == hdr.face_list) {
+                    bool ok = faces.face(n, [&](uint32_t &idx) {
+                        idx = loadIndex(p, prop.type);
+                        p += isize;
+                        return true;
+                    });
+                    if (!ok)
+                        return fail(path,
+                                    "invalid face " + std::to_string(i));
+                } else {
+                    p += n * isize;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int32_t
+PlyMesh::property(std::string_view name) const
+{
+    for (size_t i = 0; i < properties.size(); ++i)
+        if (properties[i] == name)
+            return int32_t(i);
+    return -1;
+}
+
+void
+PlyMesh::clear()
+{
+    properties.clear();
+    vertices.clear();
+    indices.clear();
+    faces = 0;
+    face_size = 0;
+}
+
+bool
+loadPly(const std::string &path, PlyMesh &mesh, const PlyLoadOptions &opts)
+{
+    mesh.clear();
+
+    auto res = sys::io::mapFile(path);
+    if (!res)
+        return fail(path, "couldnt open file");
+    auto file = std::move(res).value();
+    const char *begin = file.data().data();
+    const char *end = begin + file.data().size();
+
+    PlyHeader hdr;
+    const bool is_ply =
+      file.data().size() >= 4 && memcmp(begin, "ply", 3) == 0 &&
+      (begin[3] == '\n' || begin[3] == '\r');
+    if (!(is_ply ? parsePlyHeader(path, begin, end, hdr)
+                 : parseSplyHeader(path, begin, end, hdr)))
+        return false;
+    if (!resolveElements(path, hdr))
+        return false;
+    if (hdr.format == PlyFormat::BinaryBE)
+        return fail(path, "binary big endian files are not supported");
+
+    unsigned threads = opts.threads;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    const auto &vert_el = hdr.elements[size_t(hdr.vertex_element)];
+    for (const auto &prop : vert_el.properties)
+        mesh.properties.emplace_back(prop.name);
+    mesh.vertices.resize(vert_el.count * vert_el.properties.size());
+
+    std::vector<FaceSink> sinks(1);
+    sinks[0].nverts = vert_el.count;
+    sinks[0].triangulate = opts.triangulate;
+
+    bool ok = hdr.format == PlyFormat::Ascii
+                ? parseAsciiBody(path, hdr, end, mesh, sinks, threads)
+                : parseBinaryBody(path, hdr, end, mesh, sinks[0], threads);
+    if (!ok) {
+        mesh.clear();
+        return false;
+    }
+
+    uint32_t face_size = opts.triangulate ? 3 : 0;
+    size_t nindices = 0;
+    for (const auto &s : sinks) {
+        if (!opts.triangulate && s.face_size != 0) {
+            if (face_size != 0 && s.face_size != face_size) {
+                mesh.clear();
+                return fail(path, "faces of different size");
+            }
+            face_size = s.face_size;
+        }
+        nindices += s.indices.size();
+    }
+
+    mesh.indices.resize(nindices);
+    auto out = mesh.indices.data();
+    for (const auto &s : sinks) {
+        if (!s.indices.empty())
+            memcpy(out, s.indices.data(), s.indices.size() * sizeof *out);
+        out += s.indices.size();
+    }
+
+    mesh.faces =
+      hdr.face_element >= 0 ? hdr.elements[size_t(hdr.face_element)].count : 0;
+    mesh.face_size = face_size;
+    return true;
+}
+
+} // namespace glt
@@ -0,0 +1,82 @@
+#ifndef GLT_PLY_LOADER_HPP
+#define GLT_PLY_LOADER_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/Mesh.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace glt {
+
+struct PlyLoadOptions
+{
+    // worker threads, 0: one per hardware thread
+    unsigned threads = 0;
+    // split faces into triangle fans, otherwise all faces need to have the
+    // same number of vertices
+    bool triangulate = true;
+};
+
+// Vertices and faces of a PLY file. Vertex properties are converted to
+// float, whatever their type in the file.
+struct GLT_API PlyMesh
+{
+    std::vector<std::string> properties; // vertex properties, in file order
+    std::vector<float> vertices;         // vertexCount() * properties.size()
+    std::vector<uint32_t> indices;       // faceSize() indices per face
+    size_t faces{};                      // faces in the file
+    uint32_t face_size{};
+
+    size_t vertexCount() const
+    {
+        return properties.empty() ? 0 : vertices.size() / properties.size();
+    }
+
+    // 3 if triangulated
+    uint32_t faceSize() const { return face_size; }
+
+    // column of the property in a vertex, -1 if there is none
+    int32_t property(std::string_view name) const;
+
+    std::span<const float> vertex(size_t i) const
+    {
+        return { vertices.data() + i * properties.size(), properties.size() };
+    }
+
+    void clear();
+
+    // replaces the host side data of mesh with one vertex per PLY vertex,
+    // make_vertex maps the properties of a vertex to a T
+    template<typename T, typename F>
+    void toMesh(Mesh<T> &mesh, F &&make_vertex) const
+    {
+        using gl_t = typename T::gl;
+        static_assert(sizeof(gl_t) == gl_t::struct_info::info.size);
+        const auto n = vertexCount();
+        std::vector<gl_t> verts(n);
+        for (size_t i = 0; i < n; ++i)
+            verts[i] = static_cast<gl_t>(T(make_vertex(vertex(i))));
+        mesh.assign({ reinterpret_cast<const char *>(verts.data()),
+                      n * sizeof(gl_t) },
+                    indices);
+        mesh.drawType(DrawElements);
+    }
+};
+
+// Loads ASCII and binary little endian PLY files, and SPLY files: a vertex
+// and a face count on the first two lines followed by "x y z nx ny nz"
+// vertex and "n i0 ... in-1" face lines. The file is mapped and parsed in
+// parallel, ASCII files in chunks of whole lines.
+GLT_API bool
+loadPly(const std::string &path,
+        PlyMesh &mesh,
+        const PlyLoadOptions &opts = {});
+
+} // namespace glt
+
+#endif
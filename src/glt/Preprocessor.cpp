@@ -2,6 +2,8 @@
 
 #include "err/err.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <cstring>
 
 namespace glt {
@@ -202,4 +204,485 @@ Preprocessor::name(std::string &&name)
 //     return nullHandler;
 // }
 
+struct MacroTable::Token
+{
+    enum Kind : uint8_t
+    {
+        Number,
+        Ident,
+        Punct
+    };
+
+    Kind kind;
+    std::string_view text;
+    int64_t value;
+};
+
+namespace {
+
+constexpr size_t MAX_MACRO_NESTING = 64;
+
+bool
+is_ident_start(char c)
+{
+    return isalpha(static_cast<unsigned char>(c)) != 0 || c == '_';
+}
+
+bool
+is_ident_char(char c)
+{
+    return isalnum(static_cast<unsigned char>(c)) != 0 || c == '_';
+}
+
+std::string_view
+trim(std::string_view s)
+{
+    while (!s.empty() && isspace(static_cast<unsigned char>(s.front())))
+        s.remove_prefix(1);
+    while (!s.empty() && isspace(static_cast<unsigned char>(s.back())))
+        s.remove_suffix(1);
+    return s;
+}
+
+std::string_view
+leading_ident(std::string_view s)
+{
+    s = trim(s);
+    size_t n = 0;
+    if (!s.empty() && is_ident_start(s[0]))
+        while (n < s.size() && is_ident_char(s[n]))
+            ++n;
+    return s.substr(0, n);
+}
+
+bool
+tokenize(std::string_view s, std::vector<MacroTable::Token> &toks)
+{
+    static constexpr std::string_view puncts2[] = { "<<", ">>", "<=", ">=",
+                                                    "==", "!=", "&&", "||" };
+    static constexpr std::string_view puncts1 = "()!~-+*/%<>&^|?:,";
+
+    size_t i = 0;
+    while (i < s.size()) {
+        char c = s[i];
+        if (isspace(static_cast<unsigned char>(c)) || c == '\\') {
+            ++i;
+        } else if (s.substr(i, 2) == "//") {
+            break;
+        } else if (s.substr(i, 2) == "/*") {
+            auto close = s.find("*/", i + 2);
+            if (close == std::string_view::npos)
+                return false;
+            i = close + 2;
+        } else if (is_ident_start(c)) {
+            size_t j = i;
+            while (j < s.size() && is_ident_char(s[j]))
+                ++j;
+            toks.push_back({ MacroTable::Token::Ident, s.substr(i, j - i), 0 });
+            i = j;
+        } else if (isdigit(static_cast<unsigned char>(c))) {
+            size_t j = i;
+            while (j < s.size() && is_ident_char(s[j]))
+                ++j;
+            auto lit = s.substr(i, j - i);
+            while (!lit.empty() && (lit.back() == 'u' || lit.back() == 'U'))
+                lit.remove_suffix(1);
+            int base = 10;
+            if (lit.size() > 1 && lit[0] == '0') {
+                base = 8;
+                lit.remove_prefix(1);
+                if (lit[0] == 'x' || lit[0] == 'X') {
+                    base = 16;
+                    lit.remove_prefix(1);
+                }
+            }
+            uint64_t value = 0;
+            auto [p, ec] = std::from_chars(
+              lit.data(), lit.data() + lit.size(), value, base);
+            if (ec != std::errc{} || p != lit.data() + lit.size())
+                return false;
+            toks.push_back({ MacroTable::Token::Number,
+                             s.substr(i, j - i),
+                             static_cast<int64_t>(value) });
+            i = j;
+        } else {
+            auto two = s.substr(i, 2);
+            if (std::find(std::begin(puncts2), std::end(puncts2), two) !=
+                std::end(puncts2)) {
+                toks.push_back({ MacroTable::Token::Punct, two, 0 });
+                i += 2;
+            } else if (puncts1.find(c) != std::string_view::npos) {
+                toks.push_back({ MacroTable::Token::Punct, s.substr(i, 1), 0 });
+                ++i;
+            } else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int
+binary_precedence(std::string_view op)
+{
+    if (op == "||")
+        return 1;
+    if (op == "&&")
+        return 2;
+    if (op == "|")
+        return 3;
+    if (op == "^")
+        return 4;
+    if (op == "&")
+        return 5;
+    if (op == "==" || op == "!=")
+        return 6;
+    if (op == "<" || op == ">" || op == "<=" || op == ">=")
+        return 7;
+    if (op == "<<" || op == ">>")
+        return 8;
+    if (op == "+" || op == "-")
+        return 9;
+    if (op == "*" || op == "/" || op == "%")
+        return 10;
+    return 0;
+}
+
+// precedence climbing over the macro expanded tokens, subexpressions not
+// evaluated because of short circuiting may contain anything the driver
+// would accept there
+struct ExprParser
+{
+    std::span<const MacroTable::Token> toks;
+    size_t pos = 0;
+    bool ok = true;
+
+    bool at(std::string_view punct) const
+    {
+        return pos < toks.size() &&
+               toks[pos].kind == MacroTable::Token::Punct &&
+               toks[pos].text == punct;
+    }
+
+    bool expect(std::string_view punct)
+    {
+        if (!at(punct))
+            return ok = false;
+        ++pos;
+        return true;
+    }
+
+    int64_t ternary(bool eval)
+    {
+        auto cond = binary(1, eval);
+        if (!at("?"))
+            return cond;
+        ++pos;
+        auto a = ternary(eval && cond != 0);
+        expect(":");
+        auto b = ternary(eval && cond == 0);
+        return cond != 0 ? a : b;
+    }
+
+    int64_t binary(int min_prec, bool eval)
+    {
+        auto lhs = unary(eval);
+        while (ok && pos < toks.size() &&
+               toks[pos].kind == MacroTable::Token::Punct) {
+            auto op = toks[pos].text;
+            int prec = binary_precedence(op);
+            if (prec == 0 || prec < min_prec)
+                break;
+            ++pos;
+
+            bool rhs_eval = eval && !(op == "&&" && lhs == 0) &&
+                            !(op == "||" && lhs != 0);
+            auto rhs = binary(prec + 1, rhs_eval);
+            if (eval)
+                lhs = apply(op, lhs, rhs, rhs_eval);
+        }
+        return lhs;
+    }
+
+    int64_t apply(std::string_view op, int64_t a, int64_t b, bool b_eval)
+    {
+        // wrap around instead of overflowing
+        auto ua = static_cast<uint64_t>(a);
+        auto ub = static_cast<uint64_t>(b);
+        if (op == "||")
+            return a != 0 || (b_eval && b != 0);
+        if (op == "&&")
+            return a != 0 && b != 0;
+        if (op == "|")
+            return a | b;
+        if (op == "^")
+            return a ^ b;
+        if (op == "&")
+            return a & b;
+        if (op == "==")
+            return a == b;
+        if (op == "!=")
+            return a != b;
+        if (op == "<")
+            return a < b;
+        if (op == ">")
+            return a > b;
+        if (op == "<=")
+            return a <= b;
+        if (op == ">=")
+            return a >= b;
+        if (op == "+")
+            return static_cast<int64_t>(ua + ub);
+        if (op == "-")
+            return static_cast<int64_t>(ua - ub);
+        if (op == "*")
+            return static_cast<int64_t>(ua * ub);
+        if (op == "<<" || op == ">>") {
+            if (b < 0 || b > 63) {
+                ok = false;
+                return 0;
+            }
+            return op == "<<" ? static_cast<int64_t>(ua << b) : a >> b;
+        }
+        // "/" and "%"
+        if (b == 0 || (a == INT64_MIN && b == -1)) {
+            ok = false;
+            return 0;
+        }
+        return op == "/" ? a / b : a % b;
+    }
+
+    int64_t unary(bool eval)
+    {
+        if (pos >= toks.size()) {
+            ok = false;
+            return 0;
+        }
+
+        const auto &tok = toks[pos++];
+        switch (tok.kind) {
+        case MacroTable::Token::Number:
+            return tok.value;
+        case MacroTable::Token::Ident:
+            // undefined identifier, GLSL makes this an error, let the
+            // driver decide
+            if (eval)
+                ok = false;
+            return 0;
+        case MacroTable::Token::Punct:
+            break;
+        }
+
+        if (tok.text == "(") {
+            auto x = ternary(eval);
+            expect(")");
+            return x;
+        }
+
+        auto x = unary(eval);
+        if (tok.text == "+")
+            return x;
+        if (tok.text == "-")
+            return static_cast<int64_t>(0 - static_cast<uint64_t>(x));
+        if (tok.text == "!")
+            return x == 0;
+        if (tok.text == "~")
+            return ~x;
+        ok = false;
+        return 0;
+    }
+};
+
+} // namespace
+
+bool
+MacroTable::define(std::string_view definition)
+{
+    definition = trim(definition);
+    auto name = leading_ident(definition);
+    if (name.empty())
+        return false;
+
+    Macro m;
+    auto rest = definition.substr(name.size());
+    if (!rest.empty() && rest[0] == '(') {
+        m.function_like = true;
+        auto close = rest.find(')');
+        if (close == std::string_view::npos)
+            return false;
+        auto params = rest.substr(1, close - 1);
+        rest = rest.substr(close + 1);
+        while (!trim(params).empty()) {
+            auto comma = params.find(',');
+            auto param = trim(params.substr(0, comma));
+            if (param.empty() || leading_ident(param) != param)
+                return false;
+            m.params.emplace_back(param);
+            if (comma == std::string_view::npos)
+                break;
+            params = params.substr(comma + 1);
+            if (trim(params).empty())
+                return false;
+        }
+    }
+    m.body = trim(rest);
+    _macros.insert_or_assign(std::string(name), std::move(m));
+    return true;
+}
+
+void
+MacroTable::undefine(std::string_view name)
+{
+    auto id = leading_ident(name);
+    if (!id.empty()) {
+        Macro m;
+        m.undefined = true;
+        _macros.insert_or_assign(std::string(id), std::move(m));
+    }
+}
+
+void
+MacroTable::markUnknown(std::string_view name)
+{
+    auto id = leading_ident(name);
+    if (!id.empty()) {
+        Macro m;
+        m.unknown = true;
+        _macros.insert_or_assign(std::string(id), std::move(m));
+    }
+}
+
+std::optional<bool>
+MacroTable::defined(std::string_view name) const
+{
+    auto id = leading_ident(name);
+    auto it = _macros.find(std::string(id));
+    if (it != _macros.end()) {
+        if (it->second.unknown)
+            return std::nullopt;
+        return !it->second.undefined;
+    }
+    // GL_ES, GL_ARB_* and friends are defined by the driver
+    if (id.empty() || id.starts_with("GL_") || id.starts_with("__"))
+        return std::nullopt;
+    return false;
+}
+
+bool
+MacroTable::expand(std::span<const Token> in,
+                   std::vector<Token> &out,
+                   std::vector<std::string_view> &active) const
+{
+    if (active.size() > MAX_MACRO_NESTING)
+        return false;
+
+    for (size_t i = 0; i < in.size(); ++i) {
+        const auto &tok = in[i];
+        if (tok.kind != Token::Ident) {
+            out.push_back(tok);
+            continue;
+        }
+
+        if (tok.text == "defined") {
+            size_t j = i + 1;
+            bool paren = j < in.size() && in[j].text == "(";
+            if (paren)
+                ++j;
+            if (j >= in.size() || in[j].kind != Token::Ident)
+                return false;
+            auto def = defined(in[j].text);
+            if (!def)
+                return false;
+            if (paren && (++j >= in.size() || in[j].text != ")"))
+                return false;
+            out.push_back({ Token::Number, tok.text, *def ? 1 : 0 });
+            i = j;
+            continue;
+        }
+
+        auto it = _macros.find(std::string(tok.text));
+        if (it == _macros.end() || it->second.undefined ||
+            std::find(active.begin(), active.end(), tok.text) !=
+              active.end()) {
+            out.push_back(tok);
+            continue;
+        }
+
+        const auto &m = it->second;
+        if (m.unknown)
+            return false;
+
+        std::vector<Token> body;
+        if (!tokenize(m.body, body))
+            return false;
+
+        if (m.function_like) {
+            // the name alone is no invocation
+            size_t j = i + 1;
+            if (j >= in.size() || in[j].text != "(") {
+                out.push_back(tok);
+                continue;
+            }
+
+            std::vector<std::vector<Token>> args(1);
+            int depth = 0;
+            for (++j; j < in.size(); ++j) {
+                const auto &t = in[j];
+                if (t.kind == Token::Punct) {
+                    if (t.text == ")" && depth-- == 0)
+                        break;
+                    if (t.text == "(")
+                        ++depth;
+                    if (t.text == "," && depth == 0) {
+                        args.emplace_back();
+                        continue;
+                    }
+                }
+                args.back().push_back(t);
+            }
+            if (j >= in.size())
+                return false;
+            if (m.params.empty() && args.size() == 1 && args[0].empty())
+                args.clear();
+            if (args.size() != m.params.size())
+                return false;
+
+            std::vector<Token> subst;
+            for (const auto &t : body) {
+                auto p = std::find(m.params.begin(), m.params.end(), t.text);
+                if (t.kind != Token::Ident || p == m.params.end()) {
+                    subst.push_back(t);
+                    continue;
+                }
+                if (!expand(args[size_t(p - m.params.begin())], subst, active))
+                    return false;
+            }
+            body = std::move(subst);
+            i = j;
+        }
+
+        active.push_back(tok.text);
+        bool ok = expand(body, out, active);
+        active.pop_back();
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+std::optional<int64_t>
+MacroTable::evaluate(std::string_view expr) const
+{
+    std::vector<Token> toks, expanded;
+    std::vector<std::string_view> active;
+    if (!tokenize(expr, toks) || !expand(toks, expanded, active))
+        return std::nullopt;
+
+    ExprParser parser{ expanded };
+    auto value = parser.ternary(true);
+    if (!parser.ok || parser.pos != expanded.size())
+        return std::nullopt;
+    return value;
+}
+
 } // namespace glt
@@ -6,7 +6,12 @@
 #include "sys/io/Stream.hpp"
 
 #include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace glt {
 
@@ -81,6 +86,48 @@ private:
     DECLARE_PIMPL(GLT_API, self);
 };
 
+// Macros defined by #define, as far as needed to evaluate #if and #ifdef
+// conditions. Conditions which depend on the driver, like the GL_*
+// extension macros or __LINE__, cannot be decided and yield nothing.
+struct GLT_API MacroTable
+{
+    // "NAME body" or "NAME(params) body", false if malformed
+    bool define(std::string_view definition);
+
+    // known to be undefined afterwards, even names reserved for the driver
+    void undefine(std::string_view name);
+
+    // definition not known, e.g. when defined in a conditional left to the
+    // driver, conditions using the macro are undecidable
+    void markUnknown(std::string_view name);
+
+    std::optional<bool> defined(std::string_view name) const;
+
+    // value of the expression of an #if or #elif directive
+    std::optional<int64_t> evaluate(std::string_view expr) const;
+
+    void clear() { _macros.clear(); }
+
+    // of #if expressions and macro bodies
+    struct Token;
+
+private:
+    struct Macro
+    {
+        bool function_like{};
+        bool unknown{};
+        bool undefined{};
+        std::vector<std::string> params;
+        std::string body;
+    };
+
+    bool expand(std::span<const Token> in,
+                std::vector<Token> &out,
+                std::vector<std::string_view> &active) const;
+
+    std::unordered_map<std::string, Macro> _macros;
+};
+
 } // namespace glt
 
 #endif
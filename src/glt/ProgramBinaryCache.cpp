@@ -0,0 +1,441 @@
+#include "glt/ProgramBinaryCache.hpp"
+
+#include "err/err.hpp"
+#include "glt/utils.hpp"
+#include "sys/clock.hpp"
+#include "sys/fs.hpp"
+#include "sys/io.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace glt {
+
+namespace {
+
+inline constexpr char PROGRAM_FILE_MAGIC[8] = "GLTPROG";
+inline constexpr uint32_t PROGRAM_FILE_VERSION = 1;
+inline constexpr const char *INDEX_FILE = "index";
+
+struct ProgramFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t format; // as returned by glGetProgramBinary
+    uint64_t length;
+    Hash128 key;
+    Hash128 checksum; // of the binary
+    double build_time;
+};
+
+struct IndexEntry
+{
+    uint64_t size{};
+    uint64_t last_use{};
+};
+
+bool
+writeFileAtomic(const std::string &path,
+                std::span<const std::span<const char>> parts)
+{
+    auto tmp_path = path + ".tmp";
+    {
+        auto res = sys::io::HandleStream::open(tmp_path, sys::io::HM_WRITE);
+        if (!res)
+            return false;
+        auto out = std::move(res).value();
+        for (auto part : parts) {
+            auto [n, ret] = out.write(part);
+            if (ret != sys::io::StreamResult::OK || n != part.size()) {
+                out.close();
+                std::remove(tmp_path.c_str());
+                return false;
+            }
+        }
+        auto flushed = out.flush();
+        out.close();
+        if (flushed != sys::io::StreamResult::OK) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool
+parseHex(std::string_view s, uint64_t &x)
+{
+    auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), x, 16);
+    return ec == std::errc{} && p == s.data() + s.size();
+}
+
+bool
+parseKey(std::string_view s, Hash128 &key)
+{
+    return s.size() == 32 && parseHex(s.substr(0, 16), key.hi) &&
+           parseHex(s.substr(16), key.lo);
+}
+
+std::string_view
+gl_string(GLenum name)
+{
+    auto s = glGetString(name);
+    return s ? gl_unstr(s) : "";
+}
+
+} // namespace
+
+struct ProgramBinaryCache::Data
+{
+    std::string dir;
+    size_t max_size = PROGRAM_BINARY_CACHE_DEFAULT_SIZE;
+    bool probed = false;
+    bool disabled = false;
+    Hash128 driver_key;
+
+    // least recently used entries have the smallest last_use
+    std::map<Hash128, IndexEntry> index;
+    uint64_t clock = 0;
+    size_t total_size = 0;
+    bool index_dirty = false;
+
+    ProgramBinaryCacheStats stats;
+
+    std::string path(const Hash128 &key) const
+    {
+        auto file = key.hex() + ".bin";
+        return sys::fs::join(dir, file.c_str());
+    }
+
+    bool probe();
+    void readIndex();
+    void writeIndex();
+    void touch(const Hash128 &key, uint64_t size);
+    void drop(const Hash128 &key);
+    void evict();
+};
+
+DECLARE_PIMPL_DEL(ProgramBinaryCache)
+
+ProgramBinaryCache::ProgramBinaryCache() : self(new Data) {}
+
+ProgramBinaryCache::~ProgramBinaryCache()
+{
+    close();
+}
+
+bool
+ProgramBinaryCache::open(const std::string &dir, size_t max_size)
+{
+    close();
+    if (!sys::fs::directoryExists(dir))
+        return false;
+    self->dir = dir;
+    self->max_size = max_size;
+    self->readIndex();
+    return true;
+}
+
+void
+ProgramBinaryCache::flush()
+{
+    if (self->index_dirty && !self->dir.empty())
+        self->writeIndex();
+}
+
+void
+ProgramBinaryCache::close()
+{
+    flush();
+    self->dir.clear();
+    self->index.clear();
+    self->total_size = 0;
+    self->clock = 0;
+}
+
+bool
+ProgramBinaryCache::enabled() const
+{
+    return !self->dir.empty() && !self->disabled;
+}
+
+const std::string &
+ProgramBinaryCache::directory() const
+{
+    return self->dir;
+}
+
+const Hash128 &
+ProgramBinaryCache::driverKey()
+{
+    self->probe();
+    return self->driver_key;
+}
+
+bool
+ProgramBinaryCache::Data::probe()
+{
+    if (probed)
+        return !disabled;
+    probed = true;
+
+    GLint nformats = 0;
+    if (GLAD_GL_ARB_get_program_binary)
+        GL_CALL(glGetIntegerv, GL_NUM_PROGRAM_BINARY_FORMATS, &nformats);
+    if (nformats <= 0) {
+        WARN("driver supports no program binary formats, "
+             "program binary cache disabled");
+        disabled = true;
+        return false;
+    }
+
+    auto formats = std::vector<GLint>(size_t(nformats));
+    GL_CALL(glGetIntegerv, GL_PROGRAM_BINARY_FORMATS, formats.data());
+
+    // the version string usually contains the driver version, a binary
+    // from another driver would most likely be rejected anyway
+    Hasher128 h;
+    h.field(gl_string(GL_VENDOR));
+    h.field(gl_string(GL_RENDERER));
+    h.field(gl_string(GL_VERSION));
+    for (auto fmt : formats)
+        h.value(fmt);
+    driver_key = h.finish();
+    return true;
+}
+
+void
+ProgramBinaryCache::Data::readIndex()
+{
+    auto index_path = sys::fs::join(dir, INDEX_FILE);
+    if (!sys::fs::fileExists(index_path))
+        return;
+    auto res = sys::io::readFile(index_path);
+    if (!res)
+        return;
+    auto contents = std::move(res).value();
+    std::string_view text{ contents.data(), contents.size() };
+
+    // one "key size last_use" line per entry
+    while (!text.empty()) {
+        auto eol = text.find('\n');
+        auto line = text.substr(0, eol);
+        text = eol == std::string_view::npos ? "" : text.substr(eol + 1);
+
+        auto sp1 = line.find(' ');
+        auto sp2 = line.find(' ', sp1 + 1);
+        Hash128 key;
+        IndexEntry ent;
+        if (sp1 == std::string_view::npos || sp2 == std::string_view::npos ||
+            !parseKey(line.substr(0, sp1), key) ||
+            !parseHex(line.substr(sp1 + 1, sp2 - sp1 - 1), ent.size) ||
+            !parseHex(line.substr(sp2 + 1), ent.last_use)) {
+            WARN("ignoring corrupt program binary cache index: " + index_path);
+            index.clear();
+            total_size = 0;
+            return;
+        }
+        if (index.emplace(key, ent).second)
+            total_size += ent.size;
+        clock = std::max(clock, ent.last_use);
+    }
+}
+
+void
+ProgramBinaryCache::Data::writeIndex()
+{
+    std::string text;
+    char line[80];
+    for (const auto &[key, ent] : index) {
+        int n = snprintf(line,
+                         sizeof line,
+                         " %llx %llx\n",
+                         static_cast<unsigned long long>(ent.size),
+                         static_cast<unsigned long long>(ent.last_use));
+        text += key.hex();
+        text.append(line, size_t(n));
+    }
+
+    const std::span<const char> parts[] = { { text.data(), text.size() } };
+    if (!writeFileAtomic(sys::fs::join(dir, INDEX_FILE), parts))
+        WARN("couldnt write program binary cache index in: " + dir);
+    index_dirty = false;
+}
+
+void
+ProgramBinaryCache::Data::touch(const Hash128 &key, uint64_t size)
+{
+    auto &ent = index[key];
+    total_size = total_size - ent.size + size;
+    ent.size = size;
+    ent.last_use = ++clock;
+    index_dirty = true;
+}
+
+void
+ProgramBinaryCache::Data::drop(const Hash128 &key)
+{
+    std::remove(path(key).c_str());
+    auto it = index.find(key);
+    if (it != index.end()) {
+        total_size -= it->second.size;
+        index.erase(it);
+        index_dirty = true;
+    }
+}
+
+void
+ProgramBinaryCache::Data::evict()
+{
+    while (total_size > max_size && index.size() > 1) {
+        auto lru = index.begin();
+        for (auto it = index.begin(); it != index.end(); ++it)
+            if (it->second.last_use < lru->second.last_use)
+                lru = it;
+        auto key = lru->first;
+        drop(key);
+        ++stats.evictions;
+    }
+}
+
+bool
+ProgramBinaryCache::load(const Hash128 &key, GLuint program)
+{
+    if (!enabled() || !self->probe())
+        return false;
+
+    auto file_path = self->path(key);
+    if (!sys::fs::fileExists(file_path)) {
+        ++self->stats.misses;
+        return false;
+    }
+
+    auto res = sys::io::mapFile(file_path);
+    if (!res || res->data().size() < sizeof(ProgramFileHeader)) {
+        ++self->stats.misses;
+        return false;
+    }
+
+    auto data = res->data();
+    ProgramFileHeader hdr;
+    memcpy(&hdr, data.data(), sizeof hdr);
+    auto binary = data.subspan(sizeof hdr);
+
+    // never hand a truncated or corrupt binary to the driver
+    if (memcmp(hdr.magic, PROGRAM_FILE_MAGIC, sizeof hdr.magic) != 0 ||
+        hdr.version != PROGRAM_FILE_VERSION || hdr.key != key ||
+        hdr.length != binary.size() ||
+        Hasher128().update(binary.data(), binary.size()).finish() !=
+          hdr.checksum) {
+        WARN("corrupt program binary: " + file_path);
+        self->drop(key);
+        ++self->stats.misses;
+        return false;
+    }
+
+    auto t0 = sys::queryTimer();
+    GL_CALL(glProgramBinary,
+            program,
+            GLenum(hdr.format),
+            binary.data(),
+            GLsizei(binary.size()));
+    GLint success = GL_FALSE;
+    GL_CALL(glGetProgramiv, program, GL_LINK_STATUS, &success);
+    auto load_time = sys::queryTimer() - t0;
+    self->stats.load_time += load_time;
+
+    if (success != GL_TRUE) {
+        self->drop(key);
+        ++self->stats.rejected;
+        ++self->stats.misses;
+        return false;
+    }
+
+    self->touch(key, data.size());
+    ++self->stats.hits;
+    self->stats.saved_time += hdr.build_time - load_time;
+    return true;
+}
+
+bool
+ProgramBinaryCache::store(const Hash128 &key, GLuint program, double build_time)
+{
+    self->stats.build_time += build_time;
+    if (!enabled() || !self->probe())
+        return false;
+
+    GLint length = 0;
+    GL_CALL(glGetProgramiv, program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+
+    auto binary = std::vector<char>(size_t(length));
+    GLsizei written = 0;
+    GLenum format = 0;
+    GL_CALL(glGetProgramBinary,
+            program,
+            length,
+            &written,
+            &format,
+            binary.data());
+    if (written <= 0)
+        return false;
+    binary.resize(size_t(written));
+
+    ProgramFileHeader hdr{};
+    memcpy(hdr.magic, PROGRAM_FILE_MAGIC, sizeof hdr.magic);
+    hdr.version = PROGRAM_FILE_VERSION;
+    hdr.format = format;
+    hdr.length = binary.size();
+    hdr.key = key;
+    hdr.checksum = Hasher128().update(binary.data(), binary.size()).finish();
+    hdr.build_time = build_time;
+
+    const std::span<const char> parts[] = {
+        { reinterpret_cast<const char *>(&hdr), sizeof hdr },
+        { binary.data(), binary.size() },
+    };
+    if (!writeFileAtomic(self->path(key), parts)) {
+        WARN("couldnt write program binary: " + self->path(key));
+        return false;
+    }
+
+    ++self->stats.stores;
+    self->touch(key, sizeof hdr + binary.size());
+    self->evict();
+    return true;
+}
+
+const ProgramBinaryCacheStats &
+ProgramBinaryCache::stats() const
+{
+    return self->stats;
+}
+
+void
+ProgramBinaryCache::printStats(sys::io::OutStream &out) const
+{
+    const auto &s = self->stats;
+    const auto lookups = s.hits + s.misses;
+    out << "program binary cache: " << s.hits << "/" << lookups << " hits";
+    if (lookups > 0)
+        out << " (" << (100 * s.hits / lookups) << "%)";
+    if (s.rejected > 0)
+        out << ", " << s.rejected << " rejected by the driver";
+    out << ", " << s.stores << " stored, " << s.evictions << " evicted, "
+        << (self->total_size >> 10) << " KiB\n"
+        << "  loading binaries: " << (s.load_time * 1000)
+        << " ms, building programs: " << (s.build_time * 1000)
+        << " ms, saved: " << (s.saved_time * 1000) << " ms\n";
+}
+
+} // namespace glt
@@ -0,0 +1,79 @@
+#ifndef GLT_PROGRAM_BINARY_CACHE_HPP
+#define GLT_PROGRAM_BINARY_CACHE_HPP
+
+#include "glt/conf.hpp"
+
+#include "opengl.hpp"
+#include "pp/pimpl.hpp"
+#include "sys/io/Stream.hpp"
+#include "util/Hash128.hpp"
+
+#include <memory>
+#include <string>
+
+namespace glt {
+
+inline constexpr size_t PROGRAM_BINARY_CACHE_DEFAULT_SIZE = 64 << 20;
+
+struct ProgramBinaryCacheStats
+{
+    size_t hits{};
+    size_t misses{};
+    size_t rejected{}; // binaries the driver refused, counted as misses too
+    size_t stores{};
+    size_t evictions{};
+    double load_time{};  // seconds spent in glProgramBinary
+    double build_time{}; // seconds spent compiling and linking on misses
+    double saved_time{}; // build time of the hits minus their load time
+};
+
+// Linked programs stored on disk by glGetProgramBinary, keyed by a hash of
+// everything the binary depends on: the preprocessed sources, attribute and
+// varying bindings, and the driver, see driverKey(). Entries are evicted
+// least recently used first once the cache grows beyond its size limit.
+// A binary rejected by the driver, e.g. after a driver update with an
+// unchanged version string, is dropped and the program built from source.
+// The index of sizes and use times is only written by flush() and close(),
+// binaries missing from it are picked up again when they are loaded.
+struct GLT_API ProgramBinaryCache
+{
+    ProgramBinaryCache();
+    ~ProgramBinaryCache();
+
+    // enables the cache, dir has to exist
+    bool open(const std::string &dir,
+              size_t max_size = PROGRAM_BINARY_CACHE_DEFAULT_SIZE);
+
+    // writes the index if it changed
+    void flush();
+
+    // flushes and disables the cache
+    void close();
+
+    // false if not opened or the driver has no binary formats
+    bool enabled() const;
+
+    const std::string &directory() const;
+
+    // vendor, renderer, version and binary formats of the current context
+    const Hash128 &driverKey();
+
+    // links program from a cached binary, counts a miss if there is none
+    // or the driver rejects it
+    bool load(const Hash128 &key, GLuint program);
+
+    // stores the binary of a linked program, build_time is the time it
+    // took to compile and link it
+    bool store(const Hash128 &key, GLuint program, double build_time);
+
+    const ProgramBinaryCacheStats &stats() const;
+
+    void printStats(sys::io::OutStream &out) const;
+
+private:
+    DECLARE_PIMPL(GLT_API, self);
+};
+
+} // namespace glt
+
+#endif
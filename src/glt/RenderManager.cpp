@@ -2,6 +2,8 @@
 
 #include "glt/GLObject.hpp"
 #include "glt/GLPerfCounter.hpp"
+#include "glt/GLStateCache.hpp"
+#include "glt/GPUProfiler.hpp"
 #include "glt/Transformations.hpp"
 #include "glt/utils.hpp"
 #include "opengl.hpp"
@@ -45,6 +47,8 @@ struct RenderManager::Data
 
     GLPerfCounter perf_counter;
 
+    RenderQueue queue;
+
     double sum_elapsed{};
     double min_elapsed{};
     double max_elapsed{};
@@ -82,6 +86,7 @@ RenderManager::shutdown()
     self->def_rt.reset();
 
     self->perf_counter.clear();
+    gpuProfiler().shutdown();
 }
 
 const ViewFrustum &
@@ -188,6 +193,7 @@ RenderManager::beginScene()
            "no RenderTarget specified");
 
     self->beginStats();
+    stateCache().beginFrame();
 
     self->inScene = true;
 
@@ -208,6 +214,7 @@ void
 RenderManager::endScene()
 {
     ASSERT(self->inScene, "cannot endScene() without beginScene()");
+    drawQueued();
     self->inScene = false;
     self->transformStateBOS = std::nullopt; // restore save point
     self->endStats();                       // dont count swap buffers
@@ -215,6 +222,33 @@ RenderManager::endScene()
         self->current_rt->draw();
 }
 
+void
+RenderManager::submit(const DrawPacket &p)
+{
+    ASSERT(self->inScene, "submit() outside of beginScene()/endScene()");
+    self->queue.submit(p);
+}
+
+void
+RenderManager::drawQueued()
+{
+    ASSERT(self->inScene, "drawQueued() outside of beginScene()/endScene()");
+    if (self->queue.size() == 0)
+        return;
+    self->queue.sort();
+    {
+        GPU_SCOPE("render queue");
+        self->queue.execute();
+    }
+    self->queue.clear();
+}
+
+RenderQueue &
+RenderManager::renderQueue()
+{
+    return self->queue;
+}
+
 FrameStatistics
 RenderManager::frameStatistics()
 {
@@ -237,6 +271,8 @@ RenderManager::Data::beginStats()
     if (!perf_initialized) {
         perf_initialized = true;
         perf_counter.init(2);
+        if (!gpuProfiler().initialized())
+            gpuProfiler().init();
 
         sum_elapsed = 0;
         min_elapsed = 0;
@@ -246,6 +282,7 @@ RenderManager::Data::beginStats()
     }
 
     perf_counter.begin();
+    gpuProfiler().beginFrame();
     stats.last = perf_counter.query();
     if (stats.last > 0) {
         sum_elapsed += stats.last;
@@ -259,6 +296,7 @@ RenderManager::Data::beginStats()
 void
 RenderManager::Data::endStats()
 {
+    gpuProfiler().endFrame();
     perf_counter.end();
     ++frame_id_current;
 }
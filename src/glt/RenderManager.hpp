@@ -2,6 +2,7 @@
 #define GLT_RENDER_MANAGER_HPP
 
 #include "glt/GeometryTransform.hpp"
+#include "glt/RenderQueue.hpp"
 #include "glt/RenderTarget.hpp"
 #include "glt/ViewFrustum.hpp"
 
@@ -100,8 +101,18 @@ struct GLT_API RenderManager
 
     void beginScene();
 
+    // sorts and draws the packets submitted during the scene
     void endScene();
 
+    // queues a draw until endScene(), only valid inside a scene
+    void submit(const DrawPacket &);
+
+    // sorts and draws the packets submitted so far into the active render
+    // target, e.g. before it is post processed
+    void drawQueued();
+
+    RenderQueue &renderQueue();
+
     void shutdown();
 
     FrameStatistics frameStatistics();
@@ -0,0 +1,223 @@
+#include "glt/RenderQueue.hpp"
+
+#include "err/err.hpp"
+#include "glt/Mesh.hpp"
+#include "glt/ShaderProgram.hpp"
+#include "glt/TextureSampler.hpp"
+#include "glt/utils.hpp"
+#include "util/bit_cast.hpp"
+
+#include <vector>
+
+namespace glt {
+
+namespace {
+
+struct SortItem
+{
+    uint64_t key;
+    uint32_t packet;
+};
+
+// spreads the address bits, so unrelated objects end up in unrelated
+// groups, collisions only make the order less coherent
+uint64_t
+hashBits(const void *p, unsigned bits)
+{
+    auto x = uint64_t(reinterpret_cast<uintptr_t>(p));
+    x ^= x >> 33;
+    x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33;
+    return bits == 0 ? 0 : x >> (64 - bits);
+}
+
+// positive floats compare like their bit patterns
+uint64_t
+depthBits(float depth)
+{
+    auto d = depth > 0.f ? depth : 0.f;
+    return (bit_cast<uint32_t>(d) >> 7) & 0xFFFFFF;
+}
+
+// stable LSD radix sort on 8 bit digits, digits equal in all keys are
+// skipped
+void
+radixSort(std::vector<SortItem> &items, std::vector<SortItem> &scratch)
+{
+    const auto n = items.size();
+    if (n < 2)
+        return;
+    scratch.resize(n);
+
+    std::array<std::array<uint32_t, 256>, 8> counts{};
+    for (const auto &it : items)
+        for (unsigned d = 0; d < 8; ++d)
+            ++counts[d][(it.key >> (8 * d)) & 0xFF];
+
+    for (unsigned d = 0; d < 8; ++d) {
+        auto &cnt = counts[d];
+        const auto shift = 8 * d;
+        if (cnt[(items[0].key >> shift) & 0xFF] == n)
+            continue;
+
+        uint32_t sum = 0;
+        for (auto &c : cnt) {
+            auto k = c;
+            c = sum;
+            sum += k;
+        }
+
+        for (const auto &it : items)
+            scratch[cnt[(it.key >> shift) & 0xFF]++] = it;
+        items.swap(scratch);
+    }
+}
+
+} // namespace
+
+uint64_t
+drawPacketSortKey(const DrawPacket &p)
+{
+    // bits from msb to lsb:
+    //   opaque:      pass:4 0 program:12 material:12 mesh:11 depth:24
+    //   translucent: pass:4 1 ~depth:24 program:12 material:12 mesh:11
+    const uint64_t pass = uint64_t(p.pass & 0xF) << 60;
+    const uint64_t program = hashBits(p.program, 12);
+    const uint64_t material = p.material & 0xFFF;
+    const uint64_t mesh = hashBits(p.mesh, 11);
+    const uint64_t depth = depthBits(p.depth);
+
+    if (!p.translucent)
+        return pass | (program << 47) | (material << 35) | (mesh << 24) |
+               depth;
+
+    return pass | (uint64_t(1) << 59) | ((~depth & 0xFFFFFF) << 35) |
+           (program << 23) | (material << 11) | mesh;
+}
+
+bool
+drawPacketsMergeable(const DrawPacket &a, const DrawPacket &b)
+{
+    return a.instanced && b.instanced && a.mesh == b.mesh &&
+           a.program == b.program && a.material == b.material &&
+           a.textures == b.textures && a.uniforms == b.uniforms &&
+           a.setup == b.setup && a.setup_data == b.setup_data &&
+           a.pass == b.pass && a.translucent == b.translucent &&
+           a.base_instance + a.instance_count == b.base_instance;
+}
+
+struct RenderQueue::Data
+{
+    std::vector<DrawPacket> packets;
+    std::vector<SortItem> items;
+    std::vector<SortItem> scratch;
+    std::vector<Batch> batches;
+    RenderQueueStatistics stats;
+};
+
+DECLARE_PIMPL_DEL(RenderQueue)
+
+RenderQueue::RenderQueue() : self(new Data) {}
+
+RenderQueue::~RenderQueue() = default;
+
+void
+RenderQueue::clear()
+{
+    self->packets.clear();
+    self->items.clear();
+    self->batches.clear();
+}
+
+void
+RenderQueue::submit(const DrawPacket &p)
+{
+    ASSERT(p.mesh != nullptr && p.program != nullptr);
+    auto idx = uint32_t(self->packets.size());
+    self->items.push_back({ drawPacketSortKey(p), idx });
+    self->packets.push_back(p);
+}
+
+size_t
+RenderQueue::size() const
+{
+    return self->packets.size();
+}
+
+std::span<const DrawPacket>
+RenderQueue::packets() const
+{
+    return self->packets;
+}
+
+void
+RenderQueue::sort()
+{
+    radixSort(self->items, self->scratch);
+
+    auto &batches = self->batches;
+    batches.clear();
+
+    const DrawPacket *last = nullptr;
+    for (const auto &it : self->items) {
+        const auto &p = self->packets[it.packet];
+        if (last != nullptr && drawPacketsMergeable(*last, p)) {
+            batches.back().instance_count += p.instance_count;
+        } else {
+            batches.push_back({ it.packet, p.instance_count });
+        }
+        last = &p;
+    }
+
+    self->stats.packets = self->packets.size();
+    self->stats.draws = batches.size();
+}
+
+std::span<const RenderQueue::Batch>
+RenderQueue::batches() const
+{
+    return self->batches;
+}
+
+void
+RenderQueue::execute()
+{
+    UniformRange bound_uniforms{};
+
+    for (const auto &b : self->batches) {
+        const auto &p = self->packets[b.packet];
+
+        p.program->use();
+
+        for (size_t i = 0; i < p.textures.size(); ++i)
+            if (p.textures[i] != nullptr)
+                p.textures[i]->bind(uint32_t(i));
+
+        if (p.uniforms.buffer != 0 && !(p.uniforms == bound_uniforms)) {
+            GL_CALL(glBindBufferRange,
+                    GL_UNIFORM_BUFFER,
+                    p.uniforms.binding,
+                    p.uniforms.buffer,
+                    p.uniforms.offset,
+                    p.uniforms.size);
+            bound_uniforms = p.uniforms;
+        }
+
+        if (p.setup != nullptr)
+            p.setup(*p.program, p.setup_data);
+
+        if (p.instanced)
+            p.mesh->drawInstanced(
+              b.instance_count, p.mesh->primType(), p.base_instance);
+        else
+            p.mesh->draw();
+    }
+}
+
+RenderQueueStatistics
+RenderQueue::statistics() const
+{
+    return self->stats;
+}
+
+} // namespace glt
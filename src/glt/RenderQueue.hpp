@@ -0,0 +1,112 @@
+#ifndef GLT_RENDER_QUEUE_HPP
+#define GLT_RENDER_QUEUE_HPP
+
+#include "glt/conf.hpp"
+
+#include "opengl.hpp"
+#include "pp/pimpl.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace glt {
+
+struct MeshBase;
+struct ShaderProgram;
+struct TextureSampler;
+
+inline constexpr size_t DRAW_PACKET_MAX_TEXTURES = 4;
+
+struct UniformRange
+{
+    GLuint buffer{};
+    GLuint binding{};
+    GLintptr offset{};
+    GLsizeiptr size{};
+
+    friend bool operator==(const UniformRange &,
+                           const UniformRange &) = default;
+};
+
+// called before drawing a packet, to set uniforms not kept in a UBO
+using DrawPacketSetup = void (*)(ShaderProgram &, const void *user);
+
+struct DrawPacket
+{
+    MeshBase *mesh{};
+    ShaderProgram *program{};
+    uint32_t material{}; // caller defined id of the texture/uniform state
+    std::array<TextureSampler *, DRAW_PACKET_MAX_TEXTURES> textures{};
+    UniformRange uniforms{};
+    DrawPacketSetup setup{};
+    const void *setup_data{};
+    float depth{}; // distance to the viewer, used to order within a group
+
+    // instanced packets draw instance_count instances starting at
+    // base_instance, packets drawing consecutive instance ranges with
+    // otherwise equal state are merged into a single draw call. The sort is
+    // stable, so such packets should share their depth to stay adjacent.
+    bool instanced = false;
+    uint32_t base_instance{};
+    uint32_t instance_count = 1;
+
+    uint8_t pass{};
+    bool translucent = false;
+};
+
+// Opaque packets are ordered by pass, program, material, mesh and then
+// front to back, translucent packets are drawn after the opaque packets of
+// their pass, back to front.
+GLT_API uint64_t
+drawPacketSortKey(const DrawPacket &);
+
+// true if b can be drawn as part of an instanced draw of a
+GLT_API bool
+drawPacketsMergeable(const DrawPacket &a, const DrawPacket &b);
+
+struct RenderQueueStatistics
+{
+    size_t packets{};
+    size_t draws{};
+};
+
+struct GLT_API RenderQueue
+{
+    // a run of sorted packets issued as one draw call
+    struct Batch
+    {
+        uint32_t packet;
+        uint32_t instance_count;
+    };
+
+    RenderQueue();
+    ~RenderQueue();
+
+    void clear();
+
+    void submit(const DrawPacket &);
+
+    size_t size() const;
+
+    std::span<const DrawPacket> packets() const;
+
+    // sorts the packets and merges instanced neighbours into batches, does
+    // not touch any OpenGL state
+    void sort();
+
+    std::span<const Batch> batches() const;
+
+    // draws the batches computed by the last sort()
+    void execute();
+
+    RenderQueueStatistics statistics() const;
+
+private:
+    DECLARE_PIMPL(GLT_API, self);
+};
+
+} // namespace glt
+
+#endif
@@ -1,6 +1,8 @@
 #include "glt/RenderTarget.hpp"
 
 #include "err/err.hpp"
+#include "glt/FrameCapture.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/type_info.hpp"
 #include "glt/utils.hpp"
 #include "opengl.hpp"
@@ -20,6 +22,9 @@ struct RenderTarget::Data
 
     bool viewport_changed;
 
+    std::unique_ptr<FrameCapture> capture;
+    std::shared_ptr<FrameSink> capture_sink; // of the frame being drawn
+
     DEBUG_DECL(bool active)
 
     Data(size_t w, size_t h, RenderTargetBuffers bs, const Viewport &vp)
@@ -123,7 +128,39 @@ void
 RenderTarget::draw()
 {
     DEBUG_ASSERT(self->active);
+    if (self->capture_sink) {
+        doResolve();
+        self->capture->capture(0,
+                               0,
+                               uint32_t(width()),
+                               uint32_t(height()),
+                               std::move(self->capture_sink));
+        doActivate();
+    }
     doDraw();
+    if (self->capture)
+        self->capture->poll();
+}
+
+void
+RenderTarget::captureAsync(std::shared_ptr<FrameSink> sink)
+{
+    if (!self->capture)
+        self->capture = std::make_unique<FrameCapture>();
+    self->capture_sink = std::move(sink);
+}
+
+void
+RenderTarget::finishCaptures()
+{
+    if (self->capture)
+        self->capture->finish();
+}
+
+FrameCapture *
+RenderTarget::frameCapture()
+{
+    return self->capture.get();
 }
 
 void
@@ -173,14 +210,17 @@ RenderTarget::doDraw()
     // noop
 }
 
+void
+RenderTarget::doResolve()
+{
+    // noop
+}
+
 void
 RenderTarget::doViewport(const Viewport &vp)
 {
-    GL_CALL(glViewport,
-            vp.offsetX,
-            vp.offsetY,
-            GLsizei(vp.width),
-            GLsizei(vp.height));
+    stateCache().viewport(
+      vp.offsetX, vp.offsetY, GLsizei(vp.width), GLsizei(vp.height));
 }
 
 } // namespace glt
@@ -36,6 +36,9 @@ inline constexpr RenderTargetBuffers RT_STENCIL_BUFFER = 4u;
 inline constexpr RenderTargetBuffers RT_ALL_BUFFERS =
   RT_COLOR_BUFFER | RT_DEPTH_BUFFER | RT_STENCIL_BUFFER;
 
+struct FrameCapture;
+struct FrameSink;
+
 struct GLT_API RenderTarget
 {
 
@@ -59,6 +62,17 @@ struct GLT_API RenderTarget
     void draw();
     void viewport(const Viewport &vp);
 
+    // reads the color buffer back when the current frame is drawn, sink
+    // gets the pixels on an encoder thread a few frames later, see
+    // FrameCapture
+    void captureAsync(std::shared_ptr<FrameSink> sink);
+
+    // waits until all captured frames are consumed
+    void finishCaptures();
+
+    // nullptr before the first capture
+    FrameCapture *frameCapture();
+
 protected:
     void updateSize(size_t width, size_t height);
 
@@ -66,6 +80,11 @@ protected:
     virtual void doDeactivate();
     virtual void doClear(RenderTargetBuffers buffers, color col);
     virtual void doDraw();
+
+    // called by draw() before the color buffer is read back, a
+    // multisampled target binds a single sampled copy of the frame as
+    // GL_READ_FRAMEBUFFER. draw() activates the target again afterwards.
+    virtual void doResolve();
     virtual void doViewport(const Viewport &vp);
 
 private:
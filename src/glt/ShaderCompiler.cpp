@@ -4,6 +4,7 @@
 #include "err/log.hpp"
 #include "glt/GLObject.hpp"
 #include "glt/GLSLPreprocessor.hpp"
+#include "glt/ProgramBinaryCache.hpp"
 #include "glt/utils.hpp"
 #include "sys/fs.hpp"
 #include "sys/io/Stream.hpp"
@@ -12,10 +13,10 @@
 
 #include <algorithm>
 #include <array>
-#include <functional>
+#include <atomic>
 #include <queue>
-#include <stack>
 #include <string_view>
+#include <thread>
 #include <unordered_set>
 #include <utility>
 #include <variant>
@@ -41,7 +42,7 @@ namespace {
 struct CompileJob
 {
     std::shared_ptr<ShaderSource> source;
-    std::function<std::shared_ptr<ShaderObject>()> exec;
+    std::shared_ptr<ShaderObject> current; // reloaded if outdated
 };
 } // namespace
 
@@ -85,20 +86,40 @@ struct ShaderSource::Data
     const ShaderSourceKey key;
     const std::variant<StringSource, FileSource> source;
     const ShaderType type;
+    const PreprocessorDefinitions defines;
 
-    static std::shared_ptr<ShaderObject> load(
+    // a shader object being loaded, only preprocess() may run on another
+    // thread
+    struct Load
+    {
+        std::shared_ptr<ShaderObject> so;
+        std::shared_ptr<ShaderObject> fallback; // kept if loading fails
+        GLenum gltype{};
+        std::unique_ptr<GLSLPreprocessor> proc;
+        sys::io::ByteStream log; // preprocessor messages
+    };
+
+    static std::unique_ptr<Load> beginLoad(
       const std::shared_ptr<ShaderSource> & /*src*/,
       const StringSource & /*strsrc*/,
       ShaderCompilerQueue & /*scq*/);
 
-    static std::shared_ptr<ShaderObject> load(
+    static std::unique_ptr<Load> beginLoad(
       const std::shared_ptr<ShaderSource> & /*src*/,
       const FileSource & /*filesrc*/,
       ShaderCompilerQueue & /*scq*/);
 
-    static std::shared_ptr<ShaderObject> load(
+    static std::unique_ptr<Load> beginLoad(
       const std::shared_ptr<ShaderSource> & /*src*/,
       ShaderCompilerQueue & /*scq*/);
+
+    static void preprocess(Load & /*load*/);
+
+    static void preprocessAll(std::vector<std::unique_ptr<Load>> & /*loads*/);
+
+    static std::shared_ptr<ShaderObject> finishLoad(
+      Load & /*load*/,
+      ShaderCompilerQueue & /*scq*/);
 };
 
 DECLARE_PIMPL_DEL(ShaderSource)
@@ -118,13 +139,30 @@ struct ShaderObject::Data
     std::weak_ptr<ShaderCache> cache;
     std::shared_ptr<ShaderSource> source;
     std::variant<StringShaderObject, FileShaderObject> object;
+    GLenum gl_type{};
+    Hash128 code_hash;
+    std::string pending_code; // preprocessed source, not yet compiled
+    bool status_pending{};    // compiled with SC_ASYNC, status not queried
+    bool cache_pending{};     // put into the shader cache once compiled
+    std::vector<std::string> source_names; // by #line source string number
 
     Data(ShaderObject &self_, InitArgs &&args)
       : self(self_), source(std::move(args.source)), object(std::move(args.obj))
     {}
 
-    std::pair<std::shared_ptr<ShaderObject>, ReloadState> reloadIfOutdated(
-      ShaderCompilerQueue & /*scq*/);
+    bool compile(ShaderCompilerQueue & /*scq*/,
+                 GLenum shader_type,
+                 GLSLPreprocessor & /*proc*/);
+
+    bool compilePending(ShaderCompilerQueue & /*scq*/);
+
+    bool finishCompile(ShaderCompilerQueue & /*scq*/);
+
+    bool compiled(ShaderCompilerQueue & /*scq*/, bool ok) const;
+
+    const std::string &name() const;
+
+    ReloadState checkOutdated() const;
 
     void linkCache(const std::shared_ptr<ShaderCache> & /*newcache*/);
     void unlinkCache(const std::shared_ptr<ShaderCache> & /*newcache*/);
@@ -158,6 +196,7 @@ struct ShaderCompiler::Data
     ShaderManager &shaderManager;
     PreprocessorDefinitions defines;
     std::shared_ptr<ShaderCache> cache;
+    ShaderFileCache fileCache;
 
     explicit Data(ShaderManager &sm) : shaderManager(sm) {}
     void initPreprocessor(GLSLPreprocessor & /*proc*/);
@@ -182,8 +221,6 @@ struct ShaderCompilerQueue::Data
     {}
 
     void put(const std::shared_ptr<ShaderObject> & /*so*/);
-    std::shared_ptr<ShaderObject> reload(
-      const std::shared_ptr<ShaderObject> & /*so*/);
 };
 
 DECLARE_PIMPL_DEL(ShaderCompilerQueue)
@@ -197,7 +234,30 @@ struct always_false : std::false_type
 std::string
 hash(std::string_view source)
 {
-    return "h" + std::to_string(std::hash<std::string_view>{}(source));
+    return "h" + hash128(source).hex();
+}
+
+// "{A=1,B=x}" in the order of the names, empty without defines
+std::string
+definesSuffix(const PreprocessorDefinitions &defines)
+{
+    if (defines.empty())
+        return {};
+
+    std::vector<std::pair<std::string, std::string>> sorted(defines.begin(),
+                                                            defines.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    std::string suffix = "{";
+    for (const auto &[name, value] : sorted) {
+        if (suffix.size() > 1)
+            suffix += ',';
+        suffix += name;
+        suffix += '=';
+        suffix += value;
+    }
+    suffix += '}';
+    return suffix;
 }
 
 struct ShaderTypeMapping
@@ -215,11 +275,23 @@ constexpr const auto shaderTypeMappings = std::to_array<ShaderTypeMapping>(
     { "tevl", ShaderType::TesselationEvaluation, GL_TESS_EVALUATION_SHADER } });
 
 bool
-compilePreprocessed(ShaderCompilerQueue & /*scq*/,
-                    GLenum /*shader_type*/,
-                    const std::string & /*name*/,
-                    GLSLPreprocessor & /*proc*/,
-                    GLShaderObject & /*shader*/);
+compileSegments(ShaderCompilerQueue & /*scq*/,
+                GLenum /*shader_type*/,
+                const std::string & /*name*/,
+                GLsizei nsegments,
+                const char *const * /*segments*/,
+                const GLint * /*segLengths*/,
+                GLShaderObject & /*shader*/);
+
+bool
+checkCompileStatus(ShaderCompilerQueue & /*scq*/,
+                   const std::string & /*name*/,
+                   GLShaderObject & /*shader*/);
+
+bool
+finishCompile(ShaderCompilerQueue & /*scq*/,
+              bool ok,
+              GLShaderObject & /*shader*/);
 
 void
 printShaderLog(GLShaderObject & /*shader*/, sys::io::OutStream &out);
@@ -247,19 +319,14 @@ includesNeedReload(const ShaderIncludes &incs)
 }
 
 bool
-compilePreprocessed(ShaderCompilerQueue &scq,
-                    GLenum shader_type,
-                    const std::string &name,
-                    GLSLPreprocessor &proc,
-                    GLShaderObject &shader)
+compileSegments(ShaderCompilerQueue &scq,
+                GLenum shader_type,
+                const std::string &name,
+                GLsizei nsegments,
+                const char *const *segments,
+                const GLint *segLengths,
+                GLShaderObject &shader)
 {
-
-    auto nsegments = GLsizei(proc.segments.size());
-    const char **segments = &proc.segments[0];
-    static_assert(sizeof(GLint) == sizeof(proc.segLengths[0]));
-    auto p0 = &proc.segLengths[0];
-    auto segLengths = reinterpret_cast<const GLint *>(p0); // NOLINT
-
     shader.ensure(shader_type);
     if (!shader.valid()) {
         COMPILER_ERR_MSG(
@@ -285,9 +352,16 @@ compilePreprocessed(ShaderCompilerQueue &scq,
         }
 
         GL_CALL(glShaderSource, *shader, nsegments, segments, segLengths);
+
+        // the status is queried later, see checkCompileStatus()
+        if (scq.flags() & SC_ASYNC) {
+            GL_CALL(glCompileShader, *shader);
+            logmsg << "submitted\n";
+            return true;
+        }
+
         double wct;
-        measure_time(wct, glCompileShader(*shader));
-        GL_CHECK_ERRORS();
+        measure_time(wct, [&] { GL_CALL(glCompileShader, *shader); }());
 
         GLint success;
         GL_CALL(glGetShaderiv, *shader, GL_COMPILE_STATUS, &success);
@@ -296,6 +370,28 @@ compilePreprocessed(ShaderCompilerQueue &scq,
                << "\n";
     }
 
+    return finishCompile(scq, ok, shader);
+}
+
+bool
+checkCompileStatus(ShaderCompilerQueue &scq,
+                   const std::string &name,
+                   GLShaderObject &shader)
+{
+    GLint success;
+    GL_CALL(glGetShaderiv, *shader, GL_COMPILE_STATUS, &success);
+    bool ok = success == GL_TRUE;
+    {
+        auto logmsg = err::beginLog(scq);
+        logmsg << "compiled " << (name.empty() ? " <embedded code> " : name)
+               << " ... " << (ok ? "success" : "failed") << "\n";
+    }
+    return finishCompile(scq, ok, shader);
+}
+
+bool
+finishCompile(ShaderCompilerQueue &scq, bool ok, GLShaderObject &shader)
+{
     auto logmsg =
       err::beginLog(scq, ok ? err::LogLevel::Info : err::LogLevel::Error);
     if (logmsg)
@@ -372,62 +468,65 @@ ShaderSource::key() const
     return self->key;
 }
 
+const PreprocessorDefinitions &
+ShaderSource::defines() const
+{
+    return self->defines;
+}
+
 std::shared_ptr<ShaderSource>
-ShaderSource::makeFileSource(ShaderType ty, std::string path)
+ShaderSource::makeFileSource(ShaderType ty,
+                             std::string path,
+                             PreprocessorDefinitions defines)
 {
     ASSERT(sys::fs::fileExists(path));
+    auto key = path + definesSuffix(defines);
     return std::make_shared<ShaderSource>(
-      Data{ path, { FileSource{ std::move(path) } }, ty });
+      Data{ std::move(key),
+            { FileSource{ std::move(path) } },
+            ty,
+            std::move(defines) });
 }
 
 std::shared_ptr<ShaderSource>
-ShaderSource::makeStringSource(ShaderType ty, std::string source)
+ShaderSource::makeStringSource(ShaderType ty,
+                               std::string source,
+                               PreprocessorDefinitions defines)
 {
-    auto h = hash(source);
+    auto key = hash(source) + definesSuffix(defines);
     return std::make_shared<ShaderSource>(
-      Data{ std::move(h), { StringSource{ std::move(source) } }, ty });
+      Data{ std::move(key),
+            { StringSource{ std::move(source) } },
+            ty,
+            std::move(defines) });
 }
 
-std::shared_ptr<ShaderObject>
-ShaderSource::Data::load(const std::shared_ptr<ShaderSource> &src,
-                         const StringSource &strsrc,
-                         ShaderCompilerQueue &scq)
+std::unique_ptr<ShaderSource::Data::Load>
+ShaderSource::Data::beginLoad(const std::shared_ptr<ShaderSource> &src,
+                              const StringSource &strsrc,
+                              ShaderCompilerQueue &scq)
 {
-    GLenum gltype;
+    auto load = std::make_unique<Load>();
 
-    if (!translateShaderType(src->self->type, &gltype)) {
+    if (!translateShaderType(src->self->type, &load->gltype)) {
         COMPILER_ERR_MSG(
           scq, ShaderCompilerError::InvalidShaderType, "unknown ShaderType");
         return nullptr;
     }
 
-    auto so = ShaderObject::Data::makeStringShaderObject(src, strsrc);
-    GLSLPreprocessor preproc(
-      scq.shaderCompiler().shaderManager().shaderDirectories(),
-      so->self->includes,
-      so->self->dependencies);
-    preproc.name("");
-    scq.shaderCompiler().self->initPreprocessor(preproc);
-
-    preproc.process(strsrc.source);
-
-    if (preproc.wasError())
-        return nullptr;
-
-    if (!compilePreprocessed(scq, gltype, "", preproc, so->self->handle))
-        return nullptr;
-    return so;
+    load->so = ShaderObject::Data::makeStringShaderObject(src, strsrc);
+    return load;
 }
 
-std::shared_ptr<ShaderObject>
-ShaderSource::Data::load(const std::shared_ptr<ShaderSource> &src,
-                         const FileSource &filesrc,
-                         ShaderCompilerQueue &scq)
+std::unique_ptr<ShaderSource::Data::Load>
+ShaderSource::Data::beginLoad(const std::shared_ptr<ShaderSource> &src,
+                              const FileSource &filesrc,
+                              ShaderCompilerQueue &scq)
 {
-    GLenum gltype;
+    auto load = std::make_unique<Load>();
 
     const auto &path = filesrc.path;
-    if (!translateShaderType(src->self->type, &gltype, path)) {
+    if (!translateShaderType(src->self->type, &load->gltype, path)) {
         COMPILER_ERR_MSG(
           scq, ShaderCompilerError::InvalidShaderType, "unknown ShaderType");
         return nullptr;
@@ -440,31 +539,93 @@ ShaderSource::Data::load(const std::shared_ptr<ShaderSource> &src,
         return nullptr;
     }
 
-    auto so = ShaderObject::Data::makeFileShaderObject(src, filesrc, *mtime);
-
-    GLSLPreprocessor preproc(
-      scq.shaderCompiler().shaderManager().shaderDirectories(),
-      so->self->includes,
-      so->self->dependencies);
-    scq.shaderCompiler().self->initPreprocessor(preproc);
+    load->so = ShaderObject::Data::makeFileShaderObject(src, filesrc, *mtime);
+    return load;
+}
 
-    preproc.processFileRecursively(std::string(path));
-    if (preproc.wasError())
+std::unique_ptr<ShaderSource::Data::Load>
+ShaderSource::Data::beginLoad(const std::shared_ptr<ShaderSource> &src,
+                              ShaderCompilerQueue &scq)
+{
+    ASSERT(src);
+    auto load = std::visit(
+      [&](auto &&arg) { return beginLoad(src, arg, scq); }, src->self->source);
+    if (!load)
         return nullptr;
 
-    if (!compilePreprocessed(
-          scq, gltype, so->self->source->key(), preproc, so->self->handle))
-        return nullptr;
-    return so;
+    auto &compiler = *scq.shaderCompiler().self;
+    auto &so = *load->so->self;
+    load->proc = std::make_unique<GLSLPreprocessor>(
+      compiler.shaderManager.shaderDirectories(),
+      so.includes,
+      so.dependencies,
+      &compiler.fileCache);
+    compiler.initPreprocessor(*load->proc);
+    load->proc->addDefines(src->self->defines);
+    load->proc->sourceDefines = &src->self->defines;
+    load->proc->out(load->log);
+    return load;
+}
+
+void
+ShaderSource::Data::preprocess(Load &load)
+{
+    auto &proc = *load.proc;
+    std::visit(
+      [&](auto &&arg) {
+          using T = std::decay_t<decltype(arg)>;
+          if constexpr (std::is_same_v<T, StringShaderObject>) {
+              proc.name("");
+              proc.process(arg.source.source);
+          } else if constexpr (std::is_same_v<T, FileShaderObject>) {
+              proc.processFileRecursively(std::string(arg.source.path));
+          } else {
+              static_assert(always_false<T>::value, "non-exhaustive visitor!");
+          }
+      },
+      load.so->self->object);
+}
+
+void
+ShaderSource::Data::preprocessAll(std::vector<std::unique_ptr<Load>> &loads)
+{
+    // preprocessing only reads files, the shared file cache is thread safe
+    const auto n = loads.size();
+    auto threads = std::min(size_t(std::thread::hardware_concurrency()), n);
+    if (threads <= 1) {
+        for (auto &load : loads)
+            preprocess(*load);
+        return;
+    }
+
+    std::atomic<size_t> next{ 0 };
+    auto work = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;)
+            preprocess(*loads[i]);
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (size_t k = 1; k < threads; ++k)
+        workers.emplace_back(work);
+    work();
+    for (auto &w : workers)
+        w.join();
 }
 
 std::shared_ptr<ShaderObject>
-ShaderSource::Data::load(const std::shared_ptr<ShaderSource> &src,
-                         ShaderCompilerQueue &scq)
+ShaderSource::Data::finishLoad(Load &load, ShaderCompilerQueue &scq)
 {
-    ASSERT(src);
-    return std::visit([&](auto &&arg) { return load(src, arg, scq); },
-                      src->self->source);
+    if (load.log.size() > 0)
+        scq.shaderCompiler().shaderManager().out()
+          << std::string_view(load.log);
+
+    if (load.proc->wasError())
+        return nullptr;
+
+    if (!load.so->self->compile(scq, load.gltype, *load.proc))
+        return nullptr;
+    return std::move(load.so);
 }
 
 ShaderObject::ShaderObject(InitArgs &&args)
@@ -490,6 +651,126 @@ ShaderObject::shaderSource()
     return self->source;
 }
 
+std::optional<ShaderInclude>
+ShaderObject::sourceFile() const
+{
+    if (auto file = std::get_if<FileShaderObject>(&self->object))
+        return ShaderInclude{ file->source.path, file->mtime };
+    return std::nullopt;
+}
+
+const ShaderIncludes &
+ShaderObject::includes() const
+{
+    return self->includes;
+}
+
+const ShaderDependencies &
+ShaderObject::dependencies() const
+{
+    return self->dependencies;
+}
+
+GLenum
+ShaderObject::glType() const
+{
+    return self->gl_type;
+}
+
+const Hash128 &
+ShaderObject::codeHash() const
+{
+    return self->code_hash;
+}
+
+const std::string &
+ShaderObject::Data::name() const
+{
+    static const std::string embedded;
+    if (std::holds_alternative<StringShaderObject>(object))
+        return embedded;
+    return source->key();
+}
+
+bool
+ShaderObject::Data::compile(ShaderCompilerQueue &scq,
+                            GLenum shader_type,
+                            GLSLPreprocessor &proc)
+{
+    auto nsegments = GLsizei(proc.segments.size());
+    const char **segments = &proc.segments[0];
+    static_assert(sizeof(GLint) == sizeof(proc.segLengths[0]));
+    auto p0 = &proc.segLengths[0];
+    auto segLengths = reinterpret_cast<const GLint *>(p0); // NOLINT
+
+    Hasher128 h;
+    for (const auto i : irange(nsegments))
+        h.update(segments[i], size_t(segLengths[i]));
+    gl_type = shader_type;
+    code_hash = h.finish();
+    source_names = proc.sourceNames;
+
+    // if the program binary is cached the shader need not be compiled at
+    // all, otherwise it is compiled just before linking
+    if (scq.shaderCompiler().shaderManager().programBinaryCache().enabled()) {
+        pending_code.clear();
+        for (const auto i : irange(nsegments))
+            pending_code.append(segments[i], size_t(segLengths[i]));
+        return true;
+    }
+
+    status_pending = (scq.flags() & SC_ASYNC) != 0;
+    return compiled(
+      scq,
+      compileSegments(
+        scq, gl_type, name(), nsegments, segments, segLengths, handle));
+}
+
+bool
+ShaderObject::Data::compilePending(ShaderCompilerQueue &scq)
+{
+    if (pending_code.empty()) {
+        if (!handle.valid())
+            scq.pushError(ShaderCompilerError::CompilationFailed);
+        return handle.valid();
+    }
+
+    auto code = std::move(pending_code);
+    pending_code.clear();
+    const char *segment = code.data();
+    auto length = GLint(code.size());
+    status_pending = (scq.flags() & SC_ASYNC) != 0;
+    return compiled(
+      scq,
+      compileSegments(scq, gl_type, name(), 1, &segment, &length, handle));
+}
+
+bool
+ShaderObject::Data::finishCompile(ShaderCompilerQueue &scq)
+{
+    if (!status_pending) {
+        // a shared object may have failed when another program checked it
+        if (!handle.valid())
+            scq.pushError(ShaderCompilerError::CompilationFailed);
+        return handle.valid();
+    }
+    status_pending = false;
+    return compiled(scq, checkCompileStatus(scq, name(), handle));
+}
+
+bool
+ShaderObject::Data::compiled(ShaderCompilerQueue &scq, bool ok) const
+{
+    // the driver's messages refer to files by number
+    if (!ok && source_names.size() > 1) {
+        auto logmsg = err::beginLog(scq, err::LogLevel::Error);
+        logmsg << "source string numbers:\n";
+        for (const auto i : irange(source_names.size()))
+            logmsg << "  " << i << ": " << source_names[i] << "\n";
+    }
+    return ok;
+}
+
 void
 ShaderObject::Data::unlinkCache(const std::shared_ptr<ShaderCache> &newcache)
 {
@@ -499,10 +780,10 @@ ShaderObject::Data::unlinkCache(const std::shared_ptr<ShaderCache> &newcache)
         cache.reset();
 }
 
-std::pair<std::shared_ptr<ShaderObject>, ReloadState>
-ShaderObject::Data::reloadIfOutdated(ShaderCompilerQueue &scq)
+ReloadState
+ShaderObject::Data::checkOutdated() const
 {
-    auto state = std::visit(
+    return std::visit(
       [this](auto &&arg) {
           using T = std::decay_t<decltype(arg)>;
           if constexpr (std::is_same_v<T, StringShaderObject>) {
@@ -511,27 +792,14 @@ ShaderObject::Data::reloadIfOutdated(ShaderCompilerQueue &scq)
               auto current_mtime = sys::fs::modificationTime(arg.source.path);
               if (!current_mtime)
                   return ReloadState::Failed;
-              if (*current_mtime != arg.mtime || includesNeedReload(includes))
+              if (*current_mtime != arg.mtime)
                   return ReloadState::Outdated;
-              return ReloadState::Uptodate;
+              return includesNeedReload(includes);
           } else {
               static_assert(always_false<T>::value, "non-exhaustive visitor!");
           }
       },
       object);
-
-    switch (state) {
-    case ReloadState::Failed:
-        [[fallthrough]];
-    case ReloadState::Uptodate:
-        return { nullptr, state };
-    case ReloadState::Outdated:
-        auto new_so = ShaderSource::Data::load(source, scq);
-        if (!new_so)
-            return { nullptr, ReloadState::Failed };
-        return { std::move(new_so), ReloadState::Outdated };
-    }
-    UNREACHABLE;
 }
 
 void
@@ -710,6 +978,12 @@ ShaderCompiler::shaderCache()
     return self->cache;
 }
 
+ShaderFileCache &
+ShaderCompiler::fileCache()
+{
+    return self->fileCache;
+}
+
 void
 ShaderCompiler::init()
 {
@@ -780,24 +1054,7 @@ ShaderCompilerQueue::enqueueReload(const std::shared_ptr<ShaderObject> &so)
     ASSERT(so);
     if (self->inQueue.count(so->shaderSource()->key()) > 0)
         return;
-    auto exec = [so, this]() -> std::shared_ptr<ShaderObject> {
-        sys::io::stdout() << "reloadIfOutdated: " << so->shaderSource()->key()
-                          << "\n";
-        auto [new_so, state] = so->self->reloadIfOutdated(*this);
-        switch (state) {
-        case ReloadState::Uptodate:
-            ASSERT(!new_so);
-            return so;
-        case ReloadState::Outdated:
-            ASSERT(new_so);
-            return { std::move(new_so) };
-        case ReloadState::Failed:
-            ASSERT(!new_so);
-            return so;
-        }
-        UNREACHABLE;
-    };
-    self->toCompile.push({ so->shaderSource(), std::move(exec) });
+    self->toCompile.push({ so->shaderSource(), so });
 }
 
 void
@@ -806,54 +1063,123 @@ ShaderCompilerQueue::enqueueLoad(const std::shared_ptr<ShaderSource> &src)
     ASSERT(src);
     if (self->inQueue.count(src->key()) > 0)
         return;
-    auto exec = [src, this]() -> std::shared_ptr<ShaderObject> {
-        sys::io::stdout() << "load: " << src->key() << "\n";
-        return ShaderSource::Data::load(src, *this);
-    };
-    self->toCompile.push({ src, std::move(exec) });
+    self->toCompile.push({ src, nullptr });
 }
 
 void
 ShaderCompilerQueue::compileAll()
 {
-    for (; !wasError() && !self->toCompile.empty();) {
-
-        auto job = std::move(self->toCompile.front());
-        self->toCompile.pop();
-        const ShaderSourceKey &key = job.source->key();
+    // the queued jobs are processed in rounds: the sources which have to be
+    // (re)loaded are preprocessed in parallel and compiled afterwards, the
+    // dependencies they declare are loaded in the next round
+    while (!wasError() && !self->toCompile.empty()) {
+        std::vector<std::shared_ptr<ShaderObject>> done;
+        std::vector<std::unique_ptr<ShaderSource::Data::Load>> loads;
+        std::unordered_set<ShaderSourceKey> round;
+
+        for (; !wasError() && !self->toCompile.empty();
+             self->toCompile.pop()) {
+            const auto &job = self->toCompile.front();
+            const ShaderSourceKey &key = job.source->key();
+
+            if (self->compiled.count(key) > 0 || !round.insert(key).second)
+                continue;
+
+            auto so = job.current;
+            bool check_outdated = so != nullptr;
+            if (!so && (self->flags & SC_LOOKUP_CACHE)) {
+                so = self->compiler.shaderCache()->lookup(key);
+                ASSERT(!so || key == so->shaderSource()->key());
+                check_outdated = self->flags & SC_CHECK_OUTDATED;
+            }
 
-        auto it = self->compiled.find(key);
-        if (it != self->compiled.end()) {
-            continue;
-        }
+            if (so) {
+                if (job.current)
+                    sys::io::stdout() << "reloadIfOutdated: " << key << "\n";
+                if (!check_outdated ||
+                    so->self->checkOutdated() != ReloadState::Outdated) {
+                    done.push_back(std::move(so));
+                    continue;
+                }
+            } else {
+                sys::io::stdout() << "load: " << key << "\n";
+            }
 
-        std::shared_ptr<ShaderObject> so;
-        bool cache_hit = false;
-        if (self->flags & SC_LOOKUP_CACHE) {
-            if ((so = self->compiler.shaderCache()->lookup(key))) {
-                ASSERT(key == so->shaderSource()->key());
-                cache_hit = true;
-
-                ASSERT(so);
-                if (self->flags & SC_CHECK_OUTDATED)
-                    so = self->reload(so);
+            auto load = ShaderSource::Data::beginLoad(job.source, *this);
+            if (!load) {
+                // a failed reload keeps the current object
+                if (so)
+                    done.push_back(std::move(so));
+                continue;
             }
+            load->fallback = std::move(so);
+            loads.push_back(std::move(load));
         }
 
-        if (!cache_hit)
-            so = job.exec();
+        ShaderSource::Data::preprocessAll(loads);
+
+        for (auto &load : loads) {
+            if (wasError())
+                break;
+            auto so = ShaderSource::Data::finishLoad(*load, *this);
+            if (!so)
+                so = std::move(load->fallback);
+            if (so)
+                done.push_back(std::move(so));
+            else
+                this->pushError(ShaderCompilerError::CompilationFailed);
+        }
 
-        if (!so) {
-            this->pushError(ShaderCompilerError::CompilationFailed);
-        } else {
+        for (auto &so : done) {
             self->put(so);
-
             for (auto &dep : so->self->dependencies)
                 enqueueLoad(dep);
         }
     }
 }
 
+ShaderCompileFlags
+ShaderCompilerQueue::flags() const
+{
+    return self->flags;
+}
+
+bool
+ShaderCompilerQueue::compilePending()
+{
+    for (auto &ent : self->compiled) {
+        auto &so = *ent.second->self;
+        if (!so.compilePending(*this))
+            return false;
+
+        // deferred shaders are cached before they are compiled, while an
+        // asynchronous compile is running they are not shared
+        auto cache = so.cache.lock();
+        if (so.status_pending && cache) {
+            cache->remove(ent.second.get());
+            so.unlinkCache(cache);
+            so.cache_pending = true;
+        }
+    }
+    return true;
+}
+
+bool
+ShaderCompilerQueue::finishCompiles()
+{
+    for (auto &ent : self->compiled) {
+        auto &so = *ent.second->self;
+        if (!so.finishCompile(*this))
+            return false;
+        if (so.cache_pending) {
+            so.cache_pending = false;
+            if (auto cache = self->compiler.shaderCache())
+                cache->put(ent.second);
+        }
+    }
+    return true;
+}
+
 void
 ShaderCompilerQueue::Data::put(const std::shared_ptr<ShaderObject> &so)
 {
@@ -863,19 +1189,13 @@ ShaderCompilerQueue::Data::put(const std::shared_ptr<ShaderObject> &so)
     compiled.insert(std::make_pair(so->shaderSource()->key(), so));
 
     if (flags & SC_PUT_CACHE) {
-        if (auto cache = compiler.shaderCache())
+        // other programs must not pick up a shader which may yet fail to
+        // compile, finishCompiles() shares it once it succeeded
+        if (so->self->status_pending)
+            so->self->cache_pending = true;
+        else if (auto cache = compiler.shaderCache())
             cache->put(so);
     }
 }
 
-std::shared_ptr<ShaderObject>
-ShaderCompilerQueue::Data::reload(const std::shared_ptr<ShaderObject> &so)
-{
-    ASSERT(so);
-    auto new_so = so->self->reloadIfOutdated(self).first;
-    if (!new_so)
-        return so;
-    return new_so;
-}
-
 } // namespace glt
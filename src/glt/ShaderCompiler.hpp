@@ -7,11 +7,14 @@
 #include "err/err.hpp"
 #include "glt/GLObject.hpp"
 #include "glt/ShaderManager.hpp"
+#include "glt/ShaderObjects.hpp"
 #include "opengl.hpp"
 #include "pp/enum.hpp"
 #include "sys/fs.hpp"
+#include "util/Hash128.hpp"
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -20,15 +23,10 @@
 namespace glt {
 
 struct ShaderSource;
-struct ShaderObject;
 struct ShaderCache;
 struct ShaderCompiler;
 struct ShaderCompilerQueue;
-
-using ShaderSourceKey = std::string;
-
-using ShaderObjects =
-  std::unordered_map<ShaderSourceKey, std::shared_ptr<ShaderObject>>;
+struct ShaderFileCache;
 
 using ShaderRootDependencies =
   std::unordered_map<ShaderSourceKey, std::shared_ptr<ShaderSource>>;
@@ -54,11 +52,13 @@ static const ShaderCompileFlags SC_LOOKUP_CACHE = 1 << 0;
 static const ShaderCompileFlags SC_PUT_CACHE = 1 << 1;
 static const ShaderCompileFlags SC_CHECK_OUTDATED =
   1 << 2; // only use cache if file didnt get changed
+static const ShaderCompileFlags SC_ASYNC =
+  1 << 3; // dont wait for the compile status, see finishCompiles()
 
 static const ShaderCompileFlags SC_DEFAULT_FLAGS =
   SC_LOOKUP_CACHE | SC_PUT_CACHE | SC_CHECK_OUTDATED;
 
-enum ReloadState : uint8_t
+enum class ReloadState : uint8_t
 {
     Failed,
     Uptodate,
@@ -67,14 +67,21 @@ enum ReloadState : uint8_t
 
 struct GLT_API ShaderSource : std::enable_shared_from_this<ShaderSource>
 {
-    static std::shared_ptr<ShaderSource> makeStringSource(ShaderType ty,
-                                                          std::string source);
+    // defines are added to the global ones and are part of the key
+    static std::shared_ptr<ShaderSource> makeStringSource(
+      ShaderType ty,
+      std::string source,
+      PreprocessorDefinitions defines = {});
 
-    static std::shared_ptr<ShaderSource> makeFileSource(ShaderType ty,
-                                                        std::string path);
+    static std::shared_ptr<ShaderSource> makeFileSource(
+      ShaderType ty,
+      std::string path,
+      PreprocessorDefinitions defines = {});
 
     const ShaderSourceKey &key() const;
 
+    const PreprocessorDefinitions &defines() const;
+
 private:
     friend struct ShaderCompiler;
     friend struct ShaderCompilerQueue;
@@ -91,6 +98,19 @@ struct GLT_API ShaderObject : std::enable_shared_from_this<ShaderObject>
 {
     const GLShaderObject &handle() const;
     const std::shared_ptr<ShaderSource> &shaderSource();
+
+    GLenum glType() const;
+
+    // hash of the preprocessed source, including the version and the
+    // global defines
+    const Hash128 &codeHash() const;
+
+    // the files the object was preprocessed from, with the modification
+    // times seen then, no source file for embedded code
+    std::optional<ShaderInclude> sourceFile() const;
+    const ShaderIncludes &includes() const;
+    const ShaderDependencies &dependencies() const;
+
     ~ShaderObject();
 
 private:
@@ -143,6 +163,9 @@ struct GLT_API ShaderCompiler
     ShaderManager &shaderManager();
     const std::shared_ptr<ShaderCache> &shaderCache();
 
+    // preprocessed shader files, shared by all shader objects
+    ShaderFileCache &fileCache();
+
     void init();
 
     static bool guessShaderType(std::string_view path, ShaderType *res);
@@ -160,10 +183,21 @@ struct GLT_API ShaderCompilerQueue : public err::WithError<ShaderCompilerError>
 
     ShaderCompiler &shaderCompiler();
 
+    ShaderCompileFlags flags() const;
+
     void enqueueLoad(const std::shared_ptr<ShaderSource> &);
     void enqueueReload(const std::shared_ptr<ShaderObject> &);
     void compileAll();
 
+    // compiles the objects whose compilation was deferred, see
+    // ProgramBinaryCache
+    bool compilePending();
+
+    // queries the status of compilations submitted with SC_ASYNC, blocks
+    // until they are done. With SC_PUT_CACHE such objects enter the shader
+    // cache only here, once they compiled successfully.
+    bool finishCompiles();
+
 private:
     DECLARE_PIMPL(GLT_API, self);
 };
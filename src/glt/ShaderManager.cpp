@@ -1,10 +1,17 @@
 #include "glt/ShaderManager.hpp"
 
+#include "glt/GLSLPreprocessor.hpp"
+#include "glt/ProgramBinaryCache.hpp"
 #include "glt/ShaderCompiler.hpp"
 #include "glt/ShaderProgram.hpp"
+#include "glt/ShaderVariantSet.hpp"
+#include "glt/utils.hpp"
+#include "sys/clock.hpp"
+#include "sys/fs.hpp"
 
 #include <algorithm>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace glt {
 
@@ -15,14 +22,27 @@ PP_DEF_ENUM_IMPL(GLT_SHADER_TYPE_ENUM_DEF);
 using ProgramMap =
   std::unordered_map<std::string, std::shared_ptr<ShaderProgram>>;
 
+using VariantSetMap =
+  std::unordered_map<std::string, std::shared_ptr<ShaderVariantSet>>;
+
 struct ShaderManager::Data : NonCopyable
 {
     sys::io::OutStream *out;
     std::vector<std::string> shaderDirs;
     ProgramMap programs;
+    VariantSetMap variantSets;
     std::shared_ptr<ShaderCache> globalShaderCache;
     PreprocessorDefinitions globalDefines;
     ShaderCompiler shaderCompiler;
+    ProgramBinaryCache programBinaryCache;
+    std::vector<std::shared_ptr<ShaderProgram>> reloading;
+    bool reload_active{ false };
+    double reload_start{};
+    size_t checked_files{};
+    size_t reloaded_objects{};
+    size_t reloads_started{};
+    size_t reloads_failed{};
+    bool compiler_threads_set{ false };
     uint32_t shader_version{};
     ShaderProfile shader_profile{ ShaderProfile::Core };
     ShaderManagerVerbosity verbosity{ ShaderManagerVerbosity::Info };
@@ -34,8 +54,98 @@ struct ShaderManager::Data : NonCopyable
       , globalShaderCache(std::make_shared<ShaderCache>())
       , shaderCompiler(me)
     {}
+
+    // recompiles the shader objects of all programs whose files changed,
+    // each once, and returns the programs using them
+    std::vector<std::shared_ptr<ShaderProgram>> reloadObjects(
+      ShaderObjects &reloaded,
+      bool async);
+
+    void reportReload(sys::io::OutStream &out) const;
 };
 
+std::vector<std::shared_ptr<ShaderProgram>>
+ShaderManager::Data::reloadObjects(ShaderObjects &reloaded, bool async)
+{
+    // reverse dependency index: file -> objects (with the modification
+    // time they saw) -> programs
+    std::unordered_map<std::string,
+                       std::vector<std::pair<ShaderObject *, sys::fs::FileTime>>>
+      files;
+    std::unordered_map<ShaderObject *, std::vector<ShaderProgram *>> users;
+    std::unordered_map<ShaderObject *, std::shared_ptr<ShaderObject>> objects;
+    std::unordered_map<ShaderProgram *, std::shared_ptr<ShaderProgram>> progs;
+
+    for (const auto &ent : programs) {
+        progs[ent.second.get()] = ent.second;
+        for (const auto &[key, so] : ent.second->shaderObjects()) {
+            users[so.get()].push_back(ent.second.get());
+            if (!objects.emplace(so.get(), so).second)
+                continue;
+            if (auto file = so->sourceFile())
+                files[file->first].emplace_back(so.get(), file->second);
+            for (const auto &inc : so->includes())
+                files[inc.first].emplace_back(so.get(), inc.second);
+        }
+    }
+
+    // every file is checked once, however many objects include it
+    checked_files = files.size();
+    std::vector<std::shared_ptr<ShaderObject>> outdated;
+    std::unordered_set<ShaderObject *> seen;
+    for (const auto &[path, objs] : files) {
+        auto mtime = sys::fs::modificationTime(path);
+        if (!mtime)
+            continue; // reloading would fail and keep the object anyway
+        for (const auto &[so, so_mtime] : objs)
+            if (so_mtime != *mtime && seen.insert(so).second)
+                outdated.push_back(objects[so]);
+    }
+
+    // a failed compile stops the queue, the remaining objects are
+    // compiled by a new one
+    const auto flags = SC_DEFAULT_FLAGS | (async ? SC_ASYNC : 0);
+    for (size_t done = 0; done < outdated.size();) {
+        auto scq = ShaderCompilerQueue(shaderCompiler, reloaded, flags);
+        for (const auto &so : outdated)
+            if (reloaded.count(so->shaderSource()->key()) == 0)
+                scq.enqueueReload(so);
+        scq.compileAll();
+
+        auto n = size_t(std::count_if(
+          outdated.begin(), outdated.end(), [&](const auto &so) {
+              return reloaded.count(so->shaderSource()->key()) > 0;
+          }));
+        if (n == done)
+            break;
+        done = n;
+    }
+
+    std::vector<std::shared_ptr<ShaderProgram>> affected;
+    std::unordered_set<ShaderProgram *> affected_set;
+    reloaded_objects = 0;
+    for (const auto &so : outdated) {
+        auto it = reloaded.find(so->shaderSource()->key());
+        if (it == reloaded.end() || it->second == so)
+            continue; // the reload failed, the object is kept
+        ++reloaded_objects;
+        for (auto *prog : users[so.get()])
+            if (affected_set.insert(prog).second)
+                affected.push_back(progs[prog]);
+    }
+    return affected;
+}
+
+void
+ShaderManager::Data::reportReload(sys::io::OutStream &out) const
+{
+    out << "shaders reloaded: " << checked_files << " files checked, "
+        << reloaded_objects << " objects recompiled, "
+        << (reloads_started - reloads_failed) << " of " << reloads_started
+        << " programs relinked ("
+        << ((sys::queryTimer() - reload_start) * 1000) << " ms)\n";
+}
+
 ShaderManager::ShaderManager() : self(new Data(*this))
 {
     self->shaderCompiler.init();
@@ -48,8 +158,12 @@ DECLARE_PIMPL_DEL(ShaderManager)
 void
 ShaderManager::shutdown()
 {
+    self->reloading.clear();
+    self->variantSets.clear();
     self->programs.clear();
     self->globalShaderCache->flush();
+    self->shaderCompiler.fileCache().clear();
+    self->programBinaryCache.close();
 }
 
 void
@@ -112,17 +226,109 @@ ShaderManager::declareProgram(const std::string &name)
     return prog;
 }
 
+std::shared_ptr<ShaderVariantSet>
+ShaderManager::variantSet(const std::string &name) const
+{
+    auto it = self->variantSets.find(name);
+    if (it != self->variantSets.end())
+        return it->second;
+    ERR(("variant set not found: " + name).c_str());
+    return {};
+}
+
+std::shared_ptr<ShaderVariantSet>
+ShaderManager::declareVariantSet(const std::string &name)
+{
+    auto set = std::make_shared<ShaderVariantSet>(*this, name);
+    self->variantSets[name] = set;
+    return set;
+}
+
+bool
+ShaderManager::pollPrewarm()
+{
+    bool pending = false;
+    for (auto &ent : self->variantSets)
+        pending = ent.second->pollPrewarm() || pending;
+    return pending;
+}
+
+void
+ShaderManager::enableParallelCompile()
+{
+    if (GLAD_GL_KHR_parallel_shader_compile && !self->compiler_threads_set) {
+        // let the driver choose the number of compiler threads
+        GL_CALL(glMaxShaderCompilerThreadsKHR, 0xFFFFFFFF);
+        self->compiler_threads_set = true;
+    }
+}
+
 void
 ShaderManager::reloadShaders()
 {
-    const auto n = self->programs.size();
-    auto failed = size_t{ 0 };
-    for (auto &ent : self->programs)
-        if (!ent.second->reload())
-            ++failed;
+    self->reloading.clear();
+    self->reload_active = false;
+    self->reload_start = sys::queryTimer();
+
+    ShaderObjects reloaded;
+    auto affected = self->reloadObjects(reloaded, false);
+    self->reloads_started = affected.size();
+    self->reloads_failed = 0;
+    for (auto &prog : affected)
+        if (!prog->reloadWith(reloaded))
+            ++self->reloads_failed;
+
+    self->reportReload(out());
+}
 
-    out() << "all shaders reloaded (" << (n - failed) << " successful, "
-          << failed << " failed)\n";
+void
+ShaderManager::reloadShadersAsync()
+{
+    enableParallelCompile();
+
+    self->reloading.clear();
+    self->reload_active = true;
+    self->reload_start = sys::queryTimer();
+
+    ShaderObjects reloaded;
+    auto affected = self->reloadObjects(reloaded, true);
+    self->reloads_started = affected.size();
+    self->reloads_failed = 0;
+    for (auto &prog : affected) {
+        if (prog->beginReloadWith(reloaded))
+            self->reloading.push_back(prog);
+        else
+            ++self->reloads_failed;
+    }
+    pollReloads();
+}
+
+bool
+ShaderManager::pollReloads()
+{
+    if (!self->reload_active)
+        return false;
+
+    std::erase_if(self->reloading, [&](const auto &prog) {
+        switch (prog->pollReload().value) {
+        case AsyncReloadState::ReloadPending:
+            return false;
+        case AsyncReloadState::ReloadFailed:
+            ++self->reloads_failed;
+            return true;
+        case AsyncReloadState::NoReload:
+        case AsyncReloadState::Reloaded:
+            return true;
+        }
+        UNREACHABLE;
+    });
+
+    if (!self->reloading.empty())
+        return true;
+
+    self->reload_active = false;
+    self->reportReload(out());
+    return false;
 }
 
 sys::io::OutStream &
@@ -218,6 +424,12 @@ ShaderManager::shaderCompiler()
     return self->shaderCompiler;
 }
 
+ProgramBinaryCache &
+ShaderManager::programBinaryCache()
+{
+    return self->programBinaryCache;
+}
+
 PreprocessorDefinitions &
 ShaderManager::globalDefines()
 {
@@ -13,9 +13,11 @@
 
 namespace glt {
 
+struct ProgramBinaryCache;
 struct ShaderCompiler;
 struct ShaderProgram;
 struct ShaderCache;
+struct ShaderVariantSet;
 
 using PreprocessorDefinitions = std::unordered_map<std::string, std::string>;
 
@@ -47,8 +49,27 @@ struct GLT_API ShaderManager
                     std::shared_ptr<ShaderProgram> &program);
     std::shared_ptr<ShaderProgram> declareProgram(const std::string &name);
 
+    std::shared_ptr<ShaderVariantSet> variantSet(const std::string &name) const;
+    std::shared_ptr<ShaderVariantSet> declareVariantSet(
+      const std::string &name);
+
+    // advances the prewarming of all variant sets, call once per frame,
+    // true while variants are being built
+    bool pollPrewarm();
+
+    // lets the driver compile on its own threads if it supports
+    // KHR_parallel_shader_compile
+    void enableParallelCompile();
+
     void reloadShaders();
 
+    // starts reloading all programs without blocking, the reloads are
+    // completed by pollReloads(), see ShaderProgram::beginReload()
+    void reloadShadersAsync();
+
+    // true while reloads are pending, call once per frame
+    bool pollReloads();
+
     ShaderManagerVerbosity verbosity() const;
     void verbosity(ShaderManagerVerbosity v);
 
@@ -77,6 +98,9 @@ struct GLT_API ShaderManager
 
     ShaderCompiler &shaderCompiler();
 
+    // disabled until opened
+    ProgramBinaryCache &programBinaryCache();
+
     PreprocessorDefinitions &globalDefines();
 
     const PreprocessorDefinitions &globalDefines() const;
@@ -0,0 +1,20 @@
+#ifndef GLT_SHADER_OBJECTS_HPP
+#define GLT_SHADER_OBJECTS_HPP
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace glt {
+
+struct ShaderObject;
+
+using ShaderSourceKey = std::string;
+
+// shader objects by the key of their source, see ShaderCompiler.hpp
+using ShaderObjects =
+  std::unordered_map<ShaderSourceKey, std::shared_ptr<ShaderObject>>;
+
+} // namespace glt
+
+#endif
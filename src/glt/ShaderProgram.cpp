@@ -2,16 +2,23 @@
 
 #include "err/err.hpp"
 #include "err/log.hpp"
+#include "glt/GLStateCache.hpp"
+#include "glt/ProgramBinaryCache.hpp"
 #include "glt/ShaderCompiler.hpp"
 #include "glt/ShaderManager.hpp"
+#include "glt/Uniforms.hpp"
+#include "glt/glt.hpp"
 #include "glt/utils.hpp"
 #include "opengl.hpp"
+#include "sys/clock.hpp"
 #include "sys/fs.hpp"
 #include "sys/measure.hpp"
 #include "util/range.hpp"
 #include "util/string.hpp"
 
+#include <algorithm>
 #include <unordered_map>
+#include <vector>
 
 #define RAISE_ERR(sender, ec, msg) LOG_RAISE_ERROR(sender, ec, msg)
 
@@ -29,9 +36,19 @@ struct LogTraits<glt::ShaderProgram>
 namespace glt {
 
 PP_DEF_ENUM_IMPL(GLT_SHADER_PROGRAM_ERROR_ENUM_DEF);
+PP_DEF_ENUM_IMPL(GLT_ASYNC_RELOAD_STATE_ENUM_DEF);
 
 using Attributes = std::unordered_map<std::string, GLuint>;
 
+struct UniformBlockBinding
+{
+    GLuint binding;
+    size_t size;
+};
+
+using UniformBlockBindings =
+  std::unordered_map<std::string, UniformBlockBinding>;
+
 struct ShaderProgram::Data
 {
     ShaderProgram &self;
@@ -39,17 +56,63 @@ struct ShaderProgram::Data
     ShaderObjects shaders;
     ShaderRootDependencies rootdeps;
     Attributes attrs;
+    std::vector<std::string> varyings;
+    UniformBlockBindings blocks;
+    PreprocessorDefinitions defines;
     GLProgramObject program{ 0 };
     bool linked{ false };
+    bool async_compile{ false };
+    UniformCache uniforms;
+
+    // state of a submitted link, see submitLink()
+    bool link_submitted{ false };
+    double link_start{};
+    double compile_time{};
+    Hash128 binary_key;
+
+    // replacement being linked by beginReload()
+    std::unique_ptr<ShaderProgram> pending;
 
     Data(ShaderProgram &owner, ShaderManager &_sm) : self(owner), sm(_sm) {}
 
     Data(ShaderProgram &owner, const Data &rhs)
-      : self(owner), sm(rhs.sm), rootdeps(rhs.rootdeps), attrs(rhs.attrs)
+      : self(owner)
+      , sm(rhs.sm)
+      , rootdeps(rhs.rootdeps)
+      , attrs(rhs.attrs)
+      , varyings(rhs.varyings)
+      , blocks(rhs.blocks)
+      , defines(rhs.defines)
+      , async_compile(rhs.async_compile)
     {}
 
     bool createProgram();
 
+    // compiles deferred shaders and starts linking, without waiting for
+    // the driver if async
+    bool submitLink(bool async);
+
+    // false while an asynchronous link is still running
+    bool linkCompleted();
+
+    // waits for the submitted link and checks the result
+    bool finishLink();
+
+    bool sameShaders(const ShaderObjects &other) const;
+
+    // the shaders with the reloaded ones swapped in, dependencies new to
+    // the program are loaded
+    bool collectShaders(const ShaderObjects &reloaded,
+                        ShaderObjects &newshaders,
+                        ShaderCompileFlags flags);
+
+    void initLinked();
+
+    Hash128 binaryKey(const Hash128 &driver) const;
+
+    bool applyUniformBlock(const std::string &name,
+                           const UniformBlockBinding &b);
+
     static void printProgramLog(GLuint progh, sys::io::OutStream &out);
 
     void handleCompileError(ShaderCompilerError /*unused*/);
@@ -64,7 +127,16 @@ struct ShaderProgram::Data
         swap(shaders, rhs.shaders);
         swap(rootdeps, rhs.rootdeps);
         swap(attrs, rhs.attrs);
+        swap(varyings, rhs.varyings);
+        swap(blocks, rhs.blocks);
+        swap(defines, rhs.defines);
+        swap(async_compile, rhs.async_compile);
         swap(linked, rhs.linked);
+        swap(uniforms, rhs.uniforms);
+        swap(link_submitted, rhs.link_submitted);
+        swap(link_start, rhs.link_start);
+        swap(compile_time, rhs.compile_time);
+        swap(binary_key, rhs.binary_key);
     }
 };
 
@@ -82,16 +154,24 @@ ShaderProgram::~ShaderProgram()
 void
 ShaderProgram::reset()
 {
+    self->pending.reset();
+    self->link_submitted = false;
     self->program.release();
     self->shaders.clear();
     self->rootdeps.clear();
     self->attrs.clear();
+    self->varyings.clear();
+    self->blocks.clear();
+    self->defines.clear();
+    self->uniforms.clear();
     clearError();
 }
 
 bool
 ShaderProgram::reload()
 {
+    self->pending.reset();
+
     ShaderObjects newshaders;
     auto scq = ShaderCompilerQueue(self->sm.shaderCompiler(), newshaders);
 
@@ -102,19 +182,7 @@ ShaderProgram::reload()
     if (scq.wasError())
         return false;
 
-    auto unchanged = newshaders.size() == self->shaders.size();
-    if (unchanged) {
-        for (auto it1 = self->shaders.begin(), it2 = newshaders.begin();
-             it1 != self->shaders.end() && it2 != newshaders.end();
-             ++it1, ++it2) {
-            if (it1->second != it2->second) {
-                unchanged = false;
-                break;
-            }
-        }
-    }
-
-    if (unchanged)
+    if (self->sameShaders(newshaders))
         return true;
 
     ShaderProgram new_prog(*this->self);
@@ -130,6 +198,12 @@ ShaderProgram::shaderManager()
     return self->sm;
 }
 
+const ShaderObjects &
+ShaderProgram::shaderObjects() const
+{
+    return self->shaders;
+}
+
 GLProgramObject &
 ShaderProgram::program()
 {
@@ -137,6 +211,24 @@ ShaderProgram::program()
     return self->program;
 }
 
+void
+ShaderProgram::defines(PreprocessorDefinitions defs)
+{
+    self->defines = std::move(defs);
+}
+
+const PreprocessorDefinitions &
+ShaderProgram::defines() const
+{
+    return self->defines;
+}
+
+void
+ShaderProgram::asyncCompile(bool async)
+{
+    self->async_compile = async;
+}
+
 bool
 ShaderProgram::Data::createProgram()
 {
@@ -149,6 +241,99 @@ ShaderProgram::Data::createProgram()
     return true;
 }
 
+bool
+ShaderProgram::Data::sameShaders(const ShaderObjects &other) const
+{
+    if (other.size() != shaders.size())
+        return false;
+    for (auto it1 = shaders.begin(), it2 = other.begin();
+         it1 != shaders.end() && it2 != other.end();
+         ++it1, ++it2)
+        if (it1->second != it2->second)
+            return false;
+    return true;
+}
+
+void
+ShaderProgram::Data::initLinked()
+{
+    linked = true;
+    uniforms.clear();
+    for (const auto &ent : blocks)
+        applyUniformBlock(ent.first, ent.second);
+}
+
+Hash128
+ShaderProgram::Data::binaryKey(const Hash128 &driver) const
+{
+    // the global defines and the shader version are part of the
+    // preprocessed sources
+    std::vector<std::pair<GLenum, Hash128>> code;
+    code.reserve(shaders.size());
+    for (const auto &ent : shaders)
+        code.emplace_back(ent.second->glType(), ent.second->codeHash());
+    std::sort(code.begin(), code.end());
+
+    std::vector<std::pair<std::string, GLuint>> sorted_attrs(attrs.begin(),
+                                                             attrs.end());
+    std::sort(sorted_attrs.begin(), sorted_attrs.end());
+
+    Hasher128 h;
+    h.value(driver);
+    h.value(uint64_t(code.size()));
+    for (const auto &[type, hash] : code) {
+        h.value(type);
+        h.value(hash);
+    }
+    h.value(uint64_t(sorted_attrs.size()));
+    for (const auto &[name, index] : sorted_attrs) {
+        h.field(name);
+        h.value(index);
+    }
+    h.value(uint64_t(varyings.size()));
+    for (const auto &var : varyings)
+        h.field(var);
+    return h.finish();
+}
+
+bool
+ShaderProgram::Data::applyUniformBlock(const std::string &name,
+                                       const UniformBlockBinding &b)
+{
+    GLuint index;
+    GL_ASSIGN_CALL(index, glGetUniformBlockIndex, *program, name.c_str());
+    if (index == GL_INVALID_INDEX) {
+        RAISE_ERR(self,
+                  ShaderProgramError::UniformNotKnown,
+                  "unknown uniform block: " + name);
+        return false;
+    }
+
+    // the null driver knows no block sizes
+    if (b.size != 0 && glBackend() != GLBackend::Null) {
+        GLint size = 0;
+        GL_CALL(glGetActiveUniformBlockiv,
+                *program,
+                index,
+                GL_UNIFORM_BLOCK_DATA_SIZE,
+                &size);
+        if (size_t(size) != b.size) {
+            RAISE_ERR(self,
+                      ShaderProgramError::APIError,
+                      string_concat("uniform block ",
+                                    name,
+                                    ": size mismatch, expected ",
+                                    b.size,
+                                    " got ",
+                                    size));
+            return false;
+        }
+    }
+
+    GL_CALL(glUniformBlockBinding, *program, index, b.binding);
+    return true;
+}
+
 void
 ShaderProgram::Data::printProgramLog(GLuint progh, sys::io::OutStream &out)
 {
@@ -186,8 +371,11 @@ ShaderProgram::Data::handleCompileError(ShaderCompilerError err)
 bool
 ShaderProgram::addShaderSrc(const std::string &src, ShaderType type)
 {
-    auto scq = ShaderCompilerQueue(self->sm.shaderCompiler(), self->shaders);
-    auto source = ShaderSource::makeStringSource(type, src);
+    auto scq = ShaderCompilerQueue(self->sm.shaderCompiler(),
+                                   self->shaders,
+                                   SC_DEFAULT_FLAGS |
+                                     (self->async_compile ? SC_ASYNC : 0));
+    auto source = ShaderSource::makeStringSource(type, src, self->defines);
 
     {
         self->rootdeps.insert(std::make_pair(source->key(), source));
@@ -225,8 +413,11 @@ ShaderProgram::addShaderFile(const std::string &file0,
     file = sys::fs::absolutePath(file);
     ASSERT(!file.empty());
 
-    auto scq = ShaderCompilerQueue(self->sm.shaderCompiler(), self->shaders);
-    auto source = ShaderSource::makeFileSource(type, file);
+    auto scq = ShaderCompilerQueue(self->sm.shaderCompiler(),
+                                   self->shaders,
+                                   SC_DEFAULT_FLAGS |
+                                     (self->async_compile ? SC_ASYNC : 0));
+    auto source = ShaderSource::makeFileSource(type, file, self->defines);
 
     {
         self->rootdeps.insert(std::make_pair(source->key(), source));
@@ -268,66 +459,278 @@ ShaderProgram::tryLink()
 bool
 ShaderProgram::link()
 {
+    if (!self->submitLink(false))
+        return false;
+    return self->linked || self->finishLink();
+}
 
-    if (self->shaders.empty()) {
-        RAISE_ERR(*this,
+bool
+ShaderProgram::beginLink()
+{
+    return !wasError() && self->submitLink(true);
+}
+
+bool
+ShaderProgram::linkReady()
+{
+    return self->linked || self->linkCompleted();
+}
+
+bool
+ShaderProgram::Data::submitLink(bool async)
+{
+    if (shaders.empty()) {
+        RAISE_ERR(self,
                   ShaderProgramError::LinkageFailed,
                   "no shader objects to link");
         return false;
     }
 
-    if (!self->createProgram())
+    if (!createProgram())
         return false;
 
-    if (self->linked)
+    if (linked || link_submitted)
         return true;
 
-    for (auto it = self->attrs.begin(); it != self->attrs.end(); ++it) {
-        GL_CALL(
-          glBindAttribLocation, *self->program, it->second, it->first.c_str());
+    for (auto it = attrs.begin(); it != attrs.end(); ++it) {
+        GL_CALL(glBindAttribLocation, *program, it->second, it->first.c_str());
         // FIXME: check wether attrib was added correctly
     }
 
-    std::vector<GLuint> added;
-    for (auto it = self->shaders.begin(); it != self->shaders.end(); ++it) {
-        GL_CALL(glAttachShader, *self->program, *it->second->handle());
-        added.push_back(*it->second->handle());
+    if (!varyings.empty()) {
+        std::vector<const char *> cvars;
+        cvars.reserve(varyings.size());
+        for (const auto &var : varyings)
+            cvars.push_back(var.c_str());
+        GL_CALL(glTransformFeedbackVaryings,
+                *program,
+                GLsizei(cvars.size()),
+                cvars.data(),
+                GL_INTERLEAVED_ATTRIBS);
     }
 
+    auto &binary_cache = sm.programBinaryCache();
+    compile_time = 0;
+    if (binary_cache.enabled()) {
+        binary_key = binaryKey(binary_cache.driverKey());
+        if (binary_cache.load(binary_key, *program)) {
+            auto logmsg = err::beginLog(self, err::LogLevel::Info);
+            logmsg << "linked from program binary " << binary_key.hex()
+                   << "\n";
+            initLinked();
+            return true;
+        }
+    }
+
+    // compilation is deferred while the binary cache is enabled
+    auto scq = ShaderCompilerQueue(
+      sm.shaderCompiler(), shaders, SC_DEFAULT_FLAGS | (async ? SC_ASYNC : 0));
+    bool compiled;
+    measure_time(compile_time, compiled = scq.compilePending());
+    if (compiled && !async)
+        compiled = scq.finishCompiles();
+    if (!compiled) {
+        handleCompileError(scq.getError());
+        return false;
+    }
+
+    if (binary_cache.enabled())
+        GL_CALL(glProgramParameteri,
+                *program,
+                GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                GL_TRUE);
+
+    for (auto it = shaders.begin(); it != shaders.end(); ++it)
+        GL_CALL(glAttachShader, *program, *it->second->handle());
+
+    link_start = sys::queryTimer();
+    GL_CALL(glLinkProgram, *program);
+    link_submitted = true;
+    return true;
+}
+
+bool
+ShaderProgram::Data::linkCompleted()
+{
+    if (!link_submitted || !GLAD_GL_KHR_parallel_shader_compile)
+        return true;
+    GLint done = GL_FALSE;
+    GL_CALL(glGetProgramiv, *program, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+bool
+ShaderProgram::Data::finishLink()
+{
+    ASSERT(link_submitted);
+    link_submitted = false;
+
+    // shaders compiled asynchronously are checked only now
+    auto scq = ShaderCompilerQueue(sm.shaderCompiler(), shaders);
+    bool compiled = scq.finishCompiles();
+
     bool ok{};
+    double wct{};
     {
-        auto logmsg = err::beginLog(*this, err::LogLevel::Info);
+        auto logmsg = err::beginLog(self, err::LogLevel::Info);
         logmsg << "linking ... ";
 
-        double wct;
-        measure_time(wct, glLinkProgram(*self->program));
-        GL_CHECK_ERRORS();
-
         GLint success;
-        GL_CALL(glGetProgramiv, *self->program, GL_LINK_STATUS, &success);
-        ok = gl_unbool(success);
+        GL_CALL(glGetProgramiv, *program, GL_LINK_STATUS, &success);
+        wct = sys::queryTimer() - link_start;
+        ok = compiled && gl_unbool(success);
         logmsg << (ok ? "success" : "failed") << " (" << (wct * 1000) << " ms)"
                << "\n";
 
         if (!ok) {
-            pushError(ShaderProgramError::LinkageFailed);
-
-            for (size_t i = 0; i < added.size(); ++i)
-                GL_CALL(glDetachShader, *self->program, added[size_t(i)]);
+            if (!compiled)
+                handleCompileError(scq.getError());
+            else
+                self.pushError(ShaderProgramError::LinkageFailed);
+
+            for (auto it = shaders.begin(); it != shaders.end(); ++it)
+                if (it->second->handle().valid())
+                    GL_CALL(glDetachShader, *program, *it->second->handle());
         }
     }
 
     auto logmsg =
-      err::beginLog(*this, ok ? err::LogLevel::Info : err::LogLevel::Error);
+      err::beginLog(self, ok ? err::LogLevel::Info : err::LogLevel::Error);
     if (logmsg)
-        self->printProgramLog(*self->program, logmsg.out());
+        printProgramLog(*program, logmsg.out());
 
-    if (ok)
-        self->linked = true;
+    if (ok) {
+        initLinked();
+        auto &binary_cache = sm.programBinaryCache();
+        if (binary_cache.enabled())
+            binary_cache.store(binary_key, *program, compile_time + wct);
+    }
 
     return ok;
 }
 
+bool
+ShaderProgram::beginReload()
+{
+    self->pending.reset();
+
+    ShaderObjects newshaders;
+    auto scq = ShaderCompilerQueue(
+      self->sm.shaderCompiler(), newshaders, SC_DEFAULT_FLAGS | SC_ASYNC);
+
+    for (const auto &ent : self->rootdeps)
+        scq.enqueueReload(self->shaders[ent.first]);
+
+    scq.compileAll();
+    if (scq.wasError())
+        return false;
+
+    if (self->sameShaders(newshaders))
+        return true;
+
+    auto new_prog = std::unique_ptr<ShaderProgram>(new ShaderProgram(*self));
+    new_prog->self->shaders = newshaders;
+    if (!new_prog->self->submitLink(true))
+        return false;
+    self->pending = std::move(new_prog);
+    return true;
+}
+
+bool
+ShaderProgram::Data::collectShaders(const ShaderObjects &reloaded,
+                                    ShaderObjects &newshaders,
+                                    ShaderCompileFlags flags)
+{
+    auto scq = ShaderCompilerQueue(sm.shaderCompiler(), newshaders, flags);
+    std::vector<std::shared_ptr<ShaderObject>> todo;
+
+    auto visit = [&](const std::shared_ptr<ShaderSource> &src) {
+        const auto &key = src->key();
+        if (newshaders.count(key) > 0)
+            return;
+        std::shared_ptr<ShaderObject> so;
+        if (auto it = reloaded.find(key); it != reloaded.end())
+            so = it->second;
+        else if (auto it2 = shaders.find(key); it2 != shaders.end())
+            so = it2->second;
+        if (!so) {
+            scq.enqueueLoad(src);
+            return;
+        }
+        newshaders[key] = so;
+        todo.push_back(std::move(so));
+    };
+
+    for (const auto &ent : rootdeps)
+        visit(ent.second);
+    while (!todo.empty()) {
+        auto so = std::move(todo.back());
+        todo.pop_back();
+        for (const auto &dep : so->dependencies())
+            visit(dep);
+    }
+
+    scq.compileAll();
+    return !scq.wasError();
+}
+
+bool
+ShaderProgram::reloadWith(const ShaderObjects &reloaded)
+{
+    self->pending.reset();
+
+    ShaderObjects newshaders;
+    if (!self->collectShaders(reloaded, newshaders, SC_DEFAULT_FLAGS))
+        return false;
+
+    if (self->sameShaders(newshaders))
+        return true;
+
+    ShaderProgram new_prog(*this->self);
+    new_prog.self->shaders = newshaders;
+    if (new_prog.tryLink())
+        return replaceWith(new_prog);
+    return false;
+}
+
+bool
+ShaderProgram::beginReloadWith(const ShaderObjects &reloaded)
+{
+    self->pending.reset();
+
+    ShaderObjects newshaders;
+    if (!self->collectShaders(
+          reloaded, newshaders, SC_DEFAULT_FLAGS | SC_ASYNC))
+        return false;
+
+    if (self->sameShaders(newshaders))
+        return true;
+
+    auto new_prog = std::unique_ptr<ShaderProgram>(new ShaderProgram(*self));
+    new_prog->self->shaders = newshaders;
+    if (!new_prog->self->submitLink(true))
+        return false;
+    self->pending = std::move(new_prog);
+    return true;
+}
+
+AsyncReloadState
+ShaderProgram::pollReload()
+{
+    if (!self->pending)
+        return AsyncReloadState::NoReload;
+
+    auto &p = *self->pending->self;
+    if (!p.linked && !p.linkCompleted())
+        return AsyncReloadState::ReloadPending;
+
+    auto new_prog = std::move(self->pending);
+    if (!p.linked && !p.finishLink())
+        return AsyncReloadState::ReloadFailed;
+    return replaceWith(*new_prog) ? AsyncReloadState::Reloaded
+                                  : AsyncReloadState::ReloadFailed;
+}
+
 bool
 ShaderProgram::bindAttribute(const std::string &s, GLuint position)
 {
@@ -356,7 +759,7 @@ ShaderProgram::use()
           << "\n";
     }
 
-    GL_CALL(glUseProgram, *self->program);
+    stateCache().useProgram(*self->program);
 }
 
 bool
@@ -388,6 +791,12 @@ ShaderProgram::uniformLocation(const std::string &name)
     return loc;
 }
 
+UniformCache &
+ShaderProgram::uniformCache()
+{
+    return self->uniforms;
+}
+
 bool
 ShaderProgram::validate(bool printLogOnError)
 {
@@ -425,25 +834,27 @@ ShaderProgram::bindAttributes(const StructInfo &si)
 }
 
 bool
-ShaderProgram::bindStreamOutVaryings(std::span<const std::string> vars)
+ShaderProgram::bindUniformBlock(const std::string &block_name,
+                                GLuint binding,
+                                size_t size)
 {
+    auto b = UniformBlockBinding{ binding, size };
+    self->blocks[block_name] = b;
+    if (!self->linked)
+        return true;
+    return self->applyUniformBlock(block_name, b);
+}
 
-    // FIXME: record vars to set stream out varyings again if relinked
-
+bool
+ShaderProgram::bindStreamOutVaryings(std::span<const std::string> vars)
+{
     if (self->linked) {
         RAISE_ERR(*this, ShaderProgramError::APIError, "program alredy linked");
         return false;
     }
 
-    std::vector<const char *> cvars;
-    cvars.reserve(vars.size());
-    for (const auto &var : vars)
-        cvars.push_back(var.c_str());
-    GL_CALL(glTransformFeedbackVaryings,
-            *program(),
-            GLsizei(vars.size()),
-            &cvars[0],
-            GL_INTERLEAVED_ATTRIBS);
+    // applied when linking, they are part of the program binary key
+    self->varyings.assign(vars.begin(), vars.end());
     return true;
 }
 
@@ -6,11 +6,13 @@
 #include "err/WithError.hpp"
 #include "glt/GLObject.hpp"
 #include "glt/ShaderManager.hpp"
+#include "glt/ShaderObjects.hpp"
 #include "glt/conf.hpp"
 #include "glt/type_info.hpp"
 #include "opengl.hpp"
 #include "pp/enum.hpp"
 
+#include <memory>
 #include <span>
 
 namespace glt {
@@ -24,6 +26,15 @@ namespace glt {
 
 PP_DEF_ENUM_WITH_API(GLT_API, GLT_SHADER_PROGRAM_ERROR_ENUM_DEF);
 
+#define GLT_ASYNC_RELOAD_STATE_ENUM_DEF(T, V0, V)                              \
+    T(AsyncReloadState,                                                        \
+      uint8_t,                                                                 \
+      V0(NoReload) V(ReloadPending) V(Reloaded) V(ReloadFailed))
+
+PP_DEF_ENUM_WITH_API(GLT_API, GLT_ASYNC_RELOAD_STATE_ENUM_DEF);
+
+struct UniformCache;
+
 struct GLT_API ShaderProgram
   : public std::enable_shared_from_this<ShaderProgram>
   , public err::WithError<ShaderProgramError>
@@ -35,6 +46,17 @@ struct GLT_API ShaderProgram
 
     GLProgramObject &program();
 
+    // the linked shaders, including #need dependencies
+    const ShaderObjects &shaderObjects() const;
+
+    // added to the global defines of the shaders added afterwards
+    void defines(PreprocessorDefinitions);
+    const PreprocessorDefinitions &defines() const;
+
+    // shaders added afterwards are compiled without waiting for the
+    // driver, compile errors are reported when linking
+    void asyncCompile(bool);
+
     bool addShaderSrc(const std::string &src, ShaderType type);
 
     bool addShaderFile(const std::string &file,
@@ -53,6 +75,13 @@ struct GLT_API ShaderProgram
 
     bool bindAttributes(const StructInfo &);
 
+    // assigns the named uniform block to a binding point, the binding is
+    // reapplied whenever the program is relinked. If size is nonzero the
+    // block size reported by the program is checked against it.
+    bool bindUniformBlock(const std::string &block_name,
+                          GLuint binding,
+                          size_t size = 0);
+
     template<typename VertexType>
     bool bindAttributes()
     {
@@ -63,16 +92,38 @@ struct GLT_API ShaderProgram
 
     bool link();
 
+    // starts linking without waiting for the driver, link() completes it
+    bool beginLink();
+
+    // true if link() would not block
+    bool linkReady();
+
     void use();
 
     void reset();
 
     bool reload();
 
+    // Like reload(), but the changed shaders are compiled and linked
+    // without waiting for the driver, the current program stays in use
+    // until pollReload() finds the replacement ready. Without
+    // KHR_parallel_shader_compile the first poll blocks.
+    bool beginReload();
+
+    AsyncReloadState pollReload();
+
+    // like reload() and beginReload(), but the shaders are not checked:
+    // the ones in reloaded replace those with the same key, see
+    // ShaderManager::reloadShaders()
+    bool reloadWith(const ShaderObjects &reloaded);
+    bool beginReloadWith(const ShaderObjects &reloaded);
+
     bool replaceWith(ShaderProgram &new_program);
 
     GLint uniformLocation(const std::string &name);
 
+    UniformCache &uniformCache();
+
     bool validate(bool printLogOnError = true);
 
     std::shared_ptr<ShaderProgram> get_shared_ptr()
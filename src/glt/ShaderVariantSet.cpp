@@ -0,0 +1,425 @@
+#include "glt/ShaderVariantSet.hpp"
+
+#include "err/err.hpp"
+#include "glt/ShaderProgram.hpp"
+#include "util/range.hpp"
+#include "util/string.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <unordered_map>
+
+namespace glt {
+
+namespace {
+
+// builds started per pollPrewarm(), the driver needs the GL thread for
+// at least part of each compile
+constexpr size_t MAX_PREWARM_STARTS = 4;
+
+struct TemplateShader
+{
+    std::string source; // path or code
+    ShaderType type;
+    bool is_file;
+    bool absolute;
+};
+
+struct TemplateBlock
+{
+    std::string name;
+    GLuint binding;
+    size_t size;
+};
+
+struct VariantKey
+{
+    std::string define;
+    std::vector<std::string> values; // empty for flags
+    uint32_t shift;
+    uint32_t bits;
+
+    ShaderVariantMask field(ShaderVariantMask mask) const
+    {
+        return (mask >> shift) & ((ShaderVariantMask(1) << bits) - 1);
+    }
+};
+
+enum class VariantState : uint8_t
+{
+    Unbuilt,
+    Queued,
+    Building,
+    Ready,
+    Failed
+};
+
+struct Variant
+{
+    std::shared_ptr<ShaderProgram> program;
+    VariantState state{ VariantState::Unbuilt };
+};
+
+uint32_t
+bitsFor(size_t nvalues)
+{
+    uint32_t bits = 0;
+    while ((size_t(1) << bits) < nvalues)
+        ++bits;
+    return bits;
+}
+
+} // namespace
+
+struct ShaderVariantSet::Data
+{
+    ShaderManager &sm;
+    const std::string name;
+    std::vector<TemplateShader> shaders;
+    std::vector<std::pair<std::string, GLuint>> attrs;
+    std::vector<TemplateBlock> blocks;
+    std::vector<VariantKey> keys;
+    uint32_t bits = 0;
+    bool frozen = false; // a variant was requested, the keys are fixed
+
+    std::unordered_map<ShaderVariantMask, Variant> variants;
+    std::deque<ShaderVariantMask> queue;
+
+    Data(ShaderManager &sm_, std::string nam) : sm(sm_), name(std::move(nam))
+    {}
+
+    const VariantKey *findKey(const std::string &define) const
+    {
+        auto it = std::find_if(keys.begin(), keys.end(), [&](const auto &k) {
+            return k.define == define;
+        });
+        return it == keys.end() ? nullptr : &*it;
+    }
+
+    bool addKey(const std::string &define,
+                std::vector<std::string> values,
+                uint32_t nbits);
+
+    bool validMask(ShaderVariantMask mask) const;
+
+    std::string variantName(ShaderVariantMask mask) const;
+
+    PreprocessorDefinitions defines(ShaderVariantMask mask) const;
+
+    std::shared_ptr<ShaderProgram> build(ShaderVariantMask mask, bool async);
+
+    void finish(ShaderVariantMask mask, Variant &v);
+};
+
+DECLARE_PIMPL_DEL(ShaderVariantSet)
+
+ShaderVariantSet::ShaderVariantSet(ShaderManager &sm, std::string name)
+  : self(new Data(sm, std::move(name)))
+{}
+
+ShaderVariantSet::~ShaderVariantSet() = default;
+
+ShaderManager &
+ShaderVariantSet::shaderManager()
+{
+    return self->sm;
+}
+
+const std::string &
+ShaderVariantSet::name() const
+{
+    return self->name;
+}
+
+void
+ShaderVariantSet::addShaderSrc(const std::string &src, ShaderType type)
+{
+    self->shaders.push_back({ src, type, false, false });
+}
+
+void
+ShaderVariantSet::addShaderFile(const std::string &file,
+                                ShaderType type,
+                                bool absolute)
+{
+    self->shaders.push_back({ file, type, true, absolute });
+}
+
+void
+ShaderVariantSet::addShaderFilePair(const std::string &basename,
+                                    bool absolute)
+{
+    addShaderFile(basename + ".vert", ShaderType::VertexShader, absolute);
+    addShaderFile(basename + ".frag", ShaderType::FragmentShader, absolute);
+}
+
+void
+ShaderVariantSet::bindAttribute(const std::string &name, GLuint position)
+{
+    self->attrs.emplace_back(name, position);
+}
+
+void
+ShaderVariantSet::bindAttributes(const StructInfo &si)
+{
+    for (const auto [i, a] : enumerate(si.fields))
+        bindAttribute(a.name, GLuint(i));
+}
+
+void
+ShaderVariantSet::bindUniformBlock(const std::string &block_name,
+                                   GLuint binding,
+                                   size_t size)
+{
+    self->blocks.push_back({ block_name, binding, size });
+}
+
+bool
+ShaderVariantSet::Data::addKey(const std::string &define,
+                               std::vector<std::string> values,
+                               uint32_t nbits)
+{
+    if (frozen) {
+        ERR("variant keys must be declared before the first variant is "
+            "built: " +
+            define);
+        return false;
+    }
+    if (findKey(define)) {
+        ERR("variant key declared twice: " + define);
+        return false;
+    }
+    if (bits + nbits > 64) {
+        ERR("too many variant keys, the mask has 64 bits: " + define);
+        return false;
+    }
+    keys.push_back({ define, std::move(values), bits, nbits });
+    bits += nbits;
+    return true;
+}
+
+ShaderVariantMask
+ShaderVariantSet::addFlag(const std::string &define)
+{
+    if (!self->addKey(define, {}, 1))
+        return 0;
+    return ShaderVariantMask(1) << self->keys.back().shift;
+}
+
+ShaderVariantMask
+ShaderVariantSet::addOption(const std::string &define,
+                            std::vector<std::string> values)
+{
+    if (values.size() < 2) {
+        ERR("variant option needs at least two values: " + define);
+        return 0;
+    }
+    auto nbits = bitsFor(values.size());
+    if (!self->addKey(define, std::move(values), nbits))
+        return 0;
+    const auto &key = self->keys.back();
+    return ((ShaderVariantMask(1) << key.bits) - 1) << key.shift;
+}
+
+ShaderVariantMask
+ShaderVariantSet::flag(const std::string &define) const
+{
+    auto key = self->findKey(define);
+    if (!key || !key->values.empty()) {
+        ERR("unknown variant flag: " + define);
+        return 0;
+    }
+    return ShaderVariantMask(1) << key->shift;
+}
+
+ShaderVariantMask
+ShaderVariantSet::option(const std::string &define,
+                         const std::string &value) const
+{
+    auto key = self->findKey(define);
+    if (!key || key->values.empty()) {
+        ERR("unknown variant option: " + define);
+        return 0;
+    }
+    auto it = std::find(key->values.begin(), key->values.end(), value);
+    if (it == key->values.end()) {
+        ERR("unknown value of variant option " + define + ": " + value);
+        return 0;
+    }
+    return ShaderVariantMask(it - key->values.begin()) << key->shift;
+}
+
+bool
+ShaderVariantSet::Data::validMask(ShaderVariantMask mask) const
+{
+    if (bits < 64 && (mask >> bits) != 0)
+        return false;
+    for (const auto &key : keys)
+        if (!key.values.empty() && key.field(mask) >= key.values.size())
+            return false;
+    return true;
+}
+
+std::string
+ShaderVariantSet::Data::variantName(ShaderVariantMask mask) const
+{
+    char hex[16];
+    auto [end, ec] = std::to_chars(hex, hex + sizeof hex, mask, 16);
+    ASSERT(ec == std::errc{});
+    return string_concat(
+      name, "{", std::string_view(hex, size_t(end - hex)), "}");
+}
+
+PreprocessorDefinitions
+ShaderVariantSet::Data::defines(ShaderVariantMask mask) const
+{
+    PreprocessorDefinitions defs;
+    for (const auto &key : keys) {
+        auto field = key.field(mask);
+        if (key.values.empty())
+            defs[key.define] = field ? "1" : "0";
+        else if (field < key.values.size())
+            defs[key.define] = key.values[field];
+    }
+    return defs;
+}
+
+PreprocessorDefinitions
+ShaderVariantSet::defines(ShaderVariantMask mask) const
+{
+    return self->defines(mask);
+}
+
+std::shared_ptr<ShaderProgram>
+ShaderVariantSet::Data::build(ShaderVariantMask mask, bool async)
+{
+    auto prog = std::make_shared<ShaderProgram>(sm);
+    prog->defines(defines(mask));
+    prog->asyncCompile(async);
+
+    for (const auto &[attr, index] : attrs)
+        prog->bindAttribute(attr, index);
+
+    for (const auto &shader : shaders) {
+        bool ok = shader.is_file
+                    ? prog->addShaderFile(
+                        shader.source, shader.type, shader.absolute)
+                    : prog->addShaderSrc(shader.source, shader.type);
+        if (!ok) {
+            ERR("couldnt build shader variant: " + variantName(mask));
+            return nullptr;
+        }
+    }
+
+    for (const auto &block : blocks)
+        prog->bindUniformBlock(block.name, block.binding, block.size);
+
+    if (!(async ? prog->beginLink() : prog->tryLink())) {
+        ERR("couldnt link shader variant: " + variantName(mask));
+        return nullptr;
+    }
+    return prog;
+}
+
+void
+ShaderVariantSet::Data::finish(ShaderVariantMask mask, Variant &v)
+{
+    if (v.program->link()) {
+        v.state = VariantState::Ready;
+        sm.addProgram(variantName(mask), v.program);
+        return;
+    }
+
+    ERR("couldnt link shader variant: " + variantName(mask));
+    v.state = VariantState::Failed;
+    v.program.reset();
+}
+
+std::shared_ptr<ShaderProgram>
+ShaderVariantSet::program(ShaderVariantMask mask)
+{
+    if (!self->validMask(mask)) {
+        ERR("invalid shader variant mask: " + self->variantName(mask));
+        return nullptr;
+    }
+    self->frozen = true;
+
+    auto &v = self->variants[mask];
+    switch (v.state) {
+    case VariantState::Ready:
+        return v.program;
+    case VariantState::Failed:
+        return nullptr;
+    case VariantState::Building:
+        self->finish(mask, v);
+        return v.program;
+    case VariantState::Unbuilt:
+    case VariantState::Queued:
+        v.program = self->build(mask, false);
+        if (!v.program) {
+            v.state = VariantState::Failed;
+            return nullptr;
+        }
+        self->finish(mask, v);
+        return v.program;
+    }
+    UNREACHABLE;
+}
+
+void
+ShaderVariantSet::prewarm(ShaderVariantMask mask)
+{
+    if (!self->validMask(mask)) {
+        ERR("invalid shader variant mask: " + self->variantName(mask));
+        return;
+    }
+    self->frozen = true;
+
+    auto &v = self->variants[mask];
+    if (v.state == VariantState::Unbuilt) {
+        v.state = VariantState::Queued;
+        self->queue.push_back(mask);
+        self->sm.enableParallelCompile();
+    }
+}
+
+bool
+ShaderVariantSet::pollPrewarm()
+{
+    bool outstanding = false;
+    for (auto &[mask, v] : self->variants) {
+        if (v.state != VariantState::Building)
+            continue;
+        if (v.program->linkReady())
+            self->finish(mask, v);
+        else
+            outstanding = true;
+    }
+
+    size_t started = 0;
+    while (!self->queue.empty() && started < MAX_PREWARM_STARTS) {
+        auto mask = self->queue.front();
+        self->queue.pop_front();
+        auto &v = self->variants[mask];
+        if (v.state != VariantState::Queued)
+            continue;
+        v.program = self->build(mask, true);
+        v.state = v.program ? VariantState::Building : VariantState::Failed;
+        ++started;
+    }
+
+    return outstanding || started > 0 || !self->queue.empty();
+}
+
+size_t
+ShaderVariantSet::size() const
+{
+    size_t n = 0;
+    for (const auto &ent : self->variants)
+        if (ent.second.state == VariantState::Ready)
+            ++n;
+    return n;
+}
+
+} // namespace glt
@@ -0,0 +1,93 @@
+#ifndef GLT_SHADER_VARIANT_SET_HPP
+#define GLT_SHADER_VARIANT_SET_HPP
+
+#include "glt/ShaderManager.hpp"
+#include "glt/conf.hpp"
+#include "glt/type_info.hpp"
+#include "opengl.hpp"
+#include "pp/pimpl.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace glt {
+
+// selects a variant, the keys of a set are packed in declaration order
+using ShaderVariantMask = uint64_t;
+
+// A program template compiled with different preprocessor definitions,
+// e.g. shadows on or off or the number of lights. Variants are built on
+// first request, or ahead of time by prewarm(), and cached by their mask.
+// Built variants are registered with the ShaderManager as "name{mask}" so
+// they are reloaded with all other programs.
+struct GLT_API ShaderVariantSet
+{
+    ShaderVariantSet(ShaderManager &sm, std::string name);
+    ~ShaderVariantSet();
+
+    ShaderManager &shaderManager();
+
+    const std::string &name() const;
+
+    // the template, applied to every variant
+
+    void addShaderSrc(const std::string &src, ShaderType type);
+
+    void addShaderFile(const std::string &file,
+                       ShaderType type = ShaderType::GuessShaderType,
+                       bool absolute = false);
+
+    void addShaderFilePair(const std::string &basename, bool absolute = false);
+
+    void bindAttribute(const std::string &name, GLuint position);
+
+    void bindAttributes(const StructInfo &);
+
+    template<typename VertexType>
+    void bindAttributes()
+    {
+        bindAttributes(VertexType::gl::struct_info::info);
+    }
+
+    void bindUniformBlock(const std::string &block_name,
+                          GLuint binding,
+                          size_t size = 0);
+
+    // keys, declared before the first variant is built. A flag is defined
+    // to 1 or 0, use #if not #ifdef. An option is defined to one of its
+    // values. Both return the bits of the key in the mask, 0 on error.
+    ShaderVariantMask addFlag(const std::string &define);
+
+    ShaderVariantMask addOption(const std::string &define,
+                                std::vector<std::string> values);
+
+    // mask selecting the value of a key, 0 if unknown
+    ShaderVariantMask flag(const std::string &define) const;
+
+    ShaderVariantMask option(const std::string &define,
+                             const std::string &value) const;
+
+    PreprocessorDefinitions defines(ShaderVariantMask mask) const;
+
+    // builds the variant if needed, nullptr if that failed or the mask is
+    // invalid. Waits for a variant still being prewarmed.
+    std::shared_ptr<ShaderProgram> program(ShaderVariantMask mask);
+
+    // queues the variant to be built by pollPrewarm()
+    void prewarm(ShaderVariantMask mask);
+
+    // starts and completes queued builds without blocking, true while
+    // builds are outstanding. Called by ShaderManager::pollPrewarm().
+    bool pollPrewarm();
+
+    // variants built successfully so far
+    size_t size() const;
+
+private:
+    DECLARE_PIMPL(GLT_API, self);
+};
+
+} // namespace glt
+
+#endif
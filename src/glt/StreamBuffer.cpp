@@ -0,0 +1,216 @@
+#include "glt/StreamBuffer.hpp"
+
+#include "err/err.hpp"
+#include "glt/utils.hpp"
+
+#include <algorithm>
+
+namespace glt {
+
+namespace {
+
+inline constexpr size_t FRAME_ALIGNMENT = 256;
+
+inline constexpr GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+
+size_t
+alignUp(size_t x, size_t align)
+{
+    return (x + align - 1) & ~(align - 1);
+}
+
+} // namespace
+
+StreamBuffer::StreamBuffer() = default;
+
+StreamBuffer::StreamBuffer(size_t frame_size, size_t frames) : StreamBuffer()
+{
+    init(frame_size, frames);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    clear();
+}
+
+void
+StreamBuffer::init(size_t frame_size, size_t frames)
+{
+    ASSERT(frame_size > 0 && frames > 0);
+    ASSERT(!_in_frame);
+    clear();
+    _frame_size = alignUp(frame_size, FRAME_ALIGNMENT);
+    _frames = frames;
+    _frame = 0;
+    _head = 0;
+    _flushed = 0;
+    _fences.assign(frames, nullptr);
+    createStorage();
+}
+
+void
+StreamBuffer::createStorage()
+{
+    _buffer.ensure();
+    _persistent = GLAD_GL_ARB_buffer_storage != 0;
+#if ENABLE_GLCAPTURE_P
+    // writes through a persistent mapping cannot be captured
+    _persistent = _persistent && !glCapturing();
+#endif
+
+    if (_persistent) {
+        const GLbitfield flags =
+          GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const auto total = GLsizeiptr(_frame_size * _frames);
+        GL_CALL(glNamedBufferStorageEXT, *_buffer, total, nullptr, flags);
+        void *ptr;
+        GL_ASSIGN_CALL(
+          ptr, glMapNamedBufferRangeEXT, *_buffer, 0, total, flags);
+        _mapped = static_cast<char *>(ptr);
+        if (_mapped == nullptr) {
+            WARN("StreamBuffer: persistent mapping failed, using orphaning");
+            // storage created with glBufferStorage is immutable
+            _buffer.release();
+            _buffer.ensure();
+            _persistent = false;
+        }
+    }
+
+    if (!_persistent) {
+        GL_CALL(glNamedBufferDataEXT,
+                *_buffer,
+                GLsizeiptr(_frame_size),
+                nullptr,
+                GL_STREAM_DRAW);
+        _staging.resize(_frame_size);
+    }
+}
+
+void
+StreamBuffer::clear()
+{
+    for (auto &fence : _fences) {
+        if (fence != nullptr)
+            GL_CALL(glDeleteSync, fence);
+        fence = nullptr;
+    }
+
+    if (_mapped != nullptr) {
+        GL_CALL(glUnmapNamedBufferEXT, *_buffer);
+        _mapped = nullptr;
+    }
+
+    _buffer.release();
+    _staging = {};
+    _in_frame = false;
+}
+
+void
+StreamBuffer::reserve(size_t frame_size)
+{
+    ASSERT(!_in_frame, "reserve() inside of a frame");
+    if (frame_size <= _frame_size && _buffer.valid())
+        return;
+
+    for (size_t i = 0; i < _fences.size(); ++i)
+        waitFence(i);
+
+    init(std::max(frame_size, 2 * _frame_size), _frames > 0 ? _frames : 3);
+}
+
+void
+StreamBuffer::waitFence(size_t frame)
+{
+    auto &fence = _fences[frame];
+    if (fence == nullptr)
+        return;
+
+    for (;;) {
+        GLenum res;
+        GL_ASSIGN_CALL(res,
+                       glClientWaitSync,
+                       fence,
+                       GL_SYNC_FLUSH_COMMANDS_BIT,
+                       FENCE_TIMEOUT_NS);
+        if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED)
+            break;
+        if (res == GL_WAIT_FAILED) {
+            ERR("StreamBuffer: glClientWaitSync failed");
+            break;
+        }
+    }
+
+    GL_CALL(glDeleteSync, fence);
+    fence = nullptr;
+}
+
+void
+StreamBuffer::beginFrame()
+{
+    ASSERT(_buffer.valid(), "StreamBuffer not initialized");
+    ASSERT(!_in_frame, "nested beginFrame()");
+    _in_frame = true;
+    _head = 0;
+    _flushed = 0;
+
+    if (_persistent) {
+        _frame = (_frame + 1) % _frames;
+        waitFence(_frame);
+    } else {
+        // orphan the old storage, the driver keeps it alive for pending
+        // draws
+        GL_CALL(glNamedBufferDataEXT,
+                *_buffer,
+                GLsizeiptr(_frame_size),
+                nullptr,
+                GL_STREAM_DRAW);
+    }
+}
+
+void
+StreamBuffer::endFrame()
+{
+    ASSERT(_in_frame, "endFrame() without beginFrame()");
+    flush();
+    if (_persistent) {
+        ASSERT(_fences[_frame] == nullptr);
+        GL_ASSIGN_CALL(
+          _fences[_frame], glFenceSync, GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    _in_frame = false;
+}
+
+StreamRange
+StreamBuffer::allocate(size_t bytes, size_t align)
+{
+    ASSERT(_in_frame, "allocate() outside of beginFrame()/endFrame()");
+    ASSERT(align > 0 && (align & (align - 1)) == 0);
+    ASSERT(align <= FRAME_ALIGNMENT);
+
+    auto start = alignUp(_head, align);
+    if (start + bytes > _frame_size)
+        return {};
+    _head = start + bytes;
+
+    if (_persistent) {
+        auto base = _frame * _frame_size;
+        return { { _mapped + base + start, bytes }, GLintptr(base + start) };
+    }
+
+    return { { _staging.data() + start, bytes }, GLintptr(start) };
+}
+
+void
+StreamBuffer::flush()
+{
+    if (_persistent || _flushed == _head)
+        return;
+    GL_CALL(glNamedBufferSubDataEXT,
+            *_buffer,
+            GLintptr(_flushed),
+            GLsizeiptr(_head - _flushed),
+            _staging.data() + _flushed);
+    _flushed = _head;
+}
+
+} // namespace glt
@@ -0,0 +1,80 @@
+#ifndef GLT_STREAM_BUFFER_HPP
+#define GLT_STREAM_BUFFER_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/GLObject.hpp"
+#include "opengl.hpp"
+
+#include <span>
+#include <vector>
+
+namespace glt {
+
+struct StreamRange
+{
+    std::span<char> data; // empty if the allocation failed
+    GLintptr offset{};    // offset of data in the buffer object
+
+    explicit operator bool() const { return !data.empty(); }
+};
+
+// A buffer object split into one region per frame in flight, used to stream
+// per frame data (instance attributes, uniform blocks, ...) without
+// reallocating. If ARB_buffer_storage is available the buffer is persistently
+// and coherently mapped and a region is only reused once the fence placed at
+// the end of its frame has signaled. Otherwise allocations are staged in
+// host memory, uploaded by flush(), and the buffer is orphaned every frame.
+struct GLT_API StreamBuffer
+{
+    GLBufferObject _buffer;
+    size_t _frame_size{};
+    size_t _frames{};
+    size_t _frame{};
+    size_t _head{};    // offset of the next allocation inside the region
+    size_t _flushed{}; // staged bytes already uploaded (orphaning only)
+    char *_mapped{};
+    bool _persistent{};
+    bool _in_frame{};
+    std::vector<GLsync> _fences;
+    std::vector<char> _staging;
+
+    StreamBuffer();
+    StreamBuffer(size_t frame_size, size_t frames = 3);
+    ~StreamBuffer();
+
+    void init(size_t frame_size, size_t frames = 3);
+
+    // makes sure a frame can hold at least frame_size bytes, has to be called
+    // outside of beginFrame()/endFrame(), may wait for the GPU
+    void reserve(size_t frame_size);
+
+    // waits until the next region is no longer in use by the GPU
+    void beginFrame();
+
+    // fences the region of the current frame
+    void endFrame();
+
+    // align has to be a power of two
+    StreamRange allocate(size_t bytes, size_t align = 16);
+
+    // makes the data written since the last flush visible to the GPU, a noop
+    // for persistent mappings
+    void flush();
+
+    GLuint buffer() const { return *_buffer; }
+
+    size_t frameSize() const { return _frame_size; }
+
+    bool persistent() const { return _persistent; }
+
+    void clear();
+
+private:
+    void createStorage();
+    void waitFence(size_t frame);
+};
+
+} // namespace glt
+
+#endif
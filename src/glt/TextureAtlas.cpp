@@ -0,0 +1,434 @@
+#include "glt/TextureAtlas.hpp"
+
+#include "err/err.hpp"
+#include "glt/GLStateCache.hpp"
+#include "glt/TextureData.hpp"
+#include "glt/utils.hpp"
+#include "util/range.hpp"
+#include "util/string.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <tuple>
+
+namespace glt {
+
+namespace {
+
+uint32_t
+roundUp(uint32_t x, uint32_t align)
+{
+    return (x + align - 1) / align * align;
+}
+
+// copies src into the rect of dst with its edges repeated into the part of
+// the rect around the image
+void
+blitExtruded(const Image &src, Image &dst, const AtlasRect &rect, uint32_t pad)
+{
+    const uint32_t c = src.channels;
+    for (uint32_t y = 0; y < rect.height; ++y) {
+        const uint32_t sy =
+          y < pad ? 0 : std::min(y - pad, src.height - 1);
+        const uint8_t *srow = src.pixels.data() + size_t(sy) * src.rowSize();
+        uint8_t *drow = dst.pixels.data() + size_t(rect.y + y) * dst.rowSize() +
+                        size_t(rect.x) * c;
+
+        for (uint32_t x = 0; x < pad; ++x)
+            std::copy_n(srow, c, drow + size_t(x) * c);
+        std::copy_n(srow, src.rowSize(), drow + size_t(pad) * c);
+        const uint8_t *last = srow + src.rowSize() - c;
+        for (uint32_t x = pad + src.width; x < rect.width; ++x)
+            std::copy_n(last, c, drow + size_t(x) * c);
+    }
+}
+
+} // namespace
+
+void
+SkylinePacker::reset(uint32_t width, uint32_t height)
+{
+    _width = width;
+    _height = height;
+    _used_area = 0;
+    _skyline.clear();
+    _skyline.push_back({ 0, 0, width });
+}
+
+bool
+SkylinePacker::fits(size_t i,
+                    uint32_t width,
+                    uint32_t height,
+                    uint32_t &y) const
+{
+    if (_skyline[i].x + width > _width)
+        return false;
+    y = 0;
+    for (uint32_t left = width; left > 0; ++i) {
+        y = std::max(y, _skyline[i].y);
+        if (y + height > _height)
+            return false;
+        left -= std::min(left, _skyline[i].width);
+    }
+    return true;
+}
+
+bool
+SkylinePacker::insert(uint32_t width, uint32_t height, AtlasRect &rect)
+{
+    if (width == 0 || height == 0)
+        return false;
+
+    auto best_top = std::numeric_limits<uint32_t>::max();
+    auto best_width = std::numeric_limits<uint32_t>::max();
+    size_t best = _skyline.size();
+    for (size_t i = 0; i < _skyline.size(); ++i) {
+        uint32_t y;
+        if (!fits(i, width, height, y))
+            continue;
+        // lowest top edge, ties go to the narrowest segment to keep wide
+        // ones for wide rectangles
+        if (y + height < best_top ||
+            (y + height == best_top && _skyline[i].width < best_width)) {
+            best_top = y + height;
+            best_width = _skyline[i].width;
+            best = i;
+        }
+    }
+    if (best == _skyline.size())
+        return false;
+
+    rect = { _skyline[best].x, best_top - height, width, height };
+    _used_area += uint64_t(width) * height;
+
+    // the new segment shadows the ones it spans
+    _skyline.insert(_skyline.begin() + ptrdiff_t(best),
+                    { rect.x, best_top, width });
+    const uint32_t right = rect.x + width;
+    for (size_t i = best + 1; i < _skyline.size();) {
+        auto &seg = _skyline[i];
+        if (seg.x >= right)
+            break;
+        if (seg.x + seg.width <= right) {
+            _skyline.erase(_skyline.begin() + ptrdiff_t(i));
+            continue;
+        }
+        seg.width -= right - seg.x;
+        seg.x = right;
+        break;
+    }
+
+    for (size_t i = 0; i + 1 < _skyline.size();) {
+        if (_skyline[i].y == _skyline[i + 1].y) {
+            _skyline[i].width += _skyline[i + 1].width;
+            _skyline.erase(_skyline.begin() + ptrdiff_t(i + 1));
+        } else {
+            ++i;
+        }
+    }
+    return true;
+}
+
+uint32_t
+SkylinePacker::usedHeight() const
+{
+    uint32_t h = 0;
+    for (const auto &seg : _skyline)
+        h = std::max(h, seg.y);
+    return h;
+}
+
+double
+SkylinePacker::occupancy() const
+{
+    const auto area = uint64_t(_width) * _height;
+    return area == 0 ? 0.0 : double(_used_area) / double(area);
+}
+
+TextureAtlas::TextureAtlas(const AtlasOptions &opts) : _opts(opts)
+{
+    _opts.mip_levels = std::clamp(_opts.mip_levels, 1u, 16u);
+}
+
+uint32_t
+TextureAtlas::add(std::string name, const Image &img)
+{
+    const auto index = uint32_t(_entries.size());
+    _entries.emplace_back().name = std::move(name);
+    _sources.push_back(&img);
+    return index;
+}
+
+bool
+TextureAtlas::build()
+{
+    _pages.clear();
+    if (_sources.empty())
+        return true;
+
+    const uint32_t align = 1u << (_opts.mip_levels - 1);
+    const uint32_t pad = _opts.padding;
+    const uint32_t page_size = _opts.page_size / align * align;
+    const uint32_t channels = _sources[0]->channels;
+
+    std::vector<AtlasRect> padded(_sources.size());
+    std::vector<uint32_t> order(_sources.size());
+    for (const auto [i, img] : enumerate(_sources)) {
+        if (img->channels != channels) {
+            ERR(string_concat("atlas image ",
+                              _entries[i].name,
+                              ": channels differ from the first image"));
+            return false;
+        }
+        if (img->width == 0 || img->height == 0) {
+            ERR(string_concat("atlas image ", _entries[i].name, ": empty"));
+            return false;
+        }
+        padded[i].width = roundUp(img->width + 2 * pad, align);
+        padded[i].height = roundUp(img->height + 2 * pad, align);
+        order[i] = uint32_t(i);
+    }
+
+    // tall rectangles first keep the skyline flat
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return std::tie(padded[a].height, padded[a].width) >
+               std::tie(padded[b].height, padded[b].width);
+    });
+
+    std::vector<SkylinePacker> bins;
+    for (const auto i : order) {
+        auto &rect = padded[i];
+        size_t page = 0;
+        for (; page < bins.size(); ++page)
+            if (bins[page].insert(rect.width, rect.height, rect))
+                break;
+        if (page == bins.size()) {
+            bins.emplace_back(page_size, page_size);
+            if (!bins.back().insert(rect.width, rect.height, rect)) {
+                ERR(string_concat("atlas image ",
+                                  _entries[i].name,
+                                  " does not fit on a page"));
+                _pages.clear();
+                return false;
+            }
+        }
+        _entries[i].page = uint32_t(page);
+    }
+
+    _pages.resize(bins.size());
+    for (const auto [page, bin] : enumerate(bins))
+        _pages[page].resize(
+          page_size, roundUp(bin.usedHeight(), align), channels);
+
+    for (const auto [i, img] : enumerate(_sources)) {
+        auto &e = _entries[i];
+        auto &page = _pages[e.page];
+        blitExtruded(*img, page, padded[i], pad);
+        e.rect = {
+            padded[i].x + pad, padded[i].y + pad, img->width, img->height
+        };
+        e.uv_scale = math::vec2(math::real(e.rect.width) / page.width,
+                                math::real(e.rect.height) / page.height);
+        e.uv_offset = math::vec2(math::real(e.rect.x) / page.width,
+                                 math::real(e.rect.y) / page.height);
+    }
+
+    _sources.clear();
+    return true;
+}
+
+void
+TextureAtlas::clear()
+{
+    _sources.clear();
+    _entries.clear();
+    _pages.clear();
+}
+
+const AtlasEntry *
+TextureAtlas::find(std::string_view name) const
+{
+    for (const auto &e : _entries)
+        if (e.name == name)
+            return &e;
+    return nullptr;
+}
+
+void
+TextureAtlas::upload(uint32_t page, TextureData &tex, bool srgb) const
+{
+    ASSERT(page < _pages.size(), "no such atlas page");
+    const auto &base = _pages[page];
+
+    std::vector<Image> mips;
+    if (_opts.mip_levels > 1) {
+        generateMipmaps(base, mips, MipmapFilter::Box, srgb);
+        mips.resize(std::min(mips.size(), size_t(_opts.mip_levels - 1)));
+    }
+
+    GLenum internal, format;
+    imageFormats(base.channels, srgb, internal, format);
+    tex.type(Texture2D);
+    const GLuint name = *tex.ensureHandle();
+
+    stateCache().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    GL_CALL(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i <= mips.size(); ++i) {
+        const auto &level = i == 0 ? base : mips[i - 1];
+        GL_CALL(glTextureImage2DEXT,
+                name,
+                GL_TEXTURE_2D,
+                GLint(i),
+                GLint(internal),
+                GLsizei(level.width),
+                GLsizei(level.height),
+                0,
+                format,
+                GL_UNSIGNED_BYTE,
+                level.pixels.data());
+    }
+    GL_CALL(glPixelStorei, GL_UNPACK_ALIGNMENT, 4);
+
+    GL_CALL(glTextureParameteriEXT,
+            name,
+            GL_TEXTURE_2D,
+            GL_TEXTURE_MAX_LEVEL,
+            GLint(mips.size()));
+    GL_CALL(glTextureParameteriEXT,
+            name,
+            GL_TEXTURE_2D,
+            GL_TEXTURE_MIN_FILTER,
+            mips.empty() ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR);
+}
+
+uint32_t
+TextureArrayPacker::add(std::string name, const Image &img)
+{
+    const auto index = uint32_t(_entries.size());
+    _entries.emplace_back().name = std::move(name);
+    _sources.push_back(&img);
+    return index;
+}
+
+void
+TextureArrayPacker::build(uint32_t max_layers)
+{
+    max_layers = std::max(max_layers, 1u);
+    _arrays.clear();
+
+    // the array currently filled per size, in the order sizes first appear
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint32_t> open;
+    for (const auto [i, img] : enumerate(_sources)) {
+        const auto key =
+          std::make_tuple(img->width, img->height, img->channels);
+        auto it = open.find(key);
+        if (it == open.end() ||
+            _arrays[it->second].layers.size() >= max_layers) {
+            const auto index = uint32_t(_arrays.size());
+            auto &group = _arrays.emplace_back();
+            group.width = img->width;
+            group.height = img->height;
+            group.channels = img->channels;
+            open[key] = index;
+            it = open.find(key);
+        }
+        auto &group = _arrays[it->second];
+        _entries[i].array = it->second;
+        _entries[i].layer = uint32_t(group.layers.size());
+        group.layers.push_back(img);
+    }
+}
+
+void
+TextureArrayPacker::clear()
+{
+    _sources.clear();
+    _entries.clear();
+    _arrays.clear();
+}
+
+const ArrayEntry *
+TextureArrayPacker::find(std::string_view name) const
+{
+    for (const auto &e : _entries)
+        if (e.name == name)
+            return &e;
+    return nullptr;
+}
+
+void
+TextureArrayPacker::upload(uint32_t array,
+                           TextureData &tex,
+                           bool mipmaps,
+                           MipmapFilter filter,
+                           bool srgb) const
+{
+    ASSERT(array < _arrays.size(), "no such texture array");
+    const auto &group = _arrays[array];
+    const auto depth = GLsizei(group.layers.size());
+
+    size_t nlevels = 1;
+    if (mipmaps)
+        for (auto w = group.width, h = group.height; w > 1 || h > 1;
+             w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+            ++nlevels;
+
+    GLenum internal, format;
+    imageFormats(group.channels, srgb, internal, format);
+    tex.type(Texture2DArray);
+    const GLuint name = *tex.ensureHandle();
+
+    stateCache().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    for (size_t i = 0; i < nlevels; ++i)
+        GL_CALL(glTextureImage3DEXT,
+                name,
+                GL_TEXTURE_2D_ARRAY,
+                GLint(i),
+                GLint(internal),
+                GLsizei(std::max(group.width >> i, 1u)),
+                GLsizei(std::max(group.height >> i, 1u)),
+                depth,
+                0,
+                format,
+                GL_UNSIGNED_BYTE,
+                nullptr);
+
+    GL_CALL(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
+    std::vector<Image> mips;
+    for (const auto [layer, img] : enumerate(group.layers)) {
+        mips.clear();
+        if (nlevels > 1)
+            generateMipmaps(*img, mips, filter, srgb);
+        for (size_t i = 0; i < nlevels; ++i) {
+            const auto &level = i == 0 ? *img : mips[i - 1];
+            GL_CALL(glTextureSubImage3DEXT,
+                    name,
+                    GL_TEXTURE_2D_ARRAY,
+                    GLint(i),
+                    0,
+                    0,
+                    GLint(layer),
+                    GLsizei(level.width),
+                    GLsizei(level.height),
+                    1,
+                    format,
+                    GL_UNSIGNED_BYTE,
+                    level.pixels.data());
+        }
+    }
+    GL_CALL(glPixelStorei, GL_UNPACK_ALIGNMENT, 4);
+
+    GL_CALL(glTextureParameteriEXT,
+            name,
+            GL_TEXTURE_2D_ARRAY,
+            GL_TEXTURE_MAX_LEVEL,
+            GLint(nlevels - 1));
+    GL_CALL(glTextureParameteriEXT,
+            name,
+            GL_TEXTURE_2D_ARRAY,
+            GL_TEXTURE_MIN_FILTER,
+            nlevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+}
+
+} // namespace glt
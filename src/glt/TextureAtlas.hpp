@@ -0,0 +1,187 @@
+#ifndef GLT_TEXTURE_ATLAS_HPP
+#define GLT_TEXTURE_ATLAS_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/Image.hpp"
+#include "math/vec2.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace glt {
+
+struct TextureData;
+
+struct AtlasRect
+{
+    uint32_t x{};
+    uint32_t y{};
+    uint32_t width{};
+    uint32_t height{};
+
+    bool overlaps(const AtlasRect &r) const
+    {
+        return x < r.x + r.width && r.x < x + width && y < r.y + r.height &&
+               r.y < y + height;
+    }
+};
+
+// Skyline bottom left rectangle packing into a bin of fixed size: the top
+// edge of the packed area is kept as a list of horizontal segments, a
+// rectangle goes where its top ends lowest. Pure CPU, no GL needed.
+struct GLT_API SkylinePacker
+{
+    SkylinePacker() = default;
+    SkylinePacker(uint32_t width, uint32_t height) { reset(width, height); }
+
+    void reset(uint32_t width, uint32_t height);
+
+    // false if the rectangle does not fit anymore
+    bool insert(uint32_t width, uint32_t height, AtlasRect &rect);
+
+    uint32_t width() const { return _width; }
+    uint32_t height() const { return _height; }
+
+    // highest y covered by a rectangle
+    uint32_t usedHeight() const;
+
+    // fraction of the bin covered by rectangles
+    double occupancy() const;
+
+private:
+    struct Segment
+    {
+        uint32_t x, y, width;
+    };
+
+    bool fits(size_t i, uint32_t width, uint32_t height, uint32_t &y) const;
+
+    uint32_t _width{};
+    uint32_t _height{};
+    uint64_t _used_area{};
+    std::vector<Segment> _skyline;
+};
+
+struct AtlasOptions
+{
+    // width and maximum height of a page
+    uint32_t page_size = 2048;
+    // texels around each image filled by repeating its edges, so bilinear
+    // filtering never reads a neighbour
+    uint32_t padding = 2;
+    // levels the pages are mipmapped to. Images are placed on multiples of
+    // 2^(mip_levels - 1) texels, the box filter then never mixes two images
+    // in those levels.
+    uint32_t mip_levels = 1;
+};
+
+// where an image ended up. UVs in [0, 1] over the source image map to
+// uv * uv_scale + uv_offset on its page. Texture coordinates outside of
+// [0, 1] (repeating textures) cannot be remapped.
+struct AtlasEntry
+{
+    std::string name;
+    uint32_t page{};
+    AtlasRect rect; // the image without padding, in texels of its page
+    math::vec2_t uv_scale{};
+    math::vec2_t uv_offset{};
+
+    math::vec2_t remap(const math::vec2_t &uv) const
+    {
+        return uv * uv_scale + uv_offset;
+    }
+};
+
+// Packs many small images into few large pages, so meshes drawn with
+// different textures can share a binding: add() the images, build(), then
+// remap the texture coordinates of each mesh with its entry, once when the
+// mesh is built. All images need the same number of channels.
+struct GLT_API TextureAtlas
+{
+    explicit TextureAtlas(const AtlasOptions &opts = {});
+
+    const AtlasOptions &options() const { return _opts; }
+
+    // img is referenced until build() returns, the index selects the entry
+    uint32_t add(std::string name, const Image &img);
+
+    // packs all added images, larger ones first, opening pages as needed.
+    // Pages are page_size wide and cropped to the height used. False if an
+    // image does not fit on an empty page or channels differ.
+    bool build();
+
+    void clear();
+
+    const std::vector<Image> &pages() const { return _pages; }
+    const std::vector<AtlasEntry> &entries() const { return _entries; }
+    const AtlasEntry &entry(uint32_t index) const { return _entries[index]; }
+
+    // nullptr if there is no image of that name
+    const AtlasEntry *find(std::string_view name) const;
+
+    // uploads a page as 2D texture with the mip_levels the layout is safe
+    // for, box filtered, GL thread only
+    void upload(uint32_t page, TextureData &tex, bool srgb = false) const;
+
+private:
+    AtlasOptions _opts;
+    std::vector<const Image *> _sources;
+    std::vector<AtlasEntry> _entries;
+    std::vector<Image> _pages;
+};
+
+// where an image ended up in a TextureArrayPacker
+struct ArrayEntry
+{
+    std::string name;
+    uint32_t array{};
+    uint32_t layer{};
+};
+
+// images of equal size and channels as layers of a texture array
+struct TextureArrayGroup
+{
+    uint32_t width{};
+    uint32_t height{};
+    uint32_t channels{};
+    std::vector<const Image *> layers;
+};
+
+// Groups images of identical size into GL_TEXTURE_2D_ARRAY layers. Unlike
+// an atlas, layers mipmap and repeat independently, texture coordinates
+// stay as they are and the layer is passed to the shader instead.
+struct GLT_API TextureArrayPacker
+{
+    // img is referenced until the arrays are uploaded
+    uint32_t add(std::string name, const Image &img);
+
+    // assigns arrays and layers, groups hold at most max_layers images
+    void build(uint32_t max_layers = 256);
+
+    void clear();
+
+    const std::vector<TextureArrayGroup> &arrays() const { return _arrays; }
+    const std::vector<ArrayEntry> &entries() const { return _entries; }
+    const ArrayEntry &entry(uint32_t index) const { return _entries[index]; }
+
+    // nullptr if there is no image of that name
+    const ArrayEntry *find(std::string_view name) const;
+
+    // uploads an array with a full mipmap chain per layer, GL thread only
+    void upload(uint32_t array,
+                TextureData &tex,
+                bool mipmaps = true,
+                MipmapFilter filter = MipmapFilter::Box,
+                bool srgb = false) const;
+
+private:
+    std::vector<const Image *> _sources;
+    std::vector<ArrayEntry> _entries;
+    std::vector<TextureArrayGroup> _arrays;
+};
+
+} // namespace glt
+
+#endif
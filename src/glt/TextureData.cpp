@@ -1,6 +1,8 @@
 #include "glt/TextureData.hpp"
 #include "err/err.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/utils.hpp"
+#include "util/string.hpp"
 
 namespace glt {
 
@@ -19,6 +21,8 @@ getGLType(TextureType ty, size_t ss)
             return GL_TEXTURE_2D_MULTISAMPLE;
     case Texture3D:
         return GL_TEXTURE_3D;
+    case Texture2DArray:
+        return GL_TEXTURE_2D_ARRAY;
     }
     UNREACHABLE;
 }
@@ -50,17 +54,17 @@ void
 TextureData::bind(uint32_t idx, bool set_active_idx)
 {
     if (set_active_idx)
-        GL_CALL(glActiveTexture, GL_TEXTURE0 + idx);
+        stateCache().activeTexture(idx);
     ensureHandle();
-    GL_CALL(glBindTexture, getGLType(_type, _samples), *_handle);
+    stateCache().bindTexture(getGLType(_type, _samples), *_handle);
 }
 
 void
 TextureData::unbind(uint32_t idx, bool set_active_idx)
 {
     if (set_active_idx)
-        GL_CALL(glActiveTexture, GL_TEXTURE0 + idx);
-    GL_CALL(glBindTexture, getGLType(_type, _samples), 0);
+        stateCache().activeTexture(idx);
+    stateCache().bindTexture(getGLType(_type, _samples), 0);
 }
 
 GLenum
@@ -78,4 +82,117 @@ TextureData::type(TextureType ty, size_t ss)
     _samples = ss;
 }
 
+bool
+compressedFormatSupported(BlockFormat format, bool srgb)
+{
+    switch (format.value) {
+    case BlockFormat::BC1:
+    case BlockFormat::BC3:
+        return GLAD_GL_EXT_texture_compression_s3tc &&
+               (!srgb || GLAD_GL_EXT_texture_sRGB);
+    case BlockFormat::BC4:
+    case BlockFormat::BC5:
+        // core since 3.0
+        return GLVersion.major >= 3 || GLAD_GL_ARB_texture_compression_rgtc;
+    }
+    UNREACHABLE;
+}
+
+GLenum
+compressedInternalFormat(BlockFormat format, bool srgb)
+{
+    switch (format.value) {
+    case BlockFormat::BC1:
+        return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+                    : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockFormat::BC3:
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+                    : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BlockFormat::BC4:
+        return GL_COMPRESSED_RED_RGTC1;
+    case BlockFormat::BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    }
+    UNREACHABLE;
+}
+
+void
+imageFormats(uint32_t channels, bool srgb, GLenum &internal, GLenum &format)
+{
+    switch (channels) {
+    case 1:
+        // there is no single channel sRGB format in core GL
+        internal = GL_R8;
+        format = GL_RED;
+        return;
+    case 3:
+        internal = srgb ? GL_SRGB8 : GL_RGB8;
+        format = GL_RGB;
+        return;
+    case 4:
+        internal = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        format = GL_RGBA;
+        return;
+    }
+    UNREACHABLE;
+}
+
+void
+TextureData::uploadCompressed(const CompressedTexture &tex)
+{
+    ASSERT(_type == Texture2D && _samples == 1,
+           "compressed textures have to be 2D");
+    if (tex.levels.empty())
+        return;
+
+    bind(0, false);
+    stateCache().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    const GLenum target = GL_TEXTURE_2D;
+    const auto nlevels = GLint(tex.levels.size());
+
+    if (compressedFormatSupported(tex.format, tex.srgb)) {
+        const auto internal = compressedInternalFormat(tex.format, tex.srgb);
+        for (GLint i = 0; i < nlevels; ++i) {
+            const auto &level = tex.levels[size_t(i)];
+            GL_CALL(glCompressedTexImage2D,
+                    target,
+                    i,
+                    internal,
+                    GLsizei(level.width),
+                    GLsizei(level.height),
+                    0,
+                    GLsizei(level.blocks.size()),
+                    level.blocks.data());
+        }
+    } else {
+        WARN(string_concat("compressed format ",
+                           tex.format.to_string(),
+                           " not supported, uploading uncompressed"));
+        GL_CALL(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
+        Image img;
+        for (GLint i = 0; i < nlevels; ++i) {
+            decompressImage(tex.levels[size_t(i)], img);
+            GLenum internal, format;
+            imageFormats(img.channels, tex.srgb, internal, format);
+            GL_CALL(glTexImage2D,
+                    target,
+                    i,
+                    GLint(internal),
+                    GLsizei(img.width),
+                    GLsizei(img.height),
+                    0,
+                    format,
+                    GL_UNSIGNED_BYTE,
+                    img.pixels.data());
+        }
+        GL_CALL(glPixelStorei, GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    GL_CALL(glTexParameteri, target, GL_TEXTURE_MAX_LEVEL, nlevels - 1);
+    GL_CALL(glTexParameteri,
+            target,
+            GL_TEXTURE_MIN_FILTER,
+            nlevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+}
+
 } // namespace glt
@@ -1,6 +1,7 @@
 #ifndef GLT_TEXTURE_DATA_HPP
 #define GLT_TEXTURE_DATA_HPP
 
+#include "glt/BlockCompression.hpp"
 #include "glt/GLObject.hpp"
 #include "glt/conf.hpp"
 #include "opengl.hpp"
@@ -12,7 +13,8 @@ enum TextureType
 {
     Texture1D,
     Texture2D,
-    Texture3D
+    Texture3D,
+    Texture2DArray
 };
 
 struct GLT_API TextureData : private NonCopyable
@@ -35,12 +37,26 @@ struct GLT_API TextureData : private NonCopyable
 
     void type(TextureType ty, size_t ss = 1);
 
+    // uploads all levels of a 2D texture with glCompressedTexImage2D,
+    // formats the driver lacks are decompressed and uploaded uncompressed
+    void uploadCompressed(const CompressedTexture &tex);
+
 private:
     size_t _samples;
     GLTextureObject _handle;
     TextureType _type;
 };
 
+GLT_API bool
+compressedFormatSupported(BlockFormat format, bool srgb = false);
+
+GLT_API GLenum
+compressedInternalFormat(BlockFormat format, bool srgb = false);
+
+// internal and pixel format for uncompressed Images with channels 1, 3 or 4
+GLT_API void
+imageFormats(uint32_t channels, bool srgb, GLenum &internal, GLenum &format);
+
 inline bool
 operator==(const TextureData &t1, const TextureData &t2)
 {
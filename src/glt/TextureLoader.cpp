@@ -0,0 +1,511 @@
+#include "glt/TextureLoader.hpp"
+
+#include "err/err.hpp"
+#include "glt/CompressedTextureCache.hpp"
+#include "glt/GLStateCache.hpp"
+#include "glt/StreamBuffer.hpp"
+#include "glt/utils.hpp"
+#include "sys/io.hpp"
+#include "util/range.hpp"
+#include "util/string.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace glt {
+
+PP_DEF_ENUM_IMPL(GLT_TEXTURE_LOAD_STATE_ENUM_DEF);
+
+namespace {
+
+// frames the staging buffer is split into
+constexpr size_t UPLOAD_FRAMES = 3;
+
+// one mipmap level as it is uploaded, in rows of pixels or of 4x4 blocks
+struct UploadLevel
+{
+    uint32_t width{};
+    uint32_t height{};
+    uint32_t row_height{}; // 1, or 4 for compressed levels
+    size_t row_size{};
+    std::vector<uint8_t> data;
+
+    uint32_t rows() const { return (height + row_height - 1) / row_height; }
+};
+
+struct Job
+{
+    std::shared_ptr<LoadedTexture> tex;
+    TextureLoadOptions opts;
+    ImageDecoder decoder{};
+    CompressedTextureCache *cache{};
+    std::vector<UploadLevel> levels; // base level first
+    uint32_t channels{};             // of uncompressed levels
+    std::string error;
+    // upload progress, GL thread only
+    GLenum internal{};
+    GLenum format{};
+    uint32_t level = 0;
+    uint32_t row = 0;
+    bool allocated = false;
+};
+
+std::string
+lowerExtension(const std::string &path)
+{
+    auto dot = path.rfind('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos)
+        return {};
+    std::string ext = path.substr(dot);
+    for (auto &c : ext)
+        c = char(std::tolower(static_cast<unsigned char>(c)));
+    return ext;
+}
+
+void
+addLevel(Job &job, Image &&img)
+{
+    job.channels = img.channels;
+    job.levels.push_back(
+      { img.width, img.height, 1, img.rowSize(), std::move(img.pixels) });
+}
+
+void
+addLevel(Job &job, CompressedImage &&img)
+{
+    job.levels.push_back(
+      { img.width, img.height, 4, img.rowSize(), std::move(img.blocks) });
+}
+
+void
+decode(Job &job)
+{
+    auto res = sys::io::mapFile(job.tex->path);
+    if (!res) {
+        job.error = "couldnt open file";
+        return;
+    }
+    auto file = std::move(res).value();
+    const auto source = file.data();
+
+    Hash128 key;
+    if (job.opts.compress && job.cache) {
+        key = CompressedTextureCache::key(source, job.opts);
+        CompressedTexture cached;
+        if (job.cache->load(key, cached)) {
+            for (auto &level : cached.levels)
+                addLevel(job, std::move(level));
+            return;
+        }
+    }
+
+    Image base;
+    if (!job.decoder(source, base, job.error))
+        return;
+
+    if (job.opts.compress) {
+        // one thread per texture, the workers already run in parallel
+        CompressedTexture tex;
+        buildCompressedTexture(base, job.opts, tex, 1);
+        if (job.cache)
+            job.cache->store(key, tex);
+        for (auto &level : tex.levels)
+            addLevel(job, std::move(level));
+        return;
+    }
+
+    std::vector<Image> mips;
+    if (job.opts.mipmaps)
+        generateMipmaps(base, mips, job.opts.filter, job.opts.srgb);
+    addLevel(job, std::move(base));
+    for (auto &mip : mips)
+        addLevel(job, std::move(mip));
+}
+
+} // namespace
+
+void
+buildCompressedTexture(const Image &base,
+                       const TextureLoadOptions &opts,
+                       CompressedTexture &out,
+                       unsigned threads)
+{
+    std::vector<Image> mips;
+    if (opts.mipmaps)
+        generateMipmaps(base, mips, opts.filter, opts.srgb);
+
+    out.format = opts.format;
+    out.srgb = opts.srgb;
+    out.levels.resize(1 + mips.size());
+    compressImage(base, opts.format, opts.quality, out.levels[0], threads);
+    for (size_t i = 0; i < mips.size(); ++i)
+        compressImage(
+          mips[i], opts.format, opts.quality, out.levels[i + 1], threads);
+}
+
+struct TextureLoader::Data
+{
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::deque<std::unique_ptr<Job>> todo;    // guarded by mutex
+    std::deque<std::unique_ptr<Job>> decoded; // guarded by mutex
+    std::vector<std::thread> workers;
+    bool stopping = false; // guarded by mutex
+
+    // GL thread only
+    std::unordered_map<std::string, ImageDecoder> decoders;
+    std::deque<std::unique_ptr<Job>> uploads;
+    StreamBuffer staging;
+    CompressedTextureCache *cache{};
+    size_t budget = TEXTURE_UPLOAD_BUDGET;
+    size_t outstanding = 0;
+
+    Data()
+    {
+        decoders[".tga"] = decodeTGA;
+        decoders[".bmp"] = decodeBMP;
+    }
+
+    void work();
+
+    void allocate(Job &job);
+
+    // uploads rows of the current level of job, false if the staging
+    // buffer is full
+    bool uploadRows(Job &job, size_t &budget_left);
+
+    void finish(std::unique_ptr<Job> job);
+};
+
+DECLARE_PIMPL_DEL(TextureLoader)
+
+TextureLoader::TextureLoader() : self(new Data) {}
+
+TextureLoader::~TextureLoader()
+{
+    shutdown();
+}
+
+void
+TextureLoader::init(unsigned threads, size_t upload_budget)
+{
+    shutdown();
+
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    self->budget = std::max(upload_budget, size_t(1));
+    self->staging.init(self->budget, UPLOAD_FRAMES);
+
+    self->stopping = false;
+    for (unsigned i = 0; i < threads; ++i)
+        self->workers.emplace_back([this]() { self->work(); });
+}
+
+void
+TextureLoader::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(self->mutex);
+        self->stopping = true;
+    }
+    self->work_available.notify_all();
+    for (auto &w : self->workers)
+        w.join();
+    self->workers.clear();
+
+    self->todo.clear();
+    self->decoded.clear();
+    self->uploads.clear();
+    self->outstanding = 0;
+    self->staging.clear();
+}
+
+void
+TextureLoader::cache(CompressedTextureCache *cache)
+{
+    self->cache = cache;
+}
+
+void
+TextureLoader::registerDecoder(const std::string &extension,
+                               ImageDecoder decoder)
+{
+    self->decoders[lowerExtension(extension)] = decoder;
+}
+
+std::shared_ptr<LoadedTexture>
+TextureLoader::load(const std::string &path, const TextureLoadOptions &opts)
+{
+    auto tex = std::make_shared<LoadedTexture>();
+    tex->path = path;
+
+    if (self->workers.empty()) {
+        ERR("TextureLoader not initialized, couldnt load: " + path);
+        tex->state = TextureLoadState::Failed;
+        return tex;
+    }
+
+    auto it = self->decoders.find(lowerExtension(path));
+    if (it == self->decoders.end()) {
+        ERR("no image decoder for file: " + path);
+        tex->state = TextureLoadState::Failed;
+        return tex;
+    }
+
+    auto job = std::make_unique<Job>();
+    job->tex = tex;
+    job->opts = opts;
+    job->decoder = it->second;
+    job->cache = self->cache;
+    if (opts.compress && !compressedFormatSupported(opts.format, opts.srgb)) {
+        WARN(string_concat("compressed format ",
+                           opts.format.to_string(),
+                           " not supported, loading uncompressed: ",
+                           path));
+        job->opts.compress = false;
+    }
+    ++self->outstanding;
+    {
+        std::lock_guard<std::mutex> lock(self->mutex);
+        self->todo.push_back(std::move(job));
+    }
+    self->work_available.notify_one();
+    return tex;
+}
+
+void
+TextureLoader::Data::work()
+{
+    for (;;) {
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock,
+                                [this]() { return stopping || !todo.empty(); });
+            if (stopping)
+                return;
+            job = std::move(todo.front());
+            todo.pop_front();
+        }
+
+        decode(*job);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        decoded.push_back(std::move(job));
+    }
+}
+
+void
+TextureLoader::Data::allocate(Job &job)
+{
+    auto &tex = *job.tex;
+    const auto &base = job.levels[0];
+    tex.width = base.width;
+    tex.height = base.height;
+    tex.levels = uint32_t(job.levels.size());
+    tex.state = TextureLoadState::Uploading;
+
+    const bool compressed = job.opts.compress;
+    if (compressed)
+        job.internal = compressedInternalFormat(job.opts.format, job.opts.srgb);
+    else
+        imageFormats(job.channels, job.opts.srgb, job.internal, job.format);
+
+    tex.data->type(Texture2D);
+    const GLuint name = *tex.data->ensureHandle();
+
+    // no pixel buffer bound: a null pointer only allocates
+    stateCache().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    for (const auto [i, level] : enumerate(job.levels)) {
+        if (compressed)
+            GL_CALL(glCompressedTextureImage2DEXT,
+                    name,
+                    GL_TEXTURE_2D,
+                    GLint(i),
+                    job.internal,
+                    GLsizei(level.width),
+                    GLsizei(level.height),
+                    0,
+                    GLsizei(level.data.size()),
+                    nullptr);
+        else
+            GL_CALL(glTextureImage2DEXT,
+                    name,
+                    GL_TEXTURE_2D,
+                    GLint(i),
+                    GLint(job.internal),
+                    GLsizei(level.width),
+                    GLsizei(level.height),
+                    0,
+                    job.format,
+                    GL_UNSIGNED_BYTE,
+                    nullptr);
+    }
+
+    GL_CALL(glTextureParameteriEXT,
+            name,
+            GL_TEXTURE_2D,
+            GL_TEXTURE_MAX_LEVEL,
+            GLint(job.levels.size() - 1));
+    GL_CALL(glTextureParameteriEXT,
+            name,
+            GL_TEXTURE_2D,
+            GL_TEXTURE_MIN_FILTER,
+            job.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    GL_CALL(glTextureParameteriEXT,
+            name,
+            GL_TEXTURE_2D,
+            GL_TEXTURE_MAG_FILTER,
+            GL_LINEAR);
+    if (!compressed && job.channels == 1) {
+        const GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        GL_CALL(glTextureParameterivEXT,
+                name,
+                GL_TEXTURE_2D,
+                GL_TEXTURE_SWIZZLE_RGBA,
+                swizzle);
+    }
+    job.allocated = true;
+}
+
+bool
+TextureLoader::Data::uploadRows(Job &job, size_t &budget_left)
+{
+    auto &level = job.levels[job.level];
+    const size_t rows = std::clamp(budget_left / level.row_size,
+                                   size_t(1),
+                                   size_t(level.rows() - job.row));
+    const size_t bytes = rows * level.row_size;
+
+    auto range = staging.allocate(bytes, 4);
+    if (!range)
+        return false;
+    memcpy(
+      range.data.data(), level.data.data() + job.row * level.row_size, bytes);
+    staging.flush();
+
+    const auto y = job.row * level.row_height;
+    const auto height =
+      std::min(uint32_t(rows) * level.row_height, level.height - y);
+    const auto *offset = reinterpret_cast<const void *>(range.offset);
+
+    stateCache().bindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer());
+    if (job.opts.compress)
+        GL_CALL(glCompressedTextureSubImage2DEXT,
+                *job.tex->data->handle(),
+                GL_TEXTURE_2D,
+                GLint(job.level),
+                0,
+                GLint(y),
+                GLsizei(level.width),
+                GLsizei(height),
+                job.internal,
+                GLsizei(bytes),
+                offset);
+    else
+        GL_CALL(glTextureSubImage2DEXT,
+                *job.tex->data->handle(),
+                GL_TEXTURE_2D,
+                GLint(job.level),
+                0,
+                GLint(y),
+                GLsizei(level.width),
+                GLsizei(height),
+                job.format,
+                GL_UNSIGNED_BYTE,
+                offset);
+
+    budget_left -= std::min(bytes, budget_left);
+    job.row += uint32_t(rows);
+    if (job.row == level.rows()) {
+        job.row = 0;
+        ++job.level;
+        // the host copy is no longer needed
+        level.data = {};
+    }
+    return true;
+}
+
+void
+TextureLoader::Data::finish(std::unique_ptr<Job> job)
+{
+    if (!job->error.empty()) {
+        ERR(job->tex->path + ": " + job->error);
+        job->tex->state = TextureLoadState::Failed;
+    } else {
+        job->tex->state = TextureLoadState::Ready;
+    }
+    --outstanding;
+}
+
+bool
+TextureLoader::update()
+{
+    {
+        std::lock_guard<std::mutex> lock(self->mutex);
+        for (auto &job : self->decoded)
+            self->uploads.push_back(std::move(job));
+        self->decoded.clear();
+    }
+
+    while (!self->uploads.empty() && !self->uploads.front()->error.empty()) {
+        self->finish(std::move(self->uploads.front()));
+        self->uploads.pop_front();
+    }
+
+    if (self->uploads.empty())
+        return self->outstanding > 0;
+
+    // a single row has to fit into a frame of the staging buffer
+    {
+        const auto &job = *self->uploads.front();
+        const auto row_size = job.levels[job.level].row_size;
+        if (row_size > self->staging.frameSize())
+            self->staging.reserve(row_size);
+    }
+
+    GL_CALL(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
+    self->staging.beginFrame();
+
+    size_t budget_left = self->budget;
+    while (!self->uploads.empty() && budget_left > 0) {
+        auto &job = *self->uploads.front();
+        if (!job.error.empty()) {
+            self->finish(std::move(self->uploads.front()));
+            self->uploads.pop_front();
+            continue;
+        }
+
+        if (!job.allocated)
+            self->allocate(job);
+
+        if (!self->uploadRows(job, budget_left))
+            break;
+
+        if (job.level == job.levels.size()) {
+            self->finish(std::move(self->uploads.front()));
+            self->uploads.pop_front();
+        }
+    }
+
+    stateCache().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    self->staging.endFrame();
+    GL_CALL(glPixelStorei, GL_UNPACK_ALIGNMENT, 4);
+
+    return self->outstanding > 0;
+}
+
+size_t
+TextureLoader::pending() const
+{
+    return self->outstanding;
+}
+
+} // namespace glt
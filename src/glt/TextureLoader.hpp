@@ -0,0 +1,103 @@
+#ifndef GLT_TEXTURE_LOADER_HPP
+#define GLT_TEXTURE_LOADER_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/BlockCompression.hpp"
+#include "glt/Image.hpp"
+#include "glt/TextureData.hpp"
+#include "pp/enum.hpp"
+#include "pp/pimpl.hpp"
+
+#include <memory>
+#include <string>
+
+namespace glt {
+
+#define GLT_TEXTURE_LOAD_STATE_ENUM_DEF(T, V0, V)                              \
+    T(TextureLoadState, uint8_t, V0(Pending) V(Uploading) V(Ready) V(Failed))
+
+PP_DEF_ENUM_WITH_API(GLT_API, GLT_TEXTURE_LOAD_STATE_ENUM_DEF);
+
+// bytes uploaded per TextureLoader::update() by default
+inline constexpr size_t TEXTURE_UPLOAD_BUDGET = 4 * 1024 * 1024;
+
+struct TextureLoadOptions
+{
+    bool mipmaps = true;
+    MipmapFilter filter = MipmapFilter::Box;
+    // the file is sRGB encoded, mipmaps are filtered in linear space and
+    // the texture gets an sRGB internal format
+    bool srgb = false;
+    // block compress all levels, cached if the loader has a cache
+    bool compress = false;
+    BlockFormat format = BlockFormat::BC1;
+    BlockQuality quality = BlockQuality::Fast;
+};
+
+struct CompressedTextureCache;
+
+// mipmaps base as requested by opts and block compresses all levels,
+// threads 0: one per hardware thread
+GLT_API void
+buildCompressedTexture(const Image &base,
+                       const TextureLoadOptions &opts,
+                       CompressedTexture &out,
+                       unsigned threads = 0);
+
+// A texture requested from a TextureLoader. The texture object exists once
+// the upload started, it can be sampled when the state is Ready.
+struct LoadedTexture
+{
+    std::string path;
+    std::shared_ptr<TextureData> data = std::make_shared<TextureData>();
+    TextureLoadState state = TextureLoadState::Pending;
+    uint32_t width{};
+    uint32_t height{};
+    uint32_t levels{};
+
+    bool ready() const { return state == TextureLoadState::Ready; }
+};
+
+// Loads 2D textures without stalling the GL thread: files are read,
+// decoded and mipmapped on worker threads, update() streams the levels
+// through a pixel buffer object, at most a budget of bytes per call. TGA
+// and BMP files are decoded out of the box, decoders for other formats
+// (e.g. PNG) can be registered. Compressed loads are block compressed by
+// the workers too, or read from a CompressedTextureCache.
+struct GLT_API TextureLoader
+{
+    TextureLoader();
+    ~TextureLoader();
+
+    // threads 0: one less than the hardware threads, at least one. Has to
+    // be called on the GL thread.
+    void init(unsigned threads = 0,
+              size_t upload_budget = TEXTURE_UPLOAD_BUDGET);
+
+    // stops the workers, textures not yet uploaded stay Pending
+    void shutdown();
+
+    // compressed loads are looked up in and stored into cache, which has
+    // to outlive the loader. nullptr disables caching.
+    void cache(CompressedTextureCache *cache);
+
+    // extension including the dot, e.g. ".png", compared case insensitive
+    void registerDecoder(const std::string &extension, ImageDecoder decoder);
+
+    std::shared_ptr<LoadedTexture> load(const std::string &path,
+                                        const TextureLoadOptions &opts = {});
+
+    // once per frame on the GL thread, true while loads are outstanding
+    bool update();
+
+    // loads not yet Ready or Failed
+    size_t pending() const;
+
+private:
+    DECLARE_PIMPL(GLT_API, self);
+};
+
+} // namespace glt
+
+#endif
@@ -1,6 +1,7 @@
 #include "glt/TextureRenderTarget.hpp"
 
 #include "err/err.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/utils.hpp"
 #include "opengl.hpp"
 
@@ -111,13 +112,13 @@ TextureRenderTarget::createTexture(bool delete_old)
 void
 TextureRenderTarget::doActivate()
 {
-    GL_CALL(glBindFramebuffer, GL_FRAMEBUFFER, *_frame_buffer);
+    stateCache().bindFramebuffer(GL_FRAMEBUFFER, *_frame_buffer);
 }
 
 void
 TextureRenderTarget::doDeactivate()
 {
-    GL_CALL(glBindFramebuffer, GL_FRAMEBUFFER, 0);
+    stateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 bool
@@ -1,5 +1,6 @@
 #include "glt/TextureRenderTarget3D.hpp"
 #include "err/err.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/utils.hpp"
 #include "math/ivec3.hpp"
 #include "math/vec3.hpp"
@@ -90,7 +91,7 @@ TextureRenderTarget3D::targetAttachment(
         (ta.type == AttachmentLayer && ta.size != _target_attachment.size)) {
 
         _target_attachment = ta;
-        GL_CALL(glBindFramebuffer, GL_FRAMEBUFFER, *_frame_buffer);
+        stateCache().bindFramebuffer(GL_FRAMEBUFFER, *_frame_buffer);
 
         switch (ta.type) {
         case AttachmentLayered:
@@ -115,7 +116,7 @@ TextureRenderTarget3D::targetAttachment(
             _sampler.data()->unbind(0, false);
             break;
         }
-        GL_CALL(glBindFramebuffer, GL_FRAMEBUFFER, 0);
+        stateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 }
 
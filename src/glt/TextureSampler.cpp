@@ -1,4 +1,5 @@
 #include "glt/TextureSampler.hpp"
+#include "glt/GLStateCache.hpp"
 #include "glt/utils.hpp"
 
 namespace glt {
@@ -70,14 +71,14 @@ void
 TextureSampler::bind(uint32_t idx, bool set_active_idx)
 {
     ensureSampler();
-    GL_CALL(glBindSampler, idx, *_sampler);
+    stateCache().bindSampler(idx, *_sampler);
     _data->bind(idx, set_active_idx);
 }
 
 void
 TextureSampler::unbind(uint32_t idx, bool set_active_idx)
 {
-    GL_CALL(glBindSampler, idx, 0);
+    stateCache().bindSampler(idx, 0);
     _data->unbind(idx, set_active_idx);
 }
 
@@ -88,6 +89,7 @@ TextureSampler::availableAxes(TextureType t)
     case Texture1D:
         return S;
     case Texture2D:
+    case Texture2DArray:
         return S | T;
     case Texture3D:
         return S | T | R;
@@ -0,0 +1,83 @@
+#include "glt/UniformBlock.hpp"
+
+#include "err/err.hpp"
+#include "glt/ShaderProgram.hpp"
+#include "glt/utils.hpp"
+
+#include <cstring>
+
+namespace glt {
+
+void
+packStd140(const StructInfo &info,
+           std::span<const Std140Info> members,
+           std::span<const uint16_t> offsets,
+           const void *src,
+           std::span<char> dst)
+{
+    ASSERT(info.fields.size() == members.size());
+    ASSERT(members.size() == offsets.size());
+
+    const auto *bytes = static_cast<const char *>(src);
+    for (size_t i = 0; i < members.size(); ++i) {
+        const auto &m = members[i];
+        const auto *from = bytes + info.fields[i].offset;
+        auto *to = dst.data() + offsets[i];
+        ASSERT(offsets[i] + m.size <= dst.size());
+        for (size_t c = 0; c < m.columns; ++c)
+            memcpy(to + c * m.align, from + c * m.column_size, m.column_size);
+    }
+}
+
+UniformBuffer::UniformBuffer(GLuint binding, size_t block_size, size_t capacity)
+  : _binding(binding)
+  , _block_size(block_size)
+  , _capacity(capacity)
+  , _staging(block_size)
+{
+    ASSERT(block_size > 0 && capacity > 0);
+
+    GLint align = 0;
+    GL_CALL(glGetIntegerv, GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    auto a = size_t(align > 0 ? align : 256);
+    _stride = (_block_size + a - 1) / a * a;
+    _next = _capacity; // force allocation on first upload
+}
+
+UniformBuffer::~UniformBuffer() = default;
+
+bool
+UniformBuffer::bindBlock(ShaderProgram &prog, const std::string &block_name)
+{
+    return prog.bindUniformBlock(block_name, _binding, _block_size);
+}
+
+void
+UniformBuffer::upload()
+{
+    _buffer.ensure();
+    if (_next == _capacity) {
+        GL_CALL(glNamedBufferDataEXT,
+                *_buffer,
+                GLsizeiptr(_stride * _capacity),
+                nullptr,
+                GL_STREAM_DRAW);
+        _next = 0;
+    }
+
+    auto offset = GLintptr(_next * _stride);
+    GL_CALL(glNamedBufferSubDataEXT,
+            *_buffer,
+            offset,
+            GLsizeiptr(_block_size),
+            _staging.data());
+    GL_CALL(glBindBufferRange,
+            GL_UNIFORM_BUFFER,
+            _binding,
+            *_buffer,
+            offset,
+            GLsizeiptr(_block_size));
+    ++_next;
+}
+
+} // namespace glt
@@ -0,0 +1,131 @@
+#ifndef GLT_UNIFORM_BLOCK_HPP
+#define GLT_UNIFORM_BLOCK_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/GLObject.hpp"
+#include "glt/type_info.hpp"
+#include "opengl.hpp"
+
+#include <array>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace glt {
+
+struct ShaderProgram;
+
+// std140 layout of a struct defined with DEF_GL_MAPPED_TYPE, computed at
+// compile time from the reflection data of its gl mapped type.
+template<typename T>
+struct Std140Layout
+{
+    using gl_type = typename T::gl;
+    using struct_info = typename gl_type::struct_info;
+
+    static inline constexpr auto &members = struct_info::std140;
+    static inline constexpr size_t count = members.size();
+
+    static constexpr bool supported()
+    {
+        for (const auto &m : members)
+            if (m.align == 0)
+                return false;
+        return true;
+    }
+
+    static constexpr std::array<uint16_t, count> computeOffsets()
+    {
+        std::array<uint16_t, count> offs{};
+        size_t off = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const auto &m = members[i];
+            off = (off + m.align - 1) / m.align * m.align;
+            offs[i] = uint16_t(off);
+            off += m.size;
+        }
+        return offs;
+    }
+
+    static constexpr size_t computeSize()
+    {
+        if constexpr (count == 0)
+            return 0;
+        auto end = size_t(offsets[count - 1]) + members[count - 1].size;
+        return (end + 15) / 16 * 16;
+    }
+
+    static_assert(supported(),
+                  "uniform block members need a std140 representation");
+    static_assert(std::is_trivially_copyable_v<gl_type>);
+
+    static inline constexpr std::array<uint16_t, count> offsets =
+      computeOffsets();
+    static inline constexpr size_t size = computeSize();
+};
+
+// copies the fields of a gl mapped struct into its std140 representation,
+// dst has to hold at least the std140 size of the struct
+GLT_API void
+packStd140(const StructInfo &info,
+           std::span<const Std140Info> members,
+           std::span<const uint16_t> offsets,
+           const void *src,
+           std::span<char> dst);
+
+// A ring of equally sized uniform blocks in one buffer object, each upload
+// goes to the next slot which is then bound to the binding point. When the
+// ring wraps the buffer storage is orphaned, so slots still read by queued
+// draw calls are never overwritten.
+struct GLT_API UniformBuffer
+{
+    GLBufferObject _buffer;
+    GLuint _binding{};
+    size_t _block_size{};
+    size_t _stride{};
+    size_t _capacity{};
+    size_t _next{};
+    std::vector<char> _staging;
+
+    UniformBuffer(GLuint binding, size_t block_size, size_t capacity);
+    ~UniformBuffer();
+
+    GLuint binding() const { return _binding; }
+
+    size_t blockSize() const { return _block_size; }
+
+    // associates the named block of the program with our binding point
+    bool bindBlock(ShaderProgram &prog, const std::string &block_name);
+
+    std::span<char> staging() { return _staging; }
+
+    // copies the staging area into the next slot and binds it
+    void upload();
+};
+
+template<typename T>
+struct UniformBlock : public UniformBuffer
+{
+    using layout = Std140Layout<T>;
+
+    explicit UniformBlock(GLuint binding, size_t capacity = 256)
+      : UniformBuffer(binding, layout::size, capacity)
+    {}
+
+    void set(const T &value)
+    {
+        const typename T::gl gl_value(value);
+        packStd140(layout::struct_info::info,
+                   layout::members,
+                   layout::offsets,
+                   &gl_value,
+                   staging());
+        upload();
+    }
+};
+
+} // namespace glt
+
+#endif
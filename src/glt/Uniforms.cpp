@@ -13,6 +13,8 @@
 #include "math/vec4.hpp"
 #include "opengl.hpp"
 
+#include <cstring>
+
 namespace glt {
 
 using namespace math;
@@ -26,6 +28,49 @@ gltype(const T &x) -> gl_mapped_type_t<T>
     return x;
 }
 
+UniformStatistics &
+statistics() noexcept
+{
+    static UniformStatistics stats;
+    return stats;
+}
+
+template<typename T>
+std::span<const char>
+valueBytes(const T &value)
+{
+    return { reinterpret_cast<const char *>(&value), sizeof value };
+}
+
+std::span<const char>
+valueBytes(std::span<const float> value)
+{
+    return { reinterpret_cast<const char *>(value.data()), value.size_bytes() };
+}
+
+std::span<const char>
+valueBytes(const BoundTexture &sampler)
+{
+    return valueBytes(sampler.size_t);
+}
+
+std::span<const char>
+valueBytes(const Sampler &sampler)
+{
+    return valueBytes(sampler.size_t);
+}
+
+// returns true if the slot did not already hold the value
+bool
+updateShadow(UniformCache::Slot &slot, std::span<const char> bytes)
+{
+    if (slot.value.size() == bytes.size() &&
+        std::memcmp(slot.value.data(), bytes.data(), bytes.size()) == 0)
+        return false;
+    slot.value.assign(bytes.begin(), bytes.end());
+    return true;
+}
+
 #if ENABLE_GLDEBUG_P
 std::string
 descGLType(GLenum ty)
@@ -207,33 +252,39 @@ programUniform(GLuint program, GLint loc, GLuint val)
     GL_CALL(glProgramUniform1ui, program, loc, val);
 }
 
-template<typename T>
-void
-setUniform(bool mandatory,
-           ShaderProgram &prog,
-           const std::string &name,
-           GLenum type,
-           const T &value)
+UniformCache::Slot *
+lookupUniform(bool mandatory,
+              ShaderProgram &prog,
+              const std::string &name,
+              GLenum type)
 {
-
     UNUSED(type);
 
-    GLint locationi;
-    GL_ASSIGN_CALL(
-      locationi, glGetUniformLocation, *prog.program(), name.c_str());
+    auto &slots = prog.uniformCache().slots;
+    auto it = slots.find(name);
+    if (it == slots.end()) {
+        UniformCache::Slot slot;
+        GL_ASSIGN_CALL(
+          slot.location, glGetUniformLocation, *prog.program(), name.c_str());
+        it = slots.emplace(name, std::move(slot)).first;
+    }
 
-    if (locationi == -1) {
+    auto &slot = it->second;
+    if (slot.location == -1) {
         if (mandatory)
             ERR("unknown uniform: " + name);
-        return;
+        return nullptr;
     }
 
 #if ENABLE_GLDEBUG_P
 
+    if (slot.type == type)
+        return &slot;
+
     GLint num_active;
     GL_CALL(glGetProgramiv, *prog.program(), GL_ACTIVE_UNIFORMS, &num_active);
-    if (locationi < num_active) {
-        auto location = GLuint(locationi);
+    if (slot.location < num_active) {
+        auto location = GLuint(slot.location);
         GLint actual_typei = -1;
         GL_CALL(glGetActiveUniformsiv,
                 *prog.program(),
@@ -249,18 +300,68 @@ setUniform(bool mandatory,
                   "\": types dont match, got: " + descGLType(type) +
                   ", expected: " + descGLType(actual_type);
                 ERR(err.c_str());
-                return;
+                return nullptr;
             }
         }
     }
 
+    slot.type = type;
+
 #endif
 
-    programUniform(*prog.program(), locationi, value);
+    return &slot;
+}
+
+template<typename T>
+void
+setUniform(bool mandatory,
+           ShaderProgram &prog,
+           const std::string &name,
+           GLenum type,
+           const T &value)
+{
+    auto *slot = lookupUniform(mandatory, prog, name, type);
+    if (!slot)
+        return;
+
+    if (!updateShadow(*slot, valueBytes(value))) {
+        ++statistics().skipped;
+        return;
+    }
+
+    ++statistics().issued;
+    programUniform(*prog.program(), slot->location, value);
 }
 
 } // namespace
 
+void
+UniformCache::invalidate()
+{
+    for (auto &ent : slots)
+        ent.second.value.clear();
+}
+
+UniformStatistics
+uniformStatistics()
+{
+    return statistics();
+}
+
+void
+resetUniformStatistics()
+{
+    statistics() = {};
+}
+
+void
+printUniformStatistics(sys::io::OutStream &out)
+{
+    const auto &stats = statistics();
+    out << "Uniform uploads: " << stats.issued << " issued, " << stats.skipped
+        << " skipped\n";
+}
+
 void
 Uniforms::set(bool mandatory, const std::string &name, float value)
 {
@@ -10,9 +10,12 @@
 #include "math/vec2.hpp"
 #include "math/vec3.hpp"
 #include "math/vec4.hpp"
+#include "sys/io/Stream.hpp"
 
 #include <span>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace glt {
 
@@ -48,6 +51,42 @@ struct GLT_API Sampler
     {}
 };
 
+// Per program cache of uniform locations and of the bytes last uploaded to
+// each location, used to elide redundant glProgramUniform* calls. Owned by
+// ShaderProgram, cleared whenever the program object is relinked.
+struct GLT_API UniformCache
+{
+    struct Slot
+    {
+        GLint location = -1;
+        GLenum type = GL_NONE;
+        std::vector<char> value; // empty if the current value is unknown
+    };
+
+    std::unordered_map<std::string, Slot> slots;
+
+    // forget the shadowed values but keep the locations, use this after
+    // modifying uniforms without going through Uniforms
+    void invalidate();
+
+    void clear() { slots.clear(); }
+};
+
+struct GLT_API UniformStatistics
+{
+    size_t issued{};
+    size_t skipped{};
+};
+
+GLT_API UniformStatistics
+uniformStatistics();
+
+GLT_API void
+resetUniformStatistics();
+
+GLT_API void
+printUniformStatistics(sys::io::OutStream &);
+
 struct GLT_API Uniforms
 {
     ShaderProgram &prog;
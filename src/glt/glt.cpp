@@ -1,6 +1,7 @@
 #define DEFINE_GLT_MODULE
 
 #include "glt/glt.hpp"
+#include "glt/NullGL.hpp"
 #include "glt/module.hpp"
 
 #include <cassert>
@@ -14,10 +15,12 @@ std::unique_ptr<Module> module;
 END_NO_WARN_GLOBAL_DESTRUCTOR
 
 void
-moduleInit()
+moduleInit(GLBackend backend)
 {
     if (!module)
         module = std::make_unique<Module>();
+    if (backend == GLBackend::Null && !module->utils.null_gl)
+        loadNullGL();
 }
 
 void
@@ -26,4 +29,11 @@ moduleExit()
     module.reset();
 }
 
+GLBackend
+glBackend()
+{
+    return module && module->utils.null_gl ? GLBackend::Null
+                                           : GLBackend::Native;
+}
+
 } // namespace glt
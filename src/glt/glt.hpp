@@ -3,14 +3,27 @@
 
 #include "glt/conf.hpp"
 
+#include <cstdint>
+
 namespace glt {
 
+enum class GLBackend : uint8_t
+{
+    Native, // functions are loaded from the context of a window
+    Null    // no context, see glt/NullGL.hpp
+};
+
+// Null loads the null driver right away. Called again on an initialized
+// module, the backend can still be switched to Null before the first GL call.
 GLT_API void
-moduleInit();
+moduleInit(GLBackend backend = GLBackend::Native);
 
 GLT_API void
 moduleExit();
 
+GLT_API GLBackend
+glBackend();
+
 } // namespace glt
 
 #endif
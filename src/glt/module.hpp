@@ -2,6 +2,8 @@
 #define GLT_MODULE_HPP
 
 #include "glt/GLDebug.hpp"
+#include "glt/GLStateCache.hpp"
+#include "glt/GPUProfiler.hpp"
 #include "glt/utils.hpp"
 
 #include <memory>
@@ -14,9 +16,14 @@
 
 namespace glt {
 
+struct GLCaptureWriter;
+struct NullGL;
+
 struct Utils
 {
     std::shared_ptr<GLDebug> gl_debug;
+    std::shared_ptr<GLCaptureWriter> gl_capture; // set while capturing
+    std::shared_ptr<NullGL> null_gl;             // set by GLBackend::Null
 
     bool print_opengl_calls = false;
 
@@ -33,6 +40,8 @@ struct Utils
 struct Module
 {
     Utils utils;
+    GLStateCache state_cache;
+    GPUProfiler gpu_profiler;
 };
 
 extern std::unique_ptr<Module> module;
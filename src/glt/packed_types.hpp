@@ -0,0 +1,257 @@
+#ifndef GLT_PACKED_TYPES_HPP
+#define GLT_PACKED_TYPES_HPP
+
+#include "glt/conf.hpp"
+
+#include "glt/type_info.hpp"
+#include "math/genvec.hpp"
+#include "util/bit_cast.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Compressed vertex attribute formats. A field of a DEF_GL_MAPPED_TYPE
+// struct declared with one of the annotations below stays a float vector on
+// the host side but is packed in the gl representation, e.g.
+//
+//   DEF_GL_MAPPED_TYPE(Vertex,
+//                      (glt::half<vec3_t>, position),
+//                      (glt::packed_normal<vec3_t>, normal),
+//                      (glt::unorm8<vec4_t>, color))
+//
+// Normalized formats arrive in the shader as floats in [-1, 1] or [0, 1].
+
+namespace glt {
+
+inline uint16_t
+packHalf(float x)
+{
+    const auto bits = bit_cast<uint32_t>(x);
+    const auto sign = uint16_t((bits >> 16) & 0x8000);
+    auto abs_bits = bits & 0x7FFFFFFF;
+
+    if (abs_bits >= 0x7F800000) // inf, nan
+        return sign | 0x7C00 | (abs_bits > 0x7F800000 ? 0x200 : 0);
+    if (abs_bits >= 0x477FF000) // rounds to >= 65520
+        return sign | 0x7C00;
+    if (abs_bits < 0x38800000) // subnormal in half precision
+        return sign |
+               uint16_t(std::lrint(bit_cast<float>(abs_bits) * 16777216.f));
+
+    // rebias the exponent and round to nearest even
+    abs_bits += 0xC8000FFF + ((abs_bits >> 13) & 1);
+    return sign | uint16_t(abs_bits >> 13);
+}
+
+inline float
+unpackHalf(uint16_t h)
+{
+    const uint32_t sign = uint32_t(h & 0x8000) << 16;
+    const uint32_t exp = (h >> 10) & 0x1F;
+    const uint32_t mant = h & 0x3FF;
+
+    if (exp == 0) {
+        auto x = float(mant) * (1.f / 16777216.f);
+        return sign != 0 ? -x : x;
+    }
+    if (exp == 31)
+        return bit_cast<float>(sign | 0x7F800000 | (mant << 13));
+    return bit_cast<float>(sign | ((exp + 112) << 23) | (mant << 13));
+}
+
+inline int16_t
+packSnorm16(float x)
+{
+    return int16_t(std::lrint(std::clamp(x, -1.f, 1.f) * 32767.f));
+}
+
+inline float
+unpackSnorm16(int16_t x)
+{
+    return std::max(float(x) * (1.f / 32767.f), -1.f);
+}
+
+inline uint8_t
+packUnorm8(float x)
+{
+    return uint8_t(std::lrint(std::clamp(x, 0.f, 1.f) * 255.f));
+}
+
+inline float
+unpackUnorm8(uint8_t x)
+{
+    return float(x) * (1.f / 255.f);
+}
+
+// GL_INT_2_10_10_10_REV: x, y, z as 10 bit snorm, w as 2 bit snorm
+inline uint32_t
+packInt2_10_10_10Rev(float x, float y, float z, float w = 0.f)
+{
+    auto c10 = [](float v) {
+        return uint32_t(std::lrint(std::clamp(v, -1.f, 1.f) * 511.f)) & 0x3FF;
+    };
+    auto c2 = uint32_t(std::lrint(std::clamp(w, -1.f, 1.f))) & 0x3;
+    return c10(x) | (c10(y) << 10) | (c10(z) << 20) | (c2 << 30);
+}
+
+inline float
+unpackInt2_10_10_10Rev(uint32_t bits, size_t component)
+{
+    if (component == 3)
+        return std::max(float(int32_t(bits) >> 30), -1.f);
+    auto c = int32_t(bits << (22 - 10 * component)) >> 22;
+    return std::max(float(c) * (1.f / 511.f), -1.f);
+}
+
+struct half_format
+{
+    using component = uint16_t;
+    static inline constexpr ScalarType scalar_type = ScalarType::F16;
+    static inline constexpr bool normalized = false;
+    static component pack(float x) { return packHalf(x); }
+    static float unpack(component c) { return unpackHalf(c); }
+};
+
+struct snorm16_format
+{
+    using component = int16_t;
+    static inline constexpr ScalarType scalar_type = ScalarType::I16;
+    static inline constexpr bool normalized = true;
+    static component pack(float x) { return packSnorm16(x); }
+    static float unpack(component c) { return unpackSnorm16(c); }
+};
+
+struct unorm8_format
+{
+    using component = uint8_t;
+    static inline constexpr ScalarType scalar_type = ScalarType::U8;
+    static inline constexpr bool normalized = true;
+    static component pack(float x) { return packUnorm8(x); }
+    static float unpack(component c) { return unpackUnorm8(c); }
+};
+
+struct int_2_10_10_10_rev_format
+{};
+
+// gl representation of a componentwise packed vector
+template<typename Format, size_t N>
+struct packed_vec
+{
+    typename Format::component components[N];
+
+    packed_vec() = default;
+
+    template<typename T>
+    explicit packed_vec(const math::genvec<T, N> &v)
+    {
+        for (size_t i = 0; i < N; ++i)
+            components[i] = Format::pack(float(v[i]));
+    }
+
+    template<typename T>
+    explicit operator math::genvec<T, N>() const
+    {
+        math::genvec<T, N> v{};
+        for (size_t i = 0; i < N; ++i)
+            v[i] = T(Format::unpack(components[i]));
+        return v;
+    }
+};
+
+// gl representation of a 3 or 4 component vector as
+// GL_INT_2_10_10_10_REV, the attribute always has 4 components
+struct packed_2_10_10_10_rev
+{
+    uint32_t bits;
+
+    packed_2_10_10_10_rev() = default;
+
+    template<typename T, size_t N>
+    explicit packed_2_10_10_10_rev(const math::genvec<T, N> &v)
+      : bits(packInt2_10_10_10Rev(float(v[0]),
+                                  float(v[1]),
+                                  float(v[2]),
+                                  N > 3 ? float(v[N - 1]) : 0.f))
+    {
+        static_assert(N == 3 || N == 4);
+    }
+
+    template<typename T, size_t N>
+    explicit operator math::genvec<T, N>() const
+    {
+        math::genvec<T, N> v{};
+        for (size_t i = 0; i < N; ++i)
+            v[i] = T(unpackInt2_10_10_10Rev(bits, i));
+        return v;
+    }
+};
+
+template<typename Format, size_t N>
+struct packed_storage
+{
+    using type = packed_vec<Format, N>;
+    static inline constexpr TypeInfo type_info{ Format::normalized,
+                                                sizeof(type),
+                                                Format::scalar_type,
+                                                N };
+};
+
+template<size_t N>
+struct packed_storage<int_2_10_10_10_rev_format, N>
+{
+    using type = packed_2_10_10_10_rev;
+    static inline constexpr TypeInfo type_info{ true,
+                                                sizeof(type),
+                                                ScalarType::I2_10_10_10_REV,
+                                                4 };
+};
+
+// host side type of an annotated field: the plain vector, convertible to
+// and from its packed gl representation
+template<typename Format, typename V>
+struct packed_attr;
+
+template<typename Format, typename T, size_t N>
+struct packed_attr<Format, math::genvec<T, N>> : public math::genvec<T, N>
+{
+    using vec_type = math::genvec<T, N>;
+    using storage = typename packed_storage<Format, N>::type;
+
+    packed_attr() = default;
+
+    packed_attr(const vec_type &v) : vec_type(v) {}
+
+    explicit packed_attr(const storage &s)
+      : vec_type(static_cast<vec_type>(s))
+    {}
+};
+
+template<typename Format, typename V>
+struct gl_mapped_type<packed_attr<Format, V>>
+{
+    using type = typename packed_attr<Format, V>::storage;
+};
+
+template<typename Format, typename T, size_t N>
+struct type_info_traits<packed_attr<Format, math::genvec<T, N>>>
+{
+    static inline constexpr TypeInfo type_info =
+      packed_storage<Format, N>::type_info;
+};
+
+template<typename V>
+using half = packed_attr<half_format, V>;
+
+template<typename V>
+using snorm16 = packed_attr<snorm16_format, V>;
+
+template<typename V>
+using unorm8 = packed_attr<unorm8_format, V>;
+
+template<typename V>
+using packed_normal = packed_attr<int_2_10_10_10_rev_format, V>;
+
+} // namespace glt
+
+#endif
@@ -26,6 +26,10 @@ toGLScalarType(ScalarType t)
         return GL_FLOAT;
     case ScalarType::F64:
         return GL_DOUBLE;
+    case ScalarType::F16:
+        return GL_HALF_FLOAT;
+    case ScalarType::I2_10_10_10_REV:
+        return GL_INT_2_10_10_10_REV;
     }
     UNREACHABLE;
 }
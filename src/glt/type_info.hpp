@@ -27,7 +27,8 @@ namespace glt {
 #define SCALAR_TYPE_ENUM_DEF(T, V0, V)                                         \
     T(ScalarType,                                                              \
       uint8_t,                                                                 \
-      V0(I8) V(I16) V(I32) V(U8) V(U16) V(U32) V(F32) V(F64))
+      V0(I8) V(I16) V(I32) V(U8) V(U16) V(U32) V(F32) V(F64) V(F16)            \
+        V(I2_10_10_10_REV))
 
 struct GLT_API ScalarType;
 
@@ -154,6 +155,68 @@ struct gl_mapped_type<color>
     using type = color;
 };
 
+// std140 layout of a single uniform block member, columns > 1 for matrices
+// whose columns are stored at a stride of align bytes. A zero align marks
+// types without a std140 representation.
+struct Std140Info
+{
+    uint16_t align;
+    uint16_t size;
+    uint16_t columns;
+    uint16_t column_size;
+};
+
+template<typename T>
+struct std140_traits
+{
+    static inline constexpr Std140Info info{ 0, 0, 0, 0 };
+};
+
+#define DEF_STD140_SCALAR(ty)                                                  \
+    template<>                                                                 \
+    struct std140_traits<ty>                                                   \
+    {                                                                          \
+        static inline constexpr Std140Info info{ sizeof(ty),                   \
+                                                 sizeof(ty),                   \
+                                                 1,                            \
+                                                 sizeof(ty) };                 \
+    }
+
+DEF_STD140_SCALAR(int32_t);
+DEF_STD140_SCALAR(uint32_t);
+DEF_STD140_SCALAR(float);
+DEF_STD140_SCALAR(double);
+
+#undef DEF_STD140_SCALAR
+
+template<typename T, size_t N>
+struct std140_traits<math::genvec<T, N>>
+{
+    static inline constexpr Std140Info component = std140_traits<T>::info;
+    static inline constexpr Std140Info info{
+        uint16_t(component.align == 0 ? 0 : (N <= 2 ? N : 4) * component.size),
+        uint16_t(N * component.size),
+        1,
+        uint16_t(N * component.size),
+    };
+};
+
+template<typename T, size_t N>
+struct std140_traits<math::genmat<T, N>>
+{
+    // column major: N columns, each a vec<N> padded to a multiple of vec4
+    static inline constexpr Std140Info column =
+      std140_traits<math::genvec<T, N>>::info;
+    static inline constexpr uint16_t stride =
+      uint16_t((column.align + 15) / 16 * 16);
+    static inline constexpr Std140Info info{
+        uint16_t(column.align == 0 ? 0 : stride),
+        uint16_t(N * stride),
+        uint16_t(N),
+        column.size,
+    };
+};
+
 struct FieldInfo
 {
     const char *name;
@@ -185,6 +248,11 @@ struct StructInfo
       ::glt::type_info_traits<PP_DEFER1(PP_ARG1) type_and_name>::type_info,    \
       ti_offsetof(struct_type, PP_DEFER1(PP_ARG2) type_and_name))
 
+#define TI_DEF_STD140_INFO0(type, field_name)                                   \
+    ::glt::std140_traits<::glt::gl_mapped_type_t<type>>::info
+#define TI_DEF_STD140_INFO(type_and_name)                                      \
+    PP_DEFER1(TI_DEF_STD140_INFO0) type_and_name
+
 #define TI_DEF_STRUCT_FIELD0(t, nm) t nm
 #define TI_DEF_STRUCT_FIELD(type_and_name)                                     \
     PP_DEFER1(TI_DEF_STRUCT_FIELD0) type_and_name
@@ -235,6 +303,8 @@ struct StructInfo
                             sizeof(sname::gl),                                 \
                             alignof(sname::gl),                                \
                             ::std::span<const ::glt::FieldInfo>(_fields));     \
+        static constexpr auto std140 = std::array{ PP_MAP(                     \
+          TI_DEF_STD140_INFO, PP_COMMA, __VA_ARGS__) };                        \
     };                                                                         \
     sname::sname(const sname::gl &TI_VAR(arg))                                 \
       : PP_MAP(TI_INIT_FIELD, PP_COMMA, __VA_ARGS__)                           \
@@ -73,6 +73,13 @@ isExtensionSupported(const char *extension)
     return false;
 }
 
+bool
+baseInstanceSupported()
+{
+    return GLAD_GL_ARB_base_instance || GLVersion.major > 4 ||
+           (GLVersion.major == 4 && GLVersion.minor >= 2);
+}
+
 void
 ignoreDebugMessage(OpenGLVendor vendor, GLuint id)
 {
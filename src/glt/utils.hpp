@@ -4,6 +4,10 @@
 #include "glt/conf.hpp"
 #include "opengl.hpp"
 
+#if ENABLE_GLCAPTURE_P
+#    include "glt/GLCapture.hpp"
+#endif
+
 #include "err/err.hpp"
 #include "sys/io/Stream.hpp"
 
@@ -12,20 +16,49 @@
         do {                                                                   \
             ::glt::printGLTrace(ERROR_LOCATION_OP(msg));                       \
         } while (0)
-#    define GL_CHECK(op)                                                       \
+// like GL_CHECK, errors are reported as coming from the expression text
+#    define GL_CHECK_AS(op, text)                                              \
         do {                                                                   \
             (op);                                                              \
-            ::glt::checkForGLError(ERROR_LOCATION_OP(PP_TOSTR(op)));           \
+            ::glt::checkForGLError(ERROR_LOCATION_OP(PP_TOSTR(text)));         \
         } while (0)
+#    define GL_CHECK(op) GL_CHECK_AS(op, op)
 #    define GL_CHECK_ERRORS() ::glt::checkForGLError(ERROR_LOCATION)
 #else
+#    define GL_CHECK_AS(op, text) UNUSED(op)
 #    define GL_CHECK(op) UNUSED(op)
 #    define GL_CHECK_ERRORS() UNUSED(0)
 #    define GL_TRACE(loc)
 #endif
 
-#define GL_CALL(fn, ...) GL_CHECK(fn(__VA_ARGS__))
-#define GL_ASSIGN_CALL(var, fn, ...) GL_CHECK(var = fn(__VA_ARGS__))
+#if ENABLE_GLCAPTURE_P
+// records the call while glt::glCaptureStart() is active. The arguments
+// are evaluated once and passed on to the recorder and to fn.
+#    define GL_CALL_NAMED(name, fn, ...)                                       \
+        GL_CHECK_AS(                                                           \
+          [&](auto &&..._gl_args_) {                                           \
+              ::glt::GLCallRecorder _gl_rec_;                                  \
+              _gl_rec_.begin((name), _gl_args_...);                            \
+              fn(_gl_args_...);                                                \
+              _gl_rec_.end();                                                  \
+          }(__VA_ARGS__),                                                      \
+          fn(__VA_ARGS__))
+#    define GL_ASSIGN_CALL(var, fn, ...)                                       \
+        GL_CHECK_AS(                                                           \
+          [&](auto &&..._gl_args_) {                                           \
+              ::glt::GLCallRecorder _gl_rec_;                                  \
+              _gl_rec_.begin(#fn, _gl_args_...);                               \
+              var = fn(_gl_args_...);                                          \
+              _gl_rec_.end(var);                                               \
+          }(__VA_ARGS__),                                                      \
+          var = fn(__VA_ARGS__))
+#else
+#    define GL_CALL_NAMED(name, fn, ...) GL_CHECK(fn(__VA_ARGS__))
+#    define GL_ASSIGN_CALL(var, fn, ...) GL_CHECK(var = fn(__VA_ARGS__))
+#endif
+
+// name is used by the capture, for calls through function pointers
+#define GL_CALL(fn, ...) GL_CALL_NAMED(#fn, fn, __VA_ARGS__)
 
 #define GL_CALL_NO_CHECK(fn, ...)
 
@@ -63,6 +96,10 @@ checkForGLError(const err::Location *loc);
 GLT_API bool
 isExtensionSupported(const char *extension);
 
+// the glDraw*BaseInstance functions need GL 4.2 or ARB_base_instance
+GLT_API bool
+baseInstanceSupported();
+
 GLT_API bool
 initDebug();
 
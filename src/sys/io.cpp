@@ -133,6 +133,8 @@ HandleStream::basic_write(size_t &s, const char *buf)
         memcpy(write_buffer + write_cursor, buf, rem);
         k = HANDLE_WRITE_BUFFER_SIZE;
         std::tie(k, err) = sys::io::write(handle, std::span{ write_buffer, k });
+    } else {
+        rem = 0; // nothing of buf went into the buffer
     }
 
     if (write_cursor == 0 ||
@@ -194,6 +194,45 @@ struct Socket : private NonCopyable
     }
 };
 
+struct MappedFile;
+
+SYS_API void
+unmap(MappedFile &);
+
+// read only mapping of a whole file, stays valid when the file is replaced
+struct MappedFile : private NonCopyable
+{
+    std::span<const char> _data{};
+    void *_base{}; // start of the mapping, null if empty
+
+    constexpr MappedFile() = default;
+    constexpr MappedFile(MappedFile &&rhs) noexcept { swap(*this, rhs); }
+    MappedFile &operator=(MappedFile &&rhs) noexcept
+    {
+        auto tmp = MappedFile{ std::move(rhs) };
+        swap(*this, tmp);
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+        if (_base != nullptr)
+            unmap(*this);
+    }
+
+    std::span<const char> data() const { return _data; }
+
+    constexpr friend void swap(MappedFile &lhs, MappedFile &rhs) noexcept
+    {
+        using std::swap;
+        swap(lhs._data, rhs._data);
+        swap(lhs._base, rhs._base);
+    }
+};
+
+HU_NODISCARD SYS_API HandleResult<MappedFile>
+mapFile(std::string_view path);
+
 struct SYS_API HandleStream : public IOStream
 {
 private:
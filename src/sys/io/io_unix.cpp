@@ -9,6 +9,7 @@
 #include <cerrno>
 #include <cstring>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -168,6 +169,41 @@ open(std::string_view path, HandleMode mode)
     return { std::move(h) };
 }
 
+HandleResult<MappedFile>
+mapFile(std::string_view path)
+{
+    auto res = open(path, HM_READ);
+    if (!res)
+        return util::unexpected{ res.error() };
+    auto h = std::move(res).value();
+
+    struct stat st;
+    if (fstat(h._os.fd, &st) == -1)
+        return util::unexpected{ convertErrno() };
+
+    MappedFile m;
+    if (st.st_size == 0)
+        return { std::move(m) };
+
+    auto size = size_t(st.st_size);
+    void *base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, h._os.fd, 0);
+    if (base == MAP_FAILED)
+        return util::unexpected{ convertErrno() };
+
+    m._base = base;
+    m._data = { static_cast<const char *>(base), size };
+    return { std::move(m) };
+}
+
+void
+unmap(MappedFile &m)
+{
+    if (m._base != nullptr && munmap(m._base, m._data.size()) == -1)
+        ERR(strerror_errno().data());
+    m._base = nullptr;
+    m._data = {};
+}
+
 HandleMode
 mode(Handle &h)
 {
@@ -168,6 +168,49 @@ open(std::string_view path, HandleMode mode)
     return { std::move(h) };
 }
 
+HandleResult<MappedFile>
+mapFile(std::string_view path)
+{
+    auto res = open(path, HM_READ);
+    if (!res)
+        return util::unexpected{ res.error() };
+    auto h = std::move(res).value();
+    auto file = castToHandle(h._os.handle);
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+        return util::unexpected{ getLastHandleError() };
+
+    MappedFile m;
+    if (size.QuadPart == 0)
+        return { std::move(m) };
+
+    auto mapping =
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+        return util::unexpected{ getLastHandleError() };
+
+    // the view keeps the mapping object alive
+    void *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    auto err = base == nullptr ? getLastHandleError() : HandleError::OK;
+    CloseHandle(mapping);
+    if (base == nullptr)
+        return util::unexpected{ err };
+
+    m._base = base;
+    m._data = { static_cast<const char *>(base), size_t(size.QuadPart) };
+    return { std::move(m) };
+}
+
+void
+unmap(MappedFile &m)
+{
+    if (m._base != nullptr && !UnmapViewOfFile(m._base))
+        ERR("UnmapViewOfFile failed");
+    m._base = nullptr;
+    m._data = {};
+}
+
 HandleMode
 mode(Handle &h)
 {
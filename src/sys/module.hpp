@@ -5,6 +5,7 @@
 #include "sys/fiber.hpp"
 #include "sys/io.hpp"
 #include "sys/io/Stream.hpp"
+#include "sys/profile.hpp"
 
 #include <memory>
 
@@ -59,6 +60,7 @@ struct Module
     io::WS32Init _ws32_init;
 #endif
     Fibers fibers;
+    TraceWriter trace;
 };
 
 extern std::unique_ptr<Module> module;
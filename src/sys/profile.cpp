@@ -0,0 +1,188 @@
+#include "sys/profile.hpp"
+
+#include "sys/clock.hpp"
+#include "sys/module.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace sys {
+
+namespace {
+
+// buffered bytes written out at once
+inline constexpr size_t TRACE_CHUNK_SIZE = 64 * 1024;
+
+// nearest rank: the smallest sample with at least p percent of the samples
+// less or equal
+double
+percentile(std::span<const double> sorted, size_t p)
+{
+    const auto rank = (sorted.size() * p + 99) / 100;
+    return sorted[std::max(rank, size_t(1)) - 1];
+}
+
+void
+appendEscaped(std::string &buf, std::string_view str)
+{
+    for (const char c : str) {
+        if (c == '"' || c == '\\') {
+            buf += '\\';
+            buf += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof esc, "\\u%04x", unsigned(c));
+            buf += esc;
+        } else {
+            buf += c;
+        }
+    }
+}
+
+} // namespace
+
+TimingStats
+timingStats(std::span<double> samples)
+{
+    TimingStats stats;
+    if (samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+    for (const auto t : samples)
+        stats.total += t;
+    stats.count = samples.size();
+    stats.min = samples.front();
+    stats.max = samples.back();
+    stats.avg = stats.total / double(stats.count);
+    stats.median = percentile(samples, 50);
+    stats.p95 = percentile(samples, 95);
+    stats.p99 = percentile(samples, 99);
+    return stats;
+}
+
+void
+printTimingStats(io::OutStream &out, const TimingStats &stats)
+{
+    auto ms = [](double secs) { return secs * 1000; };
+    out << stats.count << " samples, ms: avg " << ms(stats.avg) << ", min "
+        << ms(stats.min) << ", median " << ms(stats.median) << ", p95 "
+        << ms(stats.p95) << ", p99 " << ms(stats.p99) << ", max "
+        << ms(stats.max) << "\n";
+}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+bool
+TraceWriter::open(std::string_view path)
+{
+    close();
+    auto res = io::HandleStream::open(path, io::HM_WRITE);
+    if (!res)
+        return false;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _out.emplace(std::move(res).value());
+    _origin = queryTimer();
+    _first = true;
+    _buffer = "{\"traceEvents\":[\n";
+    _open.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void
+TraceWriter::close()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_out)
+        return;
+    _open.store(false, std::memory_order_relaxed);
+    _buffer += "\n]}\n";
+    flushLocked();
+    _out->close();
+    _out.reset();
+}
+
+void
+TraceWriter::zone(std::string_view name,
+                  uint32_t track,
+                  double begin,
+                  double end)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_out)
+        return;
+
+    char times[96];
+    snprintf(times,
+             sizeof times,
+             "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+             unsigned(track),
+             (begin - _origin) * 1e6,
+             std::max(end - begin, 0.0) * 1e6);
+
+    _buffer += _first ? "{\"name\":\"" : ",\n{\"name\":\"";
+    _first = false;
+    appendEscaped(_buffer, name);
+    _buffer += times;
+    if (_buffer.size() >= TRACE_CHUNK_SIZE)
+        flushLocked();
+}
+
+void
+TraceWriter::nameTrack(uint32_t track, std::string_view name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_out)
+        return;
+
+    char tid[64];
+    snprintf(tid,
+             sizeof tid,
+             "\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+             unsigned(track));
+
+    _buffer += _first ? "{\"name\":\"thread_name\","
+                      : ",\n{\"name\":\"thread_name\",";
+    _first = false;
+    _buffer += tid;
+    appendEscaped(_buffer, name);
+    _buffer += "\"}}";
+}
+
+uint32_t
+TraceWriter::threadTrack()
+{
+    static std::atomic<uint32_t> next_track{ TRACE_GPU_TRACK + 1 };
+    thread_local const uint32_t track = next_track++;
+    return track;
+}
+
+void
+TraceWriter::flushLocked()
+{
+    auto [n, ret] = _out->write(_buffer);
+    if (ret != io::StreamResult::OK || n != _buffer.size())
+        io::stderr() << "TraceWriter: couldnt write trace\n";
+    _buffer.clear();
+}
+
+TraceWriter &
+trace()
+{
+    return module->trace;
+}
+
+CPUScope::CPUScope(const char *name) : _name(name), _begin(queryTimer()) {}
+
+CPUScope::~CPUScope()
+{
+    auto &writer = trace();
+    if (writer.isOpen())
+        writer.zone(_name, TraceWriter::threadTrack(), _begin, queryTimer());
+}
+
+} // namespace sys
@@ -0,0 +1,97 @@
+#ifndef SYS_PROFILE_HPP
+#define SYS_PROFILE_HPP
+
+#include "sys/conf.hpp"
+
+#include "sys/io.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace sys {
+
+// summary of a set of durations, all in seconds
+struct TimingStats
+{
+    size_t count{};
+    double total{};
+    double min{};
+    double avg{};
+    double median{};
+    double p95{};
+    double p99{};
+    double max{};
+};
+
+// samples is sorted in place, the median and percentiles are samples picked
+// by nearest rank
+SYS_API TimingStats
+timingStats(std::span<double> samples);
+
+// one line: count, then avg min median p95 p99 max in milliseconds
+SYS_API void
+printTimingStats(io::OutStream &out, const TimingStats &stats);
+
+// track of the GPU timeline in a trace, CPU threads get the following ones
+inline constexpr uint32_t TRACE_GPU_TRACK = 0;
+
+// Writes zones as Chrome trace event JSON, viewable in chrome://tracing or
+// Perfetto. Timestamps are sys::queryTimer() seconds, written relative to
+// open(). Thread safe, zones are buffered and written in chunks.
+struct SYS_API TraceWriter
+{
+    TraceWriter() = default;
+    ~TraceWriter();
+
+    bool open(std::string_view path);
+    void close();
+    bool isOpen() const { return _open.load(std::memory_order_relaxed); }
+
+    // zone on track from begin to end
+    void zone(std::string_view name, uint32_t track, double begin, double end);
+
+    // shown instead of the track number
+    void nameTrack(uint32_t track, std::string_view name);
+
+    // track of the calling thread, numbered in order of first use
+    static uint32_t threadTrack();
+
+private:
+    void flushLocked();
+
+    std::mutex _mutex;
+    std::optional<io::HandleStream> _out;
+    std::string _buffer;
+    double _origin{};
+    std::atomic<bool> _open{ false };
+    bool _first{ true };
+};
+
+// the trace of this process, owned by the sys module
+SYS_API TraceWriter &
+trace();
+
+// Adds a zone from construction to destruction to the trace of the thread,
+// if the trace is open.
+struct SYS_API CPUScope
+{
+    explicit CPUScope(const char *name);
+    ~CPUScope();
+
+    CPUScope(const CPUScope &) = delete;
+    CPUScope &operator=(const CPUScope &) = delete;
+
+private:
+    const char *_name;
+    double _begin;
+};
+
+} // namespace sys
+
+#define CPU_SCOPE(name) ::sys::CPUScope PP_CAT(cpu_scope_, __LINE__)(name)
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef UTIL_HASH128_HPP
+#define UTIL_HASH128_HPP 1
+
+#include "defs.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// 128 bit hash for content addressed caches, MurmurHash3 x64_128 computed
+// incrementally. Not cryptographic, but collisions are practically
+// impossible for the amounts of data hashed here.
+
+struct Hash128
+{
+    uint64_t lo{};
+    uint64_t hi{};
+
+    // 32 lowercase hex digits, usable as a file name
+    std::string hex() const
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string s(32, '0');
+        for (int i = 0; i < 16; ++i) {
+            s[size_t(15 - i)] = digits[(hi >> (4 * i)) & 0xF];
+            s[size_t(31 - i)] = digits[(lo >> (4 * i)) & 0xF];
+        }
+        return s;
+    }
+
+    friend constexpr bool operator==(const Hash128 &a, const Hash128 &b)
+    {
+        return a.lo == b.lo && a.hi == b.hi;
+    }
+
+    friend constexpr bool operator!=(const Hash128 &a, const Hash128 &b)
+    {
+        return !(a == b);
+    }
+
+    friend constexpr bool operator<(const Hash128 &a, const Hash128 &b)
+    {
+        return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+    }
+};
+
+struct Hasher128
+{
+    static constexpr uint64_t C1 = 0x87c37b91114253d5ull;
+    static constexpr uint64_t C2 = 0x4cf5ad432745937full;
+
+    uint64_t h1;
+    uint64_t h2;
+    uint64_t length{};
+    unsigned char tail[16]{};
+    size_t tail_len{};
+
+    explicit Hasher128(uint64_t seed = 0) : h1(seed), h2(seed) {}
+
+    Hasher128 &update(const void *data, size_t n)
+    {
+        auto p = static_cast<const unsigned char *>(data);
+        length += n;
+
+        if (tail_len > 0) {
+            auto k = n < 16 - tail_len ? n : 16 - tail_len;
+            memcpy(tail + tail_len, p, k);
+            tail_len += k;
+            p += k;
+            n -= k;
+            if (tail_len < 16)
+                return *this;
+            block(tail);
+            tail_len = 0;
+        }
+
+        for (; n >= 16; p += 16, n -= 16)
+            block(p);
+
+        memcpy(tail, p, n);
+        tail_len = n;
+        return *this;
+    }
+
+    Hasher128 &update(std::string_view s) { return update(s.data(), s.size()); }
+
+    // strings are length prefixed, so consecutive fields cannot be confused
+    Hasher128 &field(std::string_view s)
+    {
+        value(uint64_t(s.size()));
+        return update(s);
+    }
+
+    template<typename T>
+    Hasher128 &value(const T &x)
+    {
+        return update(&x, sizeof x);
+    }
+
+    Hash128 finish() const
+    {
+        uint64_t a = h1, b = h2;
+        uint64_t k1 = 0, k2 = 0;
+        for (size_t i = tail_len; i > 8; --i)
+            k2 = (k2 << 8) | tail[i - 1];
+        for (size_t i = tail_len < 8 ? tail_len : 8; i > 0; --i)
+            k1 = (k1 << 8) | tail[i - 1];
+        if (tail_len > 8)
+            b ^= rotl(k2 * C2, 33) * C1;
+        if (tail_len > 0)
+            a ^= rotl(k1 * C1, 31) * C2;
+
+        a ^= length;
+        b ^= length;
+        a += b;
+        b += a;
+        a = fmix(a);
+        b = fmix(b);
+        a += b;
+        b += a;
+        return { a, b };
+    }
+
+private:
+    static constexpr uint64_t rotl(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static constexpr uint64_t fmix(uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33;
+        return k;
+    }
+
+    void block(const unsigned char *p)
+    {
+        uint64_t k1, k2;
+        memcpy(&k1, p, 8);
+        memcpy(&k2, p + 8, 8);
+
+        h1 ^= rotl(k1 * C1, 31) * C2;
+        h1 = rotl(h1, 27) + h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        h2 ^= rotl(k2 * C2, 33) * C1;
+        h2 = rotl(h2, 31) + h1;
+        h2 = h2 * 5 + 0x38495ab5;
+    }
+};
+
+inline Hash128
+hash128(std::string_view s, uint64_t seed = 0)
+{
+    return Hasher128(seed).update(s).finish();
+}
+
+#endif
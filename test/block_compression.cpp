@@ -0,0 +1,173 @@
+#include "glt/BlockCompression.hpp"
+#include "sys/clock.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// Round trips synthetic images through the BC1/BC3/BC4/BC5 encoders and the
+// reference decoder, and compares the fast and the high quality mode on the
+// teapot wood texture.
+
+namespace {
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+// root mean square error over the first channels of both images
+double
+rmse(const glt::Image &a, const glt::Image &b, uint32_t channels)
+{
+    double sum = 0;
+    for (size_t i = 0; i < size_t(a.width) * a.height; ++i)
+        for (uint32_t k = 0; k < channels; ++k) {
+            double d = double(a.pixels[i * a.channels + k]) -
+                       double(b.pixels[i * b.channels + k]);
+            sum += d * d;
+        }
+    return std::sqrt(sum / (double(a.width) * a.height * channels));
+}
+
+glt::Image
+gradient(uint32_t w, uint32_t h, uint32_t c)
+{
+    glt::Image img;
+    img.resize(w, h, c);
+    for (uint32_t y = 0; y < h; ++y)
+        for (uint32_t x = 0; x < w; ++x) {
+            auto *p = img.pixels.data() + (size_t(y) * w + x) * c;
+            p[0] = uint8_t(x * 255 / (w - 1));
+            if (c >= 3) {
+                p[1] = uint8_t(y * 255 / (h - 1));
+                p[2] = uint8_t(255 - p[0]);
+            }
+            if (c == 4)
+                p[3] = uint8_t((x + y) * 255 / (w + h - 2));
+        }
+    return img;
+}
+
+double
+roundTrip(const glt::Image &img,
+          glt::BlockFormat format,
+          glt::BlockQuality quality,
+          uint32_t channels)
+{
+    glt::CompressedImage comp;
+    glt::Image dec;
+    glt::compressImage(img, format, quality, comp);
+    glt::decompressImage(comp, dec);
+    return rmse(img, dec, channels);
+}
+
+bool
+testFormats()
+{
+    auto &out = sys::io::stdout();
+    bool ok = true;
+    using glt::BlockFormat;
+    using glt::BlockQuality;
+
+    ok = check(glt::compressedSize(BlockFormat::BC1, 5, 3) == 16,
+               "size of partial blocks") &&
+         ok;
+    ok = check(glt::compressedSize(BlockFormat::BC3, 8, 8) == 64,
+               "size of BC3") &&
+         ok;
+
+    glt::Image solid;
+    solid.resize(4, 4, 3);
+    for (size_t i = 0; i < solid.pixels.size(); i += 3) {
+        solid.pixels[i] = 200;
+        solid.pixels[i + 1] = 100;
+        solid.pixels[i + 2] = 50;
+    }
+    ok = check(roundTrip(solid, BlockFormat::BC1, BlockQuality::High, 3) < 4,
+               "solid color") &&
+         ok;
+
+    auto rgb = gradient(37, 29, 3);
+    auto fast = roundTrip(rgb, BlockFormat::BC1, BlockQuality::Fast, 3);
+    auto high = roundTrip(rgb, BlockFormat::BC1, BlockQuality::High, 3);
+    out << "BC1 gradient rmse: fast " << fast << ", high " << high << "\n";
+    ok = check(fast < 10, "BC1 fast error") && ok;
+    ok = check(high <= fast, "BC1 high quality not worse than fast") && ok;
+
+    auto rgba = gradient(16, 16, 4);
+    glt::CompressedImage comp;
+    glt::Image dec;
+    glt::compressImage(rgba, BlockFormat::BC3, BlockQuality::High, comp);
+    glt::decompressImage(comp, dec);
+    double alpha_err = 0;
+    for (size_t i = 3; i < dec.pixels.size(); i += 4)
+        alpha_err = std::max(
+          alpha_err, std::abs(double(dec.pixels[i]) - double(rgba.pixels[i])));
+    ok = check(alpha_err <= 8, "BC3 alpha") && ok;
+
+    auto gray = gradient(64, 8, 1);
+    ok = check(roundTrip(gray, BlockFormat::BC4, BlockQuality::Fast, 1) < 3,
+               "BC4 error") &&
+         ok;
+    ok = check(roundTrip(rgb, BlockFormat::BC5, BlockQuality::Fast, 2) < 3,
+               "BC5 error") &&
+         ok;
+    return ok;
+}
+
+bool
+testWood()
+{
+    auto &out = sys::io::stdout();
+    const std::string path =
+      std::string(PP_TOSTR(SOURCE_DIR)) + "/programs/teapot/data/wood.bmp";
+    auto res = sys::io::mapFile(path);
+    if (!res) {
+        out << "skipping wood.bmp: not found\n";
+        return true;
+    }
+
+    glt::Image img;
+    std::string error;
+    if (!check(glt::decodeBMP(res->data(), img, error), "wood: decode"))
+        return false;
+
+    bool ok = true;
+    for (glt::BlockQuality quality :
+         { glt::BlockQuality::Fast, glt::BlockQuality::High }) {
+        glt::CompressedImage comp;
+        glt::Image dec;
+        double t0 = sys::queryTimer();
+        glt::compressImage(img, glt::BlockFormat::BC1, quality, comp);
+        double t1 = sys::queryTimer();
+        glt::decompressImage(comp, dec);
+        auto err = rmse(img, dec, 3);
+        out << "wood.bmp BC1 " << quality.to_string() << ": "
+            << ((t1 - t0) * 1000) << " ms, rmse " << err << ", "
+            << (img.size() / comp.blocks.size()) << "x smaller\n";
+        ok = check(err < 12, "wood: BC1 error") && ok;
+    }
+    return ok;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+
+    bool ok = testFormats();
+    ok = testWood() && ok;
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+#include "glt/GLCapture.hpp"
+#include "glt/NullGL.hpp"
+#include "glt/ShaderManager.hpp"
+#include "glt/ShaderProgram.hpp"
+#include "glt/glt.hpp"
+#include "opengl.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Captures the compile of a program on the null GL driver, reads the
+// capture back and replays its shader calls: every glCompileShader which
+// reached the driver has to be in the capture, with the source of the
+// shader. Needs ENABLE_GLCAPTURE, without it the test only reports so.
+
+namespace {
+
+#if ENABLE_GLCAPTURE_P
+
+const std::string VERTEX_SRC = R"(
+in vec3 position;
+void main() { gl_Position = vec4(position, 1.0); }
+)";
+
+const std::string FRAGMENT_SRC = R"(
+out vec4 color;
+void main() { color = vec4(1.0); }
+)";
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+uint64_t
+calls(std::string_view function)
+{
+    for (const auto &c : glt::nullGLCalls())
+        if (function == c.function)
+            return c.calls;
+    return 0;
+}
+
+// the strings of a StringArray payload
+std::vector<const char *>
+strings(std::string_view data)
+{
+    std::vector<const char *> strs;
+    uint32_t count, len;
+    if (data.size() < sizeof count)
+        return strs;
+    memcpy(&count, data.data(), sizeof count);
+    size_t pos = sizeof count;
+    for (uint32_t i = 0; i < count && pos + sizeof len <= data.size(); ++i) {
+        memcpy(&len, data.data() + pos, sizeof len);
+        pos += sizeof len;
+        strs.push_back(data.data() + pos);
+        pos += len + 1;
+    }
+    return strs;
+}
+
+bool
+capture(const std::string &path)
+{
+    glt::resetNullGLCalls();
+    if (!check(glt::glCaptureStart(path), "capture: start"))
+        return false;
+
+    bool ok;
+    {
+        glt::ShaderManager sm;
+        sm.setShaderVersion(330, glt::ShaderProfile::Core);
+        auto prog = std::make_shared<glt::ShaderProgram>(sm);
+        prog->bindAttribute("position", 0);
+        ok = check(
+          prog->addShaderSrc(VERTEX_SRC, glt::ShaderType::VertexShader) &&
+            prog->addShaderSrc(FRAGMENT_SRC, glt::ShaderType::FragmentShader) &&
+            prog->link(),
+          "capture: link");
+        sm.shutdown();
+    }
+    glt::glCaptureStop();
+    return check(calls("glCompileShader") == 2, "capture: compiles") && ok;
+}
+
+bool
+replay(const std::string &path)
+{
+    glt::GLCaptureReader reader;
+    if (!check(reader.open(path), "replay: open"))
+        return false;
+
+    glt::resetNullGLCalls();
+    std::unordered_map<uint64_t, GLuint> shaders;
+    size_t sources = 0, compiles = 0;
+    bool ok = true;
+    glt::GLCapturedCall call;
+    uint64_t frame_ns;
+    glt::GLCaptureReader::Event ev;
+    while ((ev = reader.next(call, frame_ns)) != glt::GLCaptureReader::End) {
+        if (!check(ev != glt::GLCaptureReader::Error, "replay: read"))
+            return false;
+        if (ev != glt::GLCaptureReader::Call)
+            continue;
+
+        const std::string_view name = reader.functions()[call.function];
+        if (name == "glCreateShader" && call.has_result) {
+            shaders[call.result.bits] =
+              glCreateShader(GLenum(call.args[0].bits));
+            continue;
+        }
+
+        const auto shader =
+          shaders.find(call.args.empty() ? 0 : call.args[0].bits);
+        if (name == "glShaderSource") {
+            const auto *src =
+              call.payload(2, glt::GLPayloadKind::StringArray);
+            const auto strs = src ? strings(src->data)
+                                  : std::vector<const char *>{};
+            ok = check(!strs.empty() && shader != shaders.end(),
+                       "replay: source not recorded") &&
+                 ok;
+            if (shader != shaders.end())
+                glShaderSource(
+                  shader->second, GLsizei(strs.size()), strs.data(), nullptr);
+            ++sources;
+        } else if (name == "glCompileShader") {
+            if (!check(shader != shaders.end(),
+                       "replay: compiled an unknown shader"))
+                return false;
+            glCompileShader(shader->second);
+            GLint status = GL_FALSE;
+            glGetShaderiv(shader->second, GL_COMPILE_STATUS, &status);
+            ok = check(status == GL_TRUE, "replay: compile failed") && ok;
+            ++compiles;
+        }
+    }
+
+    ok = check(sources == 2, "replay: sources not recorded") && ok;
+    ok = check(compiles == 2 && calls("glCompileShader") == 2,
+               "replay: compiles not recorded") &&
+         ok;
+    return ok;
+}
+
+#endif
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    glt::moduleInit(glt::GLBackend::Null);
+    auto &out = sys::io::stdout();
+    if (glt::glBackend() != glt::GLBackend::Null) {
+        out << "FAILED: null GL driver not loaded\n";
+        return 1;
+    }
+
+    bool ok = true;
+#if ENABLE_GLCAPTURE_P
+    const std::string path = "gl_capture_test.glcap";
+    ok = capture(path) && replay(path);
+    remove(path.c_str());
+#else
+    out << "GL capture disabled, build with ENABLE_GLCAPTURE\n";
+#endif
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    glt::moduleExit();
+    sys::moduleExit();
+    return ok ? 0 : 1;
+}
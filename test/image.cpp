@@ -0,0 +1,236 @@
+#include "glt/Image.hpp"
+#include "sys/clock.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Checks the TGA and BMP decoders on small hand made files and the mipmap
+// filters on constant and two colored images, then times a mipmap chain.
+
+namespace {
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+void
+put16(std::string &s, uint32_t v)
+{
+    s += char(v & 0xff);
+    s += char((v >> 8) & 0xff);
+}
+
+void
+put32(std::string &s, uint32_t v)
+{
+    put16(s, v & 0xffff);
+    put16(s, v >> 16);
+}
+
+std::string
+tgaHeader(uint8_t type, uint16_t w, uint16_t h, uint8_t bpp, uint8_t desc)
+{
+    std::string s;
+    s += char(0); // id length
+    s += char(0); // no color map
+    s += char(type);
+    s.append(5, char(0)); // color map spec
+    put16(s, 0);
+    put16(s, 0);
+    put16(s, w);
+    put16(s, h);
+    s += char(bpp);
+    s += char(desc);
+    return s;
+}
+
+bool
+pixelIs(const glt::Image &img, uint32_t x, uint32_t y, std::vector<int> rgba)
+{
+    const auto *p = img.pixels.data() + y * img.rowSize() + x * img.channels;
+    for (size_t k = 0; k < rgba.size(); ++k)
+        if (p[k] != rgba[k])
+            return false;
+    return true;
+}
+
+bool
+testTGA()
+{
+    bool ok = true;
+    std::string error;
+    glt::Image img;
+
+    // 2x2 BGR, stored top down
+    auto tga = tgaHeader(2, 2, 2, 24, 0x20);
+    tga += std::string("\x00\x00\xff" "\x00\xff\x00", 6); // red, green
+    tga += std::string("\xff\x00\x00" "\xff\xff\xff", 6); // blue, white
+    ok = check(glt::decodeTGA(tga, img, error), "tga decode") && ok;
+    ok = check(img.width == 2 && img.height == 2 && img.channels == 3,
+               "tga size") &&
+         ok;
+    // the top row becomes the last one
+    ok = check(pixelIs(img, 0, 1, { 255, 0, 0 }), "tga red") && ok;
+    ok = check(pixelIs(img, 1, 1, { 0, 255, 0 }), "tga green") && ok;
+    ok = check(pixelIs(img, 0, 0, { 0, 0, 255 }), "tga blue") && ok;
+
+    // RLE: a run of 3 and a raw packet of 1, bottom up BGRA
+    auto rle = tgaHeader(10, 4, 1, 32, 0);
+    rle += std::string("\x82" "\x10\x20\x30\x40", 5);
+    rle += std::string("\x00" "\x01\x02\x03\x04", 5);
+    ok = check(glt::decodeTGA(rle, img, error), "tga rle decode") && ok;
+    ok = check(pixelIs(img, 2, 0, { 0x30, 0x20, 0x10, 0x40 }), "tga run") &&
+         ok;
+    ok = check(pixelIs(img, 3, 0, { 3, 2, 1, 4 }), "tga raw packet") && ok;
+
+    rle.resize(rle.size() - 2);
+    ok = check(!glt::decodeTGA(rle, img, error), "tga truncated") && ok;
+    ok = check(!glt::decodeTGA(tgaHeader(1, 1, 1, 8, 0), img, error),
+               "tga color mapped rejected") &&
+         ok;
+    return ok;
+}
+
+bool
+testBMP()
+{
+    bool ok = true;
+    std::string error;
+    glt::Image img;
+
+    // 3x2 24 bit, rows padded to 12 bytes, bottom up
+    std::string bmp = "BM";
+    put32(bmp, 54 + 24);
+    put32(bmp, 0);
+    put32(bmp, 54);
+    put32(bmp, 40);
+    put32(bmp, 3);
+    put32(bmp, 2);
+    put16(bmp, 1);
+    put16(bmp, 24);
+    put32(bmp, 0);
+    bmp.append(20, char(0));
+    bmp += std::string("\x00\x00\xff" "\x00\xff\x00" "\xff\x00\x00" "\0\0\0",
+                       12);
+    bmp += std::string("\x01\x02\x03" "\x04\x05\x06" "\x07\x08\x09" "\0\0\0",
+                       12);
+    ok = check(glt::decodeBMP(bmp, img, error), "bmp decode") && ok;
+    ok = check(img.width == 3 && img.height == 2 && img.channels == 3,
+               "bmp size") &&
+         ok;
+    ok = check(pixelIs(img, 0, 0, { 255, 0, 0 }), "bmp red") && ok;
+    ok = check(pixelIs(img, 2, 0, { 0, 0, 255 }), "bmp blue") && ok;
+    ok = check(pixelIs(img, 1, 1, { 6, 5, 4 }), "bmp second row") && ok;
+
+    bmp.resize(bmp.size() - 12);
+    ok = check(!glt::decodeBMP(bmp, img, error), "bmp truncated") && ok;
+    ok = check(!glt::decodeBMP("BX", img, error), "bmp magic") && ok;
+
+    // encoder round trip, odd widths need row padding
+    for (uint32_t c : { 3u, 4u }) {
+        glt::Image src, dec;
+        src.resize(5, 3, c);
+        for (size_t i = 0; i < src.pixels.size(); ++i)
+            src.pixels[i] = uint8_t(i * 7 + 1);
+        std::vector<char> encoded;
+        glt::encodeBMP(src, encoded);
+        ok = check(glt::decodeBMP(encoded, dec, error) &&
+                     dec.channels == c && dec.pixels == src.pixels,
+                   "bmp encode round trip") &&
+             ok;
+    }
+    return ok;
+}
+
+glt::Image
+checkerboard(uint32_t w, uint32_t h, uint32_t c)
+{
+    glt::Image img;
+    img.resize(w, h, c);
+    for (uint32_t y = 0; y < h; ++y)
+        for (uint32_t x = 0; x < w; ++x)
+            for (uint32_t k = 0; k < c; ++k)
+                img.pixels[(size_t(y) * w + x) * c + k] =
+                  (x + y) % 2 ? 255 : 0;
+    return img;
+}
+
+bool
+testMipmaps()
+{
+    bool ok = true;
+    glt::Image dst;
+
+    auto board = checkerboard(6, 4, 4);
+    glt::downsample(board, dst, glt::MipmapFilter::Box, false);
+    ok = check(dst.width == 3 && dst.height == 2, "box size") && ok;
+    ok = check(pixelIs(dst, 2, 1, { 128, 128, 128, 128 }), "box average") &&
+         ok;
+
+    // linear averaging of sRGB black and white, alpha stays linear
+    glt::downsample(board, dst, glt::MipmapFilter::Box, true);
+    ok = check(pixelIs(dst, 0, 0, { 188, 188, 188, 128 }), "box srgb") && ok;
+
+    glt::Image flat;
+    flat.resize(9, 5, 3);
+    std::fill(flat.pixels.begin(), flat.pixels.end(), uint8_t(77));
+    glt::downsample(flat, dst, glt::MipmapFilter::Kaiser, false);
+    ok = check(dst.width == 4 && dst.height == 2, "kaiser size") && ok;
+    bool constant = true;
+    for (auto v : dst.pixels)
+        constant = constant && v == 77;
+    ok = check(constant, "kaiser keeps constant images") && ok;
+
+    std::vector<glt::Image> levels;
+    glt::generateMipmaps(checkerboard(5, 3, 1),
+                         levels,
+                         glt::MipmapFilter::Kaiser,
+                         false);
+    ok = check(levels.size() == 2, "mipmap count") && ok;
+    ok = check(!levels.empty() && levels.back().width == 1 &&
+                 levels.back().height == 1,
+               "mipmap chain ends at 1x1") &&
+         ok;
+    return ok;
+}
+
+void
+benchMipmaps()
+{
+    auto &out = sys::io::stdout();
+    auto img = checkerboard(2048, 2048, 4);
+    std::vector<glt::Image> levels;
+    for (glt::MipmapFilter filter :
+         { glt::MipmapFilter::Box, glt::MipmapFilter::Kaiser }) {
+        auto t0 = sys::queryTimer();
+        glt::generateMipmaps(img, levels, filter, false);
+        auto t1 = sys::queryTimer();
+        out << "mipmaps 2048x2048 " << filter.to_string() << ": "
+            << ((t1 - t0) * 1000) << " ms\n";
+    }
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+
+    bool ok = testTGA();
+    ok = testBMP() && ok;
+    ok = testMipmaps() && ok;
+    benchMipmaps();
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+#include "glt/Mesh.hpp"
+#include "glt/MeshCache.hpp"
+#include "math/vec3.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Writes meshes in the binary mesh format, maps them again and compares the
+// data. Damaged files (indices past the last vertex, flipped bytes) have to
+// be rejected. The meshes are never sent, no OpenGL context is needed.
+
+DEF_GL_MAPPED_TYPE(Vertex, (math::vec3_t, position), (math::vec3_t, normal))
+DEF_GL_MAPPED_TYPE(OtherVertex, (math::vec3_t, position))
+
+namespace {
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+void
+grid(glt::Mesh<Vertex> &mesh, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; ++i) {
+        for (uint32_t j = 0; j < n; ++j) {
+            Vertex v;
+            v.position = math::vec3(float(i), float(j), 0);
+            v.normal = math::vec3(0, 0, 1);
+            mesh.addVertex(v);
+        }
+    }
+
+    for (uint32_t i = 0; i + 1 < n; ++i) {
+        for (uint32_t j = 0; j + 1 < n; ++j) {
+            const auto a = i * n + j, b = a + 1, c = a + n, d = c + 1;
+            for (auto e : { a, b, d, a, d, c })
+                mesh.pushElement(e);
+        }
+    }
+    mesh.drawType(glt::DrawElements);
+}
+
+bool
+sameData(const glt::MeshBase &a, const glt::MeshBase &b)
+{
+    auto va = a.vertexData(), vb = b.vertexData();
+    auto ea = a.elementData(), eb = b.elementData();
+    return va.size() == vb.size() && ea.size() == eb.size() &&
+           memcmp(va.data(), vb.data(), va.size()) == 0 &&
+           memcmp(ea.data(), eb.data(), ea.size_bytes()) == 0 &&
+           a.primType() == b.primType() && a.drawType() == b.drawType();
+}
+
+// overwrites size bytes at offset in place
+bool
+patchFile(const std::string &path, uint64_t offset, const void *data, size_t size)
+{
+    FILE *f = fopen(path.c_str(), "r+b");
+    if (f == nullptr)
+        return false;
+    bool ok = fseek(f, long(offset), SEEK_SET) == 0 &&
+              fwrite(data, 1, size, f) == size;
+    return fclose(f) == 0 && ok;
+}
+
+bool
+testRoundTrip(uint32_t n, GLenum element_type)
+{
+    const std::string path = "mesh_cache_test.mesh";
+    const auto &si = Vertex::gl::struct_info::info;
+
+    glt::Mesh<Vertex> mesh;
+    grid(mesh, n);
+    bool ok = check(glt::writeMeshFile(path, mesh), "write");
+
+    glt::MeshFile file;
+    ok = ok && check(file.open(path, si, true), "open");
+    ok = ok && check(file.verticesSize() == mesh.verticesSize() &&
+                       file.elementsSize() == mesh.elementsSize() &&
+                       file.elementType() == element_type,
+                     "header");
+    ok = ok && check(uintptr_t(file.vertexData().data()) %
+                         glt::MESH_FILE_ALIGNMENT ==
+                       0,
+                     "vertex section alignment");
+
+    glt::Mesh<Vertex> copy;
+    if (ok) {
+        file.load(copy);
+        ok = check(sameData(mesh, copy), "loaded data differs");
+    }
+    file.close();
+
+    // writing again replaces the file
+    mesh.pushElement(0);
+    ok = ok && check(glt::writeMeshFile(path, mesh), "rewrite");
+    ok = ok && check(file.open(path, si) &&
+                       file.elementsSize() == mesh.elementsSize(),
+                     "open rewritten");
+    file.close();
+
+    ok = ok && check(!file.open(path, OtherVertex::gl::struct_info::info),
+                     "other vertex type accepted");
+    remove(path.c_str());
+    return ok;
+}
+
+bool
+testDamaged()
+{
+    const std::string path = "mesh_cache_damaged.mesh";
+    const auto &si = Vertex::gl::struct_info::info;
+
+    glt::Mesh<Vertex> mesh;
+    grid(mesh, 8);
+    bool ok = check(glt::writeMeshFile(path, mesh), "damaged: write");
+
+    glt::MeshFileHeader hdr{};
+    glt::MeshFile file;
+    ok = ok && check(file.open(path, si), "damaged: open intact");
+    if (ok)
+        memcpy(&hdr, file._header, sizeof hdr);
+    file.close();
+
+    // an index one past the last vertex
+    const auto bad_index = uint16_t(hdr.vertex_count);
+    ok = ok &&
+         check(patchFile(path,
+                         hdr.element_offset + 5 * sizeof bad_index,
+                         &bad_index,
+                         sizeof bad_index),
+               "damaged: patch element");
+    ok = ok && check(!file.open(path, si), "damaged: index out of range");
+
+    // a flipped vertex byte is only found by the checksum
+    ok = ok && check(glt::writeMeshFile(path, mesh), "damaged: rewrite");
+    const char flipped = 0x7f;
+    ok = ok && check(patchFile(path, hdr.vertex_offset + 3, &flipped, 1),
+                     "damaged: patch vertex");
+    ok = ok && check(file.open(path, si, false), "damaged: open unverified");
+    file.close();
+    ok = ok && check(!file.open(path, si, true), "damaged: checksum");
+
+    remove(path.c_str());
+    return ok;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+
+    bool ok = true;
+    ok = testRoundTrip(16, GL_UNSIGNED_SHORT) && ok;
+    // more than 65535 vertices need 32 bit indices
+    ok = testRoundTrip(300, GL_UNSIGNED_INT) && ok;
+    ok = testDamaged() && ok;
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    sys::moduleExit();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#include "glt/Mesh.hpp"
+#include "glt/MeshOptimizer.hpp"
+#include "glt/primitives.hpp"
+#include "math/vec3.hpp"
+#include "sys/clock.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+// Optimizes an unindexed sphere on the host, no OpenGL context is needed as
+// the mesh is never sent.
+
+DEF_GL_MAPPED_TYPE(Vertex, (math::vec3_t, position), (math::vec3_t, normal))
+
+int
+main()
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+
+    glt::Mesh<Vertex> mesh;
+    glt::primitives::sphere(mesh, 1.f, 128, 64);
+
+    glt::MeshOptimizer opt;
+    double t0 = sys::queryTimer();
+    auto report = opt.optimize(mesh);
+    double t1 = sys::queryTimer();
+
+    out << report << "\n"
+        << "optimize: " << ((t1 - t0) * 1000) << " ms\n";
+
+    bool ok = mesh.drawType() == glt::DrawElements &&
+              mesh.elementsSize() == report.triangles * 3 &&
+              report.vertices_after < report.vertices_before &&
+              report.after.acmr < report.before.acmr;
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    return ok ? 0 : 1;
+}
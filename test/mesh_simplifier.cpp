@@ -0,0 +1,48 @@
+#include "glt/Mesh.hpp"
+#include "glt/MeshLODChain.hpp"
+#include "glt/primitives.hpp"
+#include "math/vec3.hpp"
+#include "sys/clock.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+// Builds a level of detail chain for a sphere on the host, no OpenGL context
+// is needed as the meshes are never sent.
+
+DEF_GL_MAPPED_TYPE(Vertex, (math::vec3_t, position), (math::vec3_t, normal))
+
+int
+main()
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+
+    glt::Mesh<Vertex> sphere;
+    glt::primitives::sphere(sphere, 1.f, 128, 64);
+
+    glt::MeshLODChain<Vertex> chain;
+    double t0 = sys::queryTimer();
+    chain.build(sphere, 8);
+    double t1 = sys::queryTimer();
+
+    bool ok = chain.levels() > 1;
+    for (size_t i = 0; i < chain.levels(); ++i) {
+        const auto &lvl = chain.level(i);
+        const auto &mesh = chain.mesh(i);
+        out << "level " << i << ": " << lvl.triangles
+            << " triangles, error: " << lvl.error << "\n";
+
+        if (i > 0)
+            ok = ok && lvl.triangles < chain.level(i - 1).triangles &&
+                 lvl.error >= chain.level(i - 1).error;
+        for (auto e : mesh.elementData())
+            ok = ok && e < mesh.verticesSize();
+    }
+
+    ok = ok && chain.selectLevel(1e6f) == 0 &&
+         chain.selectLevel(1.f) == chain.levels() - 1;
+
+    out << "build: " << ((t1 - t0) * 1000) << " ms\n"
+        << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    return ok ? 0 : 1;
+}
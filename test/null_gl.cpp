@@ -0,0 +1,128 @@
+#include "glt/CubeMesh.hpp"
+#include "glt/DrawBatch.hpp"
+#include "glt/NullGL.hpp"
+#include "glt/glt.hpp"
+#include "glt/primitives.hpp"
+#include "math/vec3.hpp"
+#include "sys/clock.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <memory>
+#include <vector>
+
+// Measures the CPU side of sending and drawing meshes, one draw per mesh
+// and through a DrawBatch, and checks the layout of the batched meshes and
+// the number of draw calls. GL calls go to the null driver, so no GL
+// implementation or display is needed.
+
+DEF_GL_MAPPED_TYPE(Vertex, (math::vec3_t, position))
+
+namespace {
+
+constexpr size_t N_MESHES = 256;
+constexpr size_t N_FRAMES = 200;
+constexpr uint32_t N_GROUPS = 8;
+
+// a unit cube has 4 vertices and 2 triangles per face
+constexpr uint32_t CUBE_VERTICES = 24;
+constexpr uint32_t CUBE_INDICES = 36;
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+// the meshes follow each other in the shared buffers
+bool
+checkLayout(const std::vector<glt::DrawBatchMesh> &ranges)
+{
+    bool ok = true;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        const auto &r = ranges[i];
+        ok = ok && r.base_vertex == i * CUBE_VERTICES &&
+             r.first_index == i * CUBE_INDICES &&
+             r.index_count == CUBE_INDICES;
+    }
+    return check(ok, "batched mesh offsets");
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    glt::moduleInit(glt::GLBackend::Null);
+    auto &out = sys::io::stdout();
+    if (glt::glBackend() != glt::GLBackend::Null) {
+        out << "FAILED: null GL driver not loaded\n";
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<glt::CubeMesh<Vertex>>> meshes;
+    const double t0 = sys::queryTimer();
+    for (size_t i = 0; i < N_MESHES; ++i) {
+        auto mesh = std::make_unique<glt::CubeMesh<Vertex>>();
+        glt::primitives::unitCubeWONormals(*mesh);
+        mesh->send();
+        meshes.push_back(std::move(mesh));
+    }
+
+    const double t1 = sys::queryTimer();
+    glt::resetNullGLCalls();
+    for (size_t frame = 0; frame < N_FRAMES; ++frame)
+        for (auto &mesh : meshes)
+            mesh->draw();
+    const double t2 = sys::queryTimer();
+
+    out << "send: " << (t1 - t0) * 1e6 / double(N_MESHES) << " us per mesh\n"
+        << "draw: " << (t2 - t1) * 1e9 / double(N_FRAMES * N_MESHES)
+        << " ns per draw\n";
+    glt::printNullGLCalls(out, N_FRAMES);
+
+    // the batch owns a stream buffer, it has to die before the module
+    bool ok;
+    {
+        glt::DrawBatch batch(Vertex::gl::struct_info::info);
+        std::vector<glt::DrawBatchMesh> ranges;
+        for (const auto &mesh : meshes)
+            ranges.push_back(batch.add(*mesh));
+        batch.send();
+        ok = checkLayout(ranges);
+
+        glt::resetNullGLCalls();
+        const double t3 = sys::queryTimer();
+        for (size_t frame = 0; frame < N_FRAMES; ++frame) {
+            batch.begin();
+            for (size_t i = 0; i < ranges.size(); ++i)
+                batch.record(uint32_t(i) % N_GROUPS, ranges[i]);
+            batch.end();
+            for (const auto group : batch.groups())
+                batch.draw(group);
+        }
+        const double t4 = sys::queryTimer();
+
+        out << "batched: " << (t4 - t3) * 1e9 / double(N_FRAMES * N_MESHES)
+            << " ns per draw, " << batch.statistics().calls
+            << " draw calls per frame\n";
+        glt::printNullGLCalls(out, N_FRAMES);
+
+        // one call per group with glMultiDrawElementsIndirect
+        const size_t expected_calls =
+          batch.multiDraw() ? N_GROUPS : N_MESHES;
+        ok =
+          check(batch.statistics().draws == N_MESHES, "recorded draws") && ok;
+        ok =
+          check(batch.statistics().calls == expected_calls, "draw calls") && ok;
+    }
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    meshes.clear();
+    glt::moduleExit();
+    sys::moduleExit();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+#include "glt/PlyLoader.hpp"
+#include "sys/clock.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Checks the loader on small ASCII and binary files and compares it to line
+// by line sscanf parsing on the teapot SPLY model. With --synthetic [N]
+// files with N (default 10M) vertices are generated and loaded as well.
+
+namespace {
+
+bool
+writeFile(const std::string &path, const void *data, size_t size)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+    bool ok = fwrite(data, 1, size, f) == size;
+    return fclose(f) == 0 && ok;
+}
+
+bool
+writeFile(const std::string &path, const std::string &data)
+{
+    return writeFile(path, data.data(), data.size());
+}
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+bool
+testAscii()
+{
+    const std::string path = "ply_loader_ascii.ply";
+    writeFile(path,
+              "ply\n"
+              "format ascii 1.0\n"
+              "comment two faces\n"
+              "element vertex 5\n"
+              "property float x\n"
+              "property float y\n"
+              "property float z\n"
+              "property uchar red\n"
+              "element face 2\n"
+              "property uchar flags\n"
+              "property list uchar int vertex_indices\n"
+              "end_header\n"
+              "0 0 0 255\n"
+              "1 0 0 0\n"
+              "1 1 0 0\n"
+              "0 1 0 0\n"
+              "0.5 0.5 +1e-1 128\r\n"
+              "7 4 0 1 2 3\n"
+              "0 3 0 2 4");
+
+    glt::PlyMesh mesh;
+    bool ok = check(glt::loadPly(path, mesh), "ascii: load");
+    ok = ok && check(mesh.vertexCount() == 5 && mesh.faces == 2 &&
+                       mesh.indices.size() == 9,
+                     "ascii: counts");
+    ok = ok && check(mesh.property("red") == 3 && mesh.property("w") == -1,
+                     "ascii: properties");
+    ok = ok && check(mesh.vertex(0)[3] == 255.f &&
+                       mesh.vertex(4)[2] == 0.1f &&
+                       mesh.vertex(4)[3] == 128.f,
+                     "ascii: vertex values");
+    const uint32_t expected[] = { 0, 1, 2, 0, 2, 3, 0, 2, 4 };
+    ok = ok && check(memcmp(mesh.indices.data(), expected, sizeof expected) ==
+                       0,
+                     "ascii: triangulation");
+
+    glt::PlyLoadOptions opts;
+    opts.triangulate = false;
+    ok = ok && check(!glt::loadPly(path, mesh, opts), "ascii: mixed faces");
+
+    remove(path.c_str());
+    return ok;
+}
+
+bool
+testBinary()
+{
+    const std::string path = "ply_loader_binary.ply";
+    std::string data = "ply\n"
+                       "format binary_little_endian 1.0\n"
+                       "element vertex 3\n"
+                       "property float x\n"
+                       "property short y\n"
+                       "property double z\n"
+                       "element face 1\n"
+                       "property list uchar uint vertex_index\n"
+                       "end_header\n";
+    for (int i = 0; i < 3; ++i) {
+        float x = float(i) + 0.5f;
+        int16_t y = int16_t(-i);
+        double z = i * 2.0;
+        data.append(reinterpret_cast<const char *>(&x), sizeof x);
+        data.append(reinterpret_cast<const char *>(&y), sizeof y);
+        data.append(reinterpret_cast<const char *>(&z), sizeof z);
+    }
+    data.push_back(char(3));
+    for (uint32_t i : { 2u, 1u, 0u })
+        data.append(reinterpret_cast<const char *>(&i), sizeof i);
+    writeFile(path, data);
+
+    glt::PlyMesh mesh;
+    bool ok = check(glt::loadPly(path, mesh), "binary: load");
+    ok = ok && check(mesh.vertexCount() == 3 && mesh.indices.size() == 3 &&
+                       mesh.indices[0] == 2 && mesh.indices[2] == 0,
+                     "binary: counts");
+    ok = ok && check(mesh.vertex(2)[0] == 2.5f && mesh.vertex(2)[1] == -2.f &&
+                       mesh.vertex(2)[2] == 4.f,
+                     "binary: vertex values");
+
+    // truncated
+    writeFile(path, data.data(), data.size() - 1);
+    ok = ok && check(!glt::loadPly(path, mesh), "binary: truncated");
+
+    remove(path.c_str());
+    return ok;
+}
+
+int32_t
+scanfSply(const char *filename, std::vector<float> &verts, size_t &nindices)
+{
+    FILE *f = fopen(filename, "rb");
+    if (f == nullptr)
+        return -1;
+
+    uint32_t nverts, nfaces;
+    if (fscanf(f, "%u\n%u\n", &nverts, &nfaces) != 2) {
+        fclose(f);
+        return -1;
+    }
+
+    char line[512];
+    float v[6];
+    while (verts.size() < nverts * 6 && fgets(line, sizeof line, f)) {
+        if (sscanf(line,
+                   "%f %f %f %f %f %f",
+                   &v[0],
+                   &v[1],
+                   &v[2],
+                   &v[3],
+                   &v[4],
+                   &v[5]) != 6)
+            break;
+        verts.insert(verts.end(), v, v + 6);
+    }
+
+    uint32_t n, i, j, k, l;
+    for (uint32_t face = 0; face < nfaces && fgets(line, sizeof line, f);
+         ++face) {
+        if (sscanf(line, "%u %u %u %u %u", &n, &i, &j, &k, &l) != 5)
+            break;
+        nindices += 6;
+    }
+    fclose(f);
+    return int32_t(nfaces);
+}
+
+bool
+benchTeapot()
+{
+    auto &out = sys::io::stdout();
+    const std::string path =
+      std::string(PP_TOSTR(SOURCE_DIR)) + "/programs/teapot/data/teapot.sply";
+
+    std::vector<float> verts;
+    size_t nindices = 0;
+    double t0 = sys::queryTimer();
+    scanfSply(path.c_str(), verts, nindices);
+    double t1 = sys::queryTimer();
+
+    glt::PlyMesh mesh;
+    glt::PlyLoadOptions single;
+    single.threads = 1;
+    bool ok = check(glt::loadPly(path, mesh, single), "teapot: load");
+    double t2 = sys::queryTimer();
+    ok = ok && check(glt::loadPly(path, mesh), "teapot: parallel load");
+    double t3 = sys::queryTimer();
+
+    ok = ok && check(mesh.vertices == verts && mesh.indices.size() == nindices,
+                     "teapot: same result as sscanf");
+
+    out << "teapot.sply: " << mesh.vertexCount() << " vertices, "
+        << mesh.faces << " faces\n"
+        << "  sscanf: " << ((t1 - t0) * 1000) << " ms\n"
+        << "  loadPly, 1 thread: " << ((t2 - t1) * 1000) << " ms\n"
+        << "  loadPly: " << ((t3 - t2) * 1000) << " ms\n";
+    return ok;
+}
+
+bool
+benchSynthetic(size_t nverts)
+{
+    auto &out = sys::io::stdout();
+    const size_t side = size_t(std::sqrt(double(nverts)));
+    nverts = side * side;
+    const size_t nfaces = (side - 1) * (side - 1);
+
+    // a grid of vertices with normals, written as ASCII and binary
+    std::string header = "element vertex " + std::to_string(nverts) +
+                         "\n"
+                         "property float x\nproperty float y\n"
+                         "property float z\nproperty float nx\n"
+                         "property float ny\nproperty float nz\n"
+                         "element face " +
+                         std::to_string(nfaces) +
+                         "\n"
+                         "property list uchar int vertex_indices\n"
+                         "end_header\n";
+    std::string ascii = "ply\nformat ascii 1.0\n" + header;
+    std::string binary = "ply\nformat binary_little_endian 1.0\n" + header;
+    ascii.reserve(nverts * 56 + nfaces * 40);
+    binary.reserve(binary.size() + nverts * 24 + nfaces * 17);
+
+    char line[128];
+    for (size_t y = 0; y < side; ++y) {
+        for (size_t x = 0; x < side; ++x) {
+            float v[6] = { float(x) * 0.01f, float(y) * 0.01f, 0.f,
+                           0.f,              0.f,              1.f };
+            int n = snprintf(
+              line, sizeof line, "%f %f %f 0 0 1\n", v[0], v[1], v[2]);
+            ascii.append(line, size_t(n));
+            binary.append(reinterpret_cast<const char *>(v), sizeof v);
+        }
+    }
+    for (size_t y = 0; y + 1 < side; ++y) {
+        for (size_t x = 0; x + 1 < side; ++x) {
+            int32_t q[4] = { int32_t(y * side + x),
+                             int32_t(y * side + x + 1),
+                             int32_t((y + 1) * side + x + 1),
+                             int32_t((y + 1) * side + x) };
+            int n = snprintf(
+              line, sizeof line, "4 %d %d %d %d\n", q[0], q[1], q[2], q[3]);
+            ascii.append(line, size_t(n));
+            binary.push_back(char(4));
+            binary.append(reinterpret_cast<const char *>(q), sizeof q);
+        }
+    }
+
+    bool ok = true;
+    const std::pair<const char *, const std::string *> files[] = {
+        { "ply_loader_synthetic_ascii.ply", &ascii },
+        { "ply_loader_synthetic_binary.ply", &binary },
+    };
+    for (const auto &[path, data] : files) {
+        if (!check(writeFile(path, *data), "synthetic: write file")) {
+            ok = false;
+            continue;
+        }
+
+        glt::PlyMesh mesh;
+        double t0 = sys::queryTimer();
+        ok = check(glt::loadPly(path, mesh), "synthetic: load") && ok;
+        double t1 = sys::queryTimer();
+        ok = check(mesh.vertexCount() == nverts &&
+                     mesh.indices.size() == nfaces * 6,
+                   "synthetic: counts") &&
+             ok;
+
+        out << path << ": " << nverts << " vertices, "
+            << (data->size() >> 20) << " MiB, " << ((t1 - t0) * 1000)
+            << " ms\n";
+        remove(path);
+    }
+    return ok;
+}
+
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+
+    size_t synthetic = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--synthetic") == 0) {
+            synthetic = 10000000;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                synthetic = size_t(strtoull(argv[++i], nullptr, 10));
+        }
+    }
+
+    bool ok = testAscii();
+    ok = testBinary() && ok;
+    ok = benchTeapot() && ok;
+    if (synthetic > 0)
+        ok = benchSynthetic(synthetic) && ok;
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    return ok ? 0 : 1;
+}
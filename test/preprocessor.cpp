@@ -0,0 +1,154 @@
+#include "glt/GLSLPreprocessor.hpp"
+#include "glt/Preprocessor.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Evaluates #if expressions with the MacroTable and expands a small shader
+// with the GLSLPreprocessor: inactive regions have to be dropped, conditions
+// only the driver can decide have to be kept. No GL context needed.
+
+namespace {
+
+bool
+check(bool cond, std::string_view what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+bool
+expect(const glt::MacroTable &macros,
+       std::string_view expr,
+       std::optional<int64_t> expected)
+{
+    const auto value = macros.evaluate(expr);
+    if (value == expected)
+        return true;
+    auto &out = sys::io::stdout();
+    out << "FAILED: #if " << expr << ": ";
+    if (value)
+        out << *value;
+    else
+        out << "undecided";
+    out << ", expected ";
+    if (expected)
+        out << *expected;
+    else
+        out << "undecided";
+    out << "\n";
+    return false;
+}
+
+bool
+testEvaluate()
+{
+    glt::MacroTable macros;
+    bool ok = check(macros.define("N 4"), "define N");
+    ok = check(macros.define("TWICE(x) ((x) * 2)"), "define TWICE") && ok;
+    ok = check(macros.define("EMPTY"), "define EMPTY") && ok;
+    ok = check(!macros.define("(x) 1"), "malformed define") && ok;
+
+    // precedence and associativity
+    ok = expect(macros, "1 + 2 * 3", 7) && ok;
+    ok = expect(macros, "(1 + 2) * 3", 9) && ok;
+    ok = expect(macros, "10 - 4 - 3", 3) && ok;
+    ok = expect(macros, "1 << 2 + 1", 8) && ok;
+    ok = expect(macros, "1 | 2 ^ 3 & 6", 1) && ok;
+    ok = expect(macros, "2 < 3 == 1", 1) && ok;
+    ok = expect(macros, "-N + !0 + ~0", -4) && ok;
+    ok = expect(macros, "0 ? 1 : 2 ? 3 : 4", 3) && ok;
+    ok = expect(macros, "0x10 + 010", 24) && ok;
+    ok = expect(macros, "TWICE(N + 1)", 10) && ok;
+
+    // defined, with and without parentheses
+    ok = expect(macros, "defined(N) && defined EMPTY", 1) && ok;
+    ok = expect(macros, "defined(UNDEFINED)", 0) && ok;
+    ok = expect(macros, "!defined N", 0) && ok;
+    macros.undefine("N");
+    ok = expect(macros, "defined(N)", 0) && ok;
+
+    // the skipped operand is not evaluated
+    ok = expect(macros, "0 && (1 / 0)", 0) && ok;
+    ok = expect(macros, "1 || (1 / 0)", 1) && ok;
+    ok = expect(macros, "0 && UNDEFINED", 0) && ok;
+    ok = expect(macros, "1 ? 2 : 1 % 0", 2) && ok;
+    ok = expect(macros, "1 && (1 / 0)", std::nullopt) && ok;
+
+    // division by zero and overflowing shifts are not decided
+    ok = expect(macros, "1 / 0", std::nullopt) && ok;
+    ok = expect(macros, "5 % (2 - 2)", std::nullopt) && ok;
+    ok = expect(macros, "1 << 64", std::nullopt) && ok;
+
+    // left to the driver: its macros, undefined identifiers, macros
+    // with unknown definitions and malformed expressions
+    ok = expect(macros, "defined(GL_ARB_gpu_shader5)", std::nullopt) && ok;
+    ok = expect(macros, "defined(GL_ES) || 1", std::nullopt) && ok;
+    ok = expect(macros, "__VERSION__ >= 330", std::nullopt) && ok;
+    ok = expect(macros, "UNDEFINED", std::nullopt) && ok;
+    macros.markUnknown("UNKNOWN");
+    ok = expect(macros, "defined(UNKNOWN)", std::nullopt) && ok;
+    ok = expect(macros, "(1 + 2", std::nullopt) && ok;
+    ok = expect(macros, "1 2", std::nullopt) && ok;
+    return ok;
+}
+
+bool
+testExpand()
+{
+    glt::IncludePath path;
+    glt::ShaderIncludes includes;
+    glt::ShaderDependencies deps;
+    glt::GLSLPreprocessor proc(path, includes, deps);
+    proc.name("preprocessor test");
+    proc.process("#version 330\n"
+                 "#define LIGHTS 2\n"
+                 "#if LIGHTS > 1 && defined(LIGHTS)\n"
+                 "many_lights\n"
+                 "#else\n"
+                 "one_light\n"
+                 "#endif\n"
+                 "#ifdef GL_ARB_shading_language_420pack\n"
+                 "packed\n"
+                 "#endif\n");
+
+    std::string code;
+    for (size_t i = 0; i < proc.segments.size(); ++i)
+        code.append(proc.segments[i], proc.segLengths[i]);
+
+    bool ok = check(!proc.wasError(), "expand: error");
+    ok = check(code.find("many_lights") != std::string::npos,
+               "expand: active branch dropped") &&
+         ok;
+    ok = check(code.find("one_light") == std::string::npos,
+               "expand: inactive branch kept") &&
+         ok;
+    ok = check(code.find("#ifdef GL_ARB_shading_language_420pack") !=
+                   std::string::npos &&
+                 code.find("packed") != std::string::npos,
+               "expand: driver conditional dropped") &&
+         ok;
+    if (!ok)
+        sys::io::stdout() << "expanded:\n" << code << "\n";
+    return ok;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+
+    bool ok = testEvaluate();
+    ok = testExpand() && ok;
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#include "sys/io.hpp"
+#include "sys/profile.hpp"
+#include "sys/sys.hpp"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Checks the summary of timing samples on small sets with known
+// percentiles: the median, p95 and p99 are the samples of nearest rank.
+
+namespace {
+
+bool
+check(bool cond, const std::string &what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+bool
+expect(std::vector<double> samples,
+       const sys::TimingStats &expected,
+       const std::string &what)
+{
+    const auto stats = sys::timingStats(samples);
+    bool ok = check(stats.count == expected.count, what + ": count");
+    ok = check(std::abs(stats.total - expected.total) < 1e-9,
+               what + ": total") &&
+         ok;
+    ok = check(std::abs(stats.avg - expected.avg) < 1e-9, what + ": avg") &&
+         ok;
+    ok = check(stats.min == expected.min, what + ": min") && ok;
+    ok = check(stats.median == expected.median, what + ": median") && ok;
+    ok = check(stats.p95 == expected.p95, what + ": p95") && ok;
+    ok = check(stats.p99 == expected.p99, what + ": p99") && ok;
+    ok = check(stats.max == expected.max, what + ": max") && ok;
+    return ok;
+}
+
+// 1 to n, in an order which is not sorted
+std::vector<double>
+permutation(size_t n, size_t step)
+{
+    std::vector<double> samples;
+    for (size_t i = 0; i < n; ++i)
+        samples.push_back(double((i * step) % n + 1));
+    return samples;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+
+    // count, total, min, avg, median, p95, p99, max
+    bool ok = expect({}, {}, "empty");
+    ok = expect({ 5 }, { 1, 5, 5, 5, 5, 5, 5, 5 }, "one sample") && ok;
+    ok = expect({ 3, 1 }, { 2, 4, 1, 2, 1, 3, 3, 3 }, "two samples") && ok;
+    ok = expect({ 2, 3, 1 }, { 3, 6, 1, 2, 2, 3, 3, 3 }, "three samples") &&
+         ok;
+    ok = expect(permutation(100, 37),
+                { 100, 5050, 1, 50.5, 50, 95, 99, 100 },
+                "100 samples") &&
+         ok;
+    ok = expect(permutation(1000, 389),
+                { 1000, 500500, 1, 500.5, 500, 950, 990, 1000 },
+                "1000 samples") &&
+         ok;
+
+    // one outlier in 20 samples is above p95, but not above p99
+    std::vector<double> spiky(19, 1.0);
+    spiky.insert(spiky.begin() + 7, 50.0);
+    ok = expect(spiky, { 20, 69, 1, 3.45, 1, 1, 50, 50 }, "outlier") && ok;
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    sys::moduleExit();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+#include "glt/RenderQueue.hpp"
+#include "sys/clock.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <set>
+#include <vector>
+
+// Checks and benchmarks sorting and batching of the render queue, no OpenGL
+// context is needed: the mesh and program pointers are only hashed and
+// compared.
+
+namespace {
+
+constexpr size_t N_PACKETS = 200000;
+constexpr size_t N_PROGRAMS = 48;
+constexpr size_t N_MESHES = 512;
+constexpr uint32_t N_MATERIALS = 64;
+constexpr size_t N_ITERATIONS = 20;
+
+template<typename T>
+T *
+fakeObject(std::vector<std::max_align_t> &storage, size_t i)
+{
+    return reinterpret_cast<T *>(&storage[i]);
+}
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+// programs whose hashes differ, so each gets a group of its own
+std::vector<glt::ShaderProgram *>
+distinctPrograms(std::vector<std::max_align_t> &storage, size_t n)
+{
+    std::vector<glt::ShaderProgram *> result;
+    std::set<uint64_t> keys;
+    for (size_t i = 0; i < storage.size() && result.size() < n; ++i) {
+        glt::DrawPacket p;
+        p.program = fakeObject<glt::ShaderProgram>(storage, i);
+        if (keys.insert(glt::drawPacketSortKey(p)).second)
+            result.push_back(p.program);
+    }
+    return result;
+}
+
+// a shuffled scene with a known number of draws and state changes
+bool
+testBatching()
+{
+    constexpr size_t N_SCENE_PROGRAMS = 4;
+    constexpr uint32_t N_SCENE_MATERIALS = 3;
+    constexpr size_t N_OPAQUE = 96;
+    constexpr size_t N_RUNS = 10;
+    constexpr uint32_t RUN_LENGTH = 100;
+
+    std::vector<std::max_align_t> program_storage(64), meshes(N_RUNS);
+    const auto programs = distinctPrograms(program_storage, N_SCENE_PROGRAMS);
+    bool ok = check(programs.size() == N_SCENE_PROGRAMS, "distinct programs");
+    if (!ok)
+        return false;
+
+    std::mt19937 rng(7);
+    std::vector<glt::DrawPacket> packets;
+    for (size_t i = 0; i < N_OPAQUE; ++i) {
+        glt::DrawPacket p;
+        // every program and material combination is used
+        p.program = programs[i % N_SCENE_PROGRAMS];
+        p.material = uint32_t(i / N_SCENE_PROGRAMS % N_SCENE_MATERIALS);
+        p.mesh = fakeObject<glt::MeshBase>(meshes, i % N_RUNS);
+        p.depth = float(rng() % 1000);
+        packets.push_back(p);
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        glt::DrawPacket p;
+        p.program = programs[0];
+        p.mesh = fakeObject<glt::MeshBase>(meshes, 0);
+        p.depth = float(rng() % 1000);
+        p.translucent = true;
+        packets.push_back(p);
+    }
+    std::shuffle(packets.begin(), packets.end(), rng);
+
+    // instanced runs, submitted one instance at a time
+    for (size_t run = 0; run < N_RUNS; ++run) {
+        for (uint32_t i = 0; i < RUN_LENGTH; ++i) {
+            glt::DrawPacket p;
+            p.program = programs[1];
+            p.mesh = fakeObject<glt::MeshBase>(meshes, run);
+            p.instanced = true;
+            p.base_instance = i;
+            packets.push_back(p);
+        }
+    }
+
+    glt::RenderQueue queue;
+    for (const auto &p : packets)
+        queue.submit(p);
+    queue.sort();
+
+    const auto stats = queue.statistics();
+    ok = check(stats.packets == packets.size(), "packet count") && ok;
+    ok = check(stats.draws == N_OPAQUE + 4 + N_RUNS, "draw count") && ok;
+
+    // the opaque packets change program once per program and material once
+    // per combination, translucent packets follow back to front
+    size_t program_changes = 0, state_changes = 0, instances = 0;
+    bool translucent_last = true;
+    float last_depth = 0;
+    const glt::DrawPacket *last = nullptr;
+    for (const auto &b : queue.batches()) {
+        const auto &p = queue.packets()[b.packet];
+        if (p.instanced)
+            instances += b.instance_count;
+        if (last != nullptr && last->translucent && !p.translucent)
+            translucent_last = false;
+        if (last != nullptr && last->translucent && p.translucent &&
+            p.depth > last_depth)
+            translucent_last = false;
+        if (!p.translucent) {
+            if (last == nullptr || p.program != last->program)
+                ++program_changes;
+            if (last == nullptr || p.program != last->program ||
+                p.material != last->material)
+                ++state_changes;
+        }
+        last_depth = p.depth;
+        last = &p;
+    }
+    ok = check(program_changes == N_SCENE_PROGRAMS, "program changes") && ok;
+    ok = check(state_changes == N_SCENE_PROGRAMS * N_SCENE_MATERIALS,
+               "material changes") &&
+         ok;
+    ok = check(instances == N_RUNS * RUN_LENGTH, "merged instances") && ok;
+    ok = check(translucent_last, "translucent order") && ok;
+    return ok;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+    bool ok = testBatching();
+
+    std::vector<std::max_align_t> programs(N_PROGRAMS), meshes(N_MESHES);
+    std::mt19937 rng(42);
+
+    std::vector<glt::DrawPacket> packets;
+    packets.reserve(N_PACKETS);
+    for (size_t i = 0; i < N_PACKETS; ++i) {
+        glt::DrawPacket p;
+        p.program = fakeObject<glt::ShaderProgram>(programs, rng() % N_PROGRAMS);
+        p.mesh = fakeObject<glt::MeshBase>(meshes, rng() % N_MESHES);
+        p.material = rng() % N_MATERIALS;
+        p.depth = float(rng() % 10000) * 0.01f;
+        p.translucent = rng() % 16 == 0;
+        packets.push_back(p);
+    }
+
+    // runs of instanced packets with consecutive instances, as submitted by
+    // e.g. a particle system, these are merged into one draw per run
+    for (size_t i = 0; i < N_PACKETS / 4; ++i) {
+        glt::DrawPacket p;
+        p.program = fakeObject<glt::ShaderProgram>(programs, 0);
+        p.mesh = fakeObject<glt::MeshBase>(meshes, i / 1000);
+        p.instanced = true;
+        p.base_instance = uint32_t(i % 1000);
+        packets.push_back(p);
+    }
+
+    glt::RenderQueue queue;
+    double t_submit = 0, t_sort = 0;
+    for (size_t it = 0; it < N_ITERATIONS; ++it) {
+        queue.clear();
+        double t0 = sys::queryTimer();
+        for (const auto &p : packets)
+            queue.submit(p);
+        double t1 = sys::queryTimer();
+        queue.sort();
+        double t2 = sys::queryTimer();
+        t_submit += t1 - t0;
+        t_sort += t2 - t1;
+    }
+
+    std::vector<uint64_t> keys;
+    keys.reserve(packets.size());
+    double t_std_sort = 0;
+    for (size_t it = 0; it < N_ITERATIONS; ++it) {
+        keys.clear();
+        for (const auto &p : packets)
+            keys.push_back(glt::drawPacketSortKey(p));
+        double t0 = sys::queryTimer();
+        std::stable_sort(keys.begin(), keys.end());
+        t_std_sort += sys::queryTimer() - t0;
+    }
+
+    auto stats = queue.statistics();
+    auto sorted = queue.batches();
+    bool ordered = true;
+    for (size_t i = 1; i < sorted.size(); ++i)
+        ordered = ordered && glt::drawPacketSortKey(
+                               queue.packets()[sorted[i - 1].packet]) <=
+                               glt::drawPacketSortKey(
+                                 queue.packets()[sorted[i].packet]);
+
+    const auto n = double(N_ITERATIONS);
+    out << "packets: " << stats.packets << ", draws: " << stats.draws << "\n"
+        << "submit: " << (t_submit / n * 1000) << " ms\n"
+        << "radix sort + batching: " << (t_sort / n * 1000) << " ms\n"
+        << "std::stable_sort (keys only): " << (t_std_sort / n * 1000)
+        << " ms\n"
+        << "order: " << (ordered ? "ok" : "BROKEN") << "\n";
+
+    ok = check(ordered, "sort order") && ok;
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    return ok ? 0 : 1;
+}
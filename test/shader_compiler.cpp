@@ -0,0 +1,147 @@
+#include "ge/GameWindow.hpp"
+#include "ge/ge.hpp"
+#include "glt/ShaderCompiler.hpp"
+#include "glt/ShaderManager.hpp"
+#include "glt/ShaderProgram.hpp"
+#include "glt/glt.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <memory>
+#include <string>
+
+// Compiles shaders asynchronously in a headless EGL context (e.g. Mesa
+// llvmpipe) and checks that they enter the shared shader cache only once
+// they compiled: a program with a broken shader must not hand it to the
+// next program using the same source.
+
+namespace {
+
+const std::string VERTEX_SRC = R"(
+in vec3 position;
+void main() { gl_Position = vec4(position, 1.0); }
+)";
+
+const std::string GOOD_FRAGMENT_SRC = R"(
+out vec4 color;
+void main() { color = vec4(1.0); }
+)";
+
+const std::string BAD_FRAGMENT_SRC = R"(
+out vec4 color;
+void main() { color = vec4(undeclared); }
+)";
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+bool
+cached(glt::ShaderManager &sm, glt::ShaderType ty, const std::string &src)
+{
+    const auto key = glt::ShaderSource::makeStringSource(ty, src)->key();
+    return sm.globalShaderCache()->lookup(key) != nullptr;
+}
+
+std::shared_ptr<glt::ShaderProgram>
+makeProgram(glt::ShaderManager &sm, bool async)
+{
+    auto prog = std::make_shared<glt::ShaderProgram>(sm);
+    prog->asyncCompile(async);
+    prog->bindAttribute("position", 0);
+    return prog;
+}
+
+bool
+testFailedCompile(glt::ShaderManager &sm)
+{
+    auto prog = makeProgram(sm, true);
+    bool ok =
+      check(prog->addShaderSrc(VERTEX_SRC, glt::ShaderType::VertexShader),
+            "failed: add vertex shader");
+    // the compile status is not known yet
+    ok = check(prog->addShaderSrc(BAD_FRAGMENT_SRC,
+                                  glt::ShaderType::FragmentShader),
+               "failed: add fragment shader") &&
+         ok;
+    ok = check(!cached(sm, glt::ShaderType::FragmentShader, BAD_FRAGMENT_SRC),
+               "failed: pending shader cached") &&
+         ok;
+    ok = check(!prog->tryLink(), "failed: linked a broken shader") && ok;
+    ok = check(!cached(sm, glt::ShaderType::FragmentShader, BAD_FRAGMENT_SRC),
+               "failed: broken shader cached") &&
+         ok;
+
+    // while prog is alive, a second program compiles the source itself
+    auto sync_prog = makeProgram(sm, false);
+    ok = check(!sync_prog->addShaderSrc(BAD_FRAGMENT_SRC,
+                                        glt::ShaderType::FragmentShader),
+               "failed: broken shader shared") &&
+         ok;
+    return ok;
+}
+
+bool
+testSuccessfulCompile(glt::ShaderManager &sm)
+{
+    auto prog = makeProgram(sm, true);
+    bool ok =
+      check(prog->addShaderSrc(VERTEX_SRC, glt::ShaderType::VertexShader) &&
+              prog->addShaderSrc(GOOD_FRAGMENT_SRC,
+                                 glt::ShaderType::FragmentShader),
+            "successful: add shaders");
+    ok = check(!cached(sm, glt::ShaderType::FragmentShader, GOOD_FRAGMENT_SRC),
+               "successful: pending shader cached") &&
+         ok;
+    ok = check(prog->tryLink(), "successful: link") && ok;
+    ok = check(cached(sm, glt::ShaderType::FragmentShader, GOOD_FRAGMENT_SRC),
+               "successful: compiled shader not cached") &&
+         ok;
+
+    auto other = makeProgram(sm, false);
+    ok = check(other->addShaderSrc(VERTEX_SRC, glt::ShaderType::VertexShader) &&
+                 other->addShaderSrc(GOOD_FRAGMENT_SRC,
+                                     glt::ShaderType::FragmentShader) &&
+                 other->tryLink(),
+               "successful: link with cached shaders") &&
+         ok;
+    return ok;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    glt::moduleInit();
+    ge::moduleInit();
+    auto &out = sys::io::stdout();
+
+    ge::WindowOptions opts;
+    opts.width = 64;
+    opts.height = 64;
+    opts.backend = ge::WindowOptions::HeadlessEGL;
+    opts.settings.majorVersion = 3;
+    opts.settings.minorVersion = 3;
+    opts.settings.coreProfile = true;
+    opts.settings.debugContext = false;
+
+    bool ok;
+    {
+        ge::GameWindow win(opts);
+        glt::ShaderManager sm;
+        sm.setShaderVersion(330, glt::ShaderProfile::Core);
+
+        ok = testFailedCompile(sm);
+        ok = testSuccessfulCompile(sm) && ok;
+        sm.shutdown();
+    }
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+#include "glt/GLSLPreprocessor.hpp"
+#include "glt/NullGL.hpp"
+#include "glt/ShaderCompiler.hpp"
+#include "glt/ShaderManager.hpp"
+#include "glt/ShaderProgram.hpp"
+#include "glt/glt.hpp"
+#include "sys/fs.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compiles shaders including a common file on the null GL driver: the
+// included file is scanned once and shared by all programs, until its
+// modification time changes. Shader objects preprocessed together in one
+// queue, on several threads, have to match objects preprocessed one by one.
+
+namespace {
+
+const char *const COMMON_FILE = "shader_file_cache_common.h.glsl";
+const char *const VERTEX_FILES[] = { "shader_file_cache_a.vert",
+                                     "shader_file_cache_b.vert" };
+const char *const FRAGMENT_FILE = "shader_file_cache.frag";
+
+const std::string COMMON_SRC = R"(
+#ifdef DOUBLE
+float scale() { return 2.0; }
+#else
+float scale() { return 1.0; }
+#endif
+)";
+
+const std::string VERTEX_SRC = R"(
+#include "shader_file_cache_common.h.glsl"
+in vec3 position;
+void main() { gl_Position = vec4(position * scale(), 1.0); }
+)";
+
+const std::string FRAGMENT_SRC = R"(
+out vec4 color;
+void main() { color = vec4(1.0); }
+)";
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+bool
+writeFile(const std::string &path, const std::string &data)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+}
+
+bool
+link(glt::ShaderManager &sm, const char *vertex_file)
+{
+    auto prog = std::make_shared<glt::ShaderProgram>(sm);
+    prog->bindAttribute("position", 0);
+    return prog->addShaderFile(vertex_file) &&
+           prog->addShaderFile(FRAGMENT_FILE) && prog->link();
+}
+
+bool
+testMemoize(glt::ShaderManager &sm)
+{
+    auto &cache = sm.shaderCompiler().fileCache();
+    bool ok = check(link(sm, VERTEX_FILES[0]), "memoize: link");
+    // the vertex shader, the common file and the fragment shader
+    ok = check(cache.hits() == 0 && cache.misses() == 3,
+               "memoize: first program") &&
+         ok;
+
+    // the objects died with the program, the files are still scanned
+    ok = check(link(sm, VERTEX_FILES[1]), "memoize: link second") && ok;
+    ok = check(cache.hits() == 2 && cache.misses() == 4,
+               "memoize: common file scanned again") &&
+         ok;
+
+    // only the touched file is read again
+    std::error_code ec;
+    std::filesystem::last_write_time(
+      COMMON_FILE,
+      std::filesystem::last_write_time(COMMON_FILE, ec) +
+        std::chrono::seconds(10),
+      ec);
+    ok = check(!ec, "memoize: touch") && ok;
+    ok = check(link(sm, VERTEX_FILES[0]), "memoize: link touched") && ok;
+    ok = check(cache.hits() == 4 && cache.misses() == 5,
+               "memoize: touched file not read again") &&
+         ok;
+    return ok;
+}
+
+std::vector<std::shared_ptr<glt::ShaderSource>>
+makeSources()
+{
+    std::vector<std::shared_ptr<glt::ShaderSource>> sources;
+    for (const char *file : VERTEX_FILES) {
+        for (const char *define : { "SINGLE", "DOUBLE" }) {
+            sources.push_back(
+              glt::ShaderSource::makeFileSource(glt::ShaderType::VertexShader,
+                                                sys::fs::absolutePath(file),
+                                                { { define, "1" } }));
+        }
+    }
+    sources.push_back(glt::ShaderSource::makeFileSource(
+      glt::ShaderType::FragmentShader, sys::fs::absolutePath(FRAGMENT_FILE)));
+    return sources;
+}
+
+bool
+testPreprocessAll(glt::ShaderManager &sm)
+{
+    auto &compiler = sm.shaderCompiler();
+    const auto sources = makeSources();
+
+    // all loads of one queue are preprocessed in parallel
+    glt::ShaderObjects parallel;
+    glt::ShaderCompilerQueue queue(compiler, parallel, 0);
+    for (const auto &src : sources)
+        queue.enqueueLoad(src);
+    queue.compileAll();
+    bool ok = check(!queue.wasError() && parallel.size() == sources.size(),
+                    "preprocessAll: compile");
+
+    for (const auto &src : sources) {
+        glt::ShaderObjects single;
+        glt::ShaderCompilerQueue one(compiler, single, 0);
+        one.enqueueLoad(src);
+        one.compileAll();
+        auto it = parallel.find(src->key());
+        auto jt = single.find(src->key());
+        ok = check(it != parallel.end() && jt != single.end() &&
+                     it->second->codeHash() == jt->second->codeHash(),
+                   "preprocessAll: output differs") &&
+             ok;
+    }
+    return ok;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    glt::moduleInit(glt::GLBackend::Null);
+    auto &out = sys::io::stdout();
+    if (glt::glBackend() != glt::GLBackend::Null) {
+        out << "FAILED: null GL driver not loaded\n";
+        return 1;
+    }
+
+    bool ok = check(writeFile(COMMON_FILE, COMMON_SRC) &&
+                      writeFile(VERTEX_FILES[0], VERTEX_SRC) &&
+                      writeFile(VERTEX_FILES[1], VERTEX_SRC) &&
+                      writeFile(FRAGMENT_FILE, FRAGMENT_SRC),
+                    "write shader files");
+    if (ok) {
+        glt::ShaderManager sm;
+        sm.setShaderVersion(330, glt::ShaderProfile::Core);
+        ok = check(sm.prependShaderDirectory("."), "shader directory");
+        ok = ok && testMemoize(sm);
+        ok = testPreprocessAll(sm) && ok;
+        sm.shutdown();
+    }
+
+    for (const char *file : { COMMON_FILE, FRAGMENT_FILE })
+        remove(file);
+    for (const char *file : VERTEX_FILES)
+        remove(file);
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    glt::moduleExit();
+    sys::moduleExit();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,254 @@
+#include "glt/NullGL.hpp"
+#include "glt/ShaderManager.hpp"
+#include "glt/ShaderProgram.hpp"
+#include "glt/glt.hpp"
+#include "opengl.hpp"
+#include "sys/io.hpp"
+#include "sys/io/Stream.hpp"
+#include "sys/sys.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Reloads programs from changed files on the null GL driver, which finishes
+// an asynchronous link at the second poll. Without KHR_parallel_shader_compile
+// the first poll waits for the link. Files are checked once, shader objects
+// shared by two programs are compiled once. A shared shader which fails to
+// compile fails both reloads and keeps the linked programs.
+
+namespace {
+
+const char *const VERTEX_FILES[] = { "shader_reload_a.vert",
+                                     "shader_reload_b.vert" };
+const char *const FRAGMENT_FILE = "shader_reload.frag";
+const char *const COMMON_FILE = "shader_reload_common.h.glsl";
+
+const std::string COMMON_SRC = R"(
+const float SCALE = 1.0;
+)";
+
+const std::string VERTEX_SRC = R"(
+#include "shader_reload_common.h.glsl"
+in vec3 position;
+void main() { gl_Position = vec4(position, 1.0); }
+)";
+
+const std::string FRAGMENT_SRC = R"(
+out vec4 color;
+void main() { color = vec4(1.0); }
+)";
+
+const std::string BAD_FRAGMENT_SRC = R"(
+#error broken
+)";
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+uint64_t
+calls(std::string_view function)
+{
+    for (const auto &c : glt::nullGLCalls())
+        if (function == c.function)
+            return c.calls;
+    return 0;
+}
+
+// the modification time is moved ahead, files written within the same
+// second would look unchanged
+bool
+writeFile(const std::string &path, const std::string &data)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    ok = fclose(f) == 0 && ok;
+
+    static int ahead = 0;
+    ahead += 10;
+    std::error_code ec;
+    std::filesystem::last_write_time(
+      path,
+      std::filesystem::file_time_type::clock::now() +
+        std::chrono::seconds(ahead),
+      ec);
+    return ok && !ec;
+}
+
+bool
+reported(sys::io::ByteStream &log, std::string_view what)
+{
+    bool found = std::string_view(log).find(what) != std::string_view::npos;
+    log.truncate(0);
+    return found;
+}
+
+bool
+testBeginReload(glt::ShaderProgram &prog, bool parallel)
+{
+    bool ok = check(writeFile(VERTEX_FILES[0], VERTEX_SRC + "\n"),
+                    "beginReload: write");
+    ok = check(prog.beginReload(), "beginReload: begin") && ok;
+    if (parallel)
+        ok = check(prog.pollReload() == glt::AsyncReloadState::ReloadPending,
+                   "beginReload: not pending") &&
+             ok;
+    ok = check(prog.pollReload() == glt::AsyncReloadState::Reloaded,
+               "beginReload: not reloaded") &&
+         ok;
+    ok = check(prog.pollReload() == glt::AsyncReloadState::NoReload,
+               "beginReload: reloaded again") &&
+         ok;
+    return ok;
+}
+
+bool
+testReloadAsync(glt::ShaderManager &sm, sys::io::ByteStream &log, bool parallel)
+{
+    glt::resetNullGLCalls();
+    bool ok = check(writeFile(FRAGMENT_FILE, FRAGMENT_SRC + "\n"),
+                    "reloadShadersAsync: write");
+    log.truncate(0);
+    sm.reloadShadersAsync();
+    // the report is printed once the last program is relinked
+    bool relinked = reported(log, "2 of 2 programs relinked");
+    ok = check(relinked != parallel, "reloadShadersAsync: first poll") && ok;
+    ok = check(!sm.pollReloads(), "reloadShadersAsync: still pending") && ok;
+    relinked = reported(log, "2 of 2 programs relinked") || relinked;
+    ok = check(relinked, "reloadShadersAsync: not relinked") && ok;
+    ok = check((calls("glMaxShaderCompilerThreadsKHR") > 0) == parallel,
+               "reloadShadersAsync: compiler threads") &&
+         ok;
+    return ok;
+}
+
+bool
+testReverseIndex(glt::ShaderManager &sm, sys::io::ByteStream &log)
+{
+    glt::resetNullGLCalls();
+    bool ok = check(writeFile(FRAGMENT_FILE, FRAGMENT_SRC),
+                    "reverse index: write");
+    log.truncate(0);
+    sm.reloadShaders();
+    // both vertex shaders include the common file, both programs use the
+    // fragment shader
+    ok = check(reported(log,
+                        "4 files checked, 1 objects recompiled, 2 of 2 "
+                        "programs relinked"),
+               "reverse index: report") &&
+         ok;
+    ok = check(calls("glCompileShader") == 1,
+               "reverse index: shared object compiled again") &&
+         ok;
+    return ok;
+}
+
+bool
+testSharedFailure(glt::ShaderManager &sm,
+                  sys::io::ByteStream &log,
+                  glt::ShaderProgram &a,
+                  glt::ShaderProgram &b)
+{
+    bool ok = check(writeFile(FRAGMENT_FILE, BAD_FRAGMENT_SRC),
+                    "shared failure: write");
+    log.truncate(0);
+    sm.reloadShadersAsync();
+    for (int i = 0; i < 4 && sm.pollReloads(); ++i)
+        ;
+    ok = check(reported(log, "0 of 2 programs relinked"),
+               "shared failure: relinked") &&
+         ok;
+    a.use();
+    b.use();
+    ok = check(!a.wasError() && !b.wasError(),
+               "shared failure: programs unusable") &&
+         ok;
+
+    ok = check(writeFile(FRAGMENT_FILE, FRAGMENT_SRC), "shared failure: fix") &&
+         ok;
+    sm.reloadShadersAsync();
+    for (int i = 0; i < 4 && sm.pollReloads(); ++i)
+        ;
+    ok = check(reported(log, "2 of 2 programs relinked"),
+               "shared failure: not recovered") &&
+         ok;
+    return ok;
+}
+
+std::shared_ptr<glt::ShaderProgram>
+declare(glt::ShaderManager &sm, const char *name, const char *vertex_file)
+{
+    auto prog = sm.declareProgram(name);
+    prog->bindAttribute("position", 0);
+    if (prog->addShaderFile(vertex_file) &&
+        prog->addShaderFile(FRAGMENT_FILE) && prog->link())
+        return prog;
+    return nullptr;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    glt::moduleInit(glt::GLBackend::Null);
+    auto &out = sys::io::stdout();
+    if (glt::glBackend() != glt::GLBackend::Null) {
+        out << "FAILED: null GL driver not loaded\n";
+        return 1;
+    }
+
+    bool ok = check(writeFile(COMMON_FILE, COMMON_SRC) &&
+                      writeFile(VERTEX_FILES[0], VERTEX_SRC) &&
+                      writeFile(VERTEX_FILES[1], VERTEX_SRC) &&
+                      writeFile(FRAGMENT_FILE, FRAGMENT_SRC),
+                    "write shader files");
+    ok = check(GLAD_GL_KHR_parallel_shader_compile != 0,
+               "null driver without KHR_parallel_shader_compile") &&
+         ok;
+    if (ok) {
+        sys::io::ByteStream log;
+        glt::ShaderManager sm;
+        sm.out(log);
+        sm.setShaderVersion(330, glt::ShaderProfile::Core);
+        ok = check(sm.prependShaderDirectory("."), "shader directory");
+        auto a = declare(sm, "a", VERTEX_FILES[0]);
+        auto b = declare(sm, "b", VERTEX_FILES[1]);
+        ok = check(a && b, "link") && ok;
+
+        if (ok) {
+            // the fallback first, the compiler threads are set only once
+            GLAD_GL_KHR_parallel_shader_compile = 0;
+            ok = testBeginReload(*a, false);
+            ok = testReloadAsync(sm, log, false) && ok;
+            GLAD_GL_KHR_parallel_shader_compile = 1;
+            ok = testBeginReload(*a, true) && ok;
+            ok = testReloadAsync(sm, log, true) && ok;
+            ok = testReverseIndex(sm, log) && ok;
+            ok = testSharedFailure(sm, log, *a, *b) && ok;
+        }
+        sm.shutdown();
+    }
+
+    for (const char *file : VERTEX_FILES)
+        remove(file);
+    remove(FRAGMENT_FILE);
+    remove(COMMON_FILE);
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    glt::moduleExit();
+    sys::moduleExit();
+    return ok ? 0 : 1;
+}
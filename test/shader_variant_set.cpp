@@ -0,0 +1,134 @@
+#include "ge/GameWindow.hpp"
+#include "ge/ge.hpp"
+#include "glt/ShaderManager.hpp"
+#include "glt/ShaderProgram.hpp"
+#include "glt/ShaderVariantSet.hpp"
+#include "glt/glt.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <memory>
+#include <string>
+
+// Builds the variants of a small program in a headless EGL context (e.g.
+// Mesa llvmpipe): variants are built on first request or by prewarming,
+// a variant failing to compile stays failed and never reaches the
+// ShaderManager, built variants are registered there.
+
+namespace {
+
+const std::string VERTEX_SRC = R"(
+in vec3 position;
+void main() { gl_Position = vec4(position, 1.0); }
+)";
+
+const std::string FRAGMENT_SRC = R"(
+out vec4 color;
+void main() {
+#if BROKEN
+    color = vec4(undeclared);
+#else
+    color = vec4(COLOR);
+#endif
+}
+)";
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+bool
+registered(glt::ShaderManager &sm, const char *name)
+{
+    return sm.program(std::string("variants") + name) != nullptr;
+}
+
+bool
+testVariants(glt::ShaderManager &sm)
+{
+    auto set = sm.declareVariantSet("variants");
+    set->addShaderSrc(VERTEX_SRC, glt::ShaderType::VertexShader);
+    set->addShaderSrc(FRAGMENT_SRC, glt::ShaderType::FragmentShader);
+    set->bindAttribute("position", 0);
+    const auto broken = set->addFlag("BROKEN");
+    const auto colors = set->addOption("COLOR", { "0.0", "0.5", "1.0" });
+    bool ok = check(broken == 1 && colors == 6, "masks");
+    const auto half = set->option("COLOR", "0.5");
+    const auto one = set->option("COLOR", "1.0");
+
+    // nothing is built before it is requested
+    ok = check(set->size() == 0 && !registered(sm, "{2}"), "lazy: built") &&
+         ok;
+
+    auto prog = set->program(half);
+    ok = check(prog != nullptr, "lazy: build") && ok;
+    ok = check(set->size() == 1 && registered(sm, "{2}"),
+               "lazy: not registered") &&
+         ok;
+    ok = check(set->program(half) == prog, "lazy: rebuilt") && ok;
+
+    // a failed variant is not retried and not registered
+    ok = check(set->program(broken | half) == nullptr, "failed: built") && ok;
+    ok = check(set->program(broken | half) == nullptr, "failed: retried") &&
+         ok;
+    ok = check(set->size() == 1 && !registered(sm, "{3}"),
+               "failed: registered") &&
+         ok;
+
+    // the option has no fourth value
+    ok = check(set->program(colors) == nullptr, "invalid mask accepted") &&
+         ok;
+    ok = check(set->addFlag("LATE") == 0, "key added after a build") && ok;
+
+    // prewarmed variants get ready or fail through pollPrewarm()
+    set->prewarm(one);
+    set->prewarm(broken | one);
+    ok = check(set->size() == 1, "prewarm: built before polling") && ok;
+    for (int i = 0; i < 1000 && sm.pollPrewarm(); ++i)
+        ;
+    ok = check(set->size() == 2 && registered(sm, "{4}"), "prewarm: ready") &&
+         ok;
+    ok = check(!registered(sm, "{5}") && set->program(broken | one) == nullptr,
+               "prewarm: failed") &&
+         ok;
+    ok = check(set->program(one) == sm.program("variants{4}"),
+               "prewarm: rebuilt") &&
+         ok;
+    return ok;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    glt::moduleInit();
+    ge::moduleInit();
+    auto &out = sys::io::stdout();
+
+    ge::WindowOptions opts;
+    opts.width = 64;
+    opts.height = 64;
+    opts.backend = ge::WindowOptions::HeadlessEGL;
+    opts.settings.majorVersion = 3;
+    opts.settings.minorVersion = 3;
+    opts.settings.coreProfile = true;
+    opts.settings.debugContext = false;
+
+    bool ok;
+    {
+        ge::GameWindow win(opts);
+        glt::ShaderManager sm;
+        sm.setShaderVersion(330, glt::ShaderProfile::Core);
+        ok = testVariants(sm);
+        sm.shutdown();
+    }
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+#include "glt/TextureAtlas.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Packs random rectangles and images without a GL context and checks the
+// layout: nothing overlaps or leaves its page, borders repeat the image
+// edges, mip alignment holds and UV remapping hits the right texels.
+
+namespace {
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+glt::Image
+solid(uint32_t w, uint32_t h, uint8_t value)
+{
+    glt::Image img;
+    img.resize(w, h, 1);
+    for (auto &p : img.pixels)
+        p = value;
+    return img;
+}
+
+bool
+testSkyline()
+{
+    auto &out = sys::io::stdout();
+    bool ok = true;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<uint32_t> size(1, 64);
+
+    glt::SkylinePacker packer(512, 512);
+    std::vector<glt::AtlasRect> rects;
+    for (int i = 0; i < 400; ++i) {
+        glt::AtlasRect r;
+        if (packer.insert(size(rng), size(rng), r))
+            rects.push_back(r);
+    }
+
+    bool inside = true, disjoint = true;
+    for (size_t i = 0; i < rects.size(); ++i) {
+        const auto &r = rects[i];
+        inside = inside && r.x + r.width <= 512 && r.y + r.height <= 512;
+        for (size_t j = i + 1; j < rects.size(); ++j)
+            disjoint = disjoint && !r.overlaps(rects[j]);
+    }
+    out << "skyline: " << rects.size() << " rects, occupancy "
+        << packer.occupancy() << "\n";
+    ok = check(inside, "skyline: rects inside the bin") && ok;
+    ok = check(disjoint, "skyline: rects disjoint") && ok;
+    ok = check(packer.occupancy() > 0.7, "skyline: occupancy") && ok;
+
+    glt::AtlasRect r;
+    ok = check(!packer.insert(513, 1, r), "skyline: too wide") && ok;
+    return ok;
+}
+
+bool
+testAtlas()
+{
+    bool ok = true;
+    glt::AtlasOptions opts;
+    opts.page_size = 128;
+    opts.padding = 1;
+    opts.mip_levels = 3;
+    glt::TextureAtlas atlas(opts);
+
+    std::vector<glt::Image> images;
+    for (uint32_t i = 0; i < 40; ++i)
+        images.push_back(solid(5 + i % 7, 3 + i % 11, uint8_t(i + 1)));
+    for (uint32_t i = 0; i < images.size(); ++i)
+        atlas.add("img" + std::to_string(i), images[i]);
+
+    if (!check(atlas.build(), "atlas: build"))
+        return false;
+
+    const uint32_t align = 4;
+    for (uint32_t i = 0; i < images.size(); ++i) {
+        const auto &e = atlas.entry(i);
+        const auto &img = images[i];
+        const auto &page = atlas.pages()[e.page];
+
+        ok = check(e.rect.width == img.width && e.rect.height == img.height,
+                   "atlas: rect size") &&
+             ok;
+        ok = check((e.rect.x - opts.padding) % align == 0 &&
+                     (e.rect.y - opts.padding) % align == 0,
+                   "atlas: mip alignment") &&
+             ok;
+
+        // the image and its padding hold only its own value
+        bool own = true;
+        for (uint32_t y = e.rect.y - 1; y <= e.rect.y + e.rect.height; ++y)
+            for (uint32_t x = e.rect.x - 1; x <= e.rect.x + e.rect.width; ++x)
+                own = own && page.pixels[size_t(y) * page.width + x] == i + 1;
+        ok = check(own, "atlas: image and border") && ok;
+
+        // the centre of the image
+        auto uv = e.remap(math::vec2(0.5f, 0.5f));
+        auto tx = uint32_t(uv[0] * page.width);
+        auto ty = uint32_t(uv[1] * page.height);
+        ok = check(tx >= e.rect.x && tx < e.rect.x + e.rect.width &&
+                     ty >= e.rect.y && ty < e.rect.y + e.rect.height,
+                   "atlas: uv remap") &&
+             ok;
+    }
+
+    ok = check(atlas.find("img7") == &atlas.entry(7), "atlas: find") && ok;
+    ok = check(atlas.find("nope") == nullptr, "atlas: find missing") && ok;
+
+    glt::TextureAtlas small({ .page_size = 16, .padding = 2, .mip_levels = 1 });
+    auto big = solid(16, 4, 1);
+    small.add("big", big);
+    ok = check(!small.build(), "atlas: image larger than a page") && ok;
+    return ok;
+}
+
+bool
+testArrays()
+{
+    bool ok = true;
+    std::vector<glt::Image> images;
+    for (int i = 0; i < 5; ++i)
+        images.push_back(solid(32, 32, 1));
+    images.push_back(solid(16, 16, 1));
+    images.push_back(solid(32, 32, 1));
+
+    glt::TextureArrayPacker packer;
+    for (size_t i = 0; i < images.size(); ++i)
+        packer.add("img" + std::to_string(i), images[i]);
+    packer.build(4);
+
+    ok = check(packer.arrays().size() == 3, "arrays: groups") && ok;
+    ok = check(packer.entry(3).array == 0 && packer.entry(3).layer == 3,
+               "arrays: first group") &&
+         ok;
+    ok = check(packer.entry(4).array == 1 && packer.entry(4).layer == 0,
+               "arrays: group full") &&
+         ok;
+    ok = check(packer.entry(5).array == 2 && packer.entry(5).layer == 0,
+               "arrays: other size") &&
+         ok;
+    ok = check(packer.entry(6).array == 1 && packer.entry(6).layer == 1,
+               "arrays: open group reused") &&
+         ok;
+    return ok;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+
+    bool ok = testSkyline();
+    ok = testAtlas() && ok;
+    ok = testArrays() && ok;
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    return ok ? 0 : 1;
+}
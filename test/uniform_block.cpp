@@ -0,0 +1,141 @@
+#include "err/err.hpp"
+#include "glt/UniformBlock.hpp"
+#include "math/mat3.hpp"
+#include "math/mat4.hpp"
+#include "math/vec2.hpp"
+#include "math/vec3.hpp"
+#include "math/vec4.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+// Checks the std140 offsets and sizes derived from DEF_GL_MAPPED_TYPE
+// against offsets computed by hand from the rules in the GL spec (section
+// 7.6.2.2), and that packStd140 puts the values there. No GL context needed.
+
+using namespace math;
+
+DEF_GL_MAPPED_TYPE(Transform, (mat4_t, mvp), (vec4_t, color), (real, scale))
+
+DEF_GL_MAPPED_TYPE(Mixed,
+                   (real, a),
+                   (vec3_t, b),
+                   (real, c),
+                   (vec2_t, d),
+                   (mat3_t, e),
+                   (int32_t, f),
+                   (vec3_t, g))
+
+namespace {
+
+template<typename T>
+bool
+checkLayout(sys::io::OutStream &out,
+            const char *name,
+            std::initializer_list<uint16_t> offsets,
+            size_t size)
+{
+    using layout = glt::Std140Layout<T>;
+    ASSERT(offsets.size() == layout::count);
+    bool ok = layout::size == size;
+    if (!ok)
+        out << "FAILED: " << name << ": size " << layout::size
+            << ", expected " << size << "\n";
+    for (size_t i = 0; i < layout::count; ++i) {
+        const auto expected = offsets.begin()[i];
+        if (layout::offsets[i] != expected) {
+            out << "FAILED: " << name << ": member " << i << " at "
+                << layout::offsets[i] << ", expected " << expected << "\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+template<typename U>
+U
+load(const std::vector<char> &buf, size_t offset)
+{
+    U x;
+    memcpy(&x, buf.data() + offset, sizeof x);
+    return x;
+}
+
+bool
+checkPack(sys::io::OutStream &out)
+{
+    using layout = glt::Std140Layout<Mixed>;
+
+    Mixed m;
+    m.a = 1;
+    m.b = vec3(2, 3, 4);
+    m.c = 5;
+    m.d = vec2(6, 7);
+    m.e = mat3(vec3(8, 9, 10), vec3(11, 12, 13), vec3(14, 15, 16));
+    m.f = -17;
+    m.g = vec3(18, 19, 20);
+
+    const Mixed::gl gl_m(m);
+    std::vector<char> buf(layout::size, 0);
+    glt::packStd140(layout::struct_info::info,
+                    layout::members,
+                    layout::offsets,
+                    &gl_m,
+                    buf);
+
+    // floats at their std140 offsets, matrix columns at a stride of 16
+    const std::array<std::pair<size_t, float>, 19> floats{ {
+      { 0, 1.f },   { 16, 2.f },  { 20, 3.f },  { 24, 4.f },  { 28, 5.f },
+      { 32, 6.f },  { 36, 7.f },  { 48, 8.f },  { 52, 9.f },  { 56, 10.f },
+      { 64, 11.f }, { 68, 12.f }, { 72, 13.f }, { 80, 14.f }, { 84, 15.f },
+      { 88, 16.f }, { 112, 18.f }, { 116, 19.f }, { 120, 20.f },
+    } };
+
+    bool ok = true;
+    for (const auto &[offset, value] : floats) {
+        if (load<float>(buf, offset) != value) {
+            out << "FAILED: packed float at " << offset << " is "
+                << load<float>(buf, offset) << ", expected " << value << "\n";
+            ok = false;
+        }
+    }
+    if (load<int32_t>(buf, 96) != -17) {
+        out << "FAILED: packed int at 96\n";
+        ok = false;
+    }
+
+    // the padding after vec3 columns stays untouched
+    if (load<float>(buf, 60) != 0.f || load<float>(buf, 76) != 0.f) {
+        out << "FAILED: matrix column padding written\n";
+        ok = false;
+    }
+    return ok;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    auto &out = sys::io::stdout();
+
+    bool ok = true;
+    // mat4: 4 columns of 16, vec4 at 64, float at 80, rounded up to 96
+    ok = checkLayout<Transform>(out, "Transform", { 0, 64, 80 }, 96) && ok;
+    // vec3 aligns to 16 and a float fills its last component, vec2 aligns
+    // to 8, mat3 columns are padded to vec4
+    ok = checkLayout<Mixed>(
+           out, "Mixed", { 0, 16, 28, 32, 48, 96, 112 }, 128) &&
+         ok;
+    ok = checkPack(out) && ok;
+
+    out << (ok ? "uniform_block: ok\n" : "uniform_block: FAILED\n");
+    sys::moduleExit();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include "glt/NullGL.hpp"
+#include "glt/ShaderManager.hpp"
+#include "glt/ShaderProgram.hpp"
+#include "glt/Uniforms.hpp"
+#include "glt/glt.hpp"
+#include "math/vec3.hpp"
+#include "sys/io.hpp"
+#include "sys/sys.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Sets uniforms of a program on the null GL driver and counts the
+// glProgramUniform* calls which reach it: a value equal to the last upload
+// is skipped, a changed or invalidated value is uploaded again.
+
+namespace {
+
+const std::string VERTEX_SRC = R"(
+in vec3 position;
+uniform float scale;
+uniform vec3 offset;
+void main() { gl_Position = vec4(position * scale + offset, 1.0); }
+)";
+
+const std::string FRAGMENT_SRC = R"(
+out vec4 color;
+void main() { color = vec4(1.0); }
+)";
+
+bool
+check(bool cond, const char *what)
+{
+    if (!cond)
+        sys::io::stdout() << "FAILED: " << what << "\n";
+    return cond;
+}
+
+uint64_t
+calls(std::string_view function)
+{
+    for (const auto &c : glt::nullGLCalls())
+        if (function == c.function)
+            return c.calls;
+    return 0;
+}
+
+bool
+expect(uint64_t uploads, size_t issued, size_t skipped, const char *what)
+{
+    const auto stats = glt::uniformStatistics();
+    return check(calls("glProgramUniform1fv") + calls("glProgramUniform3fv") ==
+                     uploads &&
+                   stats.issued == issued && stats.skipped == skipped,
+                 what);
+}
+
+bool
+testShadowState(glt::ShaderProgram &prog)
+{
+    glt::resetNullGLCalls();
+    glt::resetUniformStatistics();
+
+    glt::Uniforms(prog).optional("scale", 1.f);
+    bool ok = expect(1, 1, 0, "first upload");
+    glt::Uniforms(prog).optional("scale", 1.f);
+    ok = expect(1, 1, 1, "same value uploaded") && ok;
+    glt::Uniforms(prog).optional("scale", 2.f);
+    ok = expect(2, 2, 1, "changed value skipped") && ok;
+
+    // every uniform has its own shadow
+    glt::Uniforms(prog)
+      .optional("offset", math::vec3(1, 2, 3))
+      .optional("scale", 2.f);
+    ok = expect(3, 3, 2, "second uniform") && ok;
+
+    // the location is only queried once
+    ok = check(calls("glGetUniformLocation") == 2, "location queried again") &&
+         ok;
+
+    prog.uniformCache().invalidate();
+    glt::Uniforms(prog).optional("scale", 2.f);
+    ok = expect(4, 4, 2, "invalidated value skipped") && ok;
+    return ok;
+}
+
+} // namespace
+
+int
+main()
+{
+    sys::moduleInit();
+    glt::moduleInit(glt::GLBackend::Null);
+    auto &out = sys::io::stdout();
+    if (glt::glBackend() != glt::GLBackend::Null) {
+        out << "FAILED: null GL driver not loaded\n";
+        return 1;
+    }
+
+    bool ok;
+    {
+        glt::ShaderManager sm;
+        sm.setShaderVersion(330, glt::ShaderProfile::Core);
+        auto prog = std::make_shared<glt::ShaderProgram>(sm);
+        prog->bindAttribute("position", 0);
+        ok = check(
+          prog->addShaderSrc(VERTEX_SRC, glt::ShaderType::VertexShader) &&
+            prog->addShaderSrc(FRAGMENT_SRC, glt::ShaderType::FragmentShader) &&
+            prog->link(),
+          "link");
+        ok = ok && testShadowState(*prog);
+        sm.shutdown();
+    }
+
+    out << "result: " << (ok ? "ok" : "BROKEN") << "\n";
+    glt::moduleExit();
+    sys::moduleExit();
+    return ok ? 0 : 1;
+}